@@ -0,0 +1,94 @@
+#include "admission.h"
+#include "metrics.h"
+#include <stdatomic.h>
+
+// 워커 하나의 큐 상태 (CoDel 을 요청 큐에 맞게 바꾼 것)
+// 한 구간 동안 본 가장 짧은 대기가 target 보다 길었으면 큐가 한 번도 비지 않은 것이므로 다음 구간은 과부하로 본다
+typedef struct
+{
+    uint64_t interval_end;    // 지금 구간이 끝나는 시각 (ns)
+    uint64_t min_queued;      // 지금 구간에서 본 가장 짧은 큐 대기
+    int      overloaded;      // 지난 구간이 과부하였다
+} QueueState;
+
+static uint64_t     target_ns;                           // 0 이면 큐 대기로 거절하지 않는다
+static unsigned int limits[ADMIT_PRIORITIES];            // 우선순위별 동시 처리 상한 (0 이면 없음)
+static atomic_uint  inflight[ADMIT_PRIORITIES];          // 받아서 아직 응답하지 않은 요청
+static _Thread_local QueueState queue_state;             // 워커마다 자기 덱을 비우므로 상태도 워커마다 둔다 (락이 없다)
+
+static int shed(int priority);
+
+// 워커를 만들기 전에 한 번 부른다. target_ms 가 0 이면 큐 대기로 거절하지 않고, 상한이 0 이면 동시 처리 수를 제한하지 않는다
+void admission_init(int target_ms, unsigned int normal_limit, unsigned int low_limit)
+{
+    target_ns            = (uint64_t)target_ms * 1000000ULL;
+    limits[ADMIT_NORMAL] = normal_limit;
+    limits[ADMIT_LOW]    = low_limit;
+    for(int i = 0; i < ADMIT_PRIORITIES; ++i)
+    {
+        atomic_init(&inflight[i], 0);
+    }
+}
+
+// 요청 하나를 처리하기 전에 부른다. queued_ns 는 워커 큐에서 기다린 시간 (큐를 거치지 않았으면 0)
+// 받으면 1 (응답한 뒤 admission_leave), 거절하면 0
+// 과부하면 target 보다 오래 기다린 요청과 ADMIT_LOW 를, 아니면 ADMIT_INTERVAL_MS 보다 오래 기다린 요청만 거절한다
+// 오래 기다린 요청은 클라이언트가 이미 포기했을 가능성이 크므로 처리하지 않고 빨리 503 을 보내 큐를 줄인다
+int admission_enter(int priority, uint64_t queued_ns, uint64_t now)
+{
+    QueueState *state = &queue_state;
+
+    if(priority == ADMIT_CRITICAL)
+    {
+        atomic_fetch_add_explicit(&inflight[priority], 1, memory_order_relaxed);
+        return 1;
+    }
+    if(target_ns != 0 && queued_ns != 0)
+    {
+        if(now >= state->interval_end)
+        {
+            // 요청이 없는 구간이 통째로 지났으면 그동안 큐는 비어 있었다 (오래전 구간의 과부하를 이어 가지 않는다)
+            if(now >= state->interval_end + ADMIT_INTERVAL_MS * 1000000ULL)
+            {
+                state->overloaded = 0;
+            }
+            else
+            {
+                state->overloaded = state->interval_end != 0 && state->min_queued > target_ns;
+            }
+            state->interval_end = now + ADMIT_INTERVAL_MS * 1000000ULL;
+            state->min_queued   = UINT64_MAX;
+        }
+        if(queued_ns < state->min_queued)
+        {
+            state->min_queued = queued_ns;
+        }
+        if(state->overloaded ? queued_ns > target_ns || priority == ADMIT_LOW : queued_ns > ADMIT_INTERVAL_MS * 1000000ULL)
+        {
+            return shed(priority);
+        }
+    }
+    if(atomic_fetch_add_explicit(&inflight[priority], 1, memory_order_relaxed) >= limits[priority] && limits[priority] != 0)
+    {
+        atomic_fetch_sub_explicit(&inflight[priority], 1, memory_order_relaxed);
+        return shed(priority);
+    }
+    return 1;
+}
+
+void admission_leave(int priority)
+{
+    atomic_fetch_sub_explicit(&inflight[priority], 1, memory_order_relaxed);
+}
+
+// 지표용
+unsigned int admission_inflight(int priority)
+{
+    return atomic_load_explicit(&inflight[priority], memory_order_relaxed);
+}
+
+static int shed(int priority)
+{
+    metrics_count(priority == ADMIT_LOW ? METRIC_SHED_LOW : METRIC_SHED_NORMAL, 1);
+    return 0;
+}
@@ -0,0 +1,21 @@
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include <stdint.h>
+
+// 요청 우선순위
+#define ADMIT_CRITICAL 0    // /metrics 와 오류 응답: 과부하에도 받는다 (감시가 끊기지 않도록)
+#define ADMIT_NORMAL 1      // GET, HEAD
+#define ADMIT_LOW 2         // POST: 저장과 fsync 를 기다리므로 과부하면 먼저 거절한다
+#define ADMIT_PRIORITIES 3
+
+#define ADMIT_DEFAULT_TARGET_MS 10    // 큐 대기 목표 (이보다 오래 기다리는 상태가 ADMIT_INTERVAL_MS 동안 이어지면 과부하)
+#define ADMIT_INTERVAL_MS 100         // 과부하가 아닐 때도 이보다 오래 기다린 요청은 거절한다
+#define ADMIT_RETRY_AFTER 1           // 거절할 때 보내는 Retry-After (초)
+
+void         admission_init(int target_ms, unsigned int normal_limit, unsigned int low_limit);
+int          admission_enter(int priority, uint64_t queued_ns, uint64_t now);
+void         admission_leave(int priority);
+unsigned int admission_inflight(int priority);
+
+#endif
@@ -0,0 +1,158 @@
+#include "arena.h"
+#include <pthread.h>
+#include <stdlib.h>
+
+#define ALIGN_UP(n) (((n) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+#define BLOCK_HEADER ALIGN_UP(sizeof(ArenaBlock))
+
+// 스레드마다 가진 빈 블록 목록 (다른 스레드가 만든 연결을 닫아도 닫은 스레드의 목록으로 간다)
+typedef struct
+{
+    ArenaBlock *free;
+    int         count;
+} BlockCache;
+
+static _Thread_local BlockCache block_cache;
+static pthread_key_t            cache_key;    // 스레드가 끝날 때 목록을 비운다
+static pthread_once_t           cache_once = PTHREAD_ONCE_INIT;
+
+static ArenaBlock *block_get(size_t size);
+static void        block_put(ArenaBlock *block);
+static void        cache_key_create(void);
+static void        cache_release(void *arg);
+
+// 첫 블록을 받아 그 앞쪽에 아레나를 둔다. 메모리가 없으면 NULL
+Arena *arena_create(void)
+{
+    ArenaBlock *block = block_get(ARENA_BLOCK_SIZE);
+    Arena      *arena;
+
+    if(block == NULL)
+    {
+        return NULL;
+    }
+    block->next       = NULL;
+    arena             = (Arena *)((char *)block + BLOCK_HEADER);
+    arena->blocks     = block;
+    arena->used       = BLOCK_HEADER + ALIGN_UP(sizeof(Arena));
+    arena->mark_block = block;
+    arena->mark_used  = arena->used;
+    return arena;
+}
+
+// 모든 블록을 이 스레드의 목록에 돌려준다 (아레나도 첫 블록과 함께 사라진다)
+void arena_destroy(Arena *arena)
+{
+    ArenaBlock *block = arena->blocks;
+
+    while(block != NULL)
+    {
+        ArenaBlock *next = block->next;
+
+        block_put(block);
+        block = next;
+    }
+}
+
+// ARENA_ALIGN 으로 맞춘 size 바이트. 내용은 초기화하지 않는다. 메모리가 없으면 NULL
+void *arena_alloc(Arena *arena, size_t size)
+{
+    ArenaBlock *block;
+    size_t      need = ALIGN_UP(size);
+    void       *ptr;
+
+    if(arena->used + need <= arena->blocks->size)
+    {
+        ptr = (char *)arena->blocks + arena->used;
+        arena->used += need;
+        return ptr;
+    }
+
+    // 지금 블록의 남은 자리는 버린다. 한 블록에 들어가지 않으면 그 크기만큼의 블록을 따로 만든다
+    block = block_get(BLOCK_HEADER + need > ARENA_BLOCK_SIZE ? BLOCK_HEADER + need : ARENA_BLOCK_SIZE);
+    if(block == NULL)
+    {
+        return NULL;
+    }
+    block->next   = arena->blocks;
+    arena->blocks = block;
+    arena->used   = BLOCK_HEADER + need;
+    return (char *)block + BLOCK_HEADER;
+}
+
+// 지금까지 할당한 것은 arena_reset 으로 되돌리지 않는다 (연결이 살아 있는 동안 쓰는 것)
+void arena_mark(Arena *arena)
+{
+    arena->mark_block = arena->blocks;
+    arena->mark_used  = arena->used;
+}
+
+// arena_mark 뒤에 할당한 것을 모두 되돌린다. 늘어난 블록 수에만 비례한다 (요청 하나면 보통 0 이나 1)
+void arena_reset(Arena *arena)
+{
+    while(arena->blocks != arena->mark_block)
+    {
+        ArenaBlock *next = arena->blocks->next;
+
+        block_put(arena->blocks);
+        arena->blocks = next;
+    }
+    arena->used = arena->mark_used;
+}
+
+// 기본 크기 블록은 이 스레드의 목록에서 먼저 꺼낸다
+static ArenaBlock *block_get(size_t size)
+{
+    ArenaBlock *block;
+
+    if(size == ARENA_BLOCK_SIZE && block_cache.free != NULL)
+    {
+        block            = block_cache.free;
+        block_cache.free = block->next;
+        block_cache.count--;
+        return block;
+    }
+    block = (ArenaBlock *)malloc(size);
+    if(block != NULL)
+    {
+        block->size = size;
+    }
+    return block;
+}
+
+static void block_put(ArenaBlock *block)
+{
+    if(block->size != ARENA_BLOCK_SIZE || block_cache.count >= ARENA_CACHE_BLOCKS)
+    {
+        free(block);
+        return;
+    }
+    if(block_cache.count == 0 && block_cache.free == NULL)
+    {
+        // 스레드가 끝날 때 cache_release 가 불리도록 값을 걸어 둔다
+        pthread_once(&cache_once, cache_key_create);
+        pthread_setspecific(cache_key, &block_cache);
+    }
+    block->next      = block_cache.free;
+    block_cache.free = block;
+    block_cache.count++;
+}
+
+static void cache_key_create(void)
+{
+    pthread_key_create(&cache_key, cache_release);
+}
+
+static void cache_release(void *arg)
+{
+    BlockCache *cache = (BlockCache *)arg;
+
+    while(cache->free != NULL)
+    {
+        ArenaBlock *next = cache->free->next;
+
+        free(cache->free);
+        cache->free = next;
+    }
+    cache->count = 0;
+}
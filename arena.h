@@ -0,0 +1,35 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_BLOCK_SIZE 8192      // 블록 크기 (연결 구조체와 기본 수신 버퍼, 응답 버퍼가 첫 블록에 들어간다)
+#define ARENA_CACHE_BLOCKS 256     // 스레드마다 다시 쓰려고 들고 있는 빈 블록 수 (넘치면 free)
+#define ARENA_ALIGN 16
+
+// 블록 머리. 데이터는 바로 뒤에 이어진다
+typedef struct ArenaBlock
+{
+    struct ArenaBlock *next;    // 아레나에서는 먼저 받은 블록, 스레드 캐시에서는 다음 빈 블록
+    size_t             size;    // 머리를 포함한 크기 (ARENA_BLOCK_SIZE 보다 크면 큰 할당 하나만 담은 블록)
+} ArenaBlock;
+
+// 연결마다 하나씩 쓰는 bump 할당기 구조체 정의
+// 할당은 포인터를 옮기기만 하고 하나씩 돌려주지 않는다. arena_reset 이 arena_mark 뒤의 할당을 한꺼번에 되돌린다
+// 블록은 스레드마다 둔 빈 블록 목록에서 받고 돌려주므로 평소에는 malloc 을 부르지 않는다 (캐시가 빌 때와 큰 할당만)
+// 락이 없다. 한 번에 한 스레드만 쓴다 (연결을 가진 리액터나 워커)
+typedef struct
+{
+    ArenaBlock *blocks;        // 지금 쓰는 블록이 앞 (아레나 자신은 맨 뒤 블록에 있다)
+    size_t      used;          // 지금 블록에서 쓴 바이트 (머리 포함)
+    ArenaBlock *mark_block;    // arena_reset 이 돌아갈 블록과 위치
+    size_t      mark_used;
+} Arena;
+
+Arena *arena_create(void);
+void   arena_destroy(Arena *arena);
+void  *arena_alloc(Arena *arena, size_t size);
+void   arena_mark(Arena *arena);
+void   arena_reset(Arena *arena);
+
+#endif
@@ -0,0 +1,674 @@
+// 부하 생성기: 여러 연결로 GET, HEAD, POST 를 섞어 보내고 처리량과 지연 분위수를 잰다
+// 닫힌 루프 (기본): 연결마다 응답을 받으면 바로 다음 요청을 보낸다 (서버가 낼 수 있는 최대 처리량)
+// 열린 루프 (-r): 전체 rate 요청/초를 정해진 시각에 보내고, 지연은 보내야 했던 시각부터 잰다
+//                 (서버가 밀리면 기다린 시간도 지연에 들어간다, coordinated omission 보정)
+// 사용법: bench_load [-c 연결 수] [-t 스레드 수] [-d 초] [-w 예열 초] [-r 요청/초] [-m GET:HEAD:POST] [-g 경로] [-p 경로] [-h 주소] [-j] <port>
+#define _GNU_SOURCE    // strcasestr, memmem
+
+#include "metrics.h"    // 지연 히스토그램 버킷 (서버의 /metrics 와 같은 방식)
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define DEFAULT_CONNECTIONS 64
+#define DEFAULT_DURATION 10      // 초
+#define REQUEST_SIZE 512
+#define RESPONSE_BUF_SIZE (64 * 1024)
+#define base 10
+
+// 요청 종류
+#define REQ_GET 0
+#define REQ_HEAD 1
+#define REQ_POST 2
+#define REQ_KINDS 3
+
+// 연결 상태
+#define CLIENT_IDLE 0       // 다음 요청을 기다린다 (열린 루프에서 보낼 시각 전)
+#define CLIENT_WRITING 1    // 요청을 보내는 중
+#define CLIENT_READING 2    // 응답을 받는 중
+
+typedef struct
+{
+    const char        *host;
+    int                port;
+    struct sockaddr_in addr;
+    int                connections;
+    int                threads;
+    double             duration;
+    double             warmup;
+    double             rate;              // 0 이면 닫힌 루프
+    int                mix[REQ_KINDS];    // 요청 종류별 비율
+    const char        *get_path;
+    const char        *post_path;
+    int                json;
+} Options;
+
+typedef struct
+{
+    int      fd;
+    int      state;
+    int      kind;
+    char     out[REQUEST_SIZE];
+    size_t   out_len;
+    size_t   out_pos;
+    char    *in;             // 응답 헤더 (본문은 길이만 세고 버린다)
+    size_t   in_len;
+    size_t   header_len;     // 0 이면 아직 헤더를 받는 중
+    long     body_len;       // Content-Length
+    long     body_left;      // 더 받아야 할 본문 길이
+    int      status;
+    int      close_after;    // 응답 뒤에 서버가 연결을 닫는다
+    uint64_t started;        // 지연을 재기 시작한 시각 (열린 루프면 보내기로 한 시각)
+    uint64_t next_send;      // 열린 루프: 다음 요청을 보낼 시각
+} Client;
+
+typedef struct
+{
+    const Options *options;
+    int            id;
+    int            nclients;
+    uint64_t       interval;        // 열린 루프: 연결 하나의 요청 간격 (ns)
+    uint64_t       measure_from;    // 이 시각 이후에 끝난 요청만 센다 (예열 제외)
+    uint64_t       stop_at;
+    unsigned int   seed;
+    long           post_seq;
+    // 결과
+    uint64_t       buckets[METRICS_BUCKETS];
+    uint64_t       requests[REQ_KINDS];
+    uint64_t       status[6];       // 1xx ~ 5xx, [0] 은 그 밖
+    uint64_t       errors;          // 연결 오류, 응답 해석 실패
+    uint64_t       bytes;
+    uint64_t       max_ns;
+    uint64_t       sum_ns;
+} LoadThread;
+
+static void     usage(const char *name);
+static int      parse_mix(const char *str, int *mix);
+static void    *load_function(void *arg);
+static int      client_connect(LoadThread *thread, int epfd, Client *client);
+static void     client_start(LoadThread *thread, int epfd, Client *client, uint64_t now);
+static int      client_write(int epfd, Client *client);
+static int      client_read(Client *client);
+static void     client_close(int epfd, Client *client);
+static int      parse_header(Client *client);
+static void     record(LoadThread *thread, const Client *client, uint64_t now);
+static uint64_t quantile(const uint64_t *buckets, uint64_t count, double q);
+static void     set_events(int epfd, Client *client, uint32_t events);
+
+int main(int argc, char *argv[])
+{
+    Options     options;
+    LoadThread *threads;
+    pthread_t  *tids;
+    uint64_t    buckets[METRICS_BUCKETS] = {0};
+    uint64_t    requests[REQ_KINDS]      = {0};
+    uint64_t    status[6]                = {0};
+    uint64_t    errors = 0;
+    uint64_t    bytes  = 0;
+    uint64_t    max_ns = 0;
+    uint64_t    sum_ns = 0;
+    uint64_t    count  = 0;
+    uint64_t    start;
+    int         opt;
+
+    memset(&options, 0, sizeof(options));
+    options.host         = "127.0.0.1";
+    options.connections  = DEFAULT_CONNECTIONS;
+    options.threads      = 0;
+    options.duration     = DEFAULT_DURATION;
+    options.mix[REQ_GET] = 1;
+    options.get_path     = "/index.html";
+    options.post_path    = "/writer.html";
+
+    while((opt = getopt(argc, argv, "c:t:d:w:r:m:g:p:h:j")) != -1)
+    {
+        switch(opt)
+        {
+            case 'c':
+                options.connections = (int)strtol(optarg, NULL, base);
+                break;
+            case 't':
+                options.threads = (int)strtol(optarg, NULL, base);
+                break;
+            case 'd':
+                options.duration = strtod(optarg, NULL);
+                break;
+            case 'w':
+                options.warmup = strtod(optarg, NULL);
+                break;
+            case 'r':
+                options.rate = strtod(optarg, NULL);
+                break;
+            case 'm':
+                if(parse_mix(optarg, options.mix) == -1)
+                {
+                    usage(argv[0]);
+                }
+                break;
+            case 'g':
+                options.get_path = optarg;
+                break;
+            case 'p':
+                options.post_path = optarg;
+                break;
+            case 'h':
+                options.host = optarg;
+                break;
+            case 'j':
+                options.json = 1;
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+    if(argc - optind != 1 || options.connections <= 0 || options.duration <= 0 || options.rate < 0)
+    {
+        usage(argv[0]);
+    }
+    options.port = (int)strtol(argv[optind], NULL, base);
+    if(options.threads <= 0)
+    {
+        long ncpu       = sysconf(_SC_NPROCESSORS_ONLN);
+        options.threads = ncpu > 0 ? (int)ncpu : 1;
+    }
+    if(options.threads > options.connections)
+    {
+        options.threads = options.connections;
+    }
+    options.addr.sin_family = AF_INET;
+    options.addr.sin_port   = htons((uint16_t)options.port);
+    if(inet_pton(AF_INET, options.host, &(options.addr.sin_addr)) != 1)
+    {
+        fprintf(stderr, "bad address: %s\n", options.host);
+        exit(EXIT_FAILURE);
+    }
+
+    threads = (LoadThread *)calloc((size_t)options.threads, sizeof(LoadThread));
+    tids    = (pthread_t *)calloc((size_t)options.threads, sizeof(pthread_t));
+    if(threads == NULL || tids == NULL)
+    {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    start = metrics_now();
+    for(int i = 0; i < options.threads; ++i)
+    {
+        LoadThread *thread = &threads[i];
+
+        thread->options      = &options;
+        thread->id           = i;
+        thread->nclients     = options.connections / options.threads + (i < options.connections % options.threads ? 1 : 0);
+        thread->measure_from = start + (uint64_t)(options.warmup * 1e9);
+        thread->stop_at      = thread->measure_from + (uint64_t)(options.duration * 1e9);
+        thread->seed         = (unsigned int)(start ^ (uint64_t)i * 2654435761U);
+        if(options.rate > 0)
+        {
+            thread->interval = (uint64_t)(1e9 * options.connections / options.rate);
+        }
+        pthread_create(&tids[i], NULL, load_function, thread);
+    }
+    for(int i = 0; i < options.threads; ++i)
+    {
+        pthread_join(tids[i], NULL);
+        for(int b = 0; b < METRICS_BUCKETS; ++b)
+        {
+            buckets[b] += threads[i].buckets[b];
+            count += threads[i].buckets[b];
+        }
+        for(int k = 0; k < REQ_KINDS; ++k)
+        {
+            requests[k] += threads[i].requests[k];
+        }
+        for(int s = 0; s < 6; ++s)
+        {
+            status[s] += threads[i].status[s];
+        }
+        errors += threads[i].errors;
+        bytes += threads[i].bytes;
+        sum_ns += threads[i].sum_ns;
+        max_ns = threads[i].max_ns > max_ns ? threads[i].max_ns : max_ns;
+    }
+
+    double rps  = (double)count / options.duration;
+    double p50  = (double)quantile(buckets, count, 0.5) / 1e3;
+    double p99  = (double)quantile(buckets, count, 0.99) / 1e3;
+    double p999 = (double)quantile(buckets, count, 0.999) / 1e3;
+    double mean = count > 0 ? (double)sum_ns / (double)count / 1e3 : 0;
+
+    if(options.json)
+    {
+        // 한 줄 JSON (실행 결과를 모아 비교하기 쉽도록)
+        printf("{\"mode\":\"%s\",\"rate\":%.0f,\"connections\":%d,\"threads\":%d,\"duration\":%.3f,"
+               "\"mix\":{\"get\":%d,\"head\":%d,\"post\":%d},"
+               "\"requests\":%llu,\"get\":%llu,\"head\":%llu,\"post\":%llu,\"errors\":%llu,"
+               "\"status\":{\"2xx\":%llu,\"3xx\":%llu,\"4xx\":%llu,\"5xx\":%llu,\"other\":%llu},"
+               "\"rps\":%.1f,\"bytes\":%llu,\"mean_us\":%.1f,\"p50_us\":%.1f,\"p99_us\":%.1f,\"p999_us\":%.1f,\"max_us\":%.1f}\n",
+               options.rate > 0 ? "open" : "closed", options.rate, options.connections, options.threads, options.duration,
+               options.mix[REQ_GET], options.mix[REQ_HEAD], options.mix[REQ_POST],
+               (unsigned long long)count, (unsigned long long)requests[REQ_GET], (unsigned long long)requests[REQ_HEAD], (unsigned long long)requests[REQ_POST], (unsigned long long)errors,
+               (unsigned long long)status[2], (unsigned long long)status[3], (unsigned long long)status[4], (unsigned long long)status[5], (unsigned long long)(status[0] + status[1]),
+               rps, (unsigned long long)bytes, mean, p50, p99, p999, (double)max_ns / 1e3);
+    }
+    else
+    {
+        printf("%s loop, %d connections, %d threads, %.1fs", options.rate > 0 ? "open" : "closed", options.connections, options.threads, options.duration);
+        if(options.rate > 0)
+        {
+            printf(", target %.0f req/s", options.rate);
+        }
+        printf("\n  requests  %llu (GET %llu, HEAD %llu, POST %llu), errors %llu\n", (unsigned long long)count, (unsigned long long)requests[REQ_GET], (unsigned long long)requests[REQ_HEAD], (unsigned long long)requests[REQ_POST], (unsigned long long)errors);
+        printf("  status    2xx %llu, 3xx %llu, 4xx %llu, 5xx %llu\n", (unsigned long long)status[2], (unsigned long long)status[3], (unsigned long long)status[4], (unsigned long long)status[5]);
+        printf("  throughput %.1f req/s, %.2f MB/s\n", rps, (double)bytes / options.duration / 1e6);
+        printf("  latency   mean %.1fus  p50 %.1fus  p99 %.1fus  p999 %.1fus  max %.1fus\n", mean, p50, p99, p999, (double)max_ns / 1e3);
+    }
+
+    free(threads);
+    free(tids);
+    return errors > 0 && count == 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage : %s [-c connections] [-t threads] [-d seconds] [-w warmup] [-r req/s] [-m get:head:post] [-g get_path] [-p post_path] [-h host] [-j] <port>\n", name);
+    exit(EXIT_FAILURE);
+}
+
+// "8:1:1" 처럼 GET:HEAD:POST 비율 (빠진 뒤쪽은 0)
+static int parse_mix(const char *str, int *mix)
+{
+    char *end;
+    int   total = 0;
+
+    for(int k = 0; k < REQ_KINDS; ++k)
+    {
+        mix[k] = 0;
+    }
+    for(int k = 0; k < REQ_KINDS && *str != '\0'; ++k)
+    {
+        long value = strtol(str, &end, base);
+        if(end == str || value < 0 || (*end != ':' && *end != '\0'))
+        {
+            return -1;
+        }
+        mix[k] = (int)value;
+        total += mix[k];
+        str    = *end == ':' ? end + 1 : end;
+    }
+    return total > 0 ? 0 : -1;
+}
+
+// 스레드 하나가 자기 연결들을 epoll 로 돌린다
+static void *load_function(void *arg)
+{
+    LoadThread        *thread = (LoadThread *)arg;
+    struct epoll_event events[64];
+    Client            *clients;
+    int                epfd;
+    uint64_t           now = metrics_now();
+
+    epfd    = epoll_create1(EPOLL_CLOEXEC);
+    clients = (Client *)calloc((size_t)thread->nclients, sizeof(Client));
+    if(epfd == -1 || clients == NULL)
+    {
+        perror("load thread");
+        return NULL;
+    }
+    for(int i = 0; i < thread->nclients; ++i)
+    {
+        Client *client = &clients[i];
+
+        client->in = (char *)malloc(RESPONSE_BUF_SIZE);
+        if(client->in == NULL || client_connect(thread, epfd, client) == -1)
+        {
+            thread->errors++;
+            client->fd = -1;
+            continue;
+        }
+        // 열린 루프면 연결마다 시작 시각을 고르게 흩뜨린다
+        client->next_send = now + (thread->interval > 0 ? thread->interval * (uint64_t)i / (uint64_t)thread->nclients : 0);
+        client->state     = CLIENT_IDLE;
+    }
+
+    while((now = metrics_now()) < thread->stop_at)
+    {
+        int timeout = 100;
+        int n;
+
+        // 보낼 시각이 된 연결은 요청을 보낸다 (닫힌 루프는 항상 바로)
+        for(int i = 0; i < thread->nclients; ++i)
+        {
+            Client *client = &clients[i];
+
+            if(client->fd == -1 && client_connect(thread, epfd, client) == -1)
+            {
+                continue;
+            }
+            if(client->state != CLIENT_IDLE)
+            {
+                continue;
+            }
+            if(client->next_send <= now)
+            {
+                client_start(thread, epfd, client, now);
+            }
+            else
+            {
+                int wait = (int)((client->next_send - now) / 1000000);
+                timeout  = wait < timeout ? wait : timeout;
+            }
+        }
+
+        n = epoll_wait(epfd, events, 64, timeout);
+        for(int i = 0; i < n; ++i)
+        {
+            Client *client = (Client *)events[i].data.ptr;
+            int     result = 0;
+
+            if(client->state == CLIENT_WRITING)
+            {
+                result = client_write(epfd, client);
+            }
+            else if(client->state == CLIENT_READING)
+            {
+                result = client_read(client);
+                if(result == 1)
+                {
+                    record(thread, client, metrics_now());
+                    client->state = CLIENT_IDLE;
+                    set_events(epfd, client, 0);
+                    if(client->close_after)
+                    {
+                        client_close(epfd, client);    // 다음 요청 전에 다시 연결한다
+                    }
+                }
+            }
+            if(result == -1)
+            {
+                thread->errors++;
+                client_close(epfd, client);
+            }
+        }
+    }
+
+    for(int i = 0; i < thread->nclients; ++i)
+    {
+        if(clients[i].fd != -1)
+        {
+            close(clients[i].fd);
+        }
+        free(clients[i].in);
+    }
+    free(clients);
+    close(epfd);
+    return NULL;
+}
+
+// 연결이 끊기면 다시 연결한다 (Connection: close 응답, 서버 오류)
+static int client_connect(LoadThread *thread, int epfd, Client *client)
+{
+    struct epoll_event event;
+    int                on = 1;
+
+    client->fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(client->fd == -1)
+    {
+        return -1;
+    }
+    if(connect(client->fd, (const struct sockaddr *)&(thread->options->addr), sizeof(thread->options->addr)) == -1)
+    {
+        close(client->fd);
+        client->fd = -1;
+        return -1;
+    }
+    setsockopt(client->fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    fcntl(client->fd, F_SETFL, fcntl(client->fd, F_GETFL) | O_NONBLOCK);
+
+    event.events   = 0;
+    event.data.ptr = client;
+    if(epoll_ctl(epfd, EPOLL_CTL_ADD, client->fd, &event) == -1)
+    {
+        close(client->fd);
+        client->fd = -1;
+        return -1;
+    }
+    client->state  = CLIENT_IDLE;
+    client->in_len = 0;
+    return 0;
+}
+
+// 비율에 따라 요청 종류를 고르고 보내기 시작한다
+static void client_start(LoadThread *thread, int epfd, Client *client, uint64_t now)
+{
+    const Options *options = thread->options;
+    int            total   = options->mix[REQ_GET] + options->mix[REQ_HEAD] + options->mix[REQ_POST];
+    int            pick    = rand_r(&(thread->seed)) % total;
+    int            n;
+
+    client->kind = pick < options->mix[REQ_GET] ? REQ_GET : pick < options->mix[REQ_GET] + options->mix[REQ_HEAD] ? REQ_HEAD : REQ_POST;
+    if(client->kind == REQ_POST)
+    {
+        // 키마다 새 레코드가 되도록 스레드 번호와 순번을 넣는다
+        char body[128];
+        int  body_len = snprintf(body, sizeof(body), "key=load-%d-%llx-%ld&value=v%ld", thread->id, (unsigned long long)thread->stop_at, thread->post_seq, thread->post_seq);
+
+        thread->post_seq++;
+        n = snprintf(client->out, sizeof(client->out), "POST %s HTTP/1.1\r\nHost: %s\r\nContent-Type: application/x-www-form-urlencoded\r\nContent-Length: %d\r\n\r\n%s", options->post_path, options->host, body_len, body);
+    }
+    else
+    {
+        n = snprintf(client->out, sizeof(client->out), "%s %s HTTP/1.1\r\nHost: %s\r\n\r\n", client->kind == REQ_GET ? "GET" : "HEAD", options->get_path, options->host);
+    }
+    client->out_len    = (size_t)n;
+    client->out_pos    = 0;
+    client->in_len     = 0;
+    client->header_len = 0;
+
+    // 열린 루프는 보내기로 한 시각부터 잰다 (늦게 보내게 된 시간도 지연이다)
+    if(thread->interval > 0)
+    {
+        client->started = client->next_send;
+        client->next_send += thread->interval;
+    }
+    else
+    {
+        client->started   = now;
+        client->next_send = now;
+    }
+    client->state = CLIENT_WRITING;
+    if(client_write(epfd, client) == -1)
+    {
+        thread->errors++;
+        client_close(epfd, client);
+    }
+}
+
+// 다 보냈으면 응답을 기다리고, 덜 보냈으면 쓸 수 있을 때 이어서 보낸다
+static int client_write(int epfd, Client *client)
+{
+    while(client->out_pos < client->out_len)
+    {
+        ssize_t n = send(client->fd, client->out + client->out_pos, client->out_len - client->out_pos, MSG_NOSIGNAL);
+        if(n == -1)
+        {
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                set_events(epfd, client, EPOLLOUT);
+                return 0;
+            }
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        client->out_pos += (size_t)n;
+    }
+    client->state = CLIENT_READING;
+    set_events(epfd, client, EPOLLIN);
+    return 0;
+}
+
+// 반환값: 응답을 다 받았으면 1, 더 받아야 하면 0, 오류면 -1
+static int client_read(Client *client)
+{
+    char sink[RESPONSE_BUF_SIZE];
+
+    for(;;)
+    {
+        ssize_t n;
+
+        // 헤더는 모아서 해석하고, 그 뒤의 본문은 sink 로 받아 버린다
+        if(client->header_len == 0)
+        {
+            n = recv(client->fd, client->in + client->in_len, RESPONSE_BUF_SIZE - client->in_len, 0);
+        }
+        else
+        {
+            n = recv(client->fd, sink, (size_t)client->body_left < sizeof(sink) ? (size_t)client->body_left : sizeof(sink), 0);
+        }
+        if(n == 0)
+        {
+            return -1;
+        }
+        if(n == -1)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        }
+
+        if(client->header_len != 0)
+        {
+            client->body_left -= n;
+        }
+        else
+        {
+            client->in_len += (size_t)n;
+            if(parse_header(client) == -1)
+            {
+                return -1;
+            }
+            if(client->header_len == 0)
+            {
+                if(client->in_len == RESPONSE_BUF_SIZE)
+                {
+                    return -1;    // 헤더가 너무 크다
+                }
+                continue;
+            }
+        }
+        if(client->body_left <= 0)
+        {
+            return 1;
+        }
+    }
+}
+
+static void client_close(int epfd, Client *client)
+{
+    epoll_ctl(epfd, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+    client->fd    = -1;
+    client->state = CLIENT_IDLE;
+}
+
+// 헤더가 다 왔으면 header_len, status, close_after, body_left 를 채운다. 아직이면 header_len 이 0, 해석할 수 없으면 -1
+static int parse_header(Client *client)
+{
+    const char *end = memmem(client->in, client->in_len, "\r\n\r\n", 4);
+    const char *p;
+    char        header[RESPONSE_BUF_SIZE + 1];
+    size_t      header_len;
+    long        length = 0;
+
+    if(end == NULL)
+    {
+        return 0;
+    }
+    header_len = (size_t)(end - client->in) + 4;
+    if(header_len < 12 || strncmp(client->in, "HTTP/1.", 7) != 0)
+    {
+        return -1;
+    }
+    memcpy(header, client->in, header_len);
+    header[header_len] = '\0';
+
+    client->status      = atoi(header + 9);
+    client->close_after = strcasestr(header, "\r\nConnection: close") != NULL;
+    p                   = strcasestr(header, "\r\nContent-Length:");
+    if(p != NULL)
+    {
+        length = strtol(p + strlen("\r\nContent-Length:"), NULL, base);
+    }
+    else if(client->status != 304 && client->kind != REQ_HEAD)
+    {
+        return -1;    // 길이가 없는 응답 (연결을 닫아 끝을 알리는 응답) 은 다루지 않는다
+    }
+    if(client->kind == REQ_HEAD || client->status == 304)
+    {
+        length = 0;
+    }
+    client->header_len = header_len;
+    client->body_len   = length;
+    client->body_left  = length - (long)(client->in_len - header_len);
+    return 0;
+}
+
+static void record(LoadThread *thread, const Client *client, uint64_t now)
+{
+    int status = client->status;
+
+    uint64_t latency = now - client->started;
+
+    if(now < thread->measure_from || now > thread->stop_at)
+    {
+        return;    // 예열 중이거나 끝난 뒤
+    }
+    thread->buckets[metrics_bucket(latency)]++;
+    thread->requests[client->kind]++;
+    thread->status[status >= 100 && status < 600 ? status / 100 : 0]++;
+    thread->bytes += client->header_len + (uint64_t)client->body_len;
+    thread->sum_ns += latency;
+    if(latency > thread->max_ns)
+    {
+        thread->max_ns = latency;
+    }
+}
+
+// 버킷 상한으로 분위수를 구한다 (상대 오차 1/8 이하)
+static uint64_t quantile(const uint64_t *buckets, uint64_t count, double q)
+{
+    uint64_t rank = (uint64_t)(q * (double)count + 0.999999);
+    uint64_t seen = 0;
+
+    for(int i = 0; i < METRICS_BUCKETS && count > 0; ++i)
+    {
+        seen += buckets[i];
+        if(seen >= rank)
+        {
+            return metrics_bucket_upper(i) - 1;
+        }
+    }
+    return 0;
+}
+
+static void set_events(int epfd, Client *client, uint32_t events)
+{
+    struct epoll_event event;
+
+    event.events   = events;
+    event.data.ptr = client;
+    epoll_ctl(epfd, EPOLL_CTL_MOD, client->fd, &event);
+}
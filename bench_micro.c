@@ -0,0 +1,536 @@
+// 핫 함수별 마이크로벤치마크: 요청 해석, content_type, 스레드 풀 왕복, 키-값 저장소 읽기/쓰기, 연결 타이머, 연결 아레나, 응답 헤더
+// 입력과 반복 횟수를 고정하고 같은 측정을 여러 번 되풀이해 가장 빠른 값과 중앙값을 보인다 (한 부분의 회귀가 바로 드러나도록)
+// 사용법: bench_micro [-n 반복 횟수] [-r 측정 횟수] [이름...]   (이름을 주면 그 이름으로 시작하는 항목만 돈다)
+#include "arena.h"
+#include "form_parser.h"
+#include "futex.h"
+#include "http_parser.h"
+#include "kv_store.h"
+#include "mime.h"
+#include "response.h"
+#include "thread_pool.h"
+#include "timer_wheel.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_ITERATIONS 1000000L
+#define DEFAULT_REPEATS 5
+#define MAX_REPEATS 100
+#define KV_KEYS 10000       // 읽기 항목이 미리 넣어 두는 키 수
+#define POOL_BATCH 64       // pool/batch 가 한 번에 넣는 작업 수
+#define TIMERS 65536        // timer/rearm 이 걸어 두는 타이머 수 (유휴 연결 수)
+#define base 10
+
+// 측정 항목 하나. run 은 n 번 돌리고 최적화로 지워지지 않도록 결과를 더해 돌려준다
+typedef struct
+{
+    const char *name;
+    long        divisor;    // 한 번 잴 때 부르는 횟수 = 반복 횟수 / divisor (느린 항목은 줄인다)
+    int       (*setup)(void);
+    long      (*run)(long n);
+    void      (*teardown)(void);
+} Bench;
+
+static const char *const curl_get =
+    "GET /index.html HTTP/1.1\r\n"
+    "Host: localhost:8080\r\n"
+    "User-Agent: curl/8.5.0\r\n"
+    "Accept: */*\r\n"
+    "\r\n";
+
+static const char *const browser_get =
+    "GET /images/logo.gif HTTP/1.1\r\n"
+    "Host: www.example.com:8080\r\n"
+    "Connection: keep-alive\r\n"
+    "Cache-Control: max-age=0\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/124.0.0.0 Safari/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+    "Referer: http://www.example.com:8080/index.html\r\n"
+    "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+    "Accept-Language: en-US,en;q=0.9,ko;q=0.8\r\n"
+    "If-None-Match: \"65f0a1b2-1a2b\"\r\n"
+    "Cookie: session=0123456789abcdef0123456789abcdef; theme=dark\r\n"
+    "\r\n";
+
+static const char *const form_post =
+    "POST /writer.html HTTP/1.1\r\n"
+    "Host: localhost:8080\r\n"
+    "User-Agent: curl/8.5.0\r\n"
+    "Accept: */*\r\n"
+    "Content-Type: application/x-www-form-urlencoded\r\n"
+    "Content-Length: 33\r\n"
+    "\r\n"
+    "key=post_data_key&value=hello+you";
+
+static const char *const file_names[] = {"index.html", "images/logo.gif", "photos/2024/summer.jpeg", "favicon.ico", "writer.html", "docs/v1.2/readme", "album/cover.jpg", "style.css", "js/app.min.js", "fonts/Inter.WOFF2", "api.json", "archive.tar.gz"};
+
+static ThreadPool  pool;
+static atomic_uint pool_done;    // 끝난 작업 수 (기다리는 쪽이 잠드는 futex)
+static KvStore     store;
+static char        store_dir[] = "/tmp/bench_micro-XXXXXX";
+static char        store_path[PATH_MAX];
+static atomic_uint store_done;
+static long        insert_seq;   // kv/insert 가 만든 키 수 (측정을 되풀이해도 새 키가 되도록)
+static TimerWheel  wheel;
+static Timer      *timers;
+
+static long   parse_request(const char *request, int form);
+static long   run_parse_get(long n);
+static long   run_parse_browser(long n);
+static long   run_parse_post(long n);
+static long   run_content_type(long n);
+static int    pool_setup(void);
+static void   pool_teardown(void);
+static void   pool_task(void *arg);
+static long   run_pool_roundtrip(long n);
+static long   run_pool_batch(long n);
+static int    store_setup(void);
+static void   store_teardown(void);
+static void   store_callback(KvRecord *record, void *arg);
+static long   run_fetch(long n, int hit);
+static long   run_fetch_hit(long n);
+static long   run_fetch_miss(long n);
+static long   run_insert(long n);
+static int    timer_setup(void);
+static void   timer_teardown(void);
+static long   run_timer_rearm(long n);
+static long   run_arena_request(long n);
+static long   run_response_headers(long n);
+static int    selected(const char *name, char **filters, int nfilters);
+static int    compare_double(const void *a, const void *b);
+static double now_seconds(void);
+
+static const Bench benches[] = {
+    {"parse/curl-get", 1, NULL, run_parse_get, NULL},
+    {"parse/browser-get", 1, NULL, run_parse_browser, NULL},
+    {"parse/form-post", 1, NULL, run_parse_post, NULL},
+    {"mime/content_type", 1, NULL, run_content_type, NULL},
+    {"pool/roundtrip", 100, pool_setup, run_pool_roundtrip, pool_teardown},
+    {"pool/batch", 10, pool_setup, run_pool_batch, pool_teardown},
+    {"kv/fetch-hit", 1, store_setup, run_fetch_hit, store_teardown},
+    {"kv/fetch-miss", 1, store_setup, run_fetch_miss, store_teardown},
+    {"kv/insert", 100, store_setup, run_insert, store_teardown},
+    {"timer/rearm", 1, timer_setup, run_timer_rearm, timer_teardown},
+    {"arena/request", 1, NULL, run_arena_request, NULL},
+    {"response/headers", 1, NULL, run_response_headers, NULL},
+};
+
+int main(int argc, char *argv[])
+{
+    long iterations = DEFAULT_ITERATIONS;
+    int  repeats    = DEFAULT_REPEATS;
+    int  opt;
+
+    while((opt = getopt(argc, argv, "n:r:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'n':
+                iterations = strtol(optarg, NULL, base);
+                break;
+            case 'r':
+                repeats = (int)strtol(optarg, NULL, base);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n iterations] [-r repeats] [name...]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if(iterations <= 0 || repeats <= 0 || repeats > MAX_REPEATS)
+    {
+        fprintf(stderr, "%s: bad -n or -r\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    printf("# %ld iterations (divided per bench), %d repeats, ns per op\n", iterations, repeats);
+    printf("%-20s %10s %10s %10s %14s\n", "bench", "calls", "min", "median", "ops/s(median)");
+    for(size_t b = 0; b < sizeof(benches) / sizeof(benches[0]); ++b)
+    {
+        const Bench  *bench = &benches[b];
+        long          n     = iterations / bench->divisor > 0 ? iterations / bench->divisor : 1;
+        double        ns[MAX_REPEATS];
+        volatile long sink = 0;
+
+        if(!selected(bench->name, argv + optind, argc - optind))
+        {
+            continue;
+        }
+        if(bench->setup != NULL && bench->setup() == -1)
+        {
+            fprintf(stderr, "%s: setup failed\n", bench->name);
+            return EXIT_FAILURE;
+        }
+        sink += bench->run(n / 10 + 1);    // 예열 (캐시, 분기 예측, 잠든 워커)
+        for(int r = 0; r < repeats; ++r)
+        {
+            double start = now_seconds();
+
+            sink += bench->run(n);
+            ns[r] = (now_seconds() - start) * 1e9 / (double)n;
+        }
+        if(bench->teardown != NULL)
+        {
+            bench->teardown();
+        }
+        (void)sink;
+
+        qsort(ns, (size_t)repeats, sizeof(ns[0]), compare_double);
+        printf("%-20s %10ld %10.1f %10.1f %14.0f\n", bench->name, n, ns[0], ns[repeats / 2], 1e9 / ns[repeats / 2]);
+    }
+    return 0;
+}
+
+// 리액터와 워커가 요청 하나에 하는 해석: 요청 줄과 헤더, 경로, (POST 면) 폼 필드
+static long parse_request(const char *request, int form)
+{
+    size_t      len = strlen(request);
+    HttpRequest req;
+    FormParser  parser;
+    char        path[PATH_MAX];
+
+    http_request_init(&req);
+    if(http_request_parse(&req, request, len) != 1 || http_request_path(&req, request, path, sizeof(path)) == -1)
+    {
+        fprintf(stderr, "parse failed\n");
+        exit(EXIT_FAILURE);
+    }
+    if(form)
+    {
+        form_parser_init(&parser);
+        form_parse(&parser, request + req.header_len, len - req.header_len, 1);
+        return parser.nfields + req.keep_alive;
+    }
+    return req.keep_alive + (long)path[0];
+}
+
+static long run_parse_get(long n)
+{
+    long sum = 0;
+
+    for(long i = 0; i < n; ++i)
+    {
+        sum += parse_request(curl_get, 0);
+    }
+    return sum;
+}
+
+static long run_parse_browser(long n)
+{
+    long sum = 0;
+
+    for(long i = 0; i < n; ++i)
+    {
+        sum += parse_request(browser_get, 0);
+    }
+    return sum;
+}
+
+static long run_parse_post(long n)
+{
+    long sum = 0;
+
+    for(long i = 0; i < n; ++i)
+    {
+        sum += parse_request(form_post, 1);
+    }
+    return sum;
+}
+
+static long run_content_type(long n)
+{
+    long sum = 0;
+
+    for(long i = 0; i < n; ++i)
+    {
+        sum += (long)content_type(file_names[i % (long)(sizeof(file_names) / sizeof(file_names[0]))])[0];
+    }
+    return sum;
+}
+
+static int pool_setup(void)
+{
+    if(thread_pool_init(&pool, 0, 0) == -1)
+    {
+        return -1;
+    }
+    atomic_init(&pool_done, 0);
+    thread_pool_start(&pool);
+    return 0;
+}
+
+static void pool_teardown(void)
+{
+    thread_pool_shutdown(&pool);
+}
+
+static void pool_task(void *arg)
+{
+    (void)arg;
+    atomic_fetch_add(&pool_done, 1);
+    futex_wake(&pool_done, 1);
+}
+
+// 리액터처럼 워커가 아닌 스레드가 작업 하나를 넣고 끝날 때까지 기다린다 (주입 큐, 잠든 워커 깨우기, 완료 통지)
+static long run_pool_roundtrip(long n)
+{
+    for(long i = 0; i < n; ++i)
+    {
+        unsigned int done = atomic_load(&pool_done);
+
+        thread_pool_add_task(&pool, pool_task, NULL);
+        while(atomic_load(&pool_done) == done)
+        {
+            futex_wait(&pool_done, done);
+        }
+    }
+    return (long)atomic_load(&pool_done);
+}
+
+// 작업을 POOL_BATCH 개씩 넣고 모두 끝나기를 기다린다 (작업 하나당 시간)
+static long run_pool_batch(long n)
+{
+    for(long i = 0; i < n; i += POOL_BATCH)
+    {
+        for(long j = i; j < n && j < i + POOL_BATCH; ++j)
+        {
+            thread_pool_add_task(&pool, pool_task, NULL);
+        }
+        thread_pool_wait_all_tasks_completed(&pool);
+    }
+    return (long)atomic_load(&pool_done);
+}
+
+// 임시 디렉터리에 저장소를 만들고 KV_KEYS 개를 넣어 둔다. fsync 는 하지 않는다 (디스크가 아니라 코드 경로를 잰다)
+static int store_setup(void)
+{
+    strcpy(store_dir, "/tmp/bench_micro-XXXXXX");
+    if(mkdtemp(store_dir) == NULL)
+    {
+        return -1;
+    }
+    snprintf(store_path, sizeof(store_path), "%s/post.db", store_dir);
+    if(kv_store_open(&store, store_path, KV_SYNC_NONE, 0) == -1)
+    {
+        rmdir(store_dir);
+        return -1;
+    }
+    atomic_init(&store_done, 0);
+    for(int i = 0; i < KV_KEYS; ++i)
+    {
+        char key[32];
+        char value[32];
+        int  key_len   = snprintf(key, sizeof(key), "key-%d", i);
+        int  value_len = snprintf(value, sizeof(value), "value-%d", i);
+
+        kv_table_insert(&(store.table), key, (size_t)key_len, value, (size_t)value_len);
+    }
+    return 0;
+}
+
+static void store_teardown(void)
+{
+    kv_store_close(&store);
+    unlink(store_path);
+    rmdir(store_dir);
+}
+
+static void store_callback(KvRecord *record, void *arg)
+{
+    (void)record;
+    (void)arg;
+    atomic_fetch_add(&store_done, 1);
+    futex_wake(&store_done, 1);
+}
+
+// handle_post_request 가 저장하기 전에 하는 읽기 (값을 아레나에 복사하므로 요청마다 되돌리는 것까지 잰다)
+static long run_fetch(long n, int hit)
+{
+    Arena *arena = arena_create();
+    long   sum   = 0;
+
+    if(arena == NULL)
+    {
+        return 0;
+    }
+
+    for(long i = 0; i < n; ++i)
+    {
+        char   key[32];
+        int    key_len = snprintf(key, sizeof(key), hit ? "key-%ld" : "missing-%ld", i % KV_KEYS);
+        char  *value;
+        size_t value_len;
+
+        if(kv_store_fetch(&store, key, (size_t)key_len, arena, &value, &value_len) == 1)
+        {
+            sum += (long)value_len;
+        }
+        arena_reset(arena);
+    }
+    arena_destroy(arena);
+    return sum;
+}
+
+static long run_fetch_hit(long n)
+{
+    return run_fetch(n, 1);
+}
+
+static long run_fetch_miss(long n)
+{
+    return run_fetch(n, 0);
+}
+
+// 새 키 하나를 넣고 커미터가 gdbm 에 쓴 뒤 알릴 때까지 기다린다 (POST 한 건의 저장 왕복)
+static long run_insert(long n)
+{
+    for(long i = 0; i < n; ++i)
+    {
+        char         key[32];
+        KvRecord     record;
+        unsigned int done = atomic_load(&store_done);
+
+        record.key_len   = (size_t)snprintf(key, sizeof(key), "insert-%ld", insert_seq++);
+        record.key       = key;
+        record.value     = "hello+you";
+        record.value_len = strlen(record.value);
+        record.callback  = store_callback;
+        record.arg       = NULL;
+        kv_store_insert(&store, &record);
+        while(atomic_load(&store_done) == done)
+        {
+            futex_wait(&store_done, done);
+        }
+    }
+    return (long)atomic_load(&store_done);
+}
+
+// TIMERS 개를 걸어 두고 하나씩 취소하고 다시 건다 (리액터가 읽을 때마다 연결의 제한 시간을 옮기는 것과 같다)
+static int timer_setup(void)
+{
+    timers = (Timer *)calloc(TIMERS, sizeof(Timer));
+    if(timers == NULL)
+    {
+        return -1;
+    }
+    timer_wheel_init(&wheel, 0);
+    for(long i = 0; i < TIMERS; ++i)
+    {
+        timer_add(&wheel, &timers[i], (uint64_t)(i * 7919 % 600));
+    }
+    return 0;
+}
+
+static void timer_teardown(void)
+{
+    timer_wheel_take_all(&wheel);
+    free(timers);
+}
+
+// 100 틱마다 휠을 돌려 만료된 것을 꺼내 다시 건다
+static long run_timer_rearm(long n)
+{
+    long sum = 0;
+
+    for(long i = 0; i < n; ++i)
+    {
+        Timer *timer = &timers[i % TIMERS];
+
+        timer_cancel(timer);
+        timer_add(&wheel, timer, wheel.next + (uint64_t)(i * 7919 % 600));
+        if(i % 100 == 0)
+        {
+            for(Timer *expired = timer_wheel_advance(&wheel, wheel.next); expired != NULL;)
+            {
+                Timer *next = expired->next;
+
+                timer_add(&wheel, expired, wheel.next + 50);
+                expired = next;
+                sum++;
+            }
+        }
+    }
+    return sum;
+}
+
+// 연결 하나를 열고 POST 한 건을 처리한 뒤 닫는 동안의 할당 (연결, 응답 버퍼, 두 번째 블록에 들어가는 저장 대기)
+static long run_arena_request(long n)
+{
+    long sum = 0;
+
+    for(long i = 0; i < n; ++i)
+    {
+        Arena *arena = arena_create();
+        char  *conn;
+        char  *response;
+        char  *post;
+
+        if(arena == NULL)
+        {
+            return sum;
+        }
+        conn = (char *)arena_alloc(arena, 5600);
+        arena_mark(arena);
+        response = (char *)arena_alloc(arena, 2048);
+        post     = (char *)arena_alloc(arena, 4200);
+        sum += (long)(post - response) + (conn != NULL);
+        arena_reset(arena);
+        arena_destroy(arena);
+    }
+    return sum;
+}
+
+// send_entity 가 200 응답의 헤더를 모으는 것과 같은 일 (보내지는 않는다)
+static long run_response_headers(long n)
+{
+    static const char validators[] = "ETag: \"65f0a1b2-1a2b\"\r\nLast-Modified: Tue, 12 Mar 2024 18:00:50 GMT\r\nAccept-Ranges: bytes\r\n";
+    long              sum          = 0;
+
+    for(long i = 0; i < n; ++i)
+    {
+        Response res;
+
+        response_init(&res, 200);
+        response_add(&res, validators, sizeof(validators) - 1);
+        response_printf(&res, "Content-Type: %s\r\nContent-Length: %lld\r\n", "text/html", (long long)(i & 0xffff));
+        response_end_headers(&res, 1);
+        sum += res.iovcnt + (long)res.used;
+    }
+    return sum;
+}
+
+static int selected(const char *name, char **filters, int nfilters)
+{
+    if(nfilters == 0)
+    {
+        return 1;
+    }
+    for(int i = 0; i < nfilters; ++i)
+    {
+        if(strncmp(name, filters[i], strlen(filters[i])) == 0)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
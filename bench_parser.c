@@ -0,0 +1,325 @@
+// 요청 해석 비교: 기존 memmem + fmemopen/fgets/strtok_r 경로 vs 이어서 읽는 http_parser
+// 사용법: bench_parser [반복 횟수]
+#define _GNU_SOURCE    // memmem
+
+#include "http_parser.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#define DEFAULT_ITERATIONS 1000000L
+#define TRICKLE_SIZE 64    // 조금씩 도착하는 경우 한 번에 읽는 바이트 수
+#define SMALL_BUF 1024
+#define base 10
+
+#define magic1 10
+#define magic3 30
+
+typedef struct
+{
+    const char *name;
+    const char *request;
+} Sample;
+
+static const Sample samples[] = {
+    {"curl GET",
+     "GET /index.html HTTP/1.1\r\n"
+     "Host: localhost:8080\r\n"
+     "User-Agent: curl/8.5.0\r\n"
+     "Accept: */*\r\n"
+     "\r\n"},
+    {"browser GET",
+     "GET /images/logo.gif HTTP/1.1\r\n"
+     "Host: www.example.com:8080\r\n"
+     "Connection: keep-alive\r\n"
+     "Cache-Control: max-age=0\r\n"
+     "sec-ch-ua: \"Chromium\";v=\"124\", \"Google Chrome\";v=\"124\", \"Not-A.Brand\";v=\"99\"\r\n"
+     "sec-ch-ua-mobile: ?0\r\n"
+     "sec-ch-ua-platform: \"Linux\"\r\n"
+     "Upgrade-Insecure-Requests: 1\r\n"
+     "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/124.0.0.0 Safari/537.36\r\n"
+     "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+     "Sec-Fetch-Site: same-origin\r\n"
+     "Sec-Fetch-Mode: navigate\r\n"
+     "Sec-Fetch-Dest: document\r\n"
+     "Referer: http://www.example.com:8080/index.html\r\n"
+     "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+     "Accept-Language: en-US,en;q=0.9,ko;q=0.8\r\n"
+     "Cookie: session=0123456789abcdef0123456789abcdef; theme=dark\r\n"
+     "\r\n"},
+    {"form POST",
+     "POST /writer.html HTTP/1.1\r\n"
+     "Host: localhost:8080\r\n"
+     "User-Agent: curl/8.5.0\r\n"
+     "Accept: */*\r\n"
+     "Content-Type: application/x-www-form-urlencoded\r\n"
+     "Content-Length: 33\r\n"
+     "\r\n"
+     "key=post_data_key&value=hello+you"},
+};
+
+// 본문 경계가 모호해서 400 으로 거절해야 하는 요청 (앞단 프록시와 경계를 다르게 읽으면 request smuggling)
+static const Sample rejected[] = {
+    {"Content-Length 0 then 15",
+     "POST /writer.html HTTP/1.1\r\n"
+     "Host: localhost:8080\r\n"
+     "Content-Length: 0\r\n"
+     "Content-Length: 15\r\n"
+     "\r\n"
+     "key=a&value=bcd"},
+    {"Content-Length 15 then 0",
+     "POST /writer.html HTTP/1.1\r\n"
+     "Host: localhost:8080\r\n"
+     "Content-Length: 15\r\n"
+     "Content-Length: 0\r\n"
+     "\r\n"
+     "key=a&value=bcd"},
+    {"Content-Length and chunked",
+     "POST /writer.html HTTP/1.1\r\n"
+     "Host: localhost:8080\r\n"
+     "Content-Length: 15\r\n"
+     "Transfer-Encoding: chunked\r\n"
+     "\r\n"
+     "f\r\nkey=a&value=bcd\r\n0\r\n\r\n"},
+};
+
+// 두 경로가 같은 일을 했는지 확인하고 최적화로 지워지지 않도록 결과를 모은다
+typedef struct
+{
+    char method[magic1];
+    char file_name[PATH_MAX];
+    int  content_length;
+    int  keep_alive;
+} Parsed;
+
+static int    legacy_request_length(const char *buf, size_t len, size_t *req_len);
+static int    legacy_parse(char *buf, size_t len, Parsed *out);
+static int    parser_parse(HttpRequest *req, const char *buf, size_t len, Parsed *out);
+static double bench(int legacy, const char *request, long iterations, size_t step);
+static double now_seconds(void);
+
+int main(int argc, char *argv[])
+{
+    long iterations = DEFAULT_ITERATIONS;
+
+    if(argc == 2)
+    {
+        iterations = strtol(argv[1], NULL, base);
+    }
+
+    // 두 경로의 결과가 같은지 먼저 확인
+    for(size_t i = 0; i < sizeof(samples) / sizeof(samples[0]); ++i)
+    {
+        char        buf[4096];
+        HttpRequest req;
+        Parsed      a;
+        Parsed      b;
+        size_t      len = strlen(samples[i].request);
+
+        memcpy(buf, samples[i].request, len);
+        http_request_init(&req);
+        if(legacy_parse(buf, len, &a) == -1 || parser_parse(&req, samples[i].request, len, &b) == -1 || strcmp(a.method, b.method) != 0 || strcmp(a.file_name, b.file_name) != 0 || a.content_length != b.content_length || a.keep_alive != b.keep_alive)
+        {
+            fprintf(stderr, "%s: results differ\n", samples[i].name);
+            return EXIT_FAILURE;
+        }
+    }
+    for(size_t i = 0; i < sizeof(rejected) / sizeof(rejected[0]); ++i)
+    {
+        HttpRequest req;
+
+        http_request_init(&req);
+        if(http_request_parse(&req, rejected[i].request, strlen(rejected[i].request)) != -1 || req.error != 400)
+        {
+            fprintf(stderr, "%s: accepted\n", rejected[i].name);
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf("# %ld iterations, ns per request\n", iterations);
+    printf("%-24s %10s %10s %8s\n", "request", "legacy", "parser", "speedup");
+    for(size_t i = 0; i < sizeof(samples) / sizeof(samples[0]); ++i)
+    {
+        size_t len = strlen(samples[i].request);
+
+        for(int trickle = 0; trickle <= 1; ++trickle)
+        {
+            size_t step = trickle ? TRICKLE_SIZE : len;
+            double old_ns = bench(1, samples[i].request, iterations, step);
+            double new_ns = bench(0, samples[i].request, iterations, step);
+            char   label[64];
+
+            snprintf(label, sizeof(label), "%s%s", samples[i].name, trickle ? " (64B reads)" : "");
+            printf("%-24s %10.1f %10.1f %7.2fx\n", label, old_ns, new_ns, old_ns / new_ns);
+        }
+    }
+    return 0;
+}
+
+// 리액터처럼 step 바이트씩 도착할 때마다 요청이 완성됐는지 확인하고, 완성되면 해석한다
+static double bench(int legacy, const char *request, long iterations, size_t step)
+{
+    size_t        len = strlen(request);
+    char          buf[4096];
+    HttpRequest   req;
+    Parsed        out;
+    volatile long sink = 0;
+    double        start;
+
+    memcpy(buf, request, len);
+    start = now_seconds();
+    for(long n = 0; n < iterations; ++n)
+    {
+        http_request_init(&req);
+        for(size_t have = step < len ? step : len;; have = have + step < len ? have + step : len)
+        {
+            size_t req_len;
+            int    done;
+
+            if(legacy)
+            {
+                done = legacy_request_length(buf, have, &req_len) == 1 && legacy_parse(buf, req_len, &out) == 0;
+            }
+            else
+            {
+                done = parser_parse(&req, buf, have, &out) == 0;
+            }
+            if(done || have == len)
+            {
+                break;
+            }
+        }
+        sink += out.keep_alive + out.content_length;
+    }
+    (void)sink;
+    return (now_seconds() - start) * 1e9 / (double)iterations;
+}
+
+static int parser_parse(HttpRequest *req, const char *buf, size_t len, Parsed *out)
+{
+    Slice method;
+
+    if(http_request_parse(req, buf, len) != 1 || len < req->header_len + (size_t)req->content_length)
+    {
+        return -1;
+    }
+    method = http_slice(buf, req->method);
+    if(method.len >= magic1 || http_request_path(req, buf, out->file_name, sizeof(out->file_name)) == -1)
+    {
+        return -1;
+    }
+    memcpy(out->method, method.ptr, method.len);
+    out->method[method.len] = '\0';
+    out->content_length     = (int)req->content_length;
+    out->keep_alive         = req->keep_alive;
+    return 0;
+}
+
+// 기존 리액터의 request_length: 매번 버퍼 처음부터 헤더 끝을 찾는다
+static int legacy_request_length(const char *buf, size_t len, size_t *req_len)
+{
+    const char *end;
+    const char *line;
+    size_t      header_len;
+    long int    content_length = 0;
+
+    end = (const char *)memmem(buf, len, "\r\n\r\n", 4);
+    if(end == NULL)
+    {
+        return 0;
+    }
+    header_len = (size_t)(end - buf) + 4;
+
+    line = (const char *)memchr(buf, '\n', header_len);
+    while(line != NULL && (size_t)(line - buf) + 1 < header_len)
+    {
+        line++;
+        if((size_t)(buf + header_len - line) > strlen("Content-Length:") && strncasecmp(line, "Content-Length:", strlen("Content-Length:")) == 0)
+        {
+            content_length = strtol(line + strlen("Content-Length:"), NULL, base);
+        }
+        line = (const char *)memchr(line, '\n', header_len - (size_t)(line - buf));
+    }
+    if(len < header_len + (size_t)content_length)
+    {
+        return 0;
+    }
+    *req_len = header_len + (size_t)content_length;
+    return 1;
+}
+
+// 기존 handle_request 의 해석 부분 (출력만 뺐다)
+static int legacy_parse(char *buf, size_t len, Parsed *out)
+{
+    char  req_line[SMALL_BUF];
+    char  req_contents[SMALL_BUF];
+    char  file_name[magic3];
+    FILE *clnt_read = fmemopen(buf, len, "r");
+
+    fgets(req_line, SMALL_BUF, clnt_read);
+    out->keep_alive     = strstr(req_line, "HTTP/1.1") != NULL;
+    out->content_length = 0;
+    while(fgets(req_contents, SMALL_BUF, clnt_read) != NULL)
+    {
+        if(strcmp(req_contents, "\r\n") == 0 || strcmp(req_contents, "\n") == 0)
+        {
+            break;
+        }
+        if(strncasecmp(req_contents, "Content-Length:", strlen("Content-Length:")) == 0)
+        {
+            out->content_length = (int)strtol(req_contents + strlen("Content-Length:"), NULL, base);
+        }
+        if(strncasecmp(req_contents, "Connection:", strlen("Connection:")) == 0)
+        {
+            const char *value = req_contents + strlen("Connection:");
+            value += strspn(value, " \t");
+            if(strncasecmp(value, "close", strlen("close")) == 0)
+            {
+                out->keep_alive = 0;
+            }
+            else if(strncasecmp(value, "keep-alive", strlen("keep-alive")) == 0)
+            {
+                out->keep_alive = 1;
+            }
+        }
+    }
+    fclose(clnt_read);
+
+    char *saveptr;
+    char *token = strtok_r(req_line, " /", &saveptr);
+    if(token == NULL || strlen(token) >= magic1)
+    {
+        return -1;
+    }
+    strcpy(out->method, token);
+
+    token = strtok_r(NULL, " /", &saveptr);
+    if(token == NULL)
+    {
+        return -1;
+    }
+    strcpy(file_name, token);
+    while((token = strtok_r(NULL, " /", &saveptr)) != NULL)
+    {
+        if(strcmp(token, "HTTP") == 0)
+        {
+            break;
+        }
+        strcat(file_name, "/");
+        strcat(file_name, token);
+    }
+    strcpy(out->file_name, file_name);
+
+    return 0;
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
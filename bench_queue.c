@@ -0,0 +1,189 @@
+// 작업 큐 처리량 비교: 기존 뮤텍스/조건 변수 링 버퍼 vs 락 없는 MPMC 큐
+// 사용법: bench_queue [작업 수]
+#include "task_queue.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define TASK_QUEUE_SIZE 128
+#define DEFAULT_OPS 2000000L
+#define MAX_THREADS 16
+#define base 10
+
+// 기존 ThreadPool 의 큐와 같은 구조
+typedef struct
+{
+    Task            task_queue[TASK_QUEUE_SIZE];
+    int             queue_front;
+    int             queue_rear;
+    pthread_mutex_t queue_mutex;
+    pthread_cond_t  queue_not_empty;
+    pthread_cond_t  queue_not_full;
+} MutexQueue;
+
+typedef struct
+{
+    int         lock_free;    // 1 이면 TaskQueue, 0 이면 MutexQueue
+    MutexQueue *mutex_queue;
+    TaskQueue  *task_queue;
+    long        ops;          // 이 스레드가 넣을/꺼낼 작업 수
+    int         id;           // 소비자 번호
+} BenchArg;
+
+static void   mutex_queue_push(MutexQueue *queue, const Task *task);
+static void   mutex_queue_pop(MutexQueue *queue, Task *task);
+static void  *producer_function(void *arg);
+static void  *consumer_function(void *arg);
+static double run(int lock_free, int threads, long ops);
+static double now_seconds(void);
+
+static void noop(void *arg)
+{
+    (void)arg;
+}
+
+int main(int argc, char *argv[])
+{
+    long ops = DEFAULT_OPS;
+
+    if(argc == 2)
+    {
+        ops = strtol(argv[1], NULL, base);
+    }
+
+    printf("# %ld tasks per run, N producers + N consumers, queue size %d\n", ops, TASK_QUEUE_SIZE);
+    printf("%-8s %16s %16s %8s\n", "threads", "mutex(Mops/s)", "lockfree(Mops/s)", "speedup");
+    for(int threads = 1; threads <= MAX_THREADS; threads *= 2)
+    {
+        double mutex_rate    = (double)ops / run(0, threads, ops) / 1e6;
+        double lockfree_rate = (double)ops / run(1, threads, ops) / 1e6;
+        printf("%-8d %16.2f %16.2f %7.2fx\n", threads, mutex_rate, lockfree_rate, lockfree_rate / mutex_rate);
+    }
+    return 0;
+}
+
+// 스레드 수별로 한 번 돌리고 걸린 시간(초)을 돌려준다
+static double run(int lock_free, int threads, long ops)
+{
+    pthread_t  producers[MAX_THREADS];
+    pthread_t  consumers[MAX_THREADS];
+    BenchArg   args[MAX_THREADS];
+    MutexQueue mutex_queue;
+    TaskQueue  task_queue;
+    double     start;
+
+    mutex_queue.queue_front = 0;
+    mutex_queue.queue_rear  = 0;
+    pthread_mutex_init(&(mutex_queue.queue_mutex), NULL);
+    pthread_cond_init(&(mutex_queue.queue_not_empty), NULL);
+    pthread_cond_init(&(mutex_queue.queue_not_full), NULL);
+    if(task_queue_init(&task_queue, TASK_QUEUE_SIZE) == -1)
+    {
+        perror("task_queue_init");
+        exit(EXIT_FAILURE);
+    }
+
+    for(int i = 0; i < threads; ++i)
+    {
+        args[i].lock_free   = lock_free;
+        args[i].mutex_queue = &mutex_queue;
+        args[i].task_queue  = &task_queue;
+        args[i].ops         = ops / threads + (i < ops % threads ? 1 : 0);
+        args[i].id          = i;
+    }
+
+    start = now_seconds();
+    for(int i = 0; i < threads; ++i)
+    {
+        pthread_create(&consumers[i], NULL, consumer_function, &args[i]);
+        pthread_create(&producers[i], NULL, producer_function, &args[i]);
+    }
+    for(int i = 0; i < threads; ++i)
+    {
+        pthread_join(producers[i], NULL);
+        pthread_join(consumers[i], NULL);
+    }
+    double elapsed = now_seconds() - start;
+
+    task_queue_destroy(&task_queue);
+    pthread_mutex_destroy(&(mutex_queue.queue_mutex));
+    pthread_cond_destroy(&(mutex_queue.queue_not_empty));
+    pthread_cond_destroy(&(mutex_queue.queue_not_full));
+    return elapsed;
+}
+
+static void *producer_function(void *arg)
+{
+    BenchArg *bench = (BenchArg *)arg;
+    Task      task;
+
+    task.function = noop;
+    task.argument = NULL;
+    for(long i = 0; i < bench->ops; ++i)
+    {
+        if(bench->lock_free)
+        {
+            task_queue_push(bench->task_queue, &task);
+        }
+        else
+        {
+            mutex_queue_push(bench->mutex_queue, &task);
+        }
+    }
+    return NULL;
+}
+
+static void *consumer_function(void *arg)
+{
+    BenchArg *bench = (BenchArg *)arg;
+    Task      task;
+
+    for(long i = 0; i < bench->ops; ++i)
+    {
+        if(bench->lock_free)
+        {
+            task_queue_pop(bench->task_queue, &task, bench->id);
+        }
+        else
+        {
+            mutex_queue_pop(bench->mutex_queue, &task);
+        }
+        (*(task.function))(task.argument);
+    }
+    return NULL;
+}
+
+static void mutex_queue_push(MutexQueue *queue, const Task *task)
+{
+    pthread_mutex_lock(&(queue->queue_mutex));
+    while((queue->queue_rear + 1) % TASK_QUEUE_SIZE == queue->queue_front)
+    {
+        pthread_cond_wait(&(queue->queue_not_full), &(queue->queue_mutex));
+    }
+    queue->task_queue[queue->queue_rear] = *task;
+    queue->queue_rear                    = (queue->queue_rear + 1) % TASK_QUEUE_SIZE;
+    pthread_cond_signal(&(queue->queue_not_empty));
+    pthread_mutex_unlock(&(queue->queue_mutex));
+}
+
+static void mutex_queue_pop(MutexQueue *queue, Task *task)
+{
+    pthread_mutex_lock(&(queue->queue_mutex));
+    while(queue->queue_front == queue->queue_rear)
+    {
+        pthread_cond_wait(&(queue->queue_not_empty), &(queue->queue_mutex));
+    }
+    *task              = queue->task_queue[queue->queue_front];
+    queue->queue_front = (queue->queue_front + 1) % TASK_QUEUE_SIZE;
+    pthread_cond_signal(&(queue->queue_not_full));
+    pthread_mutex_unlock(&(queue->queue_mutex));
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
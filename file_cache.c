@@ -0,0 +1,482 @@
+#include "file_cache.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define WATCH_MASK (IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF)
+#define EVENT_BUF_SIZE 4096
+
+static void       *watch_function(void *arg);
+static unsigned int path_hash(const char *path, size_t len);
+static CacheEntry  *lookup_locked(FileCache *cache, const char *path, unsigned int hash);
+static CacheEntry  *load_entry(const char *path);
+static CacheEntry  *meta_entry(const char *path, int type);
+static int          watch_parent(FileCache *cache, const char *path);
+static int          watch_directory(FileCache *cache, const char *path);
+static void         invalidate_path(FileCache *cache, const char *path);
+static void         invalidate_all(FileCache *cache);
+static void         entry_free(CacheEntry *entry);
+
+// 문서 루트(현재 디렉터리)를 감시하기 시작한다. inotify 를 쓸 수 없으면 캐시를 끈다
+// ignore 는 문서 루트 안에서 서버가 계속 쓰는 파일이다. 쓸 때마다 캐시를 비우지 않도록 그 파일의 이벤트는 버리고 캐시에도 올리지 않는다
+int file_cache_init(FileCache *cache, const char *ignore)
+{
+    memset(cache, 0, sizeof(*cache));
+    pthread_rwlock_init(&(cache->lock), NULL);
+    cache->ignore = ignore;
+
+    cache->inotify_fd = inotify_init1(IN_CLOEXEC);
+    if(cache->inotify_fd == -1)
+    {
+        return -1;
+    }
+    if(watch_directory(cache, "") == -1)
+    {
+        close(cache->inotify_fd);
+        cache->inotify_fd = -1;
+        return -1;
+    }
+    if(pthread_create(&(cache->watcher), NULL, watch_function, cache) != 0)
+    {
+        close(cache->inotify_fd);
+        cache->inotify_fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+void file_cache_destroy(FileCache *cache)
+{
+    if(cache->inotify_fd != -1)
+    {
+        pthread_cancel(cache->watcher);
+        pthread_join(cache->watcher, NULL);
+        close(cache->inotify_fd);
+        cache->inotify_fd = -1;
+    }
+    invalidate_all(cache);
+    for(size_t i = 0; i < cache->nwatch; ++i)
+    {
+        free(cache->wd_dirs[i]);
+    }
+    free(cache->wds);
+    free(cache->wd_dirs);
+    pthread_rwlock_destroy(&(cache->lock));
+}
+
+// 캐시에서 항목을 찾고, 없으면 파일을 읽어 넣는다. 캐시를 쓸 수 없거나 파일을 확인하지 못했으면 NULL
+// 없는 경로와 큰 파일도 그 결과만 담은 항목 (CACHE_MISSING, CACHE_LARGE) 으로 기억해 요청마다 다시 열어 보지 않는다
+// 돌려받은 항목은 다 쓴 뒤 file_cache_release 로 반환해야 한다
+CacheEntry *file_cache_acquire(FileCache *cache, const char *path)
+{
+    unsigned int  hash = path_hash(path, strlen(path));
+    unsigned long generation;
+    CacheEntry   *entry;
+    CacheEntry   *existing;
+
+    if(cache->inotify_fd == -1 || strcmp(path, cache->ignore) == 0)
+    {
+        return NULL;
+    }
+
+    pthread_rwlock_rdlock(&(cache->lock));
+    if(cache->disabled)
+    {
+        pthread_rwlock_unlock(&(cache->lock));
+        return NULL;
+    }
+    entry = lookup_locked(cache, path, hash);
+    if(entry != NULL)
+    {
+        atomic_fetch_add(&(entry->refcount), 1);
+    }
+    generation = cache->generation;
+    pthread_rwlock_unlock(&(cache->lock));
+    if(entry != NULL)
+    {
+        return entry;
+    }
+
+    // 파일을 읽기 전에 디렉터리를 감시해야 그 사이의 변경을 놓치지 않는다
+    if(watch_parent(cache, path) == -1)
+    {
+        return NULL;
+    }
+
+    entry = load_entry(path);
+    if(entry == NULL)
+    {
+        return NULL;
+    }
+    entry->hash = hash;
+
+    pthread_rwlock_wrlock(&(cache->lock));
+    existing = lookup_locked(cache, path, hash);
+    if(existing != NULL)
+    {
+        // 다른 워커가 먼저 넣었다
+        atomic_fetch_add(&(existing->refcount), 1);
+        pthread_rwlock_unlock(&(cache->lock));
+        entry_free(entry);
+        return existing;
+    }
+    if(cache->generation == generation && cache->total_bytes + entry->body_len <= CACHE_MAX_BYTES && (entry->type == CACHE_BODY || cache->nmeta < CACHE_MAX_META))
+    {
+        // 테이블이 참조 하나를 가진다
+        atomic_fetch_add(&(entry->refcount), 1);
+        entry->next                          = cache->buckets[hash % CACHE_BUCKETS];
+        cache->buckets[hash % CACHE_BUCKETS] = entry;
+        cache->total_bytes += entry->body_len;
+        if(entry->type != CACHE_BODY)
+        {
+            cache->nmeta++;
+        }
+    }
+    // 읽는 동안 파일이 바뀌었으면 이번 요청에만 쓰고 캐시에는 넣지 않는다
+    pthread_rwlock_unlock(&(cache->lock));
+    return entry;
+}
+
+void file_cache_release(CacheEntry *entry)
+{
+    if(atomic_fetch_sub(&(entry->refcount), 1) == 1)
+    {
+        entry_free(entry);
+    }
+}
+
+// inotify 이벤트를 읽어 바뀐 파일을 캐시에서 지운다
+static void *watch_function(void *arg)
+{
+    FileCache *cache = (FileCache *)arg;
+    char       buf[EVENT_BUF_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    while(1)
+    {
+        ssize_t n = read(cache->inotify_fd, buf, sizeof(buf));
+        if(n <= 0)
+        {
+            if(n == -1 && errno == EINTR)
+            {
+                continue;
+            }
+            // 감시를 계속할 수 없으면 더 이상 캐시를 믿을 수 없다: 끄고 비운다
+            // (비울 때 세대가 바뀌므로 그 전에 읽기 시작한 워커도 항목을 넣지 못한다)
+            pthread_rwlock_wrlock(&(cache->lock));
+            cache->disabled = 1;
+            pthread_rwlock_unlock(&(cache->lock));
+            invalidate_all(cache);
+            return NULL;
+        }
+
+        for(char *p = buf; p < buf + n;)
+        {
+            const struct inotify_event *event = (const struct inotify_event *)p;
+            p += sizeof(struct inotify_event) + event->len;
+
+            // 디렉터리 자체가 바뀌면 그 아래 경로를 일일이 알 수 없으므로 전부 비운다
+            if((event->mask & (IN_Q_OVERFLOW | IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF | IN_ISDIR)) || event->len == 0)
+            {
+                invalidate_all(cache);
+                continue;
+            }
+
+            char path[PATH_MAX];
+            pthread_rwlock_rdlock(&(cache->lock));
+            path[0] = '\0';
+            for(size_t i = 0; i < cache->nwatch; ++i)
+            {
+                if(cache->wds[i] == event->wd)
+                {
+                    if(cache->wd_dirs[i][0] == '\0')
+                    {
+                        snprintf(path, sizeof(path), "%s", event->name);
+                    }
+                    else
+                    {
+                        snprintf(path, sizeof(path), "%s/%s", cache->wd_dirs[i], event->name);
+                    }
+                    break;
+                }
+            }
+            pthread_rwlock_unlock(&(cache->lock));
+
+            if(path[0] != '\0' && strcmp(path, cache->ignore) != 0)
+            {
+                invalidate_path(cache, path);
+            }
+        }
+    }
+}
+
+// FNV-1a
+static unsigned int path_hash(const char *path, size_t len)
+{
+    unsigned int hash = 2166136261U;
+
+    for(size_t i = 0; i < len; ++i)
+    {
+        hash ^= (unsigned char)path[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+static CacheEntry *lookup_locked(FileCache *cache, const char *path, unsigned int hash)
+{
+    for(CacheEntry *entry = cache->buckets[hash % CACHE_BUCKETS]; entry != NULL; entry = entry->next)
+    {
+        if(entry->hash == hash && strcmp(entry->path, path) == 0)
+        {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// 파일 내용과 헤더를 메모리에 올린다. 반환된 항목의 참조 수는 1 (호출자 몫)
+// 콘텐츠 타입과 길이는 응답(전체, 범위, 304)마다 달라지므로 헤더에는 검증자만 넣는다
+// 없거나 보낼 수 없는 경로, 올리지 않을 파일은 결과만 담은 항목을 돌려준다. 열다가 다른 이유로 실패하면 NULL
+static CacheEntry *load_entry(const char *path)
+{
+    struct stat st;
+    CacheEntry *entry;
+    int         fd;
+    int         header_len;
+    size_t      off = 0;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd == -1)
+    {
+        // fd 가 모자란 것처럼 지나가는 오류는 기억하지 않는다
+        return errno == ENOENT || errno == ENOTDIR || errno == EACCES ? meta_entry(path, CACHE_MISSING) : NULL;
+    }
+    if(fstat(fd, &st) == -1)
+    {
+        close(fd);
+        return NULL;
+    }
+    // open_send_file 과 같은 기준: 일반 파일, 파이프, 문자 장치만 보낸다
+    if(!S_ISREG(st.st_mode) || st.st_size > CACHE_MAX_FILE_SIZE)
+    {
+        close(fd);
+        return meta_entry(path, S_ISREG(st.st_mode) || S_ISFIFO(st.st_mode) || S_ISCHR(st.st_mode) ? CACHE_LARGE : CACHE_MISSING);
+    }
+
+    entry = (CacheEntry *)calloc(1, sizeof(CacheEntry));
+    if(entry == NULL)
+    {
+        close(fd);
+        return NULL;
+    }
+    entry->path     = strdup(path);
+    entry->body_len = (size_t)st.st_size;
+    entry->body     = (char *)malloc(entry->body_len + 1);
+    if(entry->path == NULL || entry->body == NULL)
+    {
+        close(fd);
+        entry_free(entry);
+        return NULL;
+    }
+
+    while(off < entry->body_len)
+    {
+        ssize_t n = read(fd, entry->body + off, entry->body_len - off);
+        if(n == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if(n <= 0)
+        {
+            close(fd);
+            entry_free(entry);
+            return NULL;
+        }
+        off += (size_t)n;
+    }
+    close(fd);
+
+    http_entity_init(&(entry->entity), st.st_size, st.st_mtime);
+    header_len = http_entity_header(&(entry->entity), entry->header, sizeof(entry->header));
+    if(header_len == -1)
+    {
+        entry_free(entry);
+        return NULL;
+    }
+    entry->header_len = (size_t)header_len;
+    atomic_init(&(entry->refcount), 1);
+    return entry;
+}
+
+// 본문 없이 종류만 담은 항목을 만든다. 반환된 항목의 참조 수는 1 (호출자 몫)
+static CacheEntry *meta_entry(const char *path, int type)
+{
+    CacheEntry *entry = (CacheEntry *)calloc(1, sizeof(CacheEntry));
+
+    if(entry == NULL)
+    {
+        return NULL;
+    }
+    entry->path = strdup(path);
+    if(entry->path == NULL)
+    {
+        free(entry);
+        return NULL;
+    }
+    entry->type = type;
+    atomic_init(&(entry->refcount), 1);
+    return entry;
+}
+
+// path 가 들어 있는 디렉터리를 감시한다. 그 디렉터리가 없으면 있는 조상을 감시한다
+// (조상 아래에 디렉터리가 생기면 IN_ISDIR 이벤트로 캐시를 모두 비우므로 없는 경로를 기억해도 된다)
+static int watch_parent(FileCache *cache, const char *path)
+{
+    char   dir[PATH_MAX];
+    size_t len = strlen(path);
+
+    if(len >= sizeof(dir))
+    {
+        return -1;
+    }
+    memcpy(dir, path, len + 1);
+    while(1)
+    {
+        char *slash = strrchr(dir, '/');
+
+        // 문서 루트는 file_cache_init 에서 감시하기 시작했다
+        if(slash == NULL)
+        {
+            return 0;
+        }
+        *slash = '\0';
+        if(watch_directory(cache, dir) == 0)
+        {
+            return 0;
+        }
+        if(errno != ENOENT && errno != ENOTDIR)
+        {
+            return -1;
+        }
+    }
+}
+
+// 디렉터리를 감시 목록에 추가한다 ("" 은 문서 루트)
+static int watch_directory(FileCache *cache, const char *path)
+{
+    int wd = inotify_add_watch(cache->inotify_fd, path[0] == '\0' ? "." : path, WATCH_MASK | IN_ONLYDIR);
+    if(wd == -1)
+    {
+        return -1;
+    }
+
+    pthread_rwlock_wrlock(&(cache->lock));
+    for(size_t i = 0; i < cache->nwatch; ++i)
+    {
+        if(cache->wds[i] == wd)
+        {
+            pthread_rwlock_unlock(&(cache->lock));
+            return 0;
+        }
+    }
+    if(cache->nwatch == cache->capwatch)
+    {
+        size_t new_cap = cache->capwatch == 0 ? 8 : cache->capwatch * 2;
+        int   *new_wds = (int *)realloc(cache->wds, new_cap * sizeof(int));
+        if(new_wds != NULL)
+        {
+            cache->wds = new_wds;
+        }
+        char **new_dirs = (char **)realloc(cache->wd_dirs, new_cap * sizeof(char *));
+        if(new_dirs != NULL)
+        {
+            cache->wd_dirs = new_dirs;
+        }
+        if(new_wds == NULL || new_dirs == NULL)
+        {
+            pthread_rwlock_unlock(&(cache->lock));
+            return -1;
+        }
+        cache->capwatch = new_cap;
+    }
+    cache->wd_dirs[cache->nwatch] = strdup(path);
+    if(cache->wd_dirs[cache->nwatch] == NULL)
+    {
+        pthread_rwlock_unlock(&(cache->lock));
+        return -1;
+    }
+    cache->wds[cache->nwatch] = wd;
+    cache->nwatch++;
+    pthread_rwlock_unlock(&(cache->lock));
+    return 0;
+}
+
+static void invalidate_path(FileCache *cache, const char *path)
+{
+    unsigned int hash  = path_hash(path, strlen(path));
+    CacheEntry  *found = NULL;
+
+    pthread_rwlock_wrlock(&(cache->lock));
+    cache->generation++;
+    for(CacheEntry **link = &(cache->buckets[hash % CACHE_BUCKETS]); *link != NULL; link = &((*link)->next))
+    {
+        if((*link)->hash == hash && strcmp((*link)->path, path) == 0)
+        {
+            found = *link;
+            *link = found->next;
+            cache->total_bytes -= found->body_len;
+            if(found->type != CACHE_BODY)
+            {
+                cache->nmeta--;
+            }
+            break;
+        }
+    }
+    pthread_rwlock_unlock(&(cache->lock));
+
+    if(found != NULL)
+    {
+        file_cache_release(found);
+    }
+}
+
+static void invalidate_all(FileCache *cache)
+{
+    CacheEntry *removed = NULL;
+
+    pthread_rwlock_wrlock(&(cache->lock));
+    cache->generation++;
+    for(size_t i = 0; i < CACHE_BUCKETS; ++i)
+    {
+        while(cache->buckets[i] != NULL)
+        {
+            CacheEntry *entry = cache->buckets[i];
+            cache->buckets[i] = entry->next;
+            entry->next       = removed;
+            removed           = entry;
+        }
+    }
+    cache->total_bytes = 0;
+    cache->nmeta       = 0;
+    pthread_rwlock_unlock(&(cache->lock));
+
+    while(removed != NULL)
+    {
+        CacheEntry *next = removed->next;
+        file_cache_release(removed);
+        removed = next;
+    }
+}
+
+static void entry_free(CacheEntry *entry)
+{
+    free(entry->path);
+    free(entry->body);
+    free(entry);
+}
@@ -0,0 +1,57 @@
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include "http_conditional.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+#define CACHE_BUCKETS 256                  // 해시 버킷 수
+#define CACHE_MAX_FILE_SIZE (256 * 1024)   // 캐시에 올릴 파일의 최대 크기
+#define CACHE_MAX_BYTES (64 * 1024 * 1024) // 캐시 전체 최대 크기
+#define CACHE_MAX_META 4096                // 본문 없이 결과만 기억하는 항목의 최대 수 (없는 경로, 큰 파일)
+
+// 캐시 항목 종류
+#define CACHE_BODY 0       // 파일 내용을 메모리에 올렸다
+#define CACHE_MISSING 1    // 없거나 보낼 수 없는 경로 (열지 않고 404)
+#define CACHE_LARGE 2      // 올리지 않는 파일 (CACHE_MAX_FILE_SIZE 보다 큰 파일, 파이프, 문자 장치). 열어서 보낸다
+
+// 캐시 항목 구조체 정의
+typedef struct CacheEntry
+{
+    char              *path;                               // 요청 경로 (문서 루트 기준)
+    unsigned int       hash;                               // 경로 해시
+    int                type;                               // CACHE_*. entity 부터는 CACHE_BODY 일 때만 쓴다
+    HttpEntity         entity;                             // 크기, 수정 시각, ETag, Last-Modified
+    char               header[HTTP_ENTITY_HEADER_SIZE];    // 미리 만들어 둔 검증자 헤더 (ETag, Last-Modified, Accept-Ranges)
+    size_t             header_len;
+    char              *body;                               // 파일 내용
+    size_t             body_len;
+    atomic_int         refcount;                           // 테이블 + 전송 중인 워커 수
+    struct CacheEntry *next;                               // 버킷 체인
+} CacheEntry;
+
+// 정적 파일 캐시 구조체 정의
+typedef struct
+{
+    pthread_rwlock_t lock;                       // 읽기가 대부분이므로 rwlock
+    CacheEntry      *buckets[CACHE_BUCKETS];     // 해시 테이블
+    size_t           total_bytes;                // 캐시된 본문 크기 합
+    size_t           nmeta;                      // CACHE_BODY 가 아닌 항목 수
+    unsigned long    generation;                 // 무효화될 때마다 증가
+    int              disabled;                   // 감시가 끊겨 더는 캐시를 쓰지 않는다
+    const char      *ignore;                     // 캐시하지도 변경을 보지도 않는 경로 (서버가 계속 쓰는 저장소 파일)
+    int              inotify_fd;                 // 문서 루트 감시용
+    pthread_t        watcher;                    // inotify 이벤트를 읽는 스레드
+    int             *wds;                        // 감시 중인 디렉터리 watch descriptor
+    char           **wd_dirs;                    // wd 에 대응하는 디렉터리 ("" 은 문서 루트)
+    size_t           nwatch;
+    size_t           capwatch;
+} FileCache;
+
+int         file_cache_init(FileCache *cache, const char *ignore);
+void        file_cache_destroy(FileCache *cache);
+CacheEntry *file_cache_acquire(FileCache *cache, const char *path);
+void        file_cache_release(CacheEntry *entry);
+
+#endif
@@ -0,0 +1,52 @@
+#include "form_parser.h"
+
+static void add_field(FormParser *form, const char *body, size_t start, size_t end);
+
+void form_parser_init(FormParser *form)
+{
+    form->pos         = 0;
+    form->field_start = 0;
+    form->nfields     = 0;
+}
+
+// body[0, len) 에서 아직 보지 않은 부분의 필드를 나눈다. done 이면 본문 끝이므로 마지막 필드도 닫는다
+void form_parse(FormParser *form, const char *body, size_t len, int done)
+{
+    while(form->pos < len)
+    {
+        const char *amp = http_find_char(body + form->pos, body + len, '&');
+
+        if(amp == NULL)
+        {
+            form->pos = len;
+            break;
+        }
+        add_field(form, body, form->field_start, (size_t)(amp - body));
+        form->field_start = (size_t)(amp - body) + 1;
+        form->pos         = form->field_start;
+    }
+    if(done && form->field_start < len)
+    {
+        add_field(form, body, form->field_start, len);
+        form->field_start = len;
+    }
+}
+
+// "name=value" 또는 "name". 빈 필드("&&")는 건너뛴다
+static void add_field(FormParser *form, const char *body, size_t start, size_t end)
+{
+    const char *eq;
+    FormField  *field;
+
+    if(start == end || form->nfields == FORM_MAX_FIELDS)
+    {
+        return;
+    }
+    eq    = http_find_char(body + start, body + end, '=');
+    field = &(form->fields[form->nfields++]);
+
+    field->name.off  = (uint32_t)start;
+    field->name.len  = (uint32_t)((eq != NULL ? (size_t)(eq - body) : end) - start);
+    field->value.off = (uint32_t)(eq != NULL ? (size_t)(eq - body) + 1 : end);
+    field->value.len = (uint32_t)(end - field->value.off);
+}
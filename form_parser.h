@@ -0,0 +1,29 @@
+#ifndef FORM_PARSER_H
+#define FORM_PARSER_H
+
+#include "http_parser.h"
+#include <stddef.h>
+
+#define FORM_MAX_FIELDS 16    // 기록할 최대 필드 수 (넘는 필드는 무시한다)
+
+// application/x-www-form-urlencoded 필드 하나 (본문 시작 기준 오프셋, 디코딩하지 않는다)
+typedef struct
+{
+    HttpSpan name;
+    HttpSpan value;
+} FormField;
+
+// 본문 파서 구조체 정의
+// 본문이 도착할 때마다 form_parse 를 다시 부르면 마지막으로 본 곳부터 이어서 필드를 나눈다
+typedef struct
+{
+    size_t    pos;            // 다음에 '&' 를 찾기 시작할 위치
+    size_t    field_start;    // 지금 읽고 있는 필드의 시작
+    int       nfields;
+    FormField fields[FORM_MAX_FIELDS];
+} FormParser;
+
+void form_parser_init(FormParser *form);
+void form_parse(FormParser *form, const char *body, size_t len, int done);
+
+#endif
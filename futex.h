@@ -0,0 +1,29 @@
+#ifndef FUTEX_H
+#define FUTEX_H
+
+#include <limits.h>
+#include <linux/futex.h>
+#include <stdatomic.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+// 값이 expected 인 동안 잠든다 (값이 이미 바뀌었으면 바로 돌아온다)
+static inline void futex_wait(atomic_uint *addr, unsigned int expected)
+{
+    syscall(SYS_futex, (unsigned int *)addr, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+// futex_wait 과 같지만 timeout (상대 시간) 이 지나면 돌아온다
+static inline void futex_wait_timeout(atomic_uint *addr, unsigned int expected, const struct timespec *timeout)
+{
+    syscall(SYS_futex, (unsigned int *)addr, FUTEX_WAIT_PRIVATE, expected, timeout, NULL, 0);
+}
+
+// addr 에서 잠든 스레드를 최대 count 개 깨운다
+static inline void futex_wake(atomic_uint *addr, int count)
+{
+    syscall(SYS_futex, (unsigned int *)addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+#endif
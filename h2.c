@@ -0,0 +1,1909 @@
+// HTTP/2 (RFC 9113) 평문 연결: 서문으로 시작하거나 (prior knowledge) HTTP/1.1 요청에서 h2c 로 업그레이드한다
+// 스트림마다 요청을 HTTP/1.1 형식으로 다시 써서 기존 요청 처리 (정적 파일, POST, /metrics, API) 에 그대로 넘기고
+// 응답은 HPACK 으로 압축한 HEADERS 와 흐름 제어 창만큼 나눈 DATA 프레임으로 바꿔 보낸다 (서버 푸시와 우선순위는 쓰지 않는다)
+#include "h2.h"
+#include "log.h"
+#include "metrics.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// 프레임 종류
+#define FRAME_DATA 0x0
+#define FRAME_HEADERS 0x1
+#define FRAME_PRIORITY 0x2
+#define FRAME_RST_STREAM 0x3
+#define FRAME_SETTINGS 0x4
+#define FRAME_PUSH_PROMISE 0x5
+#define FRAME_PING 0x6
+#define FRAME_GOAWAY 0x7
+#define FRAME_WINDOW_UPDATE 0x8
+#define FRAME_CONTINUATION 0x9
+
+// 프레임 플래그
+#define FLAG_END_STREAM 0x1
+#define FLAG_ACK 0x1
+#define FLAG_END_HEADERS 0x4
+#define FLAG_PADDED 0x8
+#define FLAG_PRIORITY 0x20
+
+// SETTINGS 항목
+#define SETTINGS_HEADER_TABLE_SIZE 0x1
+#define SETTINGS_ENABLE_PUSH 0x2
+#define SETTINGS_MAX_CONCURRENT_STREAMS 0x3
+#define SETTINGS_INITIAL_WINDOW_SIZE 0x4
+#define SETTINGS_MAX_FRAME_SIZE 0x5
+#define SETTINGS_MAX_HEADER_LIST_SIZE 0x6
+
+#define WINDOW_MAX 0x7fffffff          // 흐름 제어 창의 최대 크기
+#define UPGRADE_SETTINGS_MAX 96         // HTTP2-Settings 헤더로 받는 SETTINGS 본문의 최대 크기 (항목 16 개)
+#define HEADER_BLOCK_SIZE 4096          // 응답 헤더 블록의 최대 크기 (H2_HEADER_TEXT 를 압축한 것)
+
+// 의사 헤더 (요청 줄을 다시 쓸 때의 자리)
+#define PSEUDO_METHOD 0
+#define PSEUDO_SCHEME 1
+#define PSEUDO_PATH 2
+#define PSEUDO_AUTHORITY 3
+#define PSEUDO_COUNT 4
+
+typedef struct
+{
+    size_t         length;
+    uint8_t        type;
+    uint8_t        flags;
+    uint32_t       stream_id;
+    const uint8_t *payload;    // 연결 버퍼 안 (프레임을 처리하는 동안만 쓴다)
+} Frame;
+
+static const char *const pseudo_names[PSEUDO_COUNT] = {":method", ":scheme", ":path", ":authority"};
+
+static H2Session *session_create(Connection *conn, H2ServeFunction serve);
+static int        upgrade(Connection *conn, H2ServeFunction serve);
+static void       session_run(H2Session *session, int held, uint64_t queued);
+static void       session_process(H2Session *session);
+static void       session_pump(H2Session *session);
+static int        session_flush(H2Session *session);
+static void       session_fail(H2Session *session, uint32_t code);
+static uint32_t   handle_frame(H2Session *session, const Frame *frame);
+static uint32_t   on_data(H2Session *session, const Frame *frame);
+static uint32_t   on_headers(H2Session *session, const Frame *frame);
+static uint32_t   on_continuation(H2Session *session, const Frame *frame);
+static uint32_t   on_rst_stream(H2Session *session, const Frame *frame);
+static uint32_t   on_settings(H2Session *session, const Frame *frame);
+static uint32_t   on_window_update(H2Session *session, const Frame *frame);
+static uint32_t   apply_settings(H2Session *session, const uint8_t *p, size_t len);
+static uint32_t   header_block(H2Session *session, uint32_t id, const uint8_t *block, size_t len, int end_stream);
+static uint32_t   decode_discard(H2Session *session, const uint8_t *block, size_t len);
+static int        request_headers(H2Stream *stream, const HpackField *fields, int nfields);
+static int        field_valid(Slice name, Slice value);
+static H2Stream  *stream_open(H2Session *session, uint32_t id);
+static H2Stream  *stream_find(const H2Session *session, uint32_t id);
+static void       stream_complete(H2Session *session, H2Stream *stream);
+static void       stream_error(H2Session *session, uint32_t id, uint32_t code);
+static void       stream_abort(H2Session *session, H2Stream *stream);
+static void       stream_serve(H2Session *session, H2Stream *stream, uint64_t queued);
+static void       stream_finish(H2Session *session, H2Stream *stream);
+static void       stream_close(H2Session *session, H2Stream *stream);
+static int        send_headers(H2Session *session, H2Stream *stream, const char *text, size_t len, int end_stream);
+static ssize_t    send_data(H2Session *session, H2Stream *stream, const char *data, size_t len, int last);
+static int        send_body(H2Session *session, H2Stream *stream, const char *data, size_t len, int last);
+static int        send_file_data(H2Session *session, H2Stream *stream, int file_fd, off_t *offset, off_t *len);
+static H2Chunk   *queue_chunk(H2Session *session, H2Stream *stream, const char *data, size_t len);
+static uint8_t   *out_reserve(H2Session *session, size_t size, int iovs);
+static int        queue_control(H2Session *session, uint8_t type, uint8_t flags, uint32_t stream_id, const void *payload, size_t len);
+static void       queue_rst(H2Session *session, uint32_t id, uint32_t code);
+static void       queue_window_update(H2Session *session, uint32_t id, uint32_t increment);
+static int        buffer_grow(Connection *conn, size_t need, size_t limit);
+static int        has_token(Slice value, const char *token);
+static int        base64url_decode(Slice in, uint8_t *out, size_t size, size_t *len);
+static void       frame_header(uint8_t *p, size_t len, uint8_t type, uint8_t flags, uint32_t stream_id);
+static uint32_t   read32(const uint8_t *p);
+static void       write32(uint8_t *p, uint32_t value);
+
+// buf 가 HTTP/2 연결 서문으로 시작하면 1, 서문의 앞부분만 왔으면 0, 서문이 아니면 -1
+int h2_preface(const char *buf, size_t len)
+{
+    size_t n = len < H2_PREFACE_LEN ? len : H2_PREFACE_LEN;
+
+    if(memcmp(buf, H2_PREFACE, n) != 0)
+    {
+        return -1;
+    }
+    return len >= H2_PREFACE_LEN;
+}
+
+// 리액터가 부른다. 워커가 처리할 것 (서문이나 프레임 하나) 이 버퍼에 다 왔으면 1
+// 너무 큰 프레임이나 서문이 아닌 바이트도 워커가 연결 오류로 닫도록 넘긴다
+int h2_frame_ready(const H2Session *session, const char *buf, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+    size_t         length;
+
+    if(session->preface == 0)
+    {
+        return h2_preface(buf, len) != 0;
+    }
+    if(len < H2_FRAME_HEADER)
+    {
+        return 0;
+    }
+    length = (size_t)p[0] << 16 | (size_t)p[1] << 8 | p[2];
+    return length > H2_MAX_FRAME || len >= H2_FRAME_HEADER + length;
+}
+
+// 연결이 HTTP/2 로 시작하면 세션을 만든다: 버퍼가 서문으로 시작하거나 (prior knowledge) 버퍼 앞의 요청이 h2c 업그레이드 요청
+// 반환값: 세션을 만들었으면 1 (h2_session_run 으로 돌린다), HTTP/1.x 로 처리하면 0, 실패하면 -1 (연결을 닫는다)
+int h2_start(Connection *conn, H2ServeFunction serve)
+{
+    if(h2_preface(conn->buf, conn->len) == 1)
+    {
+        return session_create(conn, serve) == NULL ? -1 : 1;
+    }
+    if(conn->req.state == HTTP_STATE_DONE && conn->req.upgrade)
+    {
+        return upgrade(conn, serve);
+    }
+    return 0;
+}
+
+// 워커가 리액터에게 받은 HTTP/2 연결을 처리한다 (queued 는 워커 큐에서 기다린 시간, 이번에 응답할 스트림의 과부하 판단에 쓴다)
+// 저장을 마친 POST 의 응답을 보내는 워커가 세션을 돌리고 있으면 표시만 하고 그 워커가 이어서 프레임을 처리한다
+void h2_session_run(Connection *conn, uint64_t queued)
+{
+    H2Session *session = conn->h2;
+    int        run;
+
+    pthread_mutex_lock(&(session->lock));
+    run               = !session->owned;
+    session->owned    = 1;
+    session->incoming = !run;
+    if(!run)
+    {
+        session->incoming_queued = queued;
+    }
+    pthread_mutex_unlock(&(session->lock));
+    if(run)
+    {
+        session_run(session, 1, queued);
+    }
+}
+
+// 리액터가 제한 시간을 정할 때 부른다. 응답을 기다리는 스트림 (저장 중인 POST, 창이 닫힌 본문) 이 있으면 1
+int h2_session_busy(H2Session *session)
+{
+    int busy;
+
+    pthread_mutex_lock(&(session->lock));
+    busy = session->pending > 0 || session->parked > 0;
+    pthread_mutex_unlock(&(session->lock));
+    return busy;
+}
+
+// 연결을 닫을 때 (connection_free, 소켓은 이미 끊었다) 부른다. 지금 해제해도 되면 1
+// 세션을 돌리는 워커나 저장을 기다리는 POST 가 있으면 0. 세션을 마지막으로 놓는 워커가 connection_finish 로 해제하므로 그 뒤로는 세션을 건드리지 않는다
+int h2_session_close(H2Session *session)
+{
+    int idle;
+
+    pthread_mutex_lock(&(session->lock));
+    session->closed = 1;
+    idle            = !session->owned && session->pending == 0;
+    pthread_mutex_unlock(&(session->lock));
+    return idle;
+}
+
+// 연결을 닫을 때 (connection_free) 남은 스트림의 메모리를 돌려준다. 세션은 연결의 아레나와 함께 사라진다
+void h2_session_destroy(H2Session *session)
+{
+    while(session->nstreams > 0)
+    {
+        stream_close(session, session->streams[session->nstreams - 1]);
+    }
+    pthread_mutex_destroy(&(session->lock));
+}
+
+// 저장을 마친 POST 의 응답을 넘긴다 (post_committed 가 부른다). 소켓에는 세션을 돌리는 워커만 쓰므로
+// 돌리는 워커가 있으면 목록에 넣기만 하고, 없으면 (연결이 리액터에 있으면) 이 스레드가 세션을 넘겨받아 응답을 보낸다
+void h2_stream_resume(Connection *conn, void (*function)(void *), void *arg)
+{
+    H2Stream  *stream  = conn->stream;
+    H2Session *session = stream->session;
+    int        run;
+
+    stream->resume     = function;
+    stream->resume_arg = arg;
+    pthread_mutex_lock(&(session->lock));
+    stream->next     = session->resumed;
+    session->resumed = stream;
+    run              = !session->owned;
+    session->owned   = 1;
+    pthread_mutex_unlock(&(session->lock));
+    if(run)
+    {
+        session_run(session, 0, 0);
+    }
+}
+
+// 워커가 만든 HTTP/1.1 응답 (response_init 으로 시작한 조각들) 을 HEADERS 와 DATA 프레임으로 바꿔 보낸다
+// 처음 부를 때 빈 줄로 끝나는 조각까지를 응답 머리로 읽고 (Connection 처럼 HTTP/2 에 없는 헤더는 뺀다), 나머지는 본문으로 보낸다
+// more 가 0 이면 응답의 끝이다 (END_STREAM). 반환값: 0 정상, -1 스트림이나 연결에 더 쓸 수 없다
+int h2_respond(H2Stream *stream, Response *res, int more)
+{
+    H2Session *session = stream->session;
+    int        iovcnt  = res->iovcnt;
+    int        result  = 0;
+    int        i       = 0;
+
+    res->iovcnt = 0;
+    if(res->overflow || stream->reset || session->failed)
+    {
+        return -1;
+    }
+    if(!stream->headers_sent)
+    {
+        char   text[H2_HEADER_TEXT];
+        size_t len = 0;
+
+        while(i < iovcnt && !(len >= 4 && memcmp(text + len - 4, "\r\n\r\n", 4) == 0))
+        {
+            if(len + res->iov[i].iov_len > sizeof(text))
+            {
+                return -1;
+            }
+            memcpy(text + len, res->iov[i].iov_base, res->iov[i].iov_len);
+            len += res->iov[i].iov_len;
+            i++;
+        }
+        if(len < 4 || memcmp(text + len - 4, "\r\n\r\n", 4) != 0 || send_headers(session, stream, text, len, !more && i == iovcnt) == -1)
+        {
+            return -1;
+        }
+    }
+    for(; i < iovcnt && result == 0; ++i)
+    {
+        result = send_body(session, stream, (const char *)res->iov[i].iov_base, res->iov[i].iov_len, !more && i == iovcnt - 1);
+    }
+    // 맡겨 둔 본문이 있으면 END_STREAM 은 그것을 다 보낸 뒤에 붙는다 (stream_finish)
+    if(result == 0 && !more && !stream->end_sent && stream->queue == NULL && send_data(session, stream, NULL, 0, 1) == -1)
+    {
+        result = -1;
+    }
+    // 창 안의 본문 조각은 부른 쪽의 메모리이므로 돌아가기 전에 보낸다
+    if(session_flush(session) == -1)
+    {
+        return -1;
+    }
+    return result;
+}
+
+// 파일의 offset 부터 len 바이트를 DATA 프레임으로 보낸다. offset 이 -1 이면 지금 위치부터 read 로 읽고, len 이 -1 이면 끝까지 (파이프)
+// sendfile 은 프레임 머리를 끼울 수 없으므로 읽어서 보낸다. 창이 닫히면 fd 를 dup 해 두고 남은 범위는 창이 열릴 때 session_pump 가 보낸다
+int h2_send_file(H2Stream *stream, int file_fd, off_t offset, off_t len)
+{
+    H2Session *session = stream->session;
+    H2Chunk   *chunk;
+    int        status  = 0;
+
+    if(stream->reset || session->failed)
+    {
+        return -1;
+    }
+    if(stream->queue == NULL)
+    {
+        status = send_file_data(session, stream, file_fd, &offset, &len);
+    }
+    if(status != 0)
+    {
+        return status == 1 ? 0 : -1;
+    }
+    chunk = queue_chunk(session, stream, NULL, 0);
+    if(chunk == NULL)
+    {
+        return -1;
+    }
+    chunk->fd = fcntl(file_fd, F_DUPFD_CLOEXEC, 0);
+    if(chunk->fd == -1)
+    {
+        LOG(LOG_ERROR, "h2: dup: %m");
+        stream_error(session, stream->id, H2_INTERNAL_ERROR);
+        return -1;
+    }
+    chunk->offset = offset;
+    chunk->len    = len;
+    return 0;
+}
+
+// 세션을 연결의 아레나에 만들고 서버 SETTINGS 를 보낼 준비를 한다. 메모리가 없으면 NULL
+static H2Session *session_create(Connection *conn, H2ServeFunction serve)
+{
+    H2Session *session = (H2Session *)arena_alloc(conn->arena, sizeof(H2Session));
+    uint8_t    settings[12];
+    int        on      = 1;
+
+    if(session == NULL)
+    {
+        LOG(LOG_ERROR, "h2: out of memory");
+        return NULL;
+    }
+    // 세션은 연결이 닫힐 때까지 남으므로 요청을 마칠 때 되돌릴 위치를 그 뒤로 옮긴다 (큰 버퍼는 초기화하지 않는다)
+    arena_mark(conn->arena);
+    memset(session, 0, offsetof(H2Session, decoder));
+    pthread_mutex_init(&(session->lock), NULL);
+    session->conn           = conn;
+    session->serve          = serve;
+    session->send_window    = H2_DEFAULT_WINDOW;
+    session->recv_window    = H2_CONN_WINDOW;
+    session->initial_window = H2_DEFAULT_WINDOW;
+    hpack_table_init(&(session->decoder), HPACK_TABLE_SIZE);
+    hpack_table_init(&(session->encoder), HPACK_TABLE_SIZE);
+    session->out.iovcnt   = 0;
+    session->out.overflow = 0;
+    session->out.used     = 0;
+    session->out_used     = 0;
+    conn->h2              = session;
+
+    // 프레임은 out 에 모아 한 번에 보내므로 Nagle 을 끈다. 창이 조금씩 열릴 때 나가는 작은 DATA 가
+    // 앞 세그먼트의 ACK 를 기다리면 지연 ACK 와 맞물려 WINDOW_UPDATE 가 늦게 온다
+    setsockopt(conn->fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    // 서버 서문: 동시 스트림 수와 헤더 크기를 알리고, 연결 창을 늘려 여러 스트림의 본문을 한꺼번에 받는다
+    settings[0] = 0;
+    settings[1] = SETTINGS_MAX_CONCURRENT_STREAMS;
+    write32(settings + 2, H2_MAX_STREAMS);
+    settings[6] = 0;
+    settings[7] = SETTINGS_MAX_HEADER_LIST_SIZE;
+    write32(settings + 8, MAX_HEADER_SIZE);
+    queue_control(session, FRAME_SETTINGS, 0, 0, settings, sizeof(settings));
+    queue_window_update(session, 0, H2_CONN_WINDOW - H2_DEFAULT_WINDOW);
+    metrics_count(METRIC_H2_CONNECTIONS, 1);
+    return session;
+}
+
+// h2c 업그레이드 (RFC 7540 3.2): Upgrade 에 h2c 가 있고 HTTP2-Settings 를 읽을 수 있으면 101 을 보내고
+// 그 요청을 스트림 1 의 요청으로 옮긴다. 본문이 있는 요청은 업그레이드하지 않고 HTTP/1.1 로 응답한다 (서버가 고를 수 있다)
+static int upgrade(Connection *conn, H2ServeFunction serve)
+{
+    HttpRequest *req = &(conn->req);
+    H2Session   *session;
+    H2Stream    *stream;
+    Response     res;
+    Slice        value;
+    uint8_t      settings[UPGRADE_SETTINGS_MAX];
+    size_t       settings_len;
+
+    if(req->body_len > 0 || http_header_find(req, conn->buf, "Upgrade", &value) == -1 || !has_token(value, "h2c"))
+    {
+        return 0;
+    }
+    if(http_header_find(req, conn->buf, "HTTP2-Settings", &value) == -1 || base64url_decode(value, settings, sizeof(settings), &settings_len) == -1 || settings_len % 6 != 0)
+    {
+        return 0;
+    }
+
+    // 101 은 서버 SETTINGS 와 이어서 나간다
+    response_init(&res, 101);
+    response_printf(&res, "Connection: Upgrade\r\nUpgrade: h2c\r\n\r\n");
+    connection_send_begin(conn);
+    if(response_send(&res, conn->fd, 1, conn->send_deadline) == -1)
+    {
+        return -1;
+    }
+    session = session_create(conn, serve);
+    if(session == NULL || apply_settings(session, settings, settings_len) != H2_NO_ERROR)
+    {
+        return -1;
+    }
+    stream = stream_open(session, 1);
+    if(stream == NULL || buffer_grow(stream->conn, req->header_len, MAX_HEADER_SIZE) == -1)
+    {
+        return -1;
+    }
+    memcpy(stream->conn->buf, conn->buf, req->header_len);
+    stream->conn->len    = req->header_len;
+    stream->header_len   = req->header_len;
+    session->last_stream = 1;
+    stream_complete(session, stream);
+
+    conn->req_len = req->header_len;
+    connection_consume(conn);
+    return 1;
+}
+
+// 세션을 돌린다: held 면 (리액터가 넘긴 연결) 버퍼의 프레임을 처리하고, 창이 열린 스트림의 남은 본문과 저장을 마친 POST,
+// 요청을 다 받은 스트림에 차례로 응답한다. 할 일이 없으면 세션을 놓고, 넘겨받은 연결은 리액터에 돌려주거나 닫는다
+// 저장을 기다리는 POST 나 창이 닫힌 스트림이 있어도 기다리지 않는다 (h2_stream_resume 과 다음 WINDOW_UPDATE 가 이어서 돌린다)
+static void session_run(H2Session *session, int held, uint64_t queued)
+{
+    Connection *conn    = session->conn;
+    int         release = 0;
+    int         done    = 0;
+
+    // 이번에 돌리는 동안 보내는 응답 전체의 마감 (프레임이 올 때마다 새로 주지 않는다)
+    connection_send_begin(conn);
+    while(1)
+    {
+        H2Stream *stream;
+
+        if(held)
+        {
+            session_process(session);
+        }
+        session_pump(session);
+        // 업그레이드한 스트림 1 은 클라이언트 서문과 SETTINGS 를 받은 뒤 응답한다
+        // (101 뒤에 응답 본문까지 이어 보내면 업그레이드 버퍼가 작은 클라이언트가 받지 못한다)
+        stream = session->preface == 2 ? session->ready : NULL;
+        if(stream != NULL)
+        {
+            session->ready = stream->next;
+            stream_serve(session, stream, queued);
+            continue;
+        }
+
+        pthread_mutex_lock(&(session->lock));
+        stream = session->resumed;
+        if(stream != NULL)
+        {
+            session->resumed = stream->next;
+            session->pending--;
+        }
+        pthread_mutex_unlock(&(session->lock));
+        if(stream != NULL)
+        {
+            stream->resume(stream->resume_arg);
+            stream_finish(session, stream);
+            continue;
+        }
+
+        session_flush(session);
+        if(!held && session->failed)
+        {
+            // 더 쓸 수 없다: 소켓을 끊어 연결을 가진 리액터가 닫게 한다 (세션을 놓기 전이라 아직 해제되지 않는다)
+            shutdown(conn->fd, SHUT_RDWR);
+        }
+        pthread_mutex_lock(&(session->lock));
+        if(session->resumed != NULL)
+        {
+            pthread_mutex_unlock(&(session->lock));
+            continue;
+        }
+        if(session->incoming)
+        {
+            // 그동안 리액터가 넘긴 프레임: 이제 연결은 이 워커 것이다
+            session->incoming = 0;
+            held              = 1;
+            queued            = session->incoming_queued;
+            pthread_mutex_unlock(&(session->lock));
+            continue;
+        }
+        // 세션을 놓은 뒤에는 다른 워커가 넘겨받을 수 있으므로 할 일은 그 전에 정한다
+        done           = session->failed || (session->goaway && session->nstreams == 0);
+        release        = session->closed && session->pending == 0;
+        session->owned = 0;
+        pthread_mutex_unlock(&(session->lock));
+        break;
+    }
+    if(!held)
+    {
+        // 리액터가 먼저 연결을 닫았으면 세션을 마지막으로 놓은 워커가 해제한다
+        if(release)
+        {
+            connection_finish(conn);
+        }
+        return;
+    }
+
+    if(done)
+    {
+        connection_finish(conn);
+        return;
+    }
+    // 처리한 프레임을 버리고 다음 프레임은 리액터가 기다린다
+    conn->req_len = session->pos;
+    session->pos  = 0;
+    connection_consume(conn);
+    connection_resume(conn);
+}
+
+// 버퍼에 다 온 프레임을 모두 처리한다. 요청을 다 받은 스트림은 ready 에 넣는다 (응답은 session_run 이 한다)
+static void session_process(H2Session *session)
+{
+    Connection *conn = session->conn;
+
+    while(!session->failed)
+    {
+        const uint8_t *p     = (const uint8_t *)conn->buf + session->pos;
+        size_t         avail = conn->len - session->pos;
+        Frame          frame;
+        uint32_t       error;
+
+        if(session->preface == 0)
+        {
+            int status = h2_preface((const char *)p, avail);
+
+            if(status == 0)
+            {
+                return;
+            }
+            if(status == -1)
+            {
+                session_fail(session, H2_PROTOCOL_ERROR);
+                return;
+            }
+            session->pos += H2_PREFACE_LEN;
+            session->preface = 1;
+            continue;
+        }
+        if(avail < H2_FRAME_HEADER)
+        {
+            return;
+        }
+        frame.length    = (size_t)p[0] << 16 | (size_t)p[1] << 8 | p[2];
+        frame.type      = p[3];
+        frame.flags     = p[4];
+        frame.stream_id = read32(p + 5) & WINDOW_MAX;
+        frame.payload   = p + H2_FRAME_HEADER;
+        if(frame.length > H2_MAX_FRAME)
+        {
+            session_fail(session, H2_FRAME_SIZE_ERROR);
+            return;
+        }
+        if(avail < H2_FRAME_HEADER + frame.length)
+        {
+            return;
+        }
+        session->pos += H2_FRAME_HEADER + frame.length;
+
+        // 서문 바로 뒤는 SETTINGS 여야 한다
+        if(session->preface == 1 && frame.type != FRAME_SETTINGS)
+        {
+            error = H2_PROTOCOL_ERROR;
+        }
+        else
+        {
+            session->preface = 2;
+            error            = handle_frame(session, &frame);
+        }
+        if(error != H2_NO_ERROR)
+        {
+            session_fail(session, error);
+            return;
+        }
+    }
+}
+
+// 창이 열린 스트림의 맡겨 둔 본문을 보낸다 (WINDOW_UPDATE 나 SETTINGS 를 처리한 뒤). 다 보냈고 응답을 마친 스트림은 닫는다
+static void session_pump(H2Session *session)
+{
+    // stream_close 는 마지막 스트림을 빈자리로 옮기므로 뒤에서부터 돈다
+    for(int i = session->nstreams - 1; i >= 0 && !session->failed; --i)
+    {
+        H2Stream *stream = session->streams[i];
+
+        if(stream->queue == NULL)
+        {
+            continue;
+        }
+        while(stream->queue != NULL && !stream->reset)
+        {
+            H2Chunk *chunk = stream->queue;
+            int      status;
+
+            if(chunk->fd == -1)
+            {
+                ssize_t sent = send_data(session, stream, chunk->data, (size_t)chunk->len, 0);
+
+                if(sent > 0)
+                {
+                    chunk->data += sent;
+                    chunk->len -= sent;
+                }
+                status = sent == -1 ? -1 : chunk->len == 0;
+            }
+            else
+            {
+                status = send_file_data(session, stream, chunk->fd, &(chunk->offset), &(chunk->len));
+            }
+            if(status == -1)
+            {
+                stream_error(session, stream->id, H2_INTERNAL_ERROR);    // 파일이 중간에 잘렸다
+                break;
+            }
+            if(status == 0)
+            {
+                break;    // 창이 다시 닫혔다
+            }
+            stream->queue = chunk->next;
+            if(chunk->fd != -1)
+            {
+                close(chunk->fd);
+            }
+            if(stream->queue == NULL)
+            {
+                pthread_mutex_lock(&(session->lock));
+                session->parked--;
+                pthread_mutex_unlock(&(session->lock));
+            }
+        }
+        // 메모리 조각은 스트림 아레나를 가리키므로 스트림을 닫기 전에 보낸다
+        session_flush(session);
+        if(stream->finished && (stream->queue == NULL || stream->reset))
+        {
+            stream_finish(session, stream);
+        }
+    }
+}
+
+// 모아 둔 프레임을 sendmsg 한 번으로 보낸다 (응답 마감까지 기다린다). 더 쓸 수 없으면 -1
+static int session_flush(H2Session *session)
+{
+    if(session->out.iovcnt > 0 && !session->failed && response_send(&(session->out), session->conn->fd, 0, session->conn->send_deadline) == -1)
+    {
+        LOG(LOG_DEBUG, "h2: send: %m");
+        session->failed = 1;
+    }
+    session->out.iovcnt = 0;
+    session->out_used   = 0;
+    return session->failed ? -1 : 0;
+}
+
+// 연결 오류: GOAWAY 를 보내고 세션을 닫는다 (남은 스트림에는 응답하지 않는다)
+static void session_fail(H2Session *session, uint32_t code)
+{
+    uint8_t payload[8];
+
+    LOG(LOG_DEBUG, "h2: connection error %u", code);
+    write32(payload, session->last_stream);
+    write32(payload + 4, code);
+    if(queue_control(session, FRAME_GOAWAY, 0, 0, payload, sizeof(payload)) == 0)
+    {
+        session_flush(session);
+    }
+    session->failed = 1;
+}
+
+// 프레임 하나를 처리한다. 반환값: H2_NO_ERROR 또는 연결 오류 코드 (스트림 오류는 안에서 RST_STREAM 으로 보낸다)
+static uint32_t handle_frame(H2Session *session, const Frame *frame)
+{
+    // 헤더 블록은 다른 프레임이 끼어들지 않고 이어진다
+    if(session->continuation != 0 && (frame->type != FRAME_CONTINUATION || frame->stream_id != session->continuation))
+    {
+        return H2_PROTOCOL_ERROR;
+    }
+    switch(frame->type)
+    {
+        case FRAME_DATA:
+            return on_data(session, frame);
+        case FRAME_HEADERS:
+            return on_headers(session, frame);
+        case FRAME_CONTINUATION:
+            return on_continuation(session, frame);
+        case FRAME_PRIORITY:
+            // 우선순위는 쓰지 않는다 (응답은 요청을 다 받은 순서)
+            if(frame->stream_id == 0)
+            {
+                return H2_PROTOCOL_ERROR;
+            }
+            if(frame->length != 5)
+            {
+                stream_error(session, frame->stream_id, H2_FRAME_SIZE_ERROR);
+            }
+            return H2_NO_ERROR;
+        case FRAME_RST_STREAM:
+            return on_rst_stream(session, frame);
+        case FRAME_SETTINGS:
+            return on_settings(session, frame);
+        case FRAME_PUSH_PROMISE:
+            return H2_PROTOCOL_ERROR;    // 클라이언트는 푸시하지 않는다
+        case FRAME_PING:
+            if(frame->stream_id != 0)
+            {
+                return H2_PROTOCOL_ERROR;
+            }
+            if(frame->length != 8)
+            {
+                return H2_FRAME_SIZE_ERROR;
+            }
+            if(!(frame->flags & FLAG_ACK))
+            {
+                queue_control(session, FRAME_PING, FLAG_ACK, 0, frame->payload, 8);
+            }
+            return H2_NO_ERROR;
+        case FRAME_GOAWAY:
+            if(frame->stream_id != 0)
+            {
+                return H2_PROTOCOL_ERROR;
+            }
+            if(frame->length < 8)
+            {
+                return H2_FRAME_SIZE_ERROR;
+            }
+            session->goaway = 1;
+            return H2_NO_ERROR;
+        case FRAME_WINDOW_UPDATE:
+            return on_window_update(session, frame);
+        default:
+            return H2_NO_ERROR;    // 모르는 프레임은 버린다 (RFC 9113 4.1)
+    }
+}
+
+// 요청 본문. 흐름 제어는 채움까지 포함한 프레임 길이로 세고, 창이 반 넘게 줄면 다시 채운다
+static uint32_t on_data(H2Session *session, const Frame *frame)
+{
+    const uint8_t *p   = frame->payload;
+    size_t         len = frame->length;
+    H2Stream      *stream;
+
+    if(frame->stream_id == 0)
+    {
+        return H2_PROTOCOL_ERROR;
+    }
+    session->recv_window -= (int64_t)frame->length;
+    if(session->recv_window < 0)
+    {
+        return H2_FLOW_CONTROL_ERROR;
+    }
+    if(session->recv_window < H2_CONN_WINDOW / 2)
+    {
+        queue_window_update(session, 0, (uint32_t)(H2_CONN_WINDOW - session->recv_window));
+        session->recv_window = H2_CONN_WINDOW;
+    }
+    if(frame->flags & FLAG_PADDED)
+    {
+        if(len < 1 || p[0] >= len)
+        {
+            return H2_PROTOCOL_ERROR;
+        }
+        len -= 1 + (size_t)p[0];
+        p++;
+    }
+
+    stream = stream_find(session, frame->stream_id);
+    if(stream == NULL)
+    {
+        // 이미 닫은 스트림에 오던 본문은 버린다 (연결 창에서는 뺐다)
+        return frame->stream_id > session->last_stream ? H2_PROTOCOL_ERROR : H2_NO_ERROR;
+    }
+    if(stream->state != H2_STREAM_OPEN)
+    {
+        if(!stream->early)
+        {
+            stream_error(session, stream->id, H2_STREAM_CLOSED);
+        }
+        else if(frame->flags & FLAG_END_STREAM)
+        {
+            stream->early = 0;
+        }
+        return H2_NO_ERROR;
+    }
+    stream->recv_window -= (int64_t)frame->length;
+    if(stream->recv_window < 0)
+    {
+        stream_error(session, stream->id, H2_FLOW_CONTROL_ERROR);
+        return H2_NO_ERROR;
+    }
+    if(!(frame->flags & FLAG_END_STREAM) && stream->recv_window < H2_DEFAULT_WINDOW / 2)
+    {
+        queue_window_update(session, stream->id, (uint32_t)(H2_DEFAULT_WINDOW - stream->recv_window));
+        stream->recv_window = H2_DEFAULT_WINDOW;
+    }
+
+    // 이미 오류로 응답하기로 한 요청 (헤더가 너무 크다, 431) 의 본문은 버리고 그 오류를 지킨다
+    if(stream->error == 0 && len > 0 && buffer_grow(stream->conn, stream->conn->len + len, stream->header_len + stream->conn->reactor->max_body) == 0)
+    {
+        memcpy(stream->conn->buf + stream->conn->len, p, len);
+        stream->conn->len += len;
+    }
+    else if(stream->error == 0 && len > 0)
+    {
+        // 본문이 너무 크다: 나머지를 기다리지 않고 413 으로 응답한다 (응답 뒤 RST_STREAM NO_ERROR)
+        stream->error = 413;
+        stream->early = !(frame->flags & FLAG_END_STREAM);
+        stream_complete(session, stream);
+        return H2_NO_ERROR;
+    }
+    if(frame->flags & FLAG_END_STREAM)
+    {
+        stream_complete(session, stream);
+    }
+    return H2_NO_ERROR;
+}
+
+// 헤더 블록의 첫 프레임. 채움과 우선순위를 떼고, END_HEADERS 가 없으면 CONTINUATION 과 이어 붙인다
+static uint32_t on_headers(H2Session *session, const Frame *frame)
+{
+    const uint8_t *p   = frame->payload;
+    size_t         len = frame->length;
+
+    if(frame->stream_id == 0 || (frame->stream_id & 1) == 0)
+    {
+        return H2_PROTOCOL_ERROR;    // 클라이언트가 여는 스트림은 홀수
+    }
+    if(frame->flags & FLAG_PADDED)
+    {
+        if(len < 1 || p[0] >= len)
+        {
+            return H2_PROTOCOL_ERROR;
+        }
+        len -= 1 + (size_t)p[0];
+        p++;
+    }
+    if(frame->flags & FLAG_PRIORITY)
+    {
+        if(len < 5)
+        {
+            return H2_FRAME_SIZE_ERROR;
+        }
+        p += 5;
+        len -= 5;
+    }
+    if(frame->flags & FLAG_END_HEADERS)
+    {
+        // 한 프레임에 다 온 블록은 연결 버퍼에서 그대로 디코딩한다
+        return header_block(session, frame->stream_id, p, len, frame->flags & FLAG_END_STREAM);
+    }
+    if(len > sizeof(session->block))
+    {
+        return H2_ENHANCE_YOUR_CALM;
+    }
+    memcpy(session->block, p, len);
+    session->block_len    = len;
+    session->block_flags  = frame->flags;
+    session->continuation = frame->stream_id;
+    return H2_NO_ERROR;
+}
+
+static uint32_t on_continuation(H2Session *session, const Frame *frame)
+{
+    if(session->continuation == 0)
+    {
+        return H2_PROTOCOL_ERROR;
+    }
+    if(session->block_len + frame->length > sizeof(session->block))
+    {
+        return H2_ENHANCE_YOUR_CALM;    // 동적 표를 맞출 수 없으므로 연결을 닫는다
+    }
+    memcpy(session->block + session->block_len, frame->payload, frame->length);
+    session->block_len += frame->length;
+    if(!(frame->flags & FLAG_END_HEADERS))
+    {
+        return H2_NO_ERROR;
+    }
+    session->continuation = 0;
+    return header_block(session, frame->stream_id, session->block, session->block_len, session->block_flags & FLAG_END_STREAM);
+}
+
+static uint32_t on_rst_stream(H2Session *session, const Frame *frame)
+{
+    H2Stream *stream;
+
+    if(frame->stream_id == 0)
+    {
+        return H2_PROTOCOL_ERROR;
+    }
+    if(frame->length != 4)
+    {
+        return H2_FRAME_SIZE_ERROR;
+    }
+    stream = stream_find(session, frame->stream_id);
+    if(stream == NULL)
+    {
+        return frame->stream_id > session->last_stream ? H2_PROTOCOL_ERROR : H2_NO_ERROR;
+    }
+    stream_abort(session, stream);
+    return H2_NO_ERROR;
+}
+
+static uint32_t on_settings(H2Session *session, const Frame *frame)
+{
+    uint32_t error;
+
+    if(frame->stream_id != 0)
+    {
+        return H2_PROTOCOL_ERROR;
+    }
+    if(frame->flags & FLAG_ACK)
+    {
+        return frame->length == 0 ? H2_NO_ERROR : H2_FRAME_SIZE_ERROR;
+    }
+    if(frame->length % 6 != 0)
+    {
+        return H2_FRAME_SIZE_ERROR;
+    }
+    error = apply_settings(session, frame->payload, frame->length);
+    if(error == H2_NO_ERROR)
+    {
+        queue_control(session, FRAME_SETTINGS, FLAG_ACK, 0, NULL, 0);
+    }
+    return error;
+}
+
+static uint32_t on_window_update(H2Session *session, const Frame *frame)
+{
+    H2Stream *stream;
+    uint32_t  increment;
+
+    if(frame->length != 4)
+    {
+        return H2_FRAME_SIZE_ERROR;
+    }
+    increment = read32(frame->payload) & WINDOW_MAX;
+    if(frame->stream_id == 0)
+    {
+        if(increment == 0)
+        {
+            return H2_PROTOCOL_ERROR;
+        }
+        session->send_window += increment;
+        return session->send_window > WINDOW_MAX ? H2_FLOW_CONTROL_ERROR : H2_NO_ERROR;
+    }
+    stream = stream_find(session, frame->stream_id);
+    if(stream == NULL)
+    {
+        return H2_NO_ERROR;    // 응답을 마친 스트림
+    }
+    stream->send_window += increment;
+    if(increment == 0 || stream->send_window > WINDOW_MAX)
+    {
+        stream_error(session, stream->id, increment == 0 ? H2_PROTOCOL_ERROR : H2_FLOW_CONTROL_ERROR);
+    }
+    return H2_NO_ERROR;
+}
+
+// SETTINGS 항목을 적용한다 (SETTINGS 프레임이나 HTTP2-Settings 헤더). 쓰지 않는 항목은 값만 확인한다
+static uint32_t apply_settings(H2Session *session, const uint8_t *p, size_t len)
+{
+    for(size_t i = 0; i + 6 <= len; i += 6)
+    {
+        unsigned int id    = (unsigned int)p[i] << 8 | p[i + 1];
+        uint32_t     value = read32(p + i + 2);
+
+        switch(id)
+        {
+            case SETTINGS_HEADER_TABLE_SIZE:
+            {
+                // 응답을 압축할 동적 표 크기. 줄였다 늘렸으면 다음 헤더 블록에서 가장 작았던 크기부터 알린다
+                size_t size = value < HPACK_TABLE_SIZE ? value : HPACK_TABLE_SIZE;
+
+                if(size != session->encoder.max_size)
+                {
+                    if(!session->table_changed || size < session->table_min)
+                    {
+                        session->table_min = size;
+                    }
+                    session->table_changed = 1;
+                    hpack_table_resize(&(session->encoder), size);
+                }
+                break;
+            }
+            case SETTINGS_ENABLE_PUSH:
+                if(value > 1)
+                {
+                    return H2_PROTOCOL_ERROR;
+                }
+                break;
+            case SETTINGS_INITIAL_WINDOW_SIZE:
+                if(value > WINDOW_MAX)
+                {
+                    return H2_FLOW_CONTROL_ERROR;
+                }
+                // 열린 스트림의 창도 차이만큼 옮긴다 (RFC 9113 6.9.2)
+                for(int s = 0; s < session->nstreams; ++s)
+                {
+                    session->streams[s]->send_window += (int64_t)value - session->initial_window;
+                    if(session->streams[s]->send_window > WINDOW_MAX)
+                    {
+                        return H2_FLOW_CONTROL_ERROR;
+                    }
+                }
+                session->initial_window = value;
+                break;
+            case SETTINGS_MAX_FRAME_SIZE:
+                // 보내는 프레임은 늘 기본값 이하이므로 범위만 본다
+                if(value < H2_MAX_FRAME || value > 0xffffff)
+                {
+                    return H2_PROTOCOL_ERROR;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    return H2_NO_ERROR;
+}
+
+// 다 모인 헤더 블록: 새 스트림의 요청 헤더거나 열린 스트림의 트레일러
+// 쓰지 않는 블록 (거절한 스트림, 트레일러) 도 동적 표를 맞추려면 디코딩해야 한다
+static uint32_t header_block(H2Session *session, uint32_t id, const uint8_t *block, size_t len, int end_stream)
+{
+    HpackField fields[H2_MAX_FIELDS];
+    int        nfields;
+    H2Stream  *stream = stream_find(session, id);
+
+    if(stream != NULL)
+    {
+        // 트레일러는 쓰지 않는다. 본문의 끝 (END_STREAM) 과 함께만 온다
+        if(decode_discard(session, block, len) != H2_NO_ERROR)
+        {
+            return H2_COMPRESSION_ERROR;
+        }
+        if(stream->state == H2_STREAM_OPEN && end_stream)
+        {
+            stream_complete(session, stream);
+        }
+        else if(stream->early && end_stream)
+        {
+            stream->early = 0;
+        }
+        else if(!stream->early)
+        {
+            stream_error(session, id, stream->state == H2_STREAM_OPEN ? H2_PROTOCOL_ERROR : H2_STREAM_CLOSED);
+        }
+        return H2_NO_ERROR;
+    }
+    if(id <= session->last_stream)
+    {
+        // 새 스트림 번호는 앞서 연 것보다 커야 한다 (RFC 9113 5.1.1)
+        return H2_PROTOCOL_ERROR;
+    }
+    if(session->goaway || session->nstreams == H2_MAX_STREAMS)
+    {
+        // 새 스트림을 더 받지 않는다
+        if(decode_discard(session, block, len) != H2_NO_ERROR)
+        {
+            return H2_COMPRESSION_ERROR;
+        }
+        session->last_stream = id;
+        queue_rst(session, id, H2_REFUSED_STREAM);
+        return H2_NO_ERROR;
+    }
+
+    session->last_stream = id;
+    stream               = stream_open(session, id);
+    if(stream == NULL)
+    {
+        if(decode_discard(session, block, len) != H2_NO_ERROR)
+        {
+            return H2_COMPRESSION_ERROR;
+        }
+        queue_rst(session, id, H2_REFUSED_STREAM);
+        return H2_NO_ERROR;
+    }
+    if(hpack_decode(&(session->decoder), block, len, stream->conn->arena, fields, H2_MAX_FIELDS, &nfields) == -1)
+    {
+        return H2_COMPRESSION_ERROR;
+    }
+    if(request_headers(stream, fields, nfields) == -1)
+    {
+        // 잘못된 요청 (RFC 9113 8.1.1)
+        stream_error(session, id, H2_PROTOCOL_ERROR);
+        return H2_NO_ERROR;
+    }
+    if(end_stream)
+    {
+        stream_complete(session, stream);
+    }
+    return H2_NO_ERROR;
+}
+
+// 헤더 블록을 연결의 아레나에 디코딩하고 버린다 (요청을 마칠 때 되돌린다)
+static uint32_t decode_discard(H2Session *session, const uint8_t *block, size_t len)
+{
+    HpackField fields[H2_MAX_FIELDS];
+    int        nfields;
+
+    if(hpack_decode(&(session->decoder), block, len, session->conn->arena, fields, H2_MAX_FIELDS, &nfields) == -1)
+    {
+        return H2_COMPRESSION_ERROR;
+    }
+    return H2_NO_ERROR;
+}
+
+// 요청 헤더를 HTTP/1.1 요청 머리로 다시 쓴다 ("<method> <path> HTTP/1.1\r\nhost: <authority>\r\n<name>: <value>\r\n...\r\n")
+// 의사 헤더가 빠졌거나 겹치거나 일반 헤더 뒤에 오면, 연결 관련 헤더나 대문자, 줄바꿈이 있으면 잘못된 요청 (-1)
+// 헤더가 너무 많거나 크면 stream->error 에 431 을 두고 0 (요청을 다 받은 뒤 431 로 응답한다)
+static int request_headers(H2Stream *stream, const HpackField *fields, int nfields)
+{
+    Connection *conn = stream->conn;
+    Slice       pseudo[PSEUDO_COUNT];
+    unsigned    seen     = 0;
+    int         regular  = 0;
+    int         has_host = 0;
+    size_t      size;
+    char       *p;
+
+    if(nfields > H2_MAX_FIELDS)
+    {
+        stream->error = 431;
+        return 0;
+    }
+    for(int i = 0; i < nfields; ++i)
+    {
+        Slice name  = fields[i].name;
+        Slice value = fields[i].value;
+
+        if(!field_valid(name, value))
+        {
+            return -1;
+        }
+        if(name.ptr[0] == ':')
+        {
+            int slot = 0;
+
+            while(slot < PSEUDO_COUNT && !http_slice_equals(name, pseudo_names[slot]))
+            {
+                slot++;
+            }
+            if(regular || slot == PSEUDO_COUNT || (seen & 1u << slot))
+            {
+                return -1;
+            }
+            seen |= 1u << slot;
+            pseudo[slot] = value;
+            continue;
+        }
+        regular = 1;
+        if(http_slice_equals(name, "connection") || http_slice_equals(name, "keep-alive") || http_slice_equals(name, "proxy-connection") || http_slice_equals(name, "transfer-encoding") || http_slice_equals(name, "upgrade") || (http_slice_equals(name, "te") && !http_slice_equals(value, "trailers")))
+        {
+            return -1;
+        }
+        if(http_slice_equals(name, "host"))
+        {
+            has_host = 1;
+        }
+    }
+    if(!(seen & 1u << PSEUDO_METHOD) || !(seen & 1u << PSEUDO_SCHEME) || !(seen & 1u << PSEUDO_PATH) || pseudo[PSEUDO_PATH].len == 0)
+    {
+        return -1;
+    }
+    if(!(seen & 1u << PSEUDO_AUTHORITY))
+    {
+        has_host = 1;    // Host 도 :authority 도 없으면 쓰지 않는다
+    }
+
+    size = pseudo[PSEUDO_METHOD].len + 1 + pseudo[PSEUDO_PATH].len + sizeof(" HTTP/1.1\r\n") - 1 + 2;
+    if(!has_host)
+    {
+        size += sizeof("host: \r\n") - 1 + pseudo[PSEUDO_AUTHORITY].len;
+    }
+    for(int i = 0; i < nfields; ++i)
+    {
+        if(fields[i].name.ptr[0] != ':')
+        {
+            size += fields[i].name.len + 2 + fields[i].value.len + 2;
+        }
+    }
+    if(size > MAX_HEADER_SIZE || buffer_grow(conn, size, MAX_HEADER_SIZE) == -1)
+    {
+        stream->error = 431;
+        return 0;
+    }
+
+    p = conn->buf;
+    memcpy(p, pseudo[PSEUDO_METHOD].ptr, pseudo[PSEUDO_METHOD].len);
+    p += pseudo[PSEUDO_METHOD].len;
+    *p++ = ' ';
+    memcpy(p, pseudo[PSEUDO_PATH].ptr, pseudo[PSEUDO_PATH].len);
+    p += pseudo[PSEUDO_PATH].len;
+    memcpy(p, " HTTP/1.1\r\n", sizeof(" HTTP/1.1\r\n") - 1);
+    p += sizeof(" HTTP/1.1\r\n") - 1;
+    if(!has_host)
+    {
+        memcpy(p, "host: ", 6);
+        p += 6;
+        memcpy(p, pseudo[PSEUDO_AUTHORITY].ptr, pseudo[PSEUDO_AUTHORITY].len);
+        p += pseudo[PSEUDO_AUTHORITY].len;
+        *p++ = '\r';
+        *p++ = '\n';
+    }
+    for(int i = 0; i < nfields; ++i)
+    {
+        if(fields[i].name.ptr[0] == ':')
+        {
+            continue;
+        }
+        memcpy(p, fields[i].name.ptr, fields[i].name.len);
+        p += fields[i].name.len;
+        *p++ = ':';
+        *p++ = ' ';
+        memcpy(p, fields[i].value.ptr, fields[i].value.len);
+        p += fields[i].value.len;
+        *p++ = '\r';
+        *p++ = '\n';
+    }
+    *p++ = '\r';
+    *p++ = '\n';
+    conn->len          = size;
+    stream->header_len = size;
+    return 0;
+}
+
+// 이름은 소문자 토큰 (의사 헤더는 맨 앞의 ':'), 값에는 NUL, CR, LF 가 없어야 한다 (RFC 9113 8.2.1)
+static int field_valid(Slice name, Slice value)
+{
+    if(name.len == 0)
+    {
+        return 0;
+    }
+    for(size_t i = 0; i < name.len; ++i)
+    {
+        unsigned char c = (unsigned char)name.ptr[i];
+
+        if(c <= 0x20 || c >= 0x7f || (c >= 'A' && c <= 'Z') || (c == ':' && i > 0))
+        {
+            return 0;
+        }
+    }
+    for(size_t i = 0; i < value.len; ++i)
+    {
+        if(value.ptr[i] == '\0' || value.ptr[i] == '\r' || value.ptr[i] == '\n')
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// 새 스트림: 아레나를 만들고 그 안에 요청을 담을 연결 구조체를 둔다 (소켓, 주소, 리액터는 연결과 같다). 메모리가 없으면 NULL
+static H2Stream *stream_open(H2Session *session, uint32_t id)
+{
+    Connection *main_conn = session->conn;
+    Arena      *arena     = arena_create();
+    H2Stream   *stream;
+    Connection *conn;
+
+    if(arena == NULL)
+    {
+        return NULL;
+    }
+    stream = (H2Stream *)arena_alloc(arena, sizeof(H2Stream));
+    conn   = (Connection *)arena_alloc(arena, sizeof(Connection));
+    if(stream == NULL || conn == NULL)
+    {
+        arena_destroy(arena);
+        return NULL;
+    }
+    memset(stream, 0, sizeof(*stream));
+    memset(conn, 0, offsetof(Connection, inline_buf));
+    conn->fd       = main_conn->fd;
+    conn->addr     = main_conn->addr;
+    conn->arena    = arena;
+    conn->buf      = conn->inline_buf;
+    conn->cap      = CONN_BUF_SIZE;
+    conn->reactor  = main_conn->reactor;
+    conn->stream   = stream;
+    conn->priority = -1;
+    http_request_init(&(conn->req));
+    form_parser_init(&(conn->form));
+
+    stream->id          = id;
+    stream->state       = H2_STREAM_OPEN;
+    stream->send_window = session->initial_window;
+    stream->recv_window = H2_DEFAULT_WINDOW;
+    stream->remaining   = -1;
+    stream->session     = session;
+    stream->conn        = conn;
+    session->streams[session->nstreams++] = stream;
+    metrics_count(METRIC_H2_STREAMS, 1);
+    return stream;
+}
+
+static H2Stream *stream_find(const H2Session *session, uint32_t id)
+{
+    for(int i = 0; i < session->nstreams; ++i)
+    {
+        if(session->streams[i]->id == id)
+        {
+            return session->streams[i];
+        }
+    }
+    return NULL;
+}
+
+// 요청을 다 받았다: 다시 쓴 머리를 HTTP/1.1 파서로 해석하고 본문 길이를 채운 뒤 응답할 차례를 기다린다
+// 오류면 워커가 그 상태 코드로 응답하도록 표시한다 (conn->req.state 가 HTTP_STATE_ERROR)
+static void stream_complete(H2Session *session, H2Stream *stream)
+{
+    Connection  *conn     = stream->conn;
+    HttpRequest *req      = &(conn->req);
+    size_t       body_len = conn->len - stream->header_len;
+
+    stream->state = H2_STREAM_REQUEST;
+    if(stream->error != 0)
+    {
+        http_request_fail(req, stream->error);
+    }
+    else if(http_request_parse(req, conn->buf, stream->header_len) == 1)
+    {
+        // content-length 가 있으면 DATA 를 합한 길이와 같아야 한다 (RFC 9113 8.1.1)
+        if(req->has_length && (size_t)req->content_length != body_len)
+        {
+            http_request_fail(req, 400);
+        }
+        else
+        {
+            req->content_length = (long)body_len;
+            req->body_len       = body_len;
+            form_parse(&(conn->form), conn->buf + req->header_len, body_len, 1);
+        }
+    }
+    else if(req->state != HTTP_STATE_ERROR)
+    {
+        http_request_fail(req, 400);
+    }
+    conn->req_len = conn->len;
+
+    stream->next = NULL;
+    if(session->ready == NULL)
+    {
+        session->ready = stream;
+    }
+    else
+    {
+        session->ready_tail->next = stream;
+    }
+    session->ready_tail = stream;
+}
+
+// 스트림 오류: RST_STREAM 을 보내고 스트림을 닫는다
+static void stream_error(H2Session *session, uint32_t id, uint32_t code)
+{
+    H2Stream *stream = stream_find(session, id);
+
+    LOG(LOG_DEBUG, "h2: stream %u error %u", id, code);
+    queue_rst(session, id, code);
+    if(stream != NULL)
+    {
+        stream_abort(session, stream);
+    }
+}
+
+// 요청을 받는 중인 스트림은 바로 닫고, 응답을 기다리거나 보내는 스트림은 표시만 한다 (응답을 마칠 때 닫는다)
+static void stream_abort(H2Session *session, H2Stream *stream)
+{
+    stream->reset = 1;
+    if(stream->state == H2_STREAM_OPEN)
+    {
+        stream_close(session, stream);
+    }
+}
+
+// 요청을 다 받은 스트림에 응답한다. 저장을 기다리는 POST 면 h2_stream_resume 이 응답을 넘길 때까지 남겨 둔다
+static void stream_serve(H2Session *session, H2Stream *stream, uint64_t queued)
+{
+    if(stream->reset || session->failed)
+    {
+        stream_close(session, stream);
+        return;
+    }
+    if(session->serve(stream->conn, queued) == 1)
+    {
+        pthread_mutex_lock(&(session->lock));
+        session->pending++;
+        pthread_mutex_unlock(&(session->lock));
+        return;
+    }
+    stream_finish(session, stream);
+}
+
+// 응답을 마친 스트림을 닫는다. END_STREAM 을 아직 보내지 않았으면 (길이를 모르는 본문) 빈 DATA 로 끝낸다
+// 창이 닫혀 본문이 남았으면 표시만 한다 (session_pump 가 다 보낸 뒤 다시 부른다)
+static void stream_finish(H2Session *session, H2Stream *stream)
+{
+    if(stream->queue != NULL && !stream->reset && !session->failed)
+    {
+        stream->finished = 1;
+        return;
+    }
+    if(!stream->reset && !session->failed)
+    {
+        if(!stream->headers_sent)
+        {
+            queue_rst(session, stream->id, H2_INTERNAL_ERROR);
+        }
+        else if(!stream->end_sent)
+        {
+            send_data(session, stream, NULL, 0, 1);
+        }
+        if(stream->early)
+        {
+            // 요청 본문을 다 받기 전에 응답했다: 나머지는 보내지 않아도 된다 (RFC 9113 8.1)
+            queue_rst(session, stream->id, H2_NO_ERROR);
+        }
+    }
+    stream_close(session, stream);
+}
+
+static void stream_close(H2Session *session, H2Stream *stream)
+{
+    for(int i = 0; i < session->nstreams; ++i)
+    {
+        if(session->streams[i] == stream)
+        {
+            session->streams[i] = session->streams[--session->nstreams];
+            break;
+        }
+    }
+    if(stream->queue != NULL)
+    {
+        for(H2Chunk *chunk = stream->queue; chunk != NULL; chunk = chunk->next)
+        {
+            if(chunk->fd != -1)
+            {
+                close(chunk->fd);
+            }
+        }
+        pthread_mutex_lock(&(session->lock));
+        session->parked--;
+        pthread_mutex_unlock(&(session->lock));
+    }
+    arena_destroy(stream->conn->arena);
+}
+
+// HTTP/1.1 응답 머리를 HPACK 으로 바꿔 HEADERS 프레임 하나로 보낸다
+// 연결 관련 헤더는 빼고, 응답마다 같은 헤더 (Server, Content-Type 등) 만 동적 표에 넣는다
+static int send_headers(H2Session *session, H2Stream *stream, const char *text, size_t len, int end_stream)
+{
+    const char *p   = text;
+    const char *end = text + len - 2;    // 마지막 빈 줄
+    uint8_t     block[HEADER_BLOCK_SIZE];
+    size_t      n = 0;
+    uint8_t    *frame;
+
+    // "HTTP/1.1 200 OK\r\n"
+    if(len < 14 || memcmp(text, "HTTP/1.1 ", 9) != 0)
+    {
+        return -1;
+    }
+    if(session->table_changed)
+    {
+        n += hpack_encode_size_update(block + n, session->table_min);
+        if(session->table_min != session->encoder.max_size)
+        {
+            n += hpack_encode_size_update(block + n, session->encoder.max_size);
+        }
+        session->table_changed = 0;
+    }
+    n += hpack_encode_status(block + n, (text[9] - '0') * 100 + (text[10] - '0') * 10 + (text[11] - '0'));
+    p = http_find_char(p, end, '\n') + 1;
+
+    while(p < end)
+    {
+        const char *eol   = http_find_char(p, end, '\n');
+        const char *colon = http_find_char(p, eol, ':');
+        const char *value;
+        size_t      value_len;
+        char        name[64];
+        Slice       lower;
+
+        if(eol == NULL || colon == NULL || colon == p || (size_t)(colon - p) > sizeof(name))
+        {
+            return -1;
+        }
+        lower.ptr = name;
+        lower.len = (size_t)(colon - p);
+        for(size_t i = 0; i < lower.len; ++i)
+        {
+            name[i] = (char)(p[i] >= 'A' && p[i] <= 'Z' ? p[i] | 0x20 : p[i]);
+        }
+        value = colon + 1;
+        while(value < eol && (*value == ' ' || *value == '\t'))
+        {
+            value++;
+        }
+        value_len = (size_t)(eol - value);
+        while(value_len > 0 && (value[value_len - 1] == '\r' || value[value_len - 1] == ' '))
+        {
+            value_len--;
+        }
+        p = eol + 1;
+
+        if(http_slice_equals(lower, "connection") || http_slice_equals(lower, "keep-alive") || http_slice_equals(lower, "transfer-encoding") || http_slice_equals(lower, "upgrade") || http_slice_equals(lower, "proxy-connection"))
+        {
+            continue;
+        }
+        if(http_slice_equals(lower, "content-length"))
+        {
+            // 길이만큼 보내면 마지막 DATA 에 END_STREAM 을 붙인다 (sendfile 처럼 끝을 따로 알리지 않는 본문)
+            stream->remaining = strtoll(value, NULL, 10);
+        }
+        if(n + hpack_field_bound(lower.len, value_len) > sizeof(block))
+        {
+            return -1;
+        }
+        n += hpack_encode_field(&(session->encoder), block + n, name, lower.len, value, value_len, http_slice_equals(lower, "server") || http_slice_equals(lower, "date") || http_slice_equals(lower, "content-type") || http_slice_equals(lower, "cache-control") || http_slice_equals(lower, "accept-ranges"));
+    }
+
+    frame = out_reserve(session, H2_FRAME_HEADER + n, 1);
+    if(frame == NULL)
+    {
+        return -1;
+    }
+    frame_header(frame, n, FRAME_HEADERS, (uint8_t)(FLAG_END_HEADERS | (end_stream ? FLAG_END_STREAM : 0)), stream->id);
+    memcpy(frame + H2_FRAME_HEADER, block, n);
+    response_add(&(session->out), frame, H2_FRAME_HEADER + n);
+    stream->headers_sent = 1;
+    stream->end_sent     = end_stream;
+    return 0;
+}
+
+// 본문을 창이 허락하는 만큼 DATA 프레임으로 나눠 붙인다 (data 는 보낼 때까지 그대로 있어야 한다)
+// last 거나 Content-Length 만큼 다 보냈으면 마지막 프레임에 END_STREAM 을 붙인다
+// 반환값: 붙인 바이트 (창이 닫히면 len 보다 작다), 더 쓸 수 없으면 -1
+static ssize_t send_data(H2Session *session, H2Stream *stream, const char *data, size_t len, int last)
+{
+    size_t sent = 0;
+
+    if(stream->end_sent)
+    {
+        return len == 0 ? 0 : -1;
+    }
+    if(len == 0 && !last)
+    {
+        return 0;
+    }
+    do
+    {
+        size_t   chunk = len - sent;
+        uint8_t  flags = 0;
+        uint8_t *header;
+
+        if(chunk > 0)
+        {
+            if(stream->send_window <= 0 || session->send_window <= 0)
+            {
+                break;
+            }
+            if(chunk > H2_MAX_FRAME)
+            {
+                chunk = H2_MAX_FRAME;
+            }
+            if((int64_t)chunk > stream->send_window)
+            {
+                chunk = (size_t)stream->send_window;
+            }
+            if((int64_t)chunk > session->send_window)
+            {
+                chunk = (size_t)session->send_window;
+            }
+        }
+        if(stream->remaining >= 0)
+        {
+            stream->remaining -= (long long)chunk;
+        }
+        if((last && sent + chunk == len) || stream->remaining == 0)
+        {
+            flags = FLAG_END_STREAM;
+        }
+        header = out_reserve(session, H2_FRAME_HEADER, 2);
+        if(header == NULL)
+        {
+            return -1;
+        }
+        frame_header(header, chunk, FRAME_DATA, flags, stream->id);
+        response_add(&(session->out), header, H2_FRAME_HEADER);
+        if(chunk > 0)
+        {
+            response_add(&(session->out), data + sent, chunk);
+            connection_send_extend(session->conn, chunk);
+            stream->send_window -= (int64_t)chunk;
+            session->send_window -= (int64_t)chunk;
+            sent += chunk;
+        }
+        if(flags != 0)
+        {
+            stream->end_sent = 1;
+            break;
+        }
+    } while(sent < len);
+    return (ssize_t)sent;
+}
+
+// 메모리 본문을 보낸다. 창이 닫혀 붙이지 못한 나머지는 (앞서 맡겨 둔 본문이 있으면 전부) 스트림 아레나에 복사해 맡긴다
+static int send_body(H2Session *session, H2Stream *stream, const char *data, size_t len, int last)
+{
+    ssize_t sent = 0;
+
+    if(stream->queue == NULL)
+    {
+        sent = send_data(session, stream, data, len, last);
+        if(sent == -1)
+        {
+            return -1;
+        }
+    }
+    if((size_t)sent == len)
+    {
+        return 0;
+    }
+    return queue_chunk(session, stream, data + sent, len - (size_t)sent) == NULL ? -1 : 0;
+}
+
+// 파일 본문을 창이 허락하는 만큼 읽어 보낸다 (offset 과 len 은 보낸 만큼 옮긴다, h2_send_file 과 같은 뜻)
+// 반환값: 다 보냈으면 1, 창이 닫혀 멈췄으면 0, 파일이 중간에 잘렸거나 더 쓸 수 없으면 -1
+static int send_file_data(H2Session *session, H2Stream *stream, int file_fd, off_t *offset, off_t *len)
+{
+    char buf[H2_FILE_CHUNK];
+
+    while(*len != 0)
+    {
+        size_t  size = sizeof(buf);
+        ssize_t n;
+
+        if(stream->reset || session->failed)
+        {
+            return -1;
+        }
+        if(stream->send_window <= 0 || session->send_window <= 0)
+        {
+            return 0;
+        }
+        // 창 안에서만 읽으므로 읽은 것은 send_data 가 모두 붙인다
+        if(*len > 0 && *len < (off_t)size)
+        {
+            size = (size_t)*len;
+        }
+        if((int64_t)size > stream->send_window)
+        {
+            size = (size_t)stream->send_window;
+        }
+        if((int64_t)size > session->send_window)
+        {
+            size = (size_t)session->send_window;
+        }
+        n = *offset >= 0 ? pread(file_fd, buf, size, *offset) : read(file_fd, buf, size);
+        if(n == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if(n == 0 && *len < 0)
+        {
+            return 1;    // 파이프의 끝
+        }
+        if(n <= 0)
+        {
+            return -1;
+        }
+        if(send_data(session, stream, buf, (size_t)n, 0) == -1 || session_flush(session) == -1)
+        {
+            return -1;
+        }
+        if(*offset >= 0)
+        {
+            *offset += n;
+        }
+        if(*len > 0)
+        {
+            *len -= n;
+        }
+    }
+    return 1;
+}
+
+// 창이 열리기를 기다리는 조각을 스트림 아레나에 만들어 queue 뒤에 붙인다 (data 는 len 바이트를 복사해 둔다)
+// 메모리가 없으면 스트림을 끊고 NULL
+static H2Chunk *queue_chunk(H2Session *session, H2Stream *stream, const char *data, size_t len)
+{
+    H2Chunk *chunk = (H2Chunk *)arena_alloc(stream->conn->arena, sizeof(H2Chunk) + len);
+
+    if(chunk == NULL)
+    {
+        LOG(LOG_ERROR, "h2: out of memory");
+        stream_error(session, stream->id, H2_INTERNAL_ERROR);
+        return NULL;
+    }
+    if(len > 0)
+    {
+        memcpy(chunk + 1, data, len);
+    }
+    chunk->next   = NULL;
+    chunk->data   = (const char *)(chunk + 1);
+    chunk->fd     = -1;
+    chunk->offset = -1;
+    chunk->len    = (off_t)len;
+    if(stream->queue == NULL)
+    {
+        stream->queue = chunk;
+        pthread_mutex_lock(&(session->lock));
+        session->parked++;
+        pthread_mutex_unlock(&(session->lock));
+    }
+    else
+    {
+        stream->queue_tail->next = chunk;
+    }
+    stream->queue_tail = chunk;
+    return chunk;
+}
+
+// out_buf 에 size 바이트와 조각 iovs 개의 자리를 만든다 (모자라면 모은 것을 먼저 보낸다)
+static uint8_t *out_reserve(H2Session *session, size_t size, int iovs)
+{
+    uint8_t *p;
+
+    if((session->out_used + size > H2_OUT_SIZE || session->out.iovcnt + iovs > RESPONSE_IOV_MAX) && session_flush(session) == -1)
+    {
+        return NULL;
+    }
+    if(session->failed)
+    {
+        return NULL;
+    }
+    p = session->out_buf + session->out_used;
+    session->out_used += size;
+    return p;
+}
+
+// 제어 프레임 (본문이 짧다) 을 out_buf 에 복사해 붙인다
+static int queue_control(H2Session *session, uint8_t type, uint8_t flags, uint32_t stream_id, const void *payload, size_t len)
+{
+    uint8_t *p = out_reserve(session, H2_FRAME_HEADER + len, 1);
+
+    if(p == NULL)
+    {
+        return -1;
+    }
+    frame_header(p, len, type, flags, stream_id);
+    if(len > 0)
+    {
+        memcpy(p + H2_FRAME_HEADER, payload, len);
+    }
+    response_add(&(session->out), p, H2_FRAME_HEADER + len);
+    return 0;
+}
+
+static void queue_rst(H2Session *session, uint32_t id, uint32_t code)
+{
+    uint8_t payload[4];
+
+    write32(payload, code);
+    queue_control(session, FRAME_RST_STREAM, 0, id, payload, sizeof(payload));
+}
+
+static void queue_window_update(H2Session *session, uint32_t id, uint32_t increment)
+{
+    uint8_t payload[4];
+
+    write32(payload, increment);
+    queue_control(session, FRAME_WINDOW_UPDATE, 0, id, payload, sizeof(payload));
+}
+
+// 수신 버퍼를 need 바이트 이상으로 키운다 (두 배씩, limit 까지). 넘거나 메모리가 없으면 -1
+// 작은 버퍼는 아레나에 남아 있다가 요청을 마칠 때 (스트림은 닫을 때) 함께 돌아간다
+static int buffer_grow(Connection *conn, size_t need, size_t limit)
+{
+    size_t cap = conn->cap;
+    char  *buf;
+
+    if(need <= cap)
+    {
+        return 0;
+    }
+    if(need > limit)
+    {
+        return -1;
+    }
+    while(cap < need)
+    {
+        cap *= 2;
+    }
+    if(cap > limit)
+    {
+        cap = limit;
+    }
+    buf = (char *)arena_alloc(conn->arena, cap);
+    if(buf == NULL)
+    {
+        return -1;
+    }
+    memcpy(buf, conn->buf, conn->len);
+    conn->buf = buf;
+    conn->cap = cap;
+    return 0;
+}
+
+// 쉼표로 구분된 값에 token 이 있는지 (대소문자 무시)
+static int has_token(Slice value, const char *token)
+{
+    const char *p    = value.ptr;
+    const char *stop = value.ptr + value.len;
+
+    while(p < stop)
+    {
+        const char *comma = http_find_char(p, stop, ',');
+        Slice       item;
+
+        item.ptr = p;
+        item.len = (size_t)((comma != NULL ? comma : stop) - p);
+        while(item.len > 0 && (*item.ptr == ' ' || *item.ptr == '\t'))
+        {
+            item.ptr++;
+            item.len--;
+        }
+        while(item.len > 0 && (item.ptr[item.len - 1] == ' ' || item.ptr[item.len - 1] == '\t'))
+        {
+            item.len--;
+        }
+        if(http_slice_equals_nocase(item, token))
+        {
+            return 1;
+        }
+        p = comma != NULL ? comma + 1 : stop;
+    }
+    return 0;
+}
+
+// HTTP2-Settings 의 base64url (채움 없음) 을 디코딩한다. 잘못된 문자가 있거나 넘치면 -1
+static int base64url_decode(Slice in, uint8_t *out, size_t size, size_t *len)
+{
+    uint32_t acc  = 0;
+    int      bits = 0;
+    size_t   n    = 0;
+
+    for(size_t i = 0; i < in.len && in.ptr[i] != '='; ++i)
+    {
+        char     c = in.ptr[i];
+        uint32_t v;
+
+        if(c >= 'A' && c <= 'Z')
+        {
+            v = (uint32_t)(c - 'A');
+        }
+        else if(c >= 'a' && c <= 'z')
+        {
+            v = (uint32_t)(c - 'a' + 26);
+        }
+        else if(c >= '0' && c <= '9')
+        {
+            v = (uint32_t)(c - '0' + 52);
+        }
+        else if(c == '-' || c == '_')
+        {
+            v = c == '-' ? 62 : 63;
+        }
+        else
+        {
+            return -1;
+        }
+        acc = acc << 6 | v;
+        bits += 6;
+        if(bits >= 8)
+        {
+            bits -= 8;
+            if(n == size)
+            {
+                return -1;
+            }
+            out[n++] = (uint8_t)(acc >> bits);
+        }
+    }
+    *len = n;
+    return 0;
+}
+
+static void frame_header(uint8_t *p, size_t len, uint8_t type, uint8_t flags, uint32_t stream_id)
+{
+    p[0] = (uint8_t)(len >> 16);
+    p[1] = (uint8_t)(len >> 8);
+    p[2] = (uint8_t)len;
+    p[3] = type;
+    p[4] = flags;
+    write32(p + 5, stream_id);
+}
+
+static uint32_t read32(const uint8_t *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static void write32(uint8_t *p, uint32_t value)
+{
+    p[0] = (uint8_t)(value >> 24);
+    p[1] = (uint8_t)(value >> 16);
+    p[2] = (uint8_t)(value >> 8);
+    p[3] = (uint8_t)value;
+}
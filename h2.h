@@ -0,0 +1,132 @@
+#ifndef H2_H
+#define H2_H
+
+#include "hpack.h"
+#include "reactor.h"
+#include "response.h"
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define H2_PREFACE "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"    // 클라이언트 연결 서문 (RFC 9113 3.4)
+#define H2_PREFACE_LEN 24
+#define H2_FRAME_HEADER 9                 // 프레임 머리 (길이 3, 종류 1, 플래그 1, 스트림 id 4)
+#define H2_MAX_FRAME 16384                // 주고받는 프레임 본문 최대 크기 (SETTINGS_MAX_FRAME_SIZE 기본값, 더 크게 알리지 않는다)
+#define H2_MAX_STREAMS 100                // 동시에 열어 두는 스트림 수 (SETTINGS_MAX_CONCURRENT_STREAMS, 넘으면 REFUSED_STREAM)
+#define H2_DEFAULT_WINDOW 65535           // 흐름 제어 창의 처음 크기 (스트림마다 받는 창)
+#define H2_CONN_WINDOW (1 << 20)          // 연결 전체에서 받아 두는 본문 (서문 뒤 WINDOW_UPDATE 로 늘린다)
+#define H2_MAX_FIELDS (HTTP_MAX_HEADERS + 4)     // 요청 하나의 최대 헤더 수 (의사 헤더 포함, 넘으면 431)
+#define H2_OUT_SIZE 4096                  // 프레임 머리, 제어 프레임, 응답 헤더 블록을 모아 두는 자리
+#define H2_HEADER_TEXT 2048               // h2_respond 가 HPACK 으로 바꿀 HTTP/1.1 응답 머리의 최대 길이
+#define H2_FILE_CHUNK (4 * H2_MAX_FRAME)  // 파일 본문을 한 번에 읽어 보내는 크기 (sendmsg 한 번에 프레임 네 개)
+
+// 오류 코드 (RFC 9113 7)
+#define H2_NO_ERROR 0x0
+#define H2_PROTOCOL_ERROR 0x1
+#define H2_INTERNAL_ERROR 0x2
+#define H2_FLOW_CONTROL_ERROR 0x3
+#define H2_STREAM_CLOSED 0x5
+#define H2_FRAME_SIZE_ERROR 0x6
+#define H2_REFUSED_STREAM 0x7
+#define H2_COMPRESSION_ERROR 0x9
+#define H2_ENHANCE_YOUR_CALM 0xb
+
+// 요청을 다 받은 스트림에 응답하는 워커 쪽 함수. 응답을 나중에 h2_stream_resume 으로 보내면 1, 이미 보냈으면 0
+// queued 는 그 요청을 실어 온 프레임이 워커 큐에서 기다린 시간 (큐를 거치지 않았으면 0)
+typedef int (*H2ServeFunction)(Connection *stream, uint64_t queued);
+
+// 흐름 제어 창이 닫혀 아직 보내지 못한 본문 조각 (스트림 아레나에 있다)
+// 메모리 조각은 복사해 두고, 파일은 dup 한 fd 에서 남은 범위를 창이 열리는 대로 읽어 보낸다
+typedef struct H2Chunk
+{
+    struct H2Chunk *next;
+    const char     *data;      // 메모리 조각 (fd 가 -1 일 때)
+    int             fd;        // 파일 조각 (스트림을 닫을 때 닫는다)
+    off_t           offset;    // fd 에서 읽을 위치 (-1 이면 지금 위치부터 read, 파이프)
+    off_t           len;       // 남은 바이트 (-1 이면 파일 끝까지)
+} H2Chunk;
+
+// 스트림 구조체 정의
+// 스트림마다 아레나를 따로 두고 그 안에 요청을 HTTP/1.1 형식으로 다시 쓴 연결 구조체를 만든다 (fd 는 같은 소켓)
+// 워커는 그 연결 구조체를 HTTP/1.1 요청과 똑같이 처리하고, 응답은 h2_respond 가 HEADERS 와 DATA 프레임으로 바꿔 보낸다
+struct H2Stream
+{
+    uint32_t    id;
+    int         state;               // H2_STREAM_*
+    int         reset;               // RST_STREAM 을 주고받았다 (더 보내지 않고, 응답을 마치는 대로 닫는다)
+    int         error;               // 요청을 받다가 정한 오류 상태 코드 (0 이면 없음, 413, 431)
+    int         early;               // 요청 본문이 끝나기 전에 응답한다 (413, 남은 DATA 는 버리고 응답 뒤 RST_STREAM NO_ERROR)
+    int         headers_sent;
+    int         end_sent;            // END_STREAM 을 보냈다
+    int64_t     send_window;         // 상대가 더 받겠다고 한 바이트 (SETTINGS 로 줄면 음수도 된다)
+    int64_t     recv_window;         // 우리가 더 받겠다고 한 바이트
+    int         finished;            // 워커가 응답을 마쳤다 (queue 를 다 보내면 닫는다)
+    long long   remaining;           // Content-Length 로 남은 응답 본문 (-1 이면 모른다, 0 이 되면 END_STREAM)
+    H2Chunk    *queue;               // 창이 열리기를 기다리는 본문 (이 뒤의 본문도 순서를 지키려고 여기에 붙는다)
+    H2Chunk    *queue_tail;
+    size_t      header_len;          // conn->buf 에서 다시 쓴 요청 머리의 길이 (본문은 그 뒤에 붙는다)
+    void      (*resume)(void *);     // 저장을 마친 POST 의 응답 (h2_stream_resume)
+    void       *resume_arg;
+    H2Stream   *next;                // 응답할 차례를 기다리는 목록
+    H2Session  *session;
+    Connection *conn;                // 이 스트림의 요청 (스트림 아레나의 첫 블록)
+};
+
+// 스트림 상태 (서버 푸시를 하지 않으므로 reserved 는 없고, 닫힌 스트림은 목록에서 뺀다)
+#define H2_STREAM_OPEN 0       // 요청 헤더나 본문을 받는 중
+#define H2_STREAM_REQUEST 1    // 요청을 다 받았다 (half-closed remote). 응답을 기다리거나 보내는 중
+
+// HTTP/2 세션 구조체 정의
+// 연결의 아레나에 있고 연결이 닫힐 때까지 남는다. 프레임은 리액터가 연결 버퍼에 받아 두고, 워커 한 개 (owner) 가
+// 세션을 돌리며 처리하고 응답한다. 저장을 기다리는 POST 나 창이 닫힌 스트림이 있어도 할 일이 없으면 연결을 리액터에 돌려준다
+// 그동안 저장을 마친 POST 는 h2_stream_resume 이 세션을 넘겨받아 응답만 보낸다 (연결 버퍼는 리액터 것이므로 프레임은 읽지 않는다)
+struct H2Session
+{
+    Connection     *conn;
+    H2ServeFunction serve;
+    pthread_mutex_t lock;                       // owned, incoming, incoming_queued, closed, pending, parked, resumed 를 보호 (세션을 돌리는 워커와 POST 응답을 넘기는 워커, 리액터)
+    int             owned;                      // 어떤 워커가 세션을 돌리고 있다
+    int             incoming;                   // 세션을 돌리는 워커가 있을 때 리액터가 프레임을 넘겼다 (그 워커가 이어서 처리한다)
+    uint64_t        incoming_queued;            // 그 프레임이 워커 큐에서 기다린 시간
+    int             closed;                     // 리액터가 연결을 닫았다 (세션을 놓는 마지막 워커가 해제한다)
+    int             pending;                    // 응답을 h2_stream_resume 으로 기다리는 스트림 수
+    int             parked;                     // 창이 열리기를 기다리는 본문이 있는 스트림 수
+    H2Stream       *resumed;                    // 응답할 수 있게 된 POST 스트림
+    H2Stream       *ready;                      // 요청을 다 받아 응답할 차례를 기다리는 스트림 (받은 순서)
+    H2Stream       *ready_tail;
+    H2Stream       *streams[H2_MAX_STREAMS];    // 닫히지 않은 스트림
+    int             nstreams;
+    size_t          pos;                        // conn->buf 에서 아직 처리하지 않은 위치
+    int             preface;                    // 클라이언트 서문을 받았다 (1), 서문 뒤의 SETTINGS 까지 받았다 (2)
+    int             goaway;                     // GOAWAY 를 받았다: 새 스트림을 받지 않고 남은 스트림을 마치면 닫는다
+    int             failed;                     // 연결 오류로 GOAWAY 를 보냈거나 소켓에 더 쓸 수 없다: 바로 닫는다
+    uint32_t        last_stream;                // 받은 가장 큰 스트림 id
+    uint32_t        continuation;               // CONTINUATION 을 기다리는 스트림 (0 이면 아님)
+    uint8_t         block_flags;                // 그 HEADERS 의 플래그 (END_STREAM)
+    size_t          block_len;
+    int64_t         send_window;                // 연결 전체의 보내는 창
+    int64_t         recv_window;                // 연결 전체의 받는 창
+    int64_t         initial_window;             // 상대의 SETTINGS_INITIAL_WINDOW_SIZE (새 스트림의 보내는 창)
+    int             table_changed;              // 상대가 SETTINGS_HEADER_TABLE_SIZE 를 바꿨다 (다음 헤더 블록 앞에 알린다)
+    size_t          table_min;                  // 그 사이 가장 작았던 크기 (RFC 7541 4.2)
+    HpackTable      decoder;
+    HpackTable      encoder;
+    Response        out;                        // 모아 둔 프레임 (조각은 out_buf 나 보낼 본문을 가리킨다)
+    size_t          out_used;
+    uint8_t         out_buf[H2_OUT_SIZE];
+    uint8_t         block[MAX_HEADER_SIZE];     // 여러 프레임으로 나뉘어 온 헤더 블록
+};
+
+int  h2_preface(const char *buf, size_t len);
+int  h2_frame_ready(const H2Session *session, const char *buf, size_t len);
+int  h2_start(Connection *conn, H2ServeFunction serve);
+void h2_session_run(Connection *conn, uint64_t queued);
+int  h2_session_busy(H2Session *session);
+int  h2_session_close(H2Session *session);
+void h2_session_destroy(H2Session *session);
+void h2_stream_resume(Connection *conn, void (*function)(void *), void *arg);
+int  h2_respond(H2Stream *stream, Response *res, int more);
+int  h2_send_file(H2Stream *stream, int file_fd, off_t offset, off_t len);
+
+#endif
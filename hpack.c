@@ -0,0 +1,611 @@
+#include "hpack.h"
+#include <pthread.h>
+#include <string.h>
+
+#define STATIC_ENTRY(name, value) {name, sizeof(name) - 1, value, sizeof(value) - 1}
+#define HUFFMAN_EOS 256
+
+typedef struct
+{
+    const char *name;
+    size_t      name_len;
+    const char *value;
+    size_t      value_len;
+} StaticEntry;
+
+static int    decode_integer(const uint8_t **p, const uint8_t *end, int prefix, size_t *value);
+static int    decode_string(const uint8_t **p, const uint8_t *end, Arena *arena, Slice *str);
+static int    table_lookup(const HpackTable *table, size_t index, Arena *arena, HpackField *field, int with_value);
+static void   table_add(HpackTable *table, Slice name, Slice value);
+static void   table_evict(HpackTable *table, size_t limit);
+static size_t encode_integer(uint8_t *out, uint8_t first, int prefix, size_t value);
+static size_t encode_string(uint8_t *out, const char *str, size_t len);
+static int    huffman_decode(const uint8_t *in, size_t len, char *out, size_t *out_len);
+static void   huffman_build(void);
+
+// RFC 7541 부록 A
+static const StaticEntry static_table[HPACK_STATIC_ENTRIES] = {
+    STATIC_ENTRY(":authority", ""),
+    STATIC_ENTRY(":method", "GET"),
+    STATIC_ENTRY(":method", "POST"),
+    STATIC_ENTRY(":path", "/"),
+    STATIC_ENTRY(":path", "/index.html"),
+    STATIC_ENTRY(":scheme", "http"),
+    STATIC_ENTRY(":scheme", "https"),
+    STATIC_ENTRY(":status", "200"),
+    STATIC_ENTRY(":status", "204"),
+    STATIC_ENTRY(":status", "206"),
+    STATIC_ENTRY(":status", "304"),
+    STATIC_ENTRY(":status", "400"),
+    STATIC_ENTRY(":status", "404"),
+    STATIC_ENTRY(":status", "500"),
+    STATIC_ENTRY("accept-charset", ""),
+    STATIC_ENTRY("accept-encoding", "gzip, deflate"),
+    STATIC_ENTRY("accept-language", ""),
+    STATIC_ENTRY("accept-ranges", ""),
+    STATIC_ENTRY("accept", ""),
+    STATIC_ENTRY("access-control-allow-origin", ""),
+    STATIC_ENTRY("age", ""),
+    STATIC_ENTRY("allow", ""),
+    STATIC_ENTRY("authorization", ""),
+    STATIC_ENTRY("cache-control", ""),
+    STATIC_ENTRY("content-disposition", ""),
+    STATIC_ENTRY("content-encoding", ""),
+    STATIC_ENTRY("content-language", ""),
+    STATIC_ENTRY("content-length", ""),
+    STATIC_ENTRY("content-location", ""),
+    STATIC_ENTRY("content-range", ""),
+    STATIC_ENTRY("content-type", ""),
+    STATIC_ENTRY("cookie", ""),
+    STATIC_ENTRY("date", ""),
+    STATIC_ENTRY("etag", ""),
+    STATIC_ENTRY("expect", ""),
+    STATIC_ENTRY("expires", ""),
+    STATIC_ENTRY("from", ""),
+    STATIC_ENTRY("host", ""),
+    STATIC_ENTRY("if-match", ""),
+    STATIC_ENTRY("if-modified-since", ""),
+    STATIC_ENTRY("if-none-match", ""),
+    STATIC_ENTRY("if-range", ""),
+    STATIC_ENTRY("if-unmodified-since", ""),
+    STATIC_ENTRY("last-modified", ""),
+    STATIC_ENTRY("link", ""),
+    STATIC_ENTRY("location", ""),
+    STATIC_ENTRY("max-forwards", ""),
+    STATIC_ENTRY("proxy-authenticate", ""),
+    STATIC_ENTRY("proxy-authorization", ""),
+    STATIC_ENTRY("range", ""),
+    STATIC_ENTRY("referer", ""),
+    STATIC_ENTRY("refresh", ""),
+    STATIC_ENTRY("retry-after", ""),
+    STATIC_ENTRY("server", ""),
+    STATIC_ENTRY("set-cookie", ""),
+    STATIC_ENTRY("strict-transport-security", ""),
+    STATIC_ENTRY("transfer-encoding", ""),
+    STATIC_ENTRY("user-agent", ""),
+    STATIC_ENTRY("vary", ""),
+    STATIC_ENTRY("via", ""),
+    STATIC_ENTRY("www-authenticate", ""),
+};
+
+// RFC 7541 부록 B: 바이트마다 (마지막은 EOS) 허프만 부호와 비트 수
+static const uint32_t huffman_codes[HUFFMAN_EOS + 1] = {
+    0x1ff8, 0x7fffd8, 0xfffffe2, 0xfffffe3, 0xfffffe4, 0xfffffe5, 0xfffffe6, 0xfffffe7,
+    0xfffffe8, 0xffffea, 0x3ffffffc, 0xfffffe9, 0xfffffea, 0x3ffffffd, 0xfffffeb, 0xfffffec,
+    0xfffffed, 0xfffffee, 0xfffffef, 0xffffff0, 0xffffff1, 0xffffff2, 0x3ffffffe, 0xffffff3,
+    0xffffff4, 0xffffff5, 0xffffff6, 0xffffff7, 0xffffff8, 0xffffff9, 0xffffffa, 0xffffffb,
+    0x14, 0x3f8, 0x3f9, 0xffa, 0x1ff9, 0x15, 0xf8, 0x7fa,
+    0x3fa, 0x3fb, 0xf9, 0x7fb, 0xfa, 0x16, 0x17, 0x18,
+    0x0, 0x1, 0x2, 0x19, 0x1a, 0x1b, 0x1c, 0x1d,
+    0x1e, 0x1f, 0x5c, 0xfb, 0x7ffc, 0x20, 0xffb, 0x3fc,
+    0x1ffa, 0x21, 0x5d, 0x5e, 0x5f, 0x60, 0x61, 0x62,
+    0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a,
+    0x6b, 0x6c, 0x6d, 0x6e, 0x6f, 0x70, 0x71, 0x72,
+    0xfc, 0x73, 0xfd, 0x1ffb, 0x7fff0, 0x1ffc, 0x3ffc, 0x22,
+    0x7ffd, 0x3, 0x23, 0x4, 0x24, 0x5, 0x25, 0x26,
+    0x27, 0x6, 0x74, 0x75, 0x28, 0x29, 0x2a, 0x7,
+    0x2b, 0x76, 0x2c, 0x8, 0x9, 0x2d, 0x77, 0x78,
+    0x79, 0x7a, 0x7b, 0x7ffe, 0x7fc, 0x3ffd, 0x1ffd, 0xffffffc,
+    0xfffe6, 0x3fffd2, 0xfffe7, 0xfffe8, 0x3fffd3, 0x3fffd4, 0x3fffd5, 0x7fffd9,
+    0x3fffd6, 0x7fffda, 0x7fffdb, 0x7fffdc, 0x7fffdd, 0x7fffde, 0xffffeb, 0x7fffdf,
+    0xffffec, 0xffffed, 0x3fffd7, 0x7fffe0, 0xffffee, 0x7fffe1, 0x7fffe2, 0x7fffe3,
+    0x7fffe4, 0x1fffdc, 0x3fffd8, 0x7fffe5, 0x3fffd9, 0x7fffe6, 0x7fffe7, 0xffffef,
+    0x3fffda, 0x1fffdd, 0xfffe9, 0x3fffdb, 0x3fffdc, 0x7fffe8, 0x7fffe9, 0x1fffde,
+    0x7fffea, 0x3fffdd, 0x3fffde, 0xfffff0, 0x1fffdf, 0x3fffdf, 0x7fffeb, 0x7fffec,
+    0x1fffe0, 0x1fffe1, 0x3fffe0, 0x1fffe2, 0x7fffed, 0x3fffe1, 0x7fffee, 0x7fffef,
+    0xfffea, 0x3fffe2, 0x3fffe3, 0x3fffe4, 0x7ffff0, 0x3fffe5, 0x3fffe6, 0x7ffff1,
+    0x3ffffe0, 0x3ffffe1, 0xfffeb, 0x7fff1, 0x3fffe7, 0x7ffff2, 0x3fffe8, 0x1ffffec,
+    0x3ffffe2, 0x3ffffe3, 0x3ffffe4, 0x7ffffde, 0x7ffffdf, 0x3ffffe5, 0xfffff1, 0x1ffffed,
+    0x7fff2, 0x1fffe3, 0x3ffffe6, 0x7ffffe0, 0x7ffffe1, 0x3ffffe7, 0x7ffffe2, 0xfffff2,
+    0x1fffe4, 0x1fffe5, 0x3ffffe8, 0x3ffffe9, 0xffffffd, 0x7ffffe3, 0x7ffffe4, 0x7ffffe5,
+    0xfffec, 0xfffff3, 0xfffed, 0x1fffe6, 0x3fffe9, 0x1fffe7, 0x1fffe8, 0x7ffff3,
+    0x3fffea, 0x3fffeb, 0x1ffffee, 0x1ffffef, 0xfffff4, 0xfffff5, 0x3ffffea, 0x7ffff4,
+    0x3ffffeb, 0x7ffffe6, 0x3ffffec, 0x3ffffed, 0x7ffffe7, 0x7ffffe8, 0x7ffffe9, 0x7ffffea,
+    0x7ffffeb, 0xffffffe, 0x7ffffec, 0x7ffffed, 0x7ffffee, 0x7ffffef, 0x7fffff0, 0x3ffffee,
+    0x3fffffff,
+};
+
+static const uint8_t huffman_lengths[HUFFMAN_EOS + 1] = {
+    13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+    28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+    6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+    5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+    13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+    15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+    6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+    20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+    24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+    22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+    21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+    26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+    19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+    20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+    26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+    30,
+};
+
+// 허프만 부호의 이진 트리 (처음 디코딩할 때 만든다). 음수는 잎 -(기호 + 1), 0 은 비어 있음 (뿌리는 0 이므로 자식이 될 수 없다)
+static int16_t        huffman_tree[HUFFMAN_EOS][2];
+static pthread_once_t huffman_once = PTHREAD_ONCE_INIT;
+
+void hpack_table_init(HpackTable *table, size_t max_size)
+{
+    table->count    = 0;
+    table->used     = 0;
+    table->size     = 0;
+    table->max_size = max_size;
+}
+
+// 최대 크기를 바꾸고 넘치는 오래된 항목을 뺀다 (max_size 는 HPACK_TABLE_SIZE 이하)
+void hpack_table_resize(HpackTable *table, size_t max_size)
+{
+    table->max_size = max_size;
+    table_evict(table, max_size);
+}
+
+// 헤더 블록 하나를 디코딩해 fields 에 앞에서부터 채운다. 허프만 문자열과 동적 표에서 가져온 문자열은 arena 에 복사한다
+// max 를 넘는 헤더도 동적 표를 맞추기 위해 끝까지 디코딩하고 개수만 센다 (*nfields 가 max 보다 크면 버린 것이 있다)
+// 반환값: 0 정상, -1 잘못된 블록 (COMPRESSION_ERROR, 연결을 닫아야 한다)
+int hpack_decode(HpackTable *table, const uint8_t *in, size_t len, Arena *arena, HpackField *fields, int max, int *nfields)
+{
+    const uint8_t *p     = in;
+    const uint8_t *end   = in + len;
+    int            count = 0;
+
+    while(p < end)
+    {
+        HpackField field;
+        size_t     index;
+
+        if(*p & 0x80)
+        {
+            // 색인된 헤더
+            if(decode_integer(&p, end, 7, &index) == -1 || table_lookup(table, index, arena, &field, 1) == -1)
+            {
+                return -1;
+            }
+        }
+        else if((*p & 0xe0) == 0x20)
+        {
+            // 동적 표 크기 변경은 블록의 맨 앞에만 올 수 있고, 알린 크기를 넘을 수 없다
+            if(count > 0 || decode_integer(&p, end, 5, &index) == -1 || index > HPACK_TABLE_SIZE)
+            {
+                return -1;
+            }
+            hpack_table_resize(table, index);
+            continue;
+        }
+        else
+        {
+            // 리터럴: 01 이면 동적 표에 넣고, 0000 (넣지 않음) 과 0001 (절대 넣지 않음) 은 그대로 쓴다
+            int incremental = (*p & 0xc0) == 0x40;
+
+            if(decode_integer(&p, end, incremental ? 6 : 4, &index) == -1)
+            {
+                return -1;
+            }
+            if(index == 0 ? decode_string(&p, end, arena, &(field.name)) == -1 : table_lookup(table, index, arena, &field, 0) == -1)
+            {
+                return -1;
+            }
+            if(decode_string(&p, end, arena, &(field.value)) == -1)
+            {
+                return -1;
+            }
+            if(incremental)
+            {
+                table_add(table, field.name, field.value);
+            }
+        }
+        if(count < max)
+        {
+            fields[count] = field;
+        }
+        count++;
+    }
+    *nfields = count;
+    return 0;
+}
+
+// 동적 표 크기 변경 (상대가 SETTINGS_HEADER_TABLE_SIZE 를 줄였을 때 다음 블록의 맨 앞에 쓴다)
+size_t hpack_encode_size_update(uint8_t *out, size_t max_size)
+{
+    return encode_integer(out, 0x20, 5, max_size);
+}
+
+// :status. 정적 표 (8~14) 에 있으면 한 바이트
+size_t hpack_encode_status(uint8_t *out, int status)
+{
+    size_t index = 0;
+    size_t n;
+
+    switch(status)
+    {
+        case 200:
+            index = 8;
+            break;
+        case 204:
+            index = 9;
+            break;
+        case 206:
+            index = 10;
+            break;
+        case 304:
+            index = 11;
+            break;
+        case 400:
+            index = 12;
+            break;
+        case 404:
+            index = 13;
+            break;
+        case 500:
+            index = 14;
+            break;
+        default:
+            break;
+    }
+    if(index != 0)
+    {
+        return encode_integer(out, 0x80, 7, index);
+    }
+    n        = encode_integer(out, 0x00, 4, 8);    // 이름만 :status (8) 를 쓰는 리터럴
+    out[n++] = 3;
+    out[n++] = (uint8_t)('0' + status / 100 % 10);
+    out[n++] = (uint8_t)('0' + status / 10 % 10);
+    out[n++] = (uint8_t)('0' + status % 10);
+    return n;
+}
+
+// 헤더 하나를 out 에 쓰고 길이를 돌려준다 (out 에는 hpack_field_bound 만큼 자리가 있어야 한다). name 은 소문자
+// 동적 표나 정적 표에 같은 것이 있으면 색인만 쓴다. index 가 1 이면 동적 표에 넣어 다음 응답부터 색인으로 보낸다
+// (Server, Date, Content-Type 처럼 응답마다 되풀이되는 값에만 쓴다. ETag 같은 값을 넣으면 표만 밀어낸다)
+size_t hpack_encode_field(HpackTable *table, uint8_t *out, const char *name, size_t name_len, const char *value, size_t value_len, int index)
+{
+    size_t name_index = 0;
+    size_t n;
+
+    for(int i = table->count - 1; i >= 0; --i)
+    {
+        const HpackEntry *entry = &(table->entries[i]);
+
+        if(entry->name_len == name_len && entry->value_len == value_len && memcmp(table->data + entry->off, name, name_len) == 0 && memcmp(table->data + entry->off + name_len, value, value_len) == 0)
+        {
+            return encode_integer(out, 0x80, 7, HPACK_STATIC_ENTRIES + (size_t)(table->count - i));
+        }
+    }
+    for(int i = 0; i < HPACK_STATIC_ENTRIES; ++i)
+    {
+        if(static_table[i].name_len == name_len && memcmp(static_table[i].name, name, name_len) == 0)
+        {
+            if(static_table[i].value_len == value_len && memcmp(static_table[i].value, value, value_len) == 0)
+            {
+                return encode_integer(out, 0x80, 7, (size_t)i + 1);
+            }
+            if(name_index == 0)
+            {
+                name_index = (size_t)i + 1;
+            }
+        }
+    }
+
+    n = encode_integer(out, index ? 0x40 : 0x00, index ? 6 : 4, name_index);
+    if(name_index == 0)
+    {
+        n += encode_string(out + n, name, name_len);
+    }
+    n += encode_string(out + n, value, value_len);
+    if(index)
+    {
+        Slice name_slice  = {name, name_len};
+        Slice value_slice = {value, value_len};
+
+        table_add(table, name_slice, value_slice);
+    }
+    return n;
+}
+
+// hpack_encode_field 가 쓸 수 있는 최대 길이 (색인, 두 길이의 정수 표현, 허프만을 쓰지 않은 문자열)
+size_t hpack_field_bound(size_t name_len, size_t value_len)
+{
+    return 16 + name_len + value_len;
+}
+
+// 접두사 prefix 비트로 시작하는 정수 (RFC 7541 5.1). 2^28 을 넘으면 -1
+static int decode_integer(const uint8_t **p, const uint8_t *end, int prefix, size_t *value)
+{
+    size_t max    = ((size_t)1 << prefix) - 1;
+    size_t result = **p & max;
+
+    (*p)++;
+    if(result == max)
+    {
+        for(int shift = 0;; shift += 7)
+        {
+            uint8_t b;
+
+            if(*p == end || shift > 21)
+            {
+                return -1;
+            }
+            b = *(*p)++;
+            result += (size_t)(b & 0x7f) << shift;
+            if(!(b & 0x80))
+            {
+                break;
+            }
+        }
+    }
+    *value = result;
+    return 0;
+}
+
+// 길이가 앞에 붙은 문자열. 허프만이 아니면 블록을 그대로 가리킨다
+static int decode_string(const uint8_t **p, const uint8_t *end, Arena *arena, Slice *str)
+{
+    int    huffman;
+    size_t len;
+    char  *out;
+
+    if(*p == end)
+    {
+        return -1;
+    }
+    huffman = **p & 0x80;
+    if(decode_integer(p, end, 7, &len) == -1 || len > (size_t)(end - *p))
+    {
+        return -1;
+    }
+    if(!huffman)
+    {
+        str->ptr = (const char *)*p;
+        str->len = len;
+        *p += len;
+        return 0;
+    }
+
+    // 가장 짧은 부호가 5 비트이므로 디코딩한 길이는 8/5 배를 넘지 않는다
+    out = (char *)arena_alloc(arena, len * 8 / 5 + 1);
+    if(out == NULL || huffman_decode(*p, len, out, &(str->len)) == -1)
+    {
+        return -1;
+    }
+    str->ptr = out;
+    *p += len;
+    return 0;
+}
+
+// 색인 (1 부터) 의 이름과 값. 동적 표 항목은 뒤에 넣는 항목이 밀어낼 수 있으므로 arena 에 복사한다
+static int table_lookup(const HpackTable *table, size_t index, Arena *arena, HpackField *field, int with_value)
+{
+    const HpackEntry *entry;
+    char             *copy;
+    size_t            len;
+
+    if(index == 0)
+    {
+        return -1;
+    }
+    if(index <= HPACK_STATIC_ENTRIES)
+    {
+        field->name.ptr  = static_table[index - 1].name;
+        field->name.len  = static_table[index - 1].name_len;
+        field->value.ptr = static_table[index - 1].value;
+        field->value.len = static_table[index - 1].value_len;
+        return 0;
+    }
+    index -= HPACK_STATIC_ENTRIES;
+    if(index > (size_t)table->count)
+    {
+        return -1;
+    }
+    entry = &(table->entries[table->count - (int)index]);
+    len   = entry->name_len + (with_value ? entry->value_len : 0);
+    copy  = (char *)arena_alloc(arena, len + 1);
+    if(copy == NULL)
+    {
+        return -1;
+    }
+    memcpy(copy, table->data + entry->off, len);
+    field->name.ptr  = copy;
+    field->name.len  = entry->name_len;
+    field->value.ptr = copy + entry->name_len;
+    field->value.len = with_value ? entry->value_len : 0;
+    return 0;
+}
+
+// 새 항목을 넣는다. 넣을 자리만큼 오래된 항목을 빼고, 최대 크기보다 큰 항목이면 표를 비우기만 한다 (RFC 7541 4.4)
+static void table_add(HpackTable *table, Slice name, Slice value)
+{
+    size_t      size  = name.len + value.len + HPACK_ENTRY_OVERHEAD;
+    HpackEntry *entry;
+
+    if(size > table->max_size)
+    {
+        table_evict(table, 0);
+        return;
+    }
+    table_evict(table, table->max_size - size);
+    entry            = &(table->entries[table->count++]);
+    entry->off       = (uint16_t)table->used;
+    entry->name_len  = (uint16_t)name.len;
+    entry->value_len = (uint16_t)value.len;
+    memcpy(table->data + table->used, name.ptr, name.len);
+    memcpy(table->data + table->used + name.len, value.ptr, value.len);
+    table->used += name.len + value.len;
+    table->size += size;
+}
+
+// 크기가 limit 이하가 될 때까지 오래된 항목을 빼고 남은 항목을 앞으로 당긴다
+static void table_evict(HpackTable *table, size_t limit)
+{
+    size_t bytes = 0;
+    int    drop  = 0;
+
+    while(drop < table->count && table->size > limit)
+    {
+        size_t len = (size_t)table->entries[drop].name_len + table->entries[drop].value_len;
+
+        table->size -= len + HPACK_ENTRY_OVERHEAD;
+        bytes += len;
+        drop++;
+    }
+    if(drop == 0)
+    {
+        return;
+    }
+    memmove(table->data, table->data + bytes, table->used - bytes);
+    memmove(table->entries, table->entries + drop, (size_t)(table->count - drop) * sizeof(HpackEntry));
+    table->used -= bytes;
+    table->count -= drop;
+    for(int i = 0; i < table->count; ++i)
+    {
+        table->entries[i].off = (uint16_t)(table->entries[i].off - bytes);
+    }
+}
+
+static size_t encode_integer(uint8_t *out, uint8_t first, int prefix, size_t value)
+{
+    size_t max = ((size_t)1 << prefix) - 1;
+    size_t n   = 0;
+
+    if(value < max)
+    {
+        out[0] = (uint8_t)(first | value);
+        return 1;
+    }
+    out[n++] = (uint8_t)(first | max);
+    value -= max;
+    while(value >= 0x80)
+    {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+// 허프만이 더 짧을 때만 허프만으로 쓴다
+static size_t encode_string(uint8_t *out, const char *str, size_t len)
+{
+    uint64_t bits = 0;
+    uint64_t acc  = 0;
+    int      pending;
+    size_t   n;
+
+    for(size_t i = 0; i < len; ++i)
+    {
+        bits += huffman_lengths[(unsigned char)str[i]];
+    }
+    if((bits + 7) / 8 >= len)
+    {
+        n = encode_integer(out, 0x00, 7, len);
+        memcpy(out + n, str, len);
+        return n + len;
+    }
+
+    n       = encode_integer(out, 0x80, 7, (size_t)((bits + 7) / 8));
+    pending = 0;
+    for(size_t i = 0; i < len; ++i)
+    {
+        unsigned char c = (unsigned char)str[i];
+
+        acc = (acc << huffman_lengths[c]) | huffman_codes[c];
+        pending += huffman_lengths[c];
+        while(pending >= 8)
+        {
+            pending -= 8;
+            out[n++] = (uint8_t)(acc >> pending);
+        }
+    }
+    // 남은 비트는 EOS 의 앞부분 (모두 1) 으로 채운다
+    if(pending > 0)
+    {
+        out[n++] = (uint8_t)((acc << (8 - pending)) | (0xffu >> pending));
+    }
+    return n;
+}
+
+// 비트마다 트리를 따라 내려간다. EOS 가 나오거나 끝의 채움이 7 비트를 넘거나 1 이 아니면 -1
+static int huffman_decode(const uint8_t *in, size_t len, char *out, size_t *out_len)
+{
+    int    node = 0;
+    int    bits = 0;    // 마지막 기호 뒤로 읽은 비트 수
+    int    ones = 1;    // 그 비트가 모두 1 인지
+    size_t n    = 0;
+
+    pthread_once(&huffman_once, huffman_build);
+    for(size_t i = 0; i < len; ++i)
+    {
+        for(int shift = 7; shift >= 0; --shift)
+        {
+            int bit   = (in[i] >> shift) & 1;
+            int child = huffman_tree[node][bit];
+
+            if(child < 0)
+            {
+                if(-child - 1 == HUFFMAN_EOS)
+                {
+                    return -1;
+                }
+                out[n++] = (char)(-child - 1);
+                node     = 0;
+                bits     = 0;
+                ones     = 1;
+                continue;
+            }
+            node = child;
+            bits++;
+            ones &= bit;
+        }
+    }
+    if(bits > 7 || !ones)
+    {
+        return -1;
+    }
+    *out_len = n;
+    return 0;
+}
+
+static void huffman_build(void)
+{
+    int nodes = 1;
+
+    for(int sym = 0; sym <= HUFFMAN_EOS; ++sym)
+    {
+        int node = 0;
+
+        for(int shift = huffman_lengths[sym] - 1; shift > 0; --shift)
+        {
+            int bit = (huffman_codes[sym] >> shift) & 1;
+
+            if(huffman_tree[node][bit] == 0)
+            {
+                huffman_tree[node][bit] = (int16_t)nodes++;
+            }
+            node = huffman_tree[node][bit];
+        }
+        huffman_tree[node][huffman_codes[sym] & 1] = (int16_t)(-sym - 1);
+    }
+}
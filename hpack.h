@@ -0,0 +1,49 @@
+#ifndef HPACK_H
+#define HPACK_H
+
+#include "arena.h"
+#include "http_parser.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define HPACK_TABLE_SIZE 4096                                     // 동적 표 최대 크기 (SETTINGS_HEADER_TABLE_SIZE 기본값, 더 크게 알리지 않는다)
+#define HPACK_ENTRY_OVERHEAD 32                                   // 항목마다 이름과 값 길이에 더하는 크기 (RFC 7541 4.1)
+#define HPACK_MAX_ENTRIES (HPACK_TABLE_SIZE / HPACK_ENTRY_OVERHEAD)
+#define HPACK_STATIC_ENTRIES 61
+
+typedef struct
+{
+    uint16_t off;          // data 안의 이름 위치 (값은 바로 뒤)
+    uint16_t name_len;
+    uint16_t value_len;
+} HpackEntry;
+
+// HPACK 동적 표 구조체 정의
+// 오래된 항목부터 이름과 값을 data 에 이어 쓴다. 넘치면 앞의 항목을 빼고 나머지를 앞으로 당긴다
+// 항목의 실제 바이트는 크기에서 항목마다 32 를 뺀 것이므로 data 는 최대 크기만큼이면 충분하다
+typedef struct
+{
+    char       data[HPACK_TABLE_SIZE];
+    HpackEntry entries[HPACK_MAX_ENTRIES];    // 0 이 가장 오래된 항목 (HPACK 색인 62 는 가장 새 항목)
+    int        count;
+    size_t     used;                          // data 에 쓴 바이트
+    size_t     size;                          // RFC 7541 4.1 의 크기
+    size_t     max_size;
+} HpackTable;
+
+// 디코딩한 헤더 하나 (정적 표, 헤더 블록, 아레나 중 하나를 가리킨다)
+typedef struct
+{
+    Slice name;
+    Slice value;
+} HpackField;
+
+void   hpack_table_init(HpackTable *table, size_t max_size);
+void   hpack_table_resize(HpackTable *table, size_t max_size);
+int    hpack_decode(HpackTable *table, const uint8_t *in, size_t len, Arena *arena, HpackField *fields, int max, int *nfields);
+size_t hpack_encode_size_update(uint8_t *out, size_t max_size);
+size_t hpack_encode_status(uint8_t *out, int status);
+size_t hpack_encode_field(HpackTable *table, uint8_t *out, const char *name, size_t name_len, const char *value, size_t value_len, int index);
+size_t hpack_field_bound(size_t name_len, size_t value_len);
+
+#endif
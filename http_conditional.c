@@ -0,0 +1,290 @@
+#define _GNU_SOURCE    // strptime, timegm
+
+#include "http_conditional.h"
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+static int   is_weak_or_quoted(Slice value);
+static Slice trim(const char *p, const char *end);
+static int   parse_offset(const char *p, const char *end, off_t *value);
+
+// 크기와 수정 시각으로 ETag 와 Last-Modified 를 만든다 (파일이 바뀌면 둘 중 하나는 바뀐다)
+void http_entity_init(HttpEntity *entity, off_t size, time_t mtime)
+{
+    entity->size  = size;
+    entity->mtime = mtime;
+    snprintf(entity->etag, sizeof(entity->etag), "\"%llx-%llx\"", (unsigned long long)mtime, (unsigned long long)size);
+    if(http_date_format(mtime, entity->last_modified, sizeof(entity->last_modified)) == -1)
+    {
+        entity->last_modified[0] = '\0';
+    }
+}
+
+// 모든 응답에 붙는 검증자 헤더를 만들고 길이를 돌려준다 (넘치면 -1)
+int http_entity_header(const HttpEntity *entity, char *buf, size_t size)
+{
+    int n = snprintf(buf, size, "ETag: %s\r\nLast-Modified: %s\r\nAccept-Ranges: bytes\r\n", entity->etag, entity->last_modified);
+
+    return n < 0 || (size_t)n >= size ? -1 : n;
+}
+
+// RFC 9110 13.2.2 순서로 전제 조건을 평가하고, 통과하면 Range 를 본다
+// req 가 NULL 이면 (POST 응답, 404 페이지) 조건 없이 200. Range 는 allow_range 일 때만 (GET)
+void http_conditional_evaluate(const HttpRequest *req, const char *buf, const HttpEntity *entity, int allow_range, HttpSelection *sel)
+{
+    Slice  value;
+    time_t t;
+
+    sel->status  = 200;
+    sel->nranges = 0;
+    if(req == NULL)
+    {
+        return;
+    }
+
+    // 1, 2. 클라이언트가 가진 것과 다르면 412
+    if(http_header_find(req, buf, "If-Match", &value) == 0)
+    {
+        if(!http_etag_matches(value, entity->etag, 0))
+        {
+            sel->status = 412;
+            return;
+        }
+    }
+    else if(http_header_find(req, buf, "If-Unmodified-Since", &value) == 0 && http_date_parse(value, &t) == 0 && entity->mtime > t)
+    {
+        sel->status = 412;
+        return;
+    }
+
+    // 3, 4. 클라이언트가 가진 것과 같으면 304 (If-None-Match 가 있으면 If-Modified-Since 는 보지 않는다)
+    if(http_header_find(req, buf, "If-None-Match", &value) == 0)
+    {
+        if(http_etag_matches(value, entity->etag, 1))
+        {
+            sel->status = 304;
+            return;
+        }
+    }
+    else if(http_header_find(req, buf, "If-Modified-Since", &value) == 0 && http_date_parse(value, &t) == 0 && entity->mtime <= t)
+    {
+        sel->status = 304;
+        return;
+    }
+
+    // 5. Range
+    if(!allow_range || http_header_find(req, buf, "Range", &value) == -1)
+    {
+        return;
+    }
+    // If-Range 가 맞지 않으면 파일이 바뀐 것이므로 범위 대신 전체를 보낸다 (ETag 는 강한 비교, 날짜는 정확히 같아야 한다)
+    Slice if_range;
+    if(http_header_find(req, buf, "If-Range", &if_range) == 0)
+    {
+        if(is_weak_or_quoted(if_range) ? !http_slice_equals(if_range, entity->etag) : http_date_parse(if_range, &t) == -1 || t != entity->mtime)
+        {
+            return;
+        }
+    }
+    sel->nranges = http_range_parse(value, entity->size, sel->ranges, HTTP_MAX_RANGES);
+    if(sel->nranges == -1)
+    {
+        // 잘못됐거나 너무 많은 범위는 무시한다
+        sel->nranges = 0;
+        return;
+    }
+    sel->status = sel->nranges == 0 ? 416 : 206;
+}
+
+// If-Match / If-None-Match 목록 ("a", W/"b", *) 에 etag 가 있는지 확인한다
+// weak 이면 W/ 를 떼고 비교한다 (If-None-Match, RFC 9110 13.1.2). 아니면 W/ 가 붙은 태그는 맞지 않는다
+int http_etag_matches(Slice header, const char *etag, int weak)
+{
+    const char *p   = header.ptr;
+    const char *end = header.ptr + header.len;
+
+    while(p < end)
+    {
+        const char *comma = http_find_char(p, end, ',');
+        const char *stop  = comma != NULL ? comma : end;
+        Slice       token = trim(p, stop);
+
+        if(token.len > 2 && token.ptr[0] == 'W' && token.ptr[1] == '/')
+        {
+            if(!weak)
+            {
+                p = stop + 1;
+                continue;
+            }
+            token.ptr += 2;
+            token.len -= 2;
+        }
+        if(http_slice_equals(token, "*") || http_slice_equals(token, etag))
+        {
+            return 1;
+        }
+        p = stop + 1;
+    }
+    return 0;
+}
+
+// IMF-fixdate ("Sun, 06 Nov 1994 08:49:37 GMT")
+int http_date_format(time_t t, char *buf, size_t size)
+{
+    struct tm tm;
+
+    if(gmtime_r(&t, &tm) == NULL || strftime(buf, size, "%a, %d %b %Y %H:%M:%S GMT", &tm) == 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+// IMF-fixdate 만 받는다. 다른 형식이거나 잘못된 날짜면 -1 (그 헤더는 없는 것으로 본다)
+int http_date_parse(Slice value, time_t *t)
+{
+    char        str[HTTP_DATE_SIZE];
+    struct tm   tm;
+    const char *end;
+
+    if(value.len >= sizeof(str))
+    {
+        return -1;
+    }
+    memcpy(str, value.ptr, value.len);
+    str[value.len] = '\0';
+
+    memset(&tm, 0, sizeof(tm));
+    end = strptime(str, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    if(end == NULL || *end != '\0')
+    {
+        return -1;
+    }
+    *t = timegm(&tm);
+    return *t == (time_t)-1 ? -1 : 0;
+}
+
+// "bytes=0-499, 500-, -200" 을 size 바이트 파일의 범위로 바꾼다 (RFC 9110 14.1.2)
+// 반환값: 만족할 수 있는 범위 수 (0 이면 416), 문법이 틀렸거나 max 개를 넘으면 -1
+int http_range_parse(Slice value, off_t size, HttpRange *ranges, int max)
+{
+    const char *p   = value.ptr;
+    const char *end = value.ptr + value.len;
+    int         n   = 0;
+
+    if(value.len < strlen("bytes=") || strncasecmp(p, "bytes=", strlen("bytes=")) != 0)
+    {
+        return -1;
+    }
+    p += strlen("bytes=");
+
+    while(p < end)
+    {
+        const char *comma = http_find_char(p, end, ',');
+        const char *stop  = comma != NULL ? comma : end;
+        Slice       spec  = trim(p, stop);
+        const char *dash  = http_find_char(spec.ptr, spec.ptr + spec.len, '-');
+        off_t       first;
+        off_t       last;
+
+        p = stop + 1;
+        if(spec.len == 0)
+        {
+            continue;    // "bytes=0-1,,2-3" 의 빈 항목
+        }
+        if(dash == NULL)
+        {
+            return -1;
+        }
+        if(dash == spec.ptr)
+        {
+            // "-N": 마지막 N 바이트
+            if(parse_offset(dash + 1, spec.ptr + spec.len, &last) == -1)
+            {
+                return -1;
+            }
+            if(last == 0 || size == 0)
+            {
+                continue;
+            }
+            first = last >= size ? 0 : size - last;
+            last  = size - 1;
+        }
+        else
+        {
+            if(parse_offset(spec.ptr, dash, &first) == -1)
+            {
+                return -1;
+            }
+            if(dash + 1 == spec.ptr + spec.len)
+            {
+                last = size - 1;    // "N-": 끝까지
+            }
+            else if(parse_offset(dash + 1, spec.ptr + spec.len, &last) == -1 || last < first)
+            {
+                return -1;
+            }
+            if(first >= size)
+            {
+                continue;    // 만족할 수 없는 범위는 건너뛴다
+            }
+            if(last >= size)
+            {
+                last = size - 1;
+            }
+        }
+        if(n == max)
+        {
+            return -1;
+        }
+        ranges[n].first = first;
+        ranges[n].last  = last;
+        n++;
+    }
+    return n;
+}
+
+// 따옴표나 W/ 로 시작하면 ETag, 아니면 날짜
+static int is_weak_or_quoted(Slice value)
+{
+    return value.len > 0 && (value.ptr[0] == '"' || (value.len > 1 && value.ptr[0] == 'W' && value.ptr[1] == '/'));
+}
+
+static Slice trim(const char *p, const char *end)
+{
+    Slice slice;
+
+    while(p < end && (*p == ' ' || *p == '\t'))
+    {
+        p++;
+    }
+    while(end > p && (end[-1] == ' ' || end[-1] == '\t'))
+    {
+        end--;
+    }
+    slice.ptr = p;
+    slice.len = (size_t)(end - p);
+    return slice;
+}
+
+// 10진수만, 18자리까지
+static int parse_offset(const char *p, const char *end, off_t *value)
+{
+    off_t result = 0;
+
+    if(p == end || end - p > 18)
+    {
+        return -1;
+    }
+    for(; p < end; ++p)
+    {
+        if(*p < '0' || *p > '9')
+        {
+            return -1;
+        }
+        result = result * 10 + (*p - '0');
+    }
+    *value = result;
+    return 0;
+}
@@ -0,0 +1,46 @@
+#ifndef HTTP_CONDITIONAL_H
+#define HTTP_CONDITIONAL_H
+
+#include "http_parser.h"
+#include <stddef.h>
+#include <sys/types.h>
+#include <time.h>
+
+#define HTTP_MAX_RANGES 16     // 한 요청에서 받을 최대 범위 수 (넘으면 Range 를 무시하고 전체를 보낸다)
+#define HTTP_DATE_SIZE 32      // "Sun, 06 Nov 1994 08:49:37 GMT" + NUL
+#define HTTP_ETAG_SIZE 48
+#define HTTP_ENTITY_HEADER_SIZE 160
+
+// 바이트 범위 (양 끝 포함)
+typedef struct
+{
+    off_t first;
+    off_t last;
+} HttpRange;
+
+// 파일 하나의 검증자 (크기와 수정 시각에서 만든다)
+typedef struct
+{
+    off_t  size;
+    time_t mtime;
+    char   etag[HTTP_ETAG_SIZE];               // "\"<mtime>-<size>\"" (16진수)
+    char   last_modified[HTTP_DATE_SIZE];
+} HttpEntity;
+
+// 조건부 요청과 Range 를 평가한 결과
+typedef struct
+{
+    int       status;                         // 200, 206, 304, 412, 416
+    int       nranges;                        // 206 일 때 보낼 범위 수
+    HttpRange ranges[HTTP_MAX_RANGES];
+} HttpSelection;
+
+void http_entity_init(HttpEntity *entity, off_t size, time_t mtime);
+int  http_entity_header(const HttpEntity *entity, char *buf, size_t size);
+void http_conditional_evaluate(const HttpRequest *req, const char *buf, const HttpEntity *entity, int allow_range, HttpSelection *sel);
+int  http_etag_matches(Slice header, const char *etag, int weak);
+int  http_date_format(time_t t, char *buf, size_t size);
+int  http_date_parse(Slice value, time_t *t);
+int  http_range_parse(Slice value, off_t size, HttpRange *ranges, int max);
+
+#endif
@@ -0,0 +1,620 @@
+#include "http_parser.h"
+#include <string.h>
+#include <strings.h>
+
+#if defined(__x86_64__) && defined(__SSE2__)
+    #include <immintrin.h>
+#endif
+
+static int         parse_request_line(HttpRequest *req, const char *buf, size_t start, size_t end);
+static int         parse_header_line(HttpRequest *req, const char *buf, size_t start, size_t end);
+static int         parse_content_length(Slice value, long *length);
+static void        parse_connection(HttpRequest *req, Slice value);
+static int         parse_transfer_encoding(HttpRequest *req, Slice value);
+static int         parse_chunk_size(const char *p, const char *end, size_t *size);
+static int         is_token_char(unsigned char c);
+static const char *find_char_scalar(const char *p, const char *end, char c);
+
+void http_request_init(HttpRequest *req)
+{
+    req->state          = HTTP_STATE_REQUEST_LINE;
+    req->pos            = 0;
+    req->line_start     = 0;
+    req->nheaders       = 0;
+    req->header_len     = 0;
+    req->content_length = 0;
+    req->has_length     = 0;
+    req->chunked        = 0;
+    req->keep_alive     = 0;
+    req->upgrade        = 0;
+    req->minor_version  = 0;
+    req->error          = 0;
+    req->body_len       = 0;
+    req->chunk_state    = HTTP_CHUNK_SIZE;
+    req->chunk_pos      = 0;
+    req->chunk_left     = 0;
+}
+
+// 요청을 더 읽지 않고 status 로 응답하도록 표시한다
+void http_request_fail(HttpRequest *req, int status)
+{
+    req->state = HTTP_STATE_ERROR;
+    req->error = status;
+}
+
+// buf[0, len) 에서 헤더 끝까지 읽는다. 본문은 읽지 않는다
+// 반환값: 1 헤더 완성, 0 바이트가 더 필요함, -1 잘못된 요청
+int http_request_parse(HttpRequest *req, const char *buf, size_t len)
+{
+    while(req->state != HTTP_STATE_DONE)
+    {
+        const char *nl;
+        size_t      end;
+        int         result;
+
+        if(req->state == HTTP_STATE_ERROR)
+        {
+            return -1;
+        }
+
+        nl = http_find_char(buf + req->pos, buf + len, '\n');
+        if(nl == NULL)
+        {
+            // 줄이 아직 덜 왔다. 다음에는 여기서부터 찾는다
+            req->pos = len;
+            return 0;
+        }
+
+        // CRLF 와 LF 를 모두 줄 끝으로 받는다
+        end = (size_t)(nl - buf);
+        if(end > req->line_start && buf[end - 1] == '\r')
+        {
+            end--;
+        }
+
+        if(req->state == HTTP_STATE_REQUEST_LINE)
+        {
+            // 요청 앞의 빈 줄은 무시한다 (RFC 9112 2.2)
+            result = end == req->line_start ? 0 : parse_request_line(req, buf, req->line_start, end);
+        }
+        else if(end == req->line_start)
+        {
+            req->header_len = (size_t)(nl - buf) + 1;
+            req->state      = HTTP_STATE_DONE;
+            req->chunk_pos  = req->header_len;
+            // 둘 다 있으면 본문 경계를 믿을 수 없다 (RFC 9112 6.3, request smuggling)
+            result = req->chunked && req->has_length ? -1 : 0;
+        }
+        else
+        {
+            result = parse_header_line(req, buf, req->line_start, end);
+        }
+
+        if(result == -1)
+        {
+            if(req->state != HTTP_STATE_ERROR)
+            {
+                http_request_fail(req, 400);
+            }
+            return -1;
+        }
+        req->line_start = (size_t)(nl - buf) + 1;
+        req->pos        = req->line_start;
+    }
+    return 1;
+}
+
+// 헤더 뒤의 chunked 본문을 그 자리에서 디코딩해 buf[header_len, header_len + body_len) 에 이어 붙인다
+// 바이트가 더 쌓일 때마다 다시 부르면 chunk_pos 부터 이어서 읽는다. 디코딩한 만큼 원본이 줄어들므로 버퍼가 본문 크기 이상으로 커지지 않는다
+// 반환값: 1 본문 끝 (chunk_pos 가 다음 요청의 시작), 0 바이트가 더 필요함, -1 잘못된 본문
+int http_chunked_decode(HttpRequest *req, char *buf, size_t len)
+{
+    while(req->chunk_state != HTTP_CHUNK_DONE)
+    {
+        const char *nl;
+        size_t      n;
+
+        switch(req->chunk_state)
+        {
+            case HTTP_CHUNK_SIZE:
+                nl = http_find_char(buf + req->chunk_pos, buf + len, '\n');
+                if(nl == NULL)
+                {
+                    return len - req->chunk_pos > HTTP_MAX_CHUNK_LINE ? -1 : 0;
+                }
+                if(parse_chunk_size(buf + req->chunk_pos, nl, &(req->chunk_left)) == -1)
+                {
+                    return -1;
+                }
+                req->chunk_pos   = (size_t)(nl - buf) + 1;
+                req->chunk_state = req->chunk_left == 0 ? HTTP_CHUNK_TRAILER : HTTP_CHUNK_DATA;
+                break;
+
+            case HTTP_CHUNK_DATA:
+                n = len - req->chunk_pos < req->chunk_left ? len - req->chunk_pos : req->chunk_left;
+                if(n == 0)
+                {
+                    return 0;
+                }
+                memmove(buf + req->header_len + req->body_len, buf + req->chunk_pos, n);
+                req->body_len += n;
+                req->chunk_pos += n;
+                req->chunk_left -= n;
+                if(req->chunk_left == 0)
+                {
+                    req->chunk_state = HTTP_CHUNK_DATA_END;
+                }
+                break;
+
+            case HTTP_CHUNK_DATA_END:
+                if(req->chunk_pos == len || (buf[req->chunk_pos] == '\r' && req->chunk_pos + 1 == len))
+                {
+                    return 0;
+                }
+                if(buf[req->chunk_pos] == '\r')
+                {
+                    req->chunk_pos++;
+                }
+                if(buf[req->chunk_pos] != '\n')
+                {
+                    return -1;
+                }
+                req->chunk_pos++;
+                req->chunk_state = HTTP_CHUNK_SIZE;
+                break;
+
+            default:
+                // 트레일러 필드는 쓰지 않으므로 빈 줄까지 건너뛴다
+                nl = http_find_char(buf + req->chunk_pos, buf + len, '\n');
+                if(nl == NULL)
+                {
+                    return len - req->chunk_pos > HTTP_MAX_CHUNK_LINE ? -1 : 0;
+                }
+                if(nl == buf + req->chunk_pos || (nl == buf + req->chunk_pos + 1 && buf[req->chunk_pos] == '\r'))
+                {
+                    req->chunk_state = HTTP_CHUNK_DONE;
+                }
+                req->chunk_pos = (size_t)(nl - buf) + 1;
+                break;
+        }
+    }
+    return 1;
+}
+
+// 이름이 같은 첫 번째 헤더의 값을 찾는다 (대소문자 무시). 없으면 -1
+int http_header_find(const HttpRequest *req, const char *buf, const char *name, Slice *value)
+{
+    for(int i = 0; i < req->nheaders; ++i)
+    {
+        if(http_slice_equals_nocase(http_slice(buf, req->headers[i].name), name))
+        {
+            *value = http_slice(buf, req->headers[i].value);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// 요청 대상에서 문서 루트 기준 파일 경로를 만든다 ("/a//b.html?x=1" -> "a/b.html", "/" -> "index.html")
+// 쿼리는 버리고 ".." 는 문서 루트 밖으로 나갈 수 있으므로 받지 않는다. 잘못됐거나 너무 길면 -1
+int http_request_path(const HttpRequest *req, const char *buf, char *path, size_t size)
+{
+    Slice       target = http_slice(buf, req->target);
+    const char *p      = target.ptr;
+    const char *end    = target.ptr + target.len;
+    const char *query  = http_find_char(p, end, '?');
+    size_t      len    = 0;
+
+    if(query != NULL)
+    {
+        end = query;
+    }
+    if(p == end || *p != '/')
+    {
+        return -1;
+    }
+
+    while(p < end)
+    {
+        const char *slash;
+        size_t      seg_len;
+
+        while(p < end && *p == '/')
+        {
+            p++;
+        }
+        if(p == end)
+        {
+            break;
+        }
+        slash   = http_find_char(p, end, '/');
+        seg_len = (size_t)((slash != NULL ? slash : end) - p);
+        if(seg_len == 2 && p[0] == '.' && p[1] == '.')
+        {
+            return -1;
+        }
+        if(len + (len > 0) + seg_len >= size)
+        {
+            return -1;
+        }
+        if(len > 0)
+        {
+            path[len++] = '/';
+        }
+        memcpy(path + len, p, seg_len);
+        len += seg_len;
+        p += seg_len;
+    }
+
+    if(len == 0)
+    {
+        if(strlen("index.html") >= size)
+        {
+            return -1;
+        }
+        strcpy(path, "index.html");
+        return 0;
+    }
+    path[len] = '\0';
+    return 0;
+}
+
+// 요청 대상의 쿼리 ("?a=1&b=2") 에서 이름이 같은 첫 번째 값을 찾는다 (디코딩하지 않는다). 없으면 -1
+int http_query_find(const HttpRequest *req, const char *buf, const char *name, Slice *value)
+{
+    Slice       target   = http_slice(buf, req->target);
+    const char *end      = target.ptr + target.len;
+    const char *p        = http_find_char(target.ptr, end, '?');
+    const char *fragment = http_find_char(target.ptr, end, '#');
+    size_t      name_len = strlen(name);
+
+    if(p == NULL)
+    {
+        return -1;
+    }
+    // 조각(#...)은 서버로 오지 않지만 오더라도 무시한다
+    if(fragment != NULL && fragment > p)
+    {
+        end = fragment;
+    }
+
+    for(p++; p < end;)
+    {
+        const char *amp     = http_find_char(p, end, '&');
+        const char *stop    = amp != NULL ? amp : end;
+        const char *eq      = http_find_char(p, stop, '=');
+        const char *key_end = eq != NULL ? eq : stop;
+
+        if((size_t)(key_end - p) == name_len && memcmp(p, name, name_len) == 0)
+        {
+            value->ptr = eq != NULL ? eq + 1 : stop;
+            value->len = (size_t)(stop - value->ptr);
+            return 0;
+        }
+        p = stop + 1;
+    }
+    return -1;
+}
+
+Slice http_slice(const char *buf, HttpSpan span)
+{
+    Slice slice;
+
+    slice.ptr = buf + span.off;
+    slice.len = span.len;
+    return slice;
+}
+
+int http_slice_equals(Slice slice, const char *str)
+{
+    return slice.len == strlen(str) && memcmp(slice.ptr, str, slice.len) == 0;
+}
+
+int http_slice_equals_nocase(Slice slice, const char *str)
+{
+    return slice.len == strlen(str) && strncasecmp(slice.ptr, str, slice.len) == 0;
+}
+
+// [p, end) 에서 c 의 첫 위치를 찾는다. 없으면 NULL
+// AVX2 를 쓸 수 있으면 32바이트씩, 아니면 SSE2 로 16바이트씩 비교한다
+#if defined(__x86_64__) && defined(__SSE2__)
+__attribute__((target("avx2"))) static const char *find_char_avx2(const char *p, const char *end, char c)
+{
+    __m256i needle = _mm256_set1_epi8(c);
+
+    while(end - p >= 32)
+    {
+        __m256i  chunk = _mm256_loadu_si256((const __m256i *)p);
+        unsigned mask  = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle));
+        if(mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+    return find_char_scalar(p, end, c);
+}
+
+static const char *find_char_sse2(const char *p, const char *end, char c)
+{
+    __m128i needle = _mm_set1_epi8(c);
+
+    while(end - p >= 16)
+    {
+        __m128i  chunk = _mm_loadu_si128((const __m128i *)p);
+        unsigned mask  = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+        if(mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+    return find_char_scalar(p, end, c);
+}
+
+const char *http_find_char(const char *p, const char *end, char c)
+{
+    if(__builtin_cpu_supports("avx2"))
+    {
+        return find_char_avx2(p, end, c);
+    }
+    return find_char_sse2(p, end, c);
+}
+#else
+const char *http_find_char(const char *p, const char *end, char c)
+{
+    return find_char_scalar(p, end, c);
+}
+#endif
+
+static const char *find_char_scalar(const char *p, const char *end, char c)
+{
+    for(; p < end; ++p)
+    {
+        if(*p == c)
+        {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+// "METHOD SP target SP HTTP/1.x"
+static int parse_request_line(HttpRequest *req, const char *buf, size_t start, size_t end)
+{
+    const char *line = buf + start;
+    const char *stop = buf + end;
+    const char *sp1;
+    const char *sp2;
+
+    sp1 = http_find_char(line, stop, ' ');
+    if(sp1 == NULL || sp1 == line)
+    {
+        return -1;
+    }
+    for(const char *p = line; p < sp1; ++p)
+    {
+        if(!is_token_char((unsigned char)*p))
+        {
+            return -1;
+        }
+    }
+    sp2 = http_find_char(sp1 + 1, stop, ' ');
+    if(sp2 == NULL || sp2 == sp1 + 1)
+    {
+        return -1;
+    }
+    if(stop - (sp2 + 1) != (long)strlen("HTTP/1.x") || memcmp(sp2 + 1, "HTTP/1.", strlen("HTTP/1.")) != 0 || (sp2[8] != '0' && sp2[8] != '1'))
+    {
+        return -1;
+    }
+
+    req->method.off    = (uint32_t)start;
+    req->method.len    = (uint32_t)(sp1 - line);
+    req->target.off    = (uint32_t)(sp1 + 1 - buf);
+    req->target.len    = (uint32_t)(sp2 - (sp1 + 1));
+    req->minor_version = sp2[8] - '0';
+
+    // HTTP/1.1 은 기본적으로 연결을 유지하고, HTTP/1.0 은 keep-alive 를 요청한 경우만 유지한다
+    req->keep_alive = req->minor_version == 1;
+    req->state      = HTTP_STATE_HEADERS;
+    return 0;
+}
+
+// "name: value"
+static int parse_header_line(HttpRequest *req, const char *buf, size_t start, size_t end)
+{
+    const char *line = buf + start;
+    const char *stop = buf + end;
+    const char *colon;
+    const char *value;
+    HttpHeader *header;
+
+    if(req->nheaders == HTTP_MAX_HEADERS)
+    {
+        return -1;
+    }
+
+    // 줄 앞 공백(obs-fold)이나 이름 없는 헤더는 받지 않는다
+    colon = http_find_char(line, stop, ':');
+    if(colon == NULL || colon == line || *line == ' ' || *line == '\t')
+    {
+        return -1;
+    }
+    for(const char *p = line; p < colon; ++p)
+    {
+        if(!is_token_char((unsigned char)*p))
+        {
+            return -1;
+        }
+    }
+
+    value = colon + 1;
+    while(value < stop && (*value == ' ' || *value == '\t'))
+    {
+        value++;
+    }
+    while(stop > value && (stop[-1] == ' ' || stop[-1] == '\t'))
+    {
+        stop--;
+    }
+
+    header            = &(req->headers[req->nheaders++]);
+    header->name.off  = (uint32_t)start;
+    header->name.len  = (uint32_t)(colon - line);
+    header->value.off = (uint32_t)(value - buf);
+    header->value.len = (uint32_t)(stop - value);
+
+    // 리액터가 본문 길이를 알아야 하므로 필요한 헤더는 여기서 해석해 둔다
+    if(http_slice_equals_nocase(http_slice(buf, header->name), "Content-Length"))
+    {
+        long length;
+        if(parse_content_length(http_slice(buf, header->value), &length) == -1)
+        {
+            return -1;
+        }
+        // 값이 다른 Content-Length 가 여러 개면 요청 경계를 믿을 수 없다
+        if(req->has_length && req->content_length != length)
+        {
+            return -1;
+        }
+        req->content_length = length;
+        req->has_length     = 1;
+    }
+    else if(http_slice_equals_nocase(http_slice(buf, header->name), "Transfer-Encoding"))
+    {
+        return parse_transfer_encoding(req, http_slice(buf, header->value));
+    }
+    else if(http_slice_equals_nocase(http_slice(buf, header->name), "Connection"))
+    {
+        parse_connection(req, http_slice(buf, header->value));
+    }
+    return 0;
+}
+
+// 숫자만 허용한다
+static int parse_content_length(Slice value, long *length)
+{
+    long result = 0;
+
+    if(value.len == 0 || value.len > 18)
+    {
+        return -1;
+    }
+    for(size_t i = 0; i < value.len; ++i)
+    {
+        if(value.ptr[i] < '0' || value.ptr[i] > '9')
+        {
+            return -1;
+        }
+        result = result * 10 + (value.ptr[i] - '0');
+    }
+    *length = result;
+    return 0;
+}
+
+// 쉼표로 구분된 옵션 중 close / keep-alive / upgrade 를 찾는다
+static void parse_connection(HttpRequest *req, Slice value)
+{
+    const char *p    = value.ptr;
+    const char *stop = value.ptr + value.len;
+
+    while(p < stop)
+    {
+        const char *comma = http_find_char(p, stop, ',');
+        const char *end   = comma != NULL ? comma : stop;
+        Slice       token;
+
+        while(p < end && (*p == ' ' || *p == '\t'))
+        {
+            p++;
+        }
+        token.ptr = p;
+        token.len = (size_t)(end - p);
+        while(token.len > 0 && (token.ptr[token.len - 1] == ' ' || token.ptr[token.len - 1] == '\t'))
+        {
+            token.len--;
+        }
+
+        if(http_slice_equals_nocase(token, "close"))
+        {
+            req->keep_alive = 0;
+        }
+        else if(http_slice_equals_nocase(token, "keep-alive"))
+        {
+            req->keep_alive = 1;
+        }
+        else if(http_slice_equals_nocase(token, "upgrade"))
+        {
+            req->upgrade = 1;
+        }
+        p = end + 1;
+    }
+}
+
+// chunked 만 지원한다. 다른 코딩이면 501 (RFC 9112 6.1)
+static int parse_transfer_encoding(HttpRequest *req, Slice value)
+{
+    if(!http_slice_equals_nocase(value, "chunked") || req->chunked)
+    {
+        http_request_fail(req, http_slice_equals_nocase(value, "chunked") ? 400 : 501);
+        return -1;
+    }
+    req->chunked = 1;
+    return 0;
+}
+
+// "1a2b[;ext=...][\r]" (줄 끝 '\n' 앞까지). 너무 큰 값은 받지 않는다
+static int parse_chunk_size(const char *p, const char *end, size_t *size)
+{
+    size_t result = 0;
+    int    digits = 0;
+
+    if(end > p && end[-1] == '\r')
+    {
+        end--;
+    }
+    for(; p < end; ++p, ++digits)
+    {
+        int v;
+
+        if(*p >= '0' && *p <= '9')
+        {
+            v = *p - '0';
+        }
+        else if((*p | 0x20) >= 'a' && (*p | 0x20) <= 'f')
+        {
+            v = (*p | 0x20) - 'a' + 10;
+        }
+        else
+        {
+            break;
+        }
+        if(digits == 15)
+        {
+            return -1;
+        }
+        result = result * 16 + (size_t)v;
+    }
+    // 확장(;name=value)은 무시한다
+    while(p < end && (*p == ' ' || *p == '\t'))
+    {
+        p++;
+    }
+    if(digits == 0 || (p < end && *p != ';'))
+    {
+        return -1;
+    }
+    *size = result;
+    return 0;
+}
+
+// RFC 9110 5.6.2 tchar
+static int is_token_char(unsigned char c)
+{
+    if((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'))
+    {
+        return 1;
+    }
+    return c != '\0' && strchr("!#$%&'*+-.^_`|~", c) != NULL;
+}
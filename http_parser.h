@@ -0,0 +1,80 @@
+#ifndef HTTP_PARSER_H
+#define HTTP_PARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HTTP_MAX_HEADERS 64       // 요청 하나의 최대 헤더 수
+#define HTTP_MAX_CHUNK_LINE 1024  // 청크 크기 줄과 트레일러 줄의 최대 길이
+
+// 파서 상태
+#define HTTP_STATE_REQUEST_LINE 0
+#define HTTP_STATE_HEADERS 1
+#define HTTP_STATE_DONE 2
+#define HTTP_STATE_ERROR 3
+
+// chunked 본문 디코더 상태
+#define HTTP_CHUNK_SIZE 0        // 청크 크기 줄
+#define HTTP_CHUNK_DATA 1        // 청크 데이터
+#define HTTP_CHUNK_DATA_END 2    // 데이터 뒤의 CRLF
+#define HTTP_CHUNK_TRAILER 3     // 마지막 청크 뒤의 트레일러
+#define HTTP_CHUNK_DONE 4
+
+// 버퍼 안의 위치 (버퍼가 realloc 으로 옮겨져도 그대로 쓸 수 있도록 포인터 대신 오프셋을 둔다)
+typedef struct
+{
+    uint32_t off;
+    uint32_t len;
+} HttpSpan;
+
+// 복사하지 않은 문자열 조각 (NUL 로 끝나지 않는다)
+typedef struct
+{
+    const char *ptr;
+    size_t      len;
+} Slice;
+
+typedef struct
+{
+    HttpSpan name;
+    HttpSpan value;    // 앞뒤 공백을 뺀 값
+} HttpHeader;
+
+// 요청 파서 구조체 정의
+// 연결 버퍼에 바이트가 더 쌓일 때마다 http_request_parse 를 다시 부르면 마지막으로 본 곳부터 이어서 읽는다
+typedef struct
+{
+    int        state;
+    size_t     pos;               // 다음에 줄 끝을 찾기 시작할 위치
+    size_t     line_start;        // 지금 읽고 있는 줄의 시작
+    HttpSpan   method;
+    HttpSpan   target;            // 요청 대상 ("/index.html?x=1")
+    int        minor_version;     // HTTP/1.x 의 x
+    HttpHeader headers[HTTP_MAX_HEADERS];
+    int        nheaders;
+    size_t     header_len;        // 빈 줄까지 포함한 헤더 길이
+    long       content_length;    // 없으면 0
+    int        has_length;        // Content-Length 헤더가 있었는지
+    int        chunked;           // Transfer-Encoding: chunked
+    int        keep_alive;        // 버전과 Connection 헤더로 정한 연결 유지 여부
+    int        upgrade;           // Connection 에 upgrade 가 있다 (h2c 업그레이드 요청일 수 있다)
+    int        error;             // HTTP_STATE_ERROR 일 때 응답할 상태 코드
+    size_t     body_len;          // 헤더 뒤에 모인 본문 길이 (chunked 면 디코딩한 길이)
+    int        chunk_state;       // HTTP_CHUNK_*
+    size_t     chunk_pos;         // 아직 디코딩하지 않은 원본 바이트의 위치
+    size_t     chunk_left;        // 지금 청크에서 남은 데이터 길이
+} HttpRequest;
+
+void        http_request_init(HttpRequest *req);
+int         http_request_parse(HttpRequest *req, const char *buf, size_t len);
+int         http_chunked_decode(HttpRequest *req, char *buf, size_t len);
+void        http_request_fail(HttpRequest *req, int status);
+int         http_header_find(const HttpRequest *req, const char *buf, const char *name, Slice *value);
+int         http_request_path(const HttpRequest *req, const char *buf, char *path, size_t size);
+int         http_query_find(const HttpRequest *req, const char *buf, const char *name, Slice *value);
+Slice       http_slice(const char *buf, HttpSpan span);
+int         http_slice_equals(Slice slice, const char *str);
+int         http_slice_equals_nocase(Slice slice, const char *str);
+const char *http_find_char(const char *p, const char *end, char c);
+
+#endif
@@ -0,0 +1,84 @@
+#include "idle_set.h"
+#include "futex.h"
+
+void idle_set_init(IdleSet *set)
+{
+    atomic_init(&(set->mask), 0);
+    for(int i = 0; i < IDLE_SET_MAX; ++i)
+    {
+        atomic_init(&(set->slots[i].word), 0);
+    }
+}
+
+// 잠들 준비: 비트를 세운 뒤 호출자는 일감을 한 번 더 확인하고 wait 또는 cancel 한다
+unsigned int idle_set_prepare(IdleSet *set, int id)
+{
+    unsigned int seq = atomic_load(&(set->slots[id].word));
+
+    atomic_fetch_or(&(set->mask), 1ULL << id);
+    // 비트를 세운 뒤 다시 확인해야 깨우기를 놓치지 않는다
+    atomic_thread_fence(memory_order_seq_cst);
+    return seq;
+}
+
+void idle_set_cancel(IdleSet *set, int id)
+{
+    atomic_fetch_and(&(set->mask), ~(1ULL << id));
+}
+
+// prepare 이후 누군가 깨웠다면 바로 돌아온다
+void idle_set_wait(IdleSet *set, int id, unsigned int seq)
+{
+    futex_wait(&(set->slots[id].word), seq);
+    atomic_fetch_and(&(set->mask), ~(1ULL << id));
+}
+
+// 잠든 스레드 하나를 골라 mask 에서 빼고 번호를 돌려준다. 잠든 스레드가 없으면 -1
+// 비트를 가져간 쪽만 깨우므로 같은 스레드에게 시스템 콜을 반복하지 않는다
+int idle_set_claim(IdleSet *set)
+{
+    unsigned long long mask;
+
+    atomic_thread_fence(memory_order_seq_cst);
+    mask = atomic_load_explicit(&(set->mask), memory_order_relaxed);
+    while(mask != 0)
+    {
+        int id = __builtin_ctzll(mask);
+        if(atomic_compare_exchange_weak(&(set->mask), &mask, mask & ~(1ULL << id)))
+        {
+            return id;
+        }
+    }
+    return -1;
+}
+
+// futex 에서 잠든 스레드를 깨운다
+void idle_set_wake(IdleSet *set, int id)
+{
+    atomic_fetch_add(&(set->slots[id].word), 1);
+    futex_wake(&(set->slots[id].word), 1);
+}
+
+// 잠든 스레드가 없으면 시스템 콜을 하지 않는다
+void idle_set_wake_one(IdleSet *set)
+{
+    int id = idle_set_claim(set);
+
+    if(id >= 0)
+    {
+        idle_set_wake(set, id);
+    }
+}
+
+void idle_set_wake_all(IdleSet *set)
+{
+    unsigned long long mask = atomic_exchange(&(set->mask), 0);
+
+    for(int id = 0; id < IDLE_SET_MAX; ++id)
+    {
+        if(mask & (1ULL << id))
+        {
+            idle_set_wake(set, id);
+        }
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef IDLE_SET_H
+#define IDLE_SET_H
+
+#include <stdatomic.h>
+
+#define CACHE_LINE 64
+#define IDLE_SET_MAX 64    // mask 한 워드로 나타낼 수 있는 스레드 수
+
+// 스레드마다 따로 잠드는 futex (다른 스레드와 캐시 라인을 공유하지 않는다)
+typedef struct
+{
+    _Alignas(CACHE_LINE) atomic_uint word;
+} ParkSlot;
+
+// 잠든 스레드 집합. 깨우는 쪽이 비트를 가져가므로 같은 스레드를 두 번 깨우지 않는다
+typedef struct
+{
+    _Alignas(CACHE_LINE) atomic_ullong mask;    // 잠들어 있거나 잠들려는 스레드 비트
+    ParkSlot slots[IDLE_SET_MAX];               // 스레드별 futex
+} IdleSet;
+
+void         idle_set_init(IdleSet *set);
+unsigned int idle_set_prepare(IdleSet *set, int id);
+void         idle_set_cancel(IdleSet *set, int id);
+void         idle_set_wait(IdleSet *set, int id, unsigned int seq);
+int          idle_set_claim(IdleSet *set);
+void         idle_set_wake(IdleSet *set, int id);
+void         idle_set_wake_one(IdleSet *set);
+void         idle_set_wake_all(IdleSet *set);
+
+#endif
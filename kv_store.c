@@ -0,0 +1,334 @@
+#include "kv_store.h"
+#include "futex.h"
+#include "metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define KV_RESULT_WAITING 2    // kv_table_stage: 같은 키의 앞선 쓰기가 아직 fsync 를 기다린다 (커미터 안에서만 쓰는 result)
+
+static void     *committer_function(void *arg);
+static KvRecord *take_pending(KvStore *store);
+static void      apply_batch(KvStore *store, KvRecord *batch);
+static int       sync_writer(KvStore *store);
+static void      finish_batch(KvStore *store, KvRecord *batch, int synced);
+static void      ack_batch(KvRecord *batch);
+static long      monotonic_ms(void);
+static int       load_table(KvStore *store);
+
+// 시작할 때 한 번 열어 파일 전체를 메모리 테이블에 올린다
+// 파일은 커미터만 쓰므로 파일 잠금은 쓰지 않는다
+int kv_store_open(KvStore *store, const char *path, int sync_policy, int sync_interval_ms)
+{
+    if(kv_table_init(&(store->table)) == -1)
+    {
+        return -1;
+    }
+    store->writer = gdbm_open(path, KV_BLOCK_SIZE, GDBM_WRCREAT | GDBM_NOLOCK, KV_MODE, NULL);
+    if(store->writer == NULL)
+    {
+        kv_table_destroy(&(store->table));
+        return -1;
+    }
+    atomic_init(&(store->generation), 0);
+    if(load_table(store) == -1)
+    {
+        gdbm_close(store->writer);
+        kv_table_destroy(&(store->table));
+        return -1;
+    }
+    store->sync_policy      = sync_policy;
+    store->sync_interval_ms = sync_interval_ms;
+    atomic_init(&(store->pending), NULL);
+    atomic_init(&(store->pending_seq), 0);
+    atomic_init(&(store->committer_waiting), 0);
+    atomic_init(&(store->stopping), 0);
+
+    if(pthread_create(&(store->committer), NULL, committer_function, store) != 0)
+    {
+        gdbm_close(store->writer);
+        kv_table_destroy(&(store->table));
+        return -1;
+    }
+    return 0;
+}
+
+// 모든 워커가 끝난 뒤에 호출한다
+void kv_store_close(KvStore *store)
+{
+    // 남은 쓰기를 모두 파일에 쓰고 커미터를 끝낸다
+    atomic_store(&(store->stopping), 1);
+    atomic_fetch_add(&(store->pending_seq), 1);
+    futex_wake(&(store->pending_seq), 1);
+    pthread_join(store->committer, NULL);
+
+    gdbm_close(store->writer);
+    kv_table_destroy(&(store->table));
+}
+
+// 값을 찾으면 1 과 함께 arena 에 만든 값을 돌려준다 (NUL 로 끝나지 않는다). 없으면 0, 오류면 -1
+// fsync 정책을 만족한 값만 보인다 (아직 커미터에 있는 쓰기는 없는 것과 같다)
+int kv_store_fetch(KvStore *store, const char *key, size_t key_len, Arena *arena, char **value, size_t *value_len)
+{
+    return kv_table_get(&(store->table), key, key_len, arena, value, value_len);
+}
+
+// 넣은 순서로 한 페이지를 가져온다 (kv_table_list)
+size_t kv_store_list(KvStore *store, size_t offset, size_t limit, const KvEntry **entries, size_t *total)
+{
+    return kv_table_list(&(store->table), offset, limit, entries, total);
+}
+
+// 내용이 바뀌었는지 비교할 수 있는 값. 테이블을 읽지 않는다
+unsigned long kv_store_generation(KvStore *store)
+{
+    return atomic_load(&(store->generation));
+}
+
+// 읽기에 보이는 키의 수 (커미터에서 기다리는 쓰기는 세지 않는다)
+size_t kv_store_count(KvStore *store)
+{
+    return kv_table_count(&(store->table));
+}
+
+// 쓰기를 커미터에게 넘기고 바로 돌아온다
+// 커미터가 다른 워커의 쓰기와 묶어서 키가 없을 때만 파일에 쓰고, fsync 정책을 만족하면 테이블에 공개한 뒤 record->callback 을 부른다
+// 같은 키의 쓰기가 아직 fsync 를 기다리고 있으면 그 결과가 나올 때 함께 알린다
+// record 와 key, value 는 callback 이 불릴 때까지 그대로 있어야 한다 (파일에 쓸 때는 복사하지 않는다)
+void kv_store_insert(KvStore *store, KvRecord *record)
+{
+    // 락 없이 목록 앞에 붙인다
+    record->next = atomic_load_explicit(&(store->pending), memory_order_relaxed);
+    while(!atomic_compare_exchange_weak_explicit(&(store->pending), &(record->next), record, memory_order_release, memory_order_relaxed))
+    {
+    }
+
+    // 커미터가 잠들어 있을 때만 깨운다 (플래그를 지운 쪽만 시스템 콜을 한다)
+    atomic_thread_fence(memory_order_seq_cst);
+    if(atomic_load_explicit(&(store->committer_waiting), memory_order_relaxed) && atomic_exchange(&(store->committer_waiting), 0))
+    {
+        atomic_fetch_add(&(store->pending_seq), 1);
+        futex_wake(&(store->pending_seq), 1);
+    }
+}
+
+// 쌓인 쓰기를 한꺼번에 가져와 적용하고, 정책에 따라 fsync 한 뒤 알린다
+// 커미터가 fsync 하는 동안 들어온 쓰기는 다음 묶음이 되므로 부하가 클수록 묶음이 커진다
+static void *committer_function(void *arg)
+{
+    KvStore  *store     = (KvStore *)arg;
+    KvRecord *unsynced  = NULL;    // KV_SYNC_INTERVAL: 적용했지만 아직 fsync 하지 않은 쓰기
+    long      last_sync = monotonic_ms();
+
+    while(1)
+    {
+        KvRecord *batch = take_pending(store);
+
+        if(batch != NULL)
+        {
+            apply_batch(store, batch);
+            if(store->sync_policy == KV_SYNC_BATCH)
+            {
+                finish_batch(store, batch, sync_writer(store) == 0);
+                ack_batch(batch);
+            }
+            else if(store->sync_policy == KV_SYNC_INTERVAL)
+            {
+                // 묶음 끝을 지금까지 쌓인 목록 앞에 잇는다
+                KvRecord *tail = batch;
+                while(tail->next != NULL)
+                {
+                    tail = tail->next;
+                }
+                tail->next = unsynced;
+                unsynced   = batch;
+            }
+            else
+            {
+                finish_batch(store, batch, 1);
+                ack_batch(batch);
+            }
+        }
+
+        if(unsynced != NULL && (monotonic_ms() - last_sync >= store->sync_interval_ms || atomic_load(&(store->stopping))))
+        {
+            finish_batch(store, unsynced, sync_writer(store) == 0);
+            last_sync = monotonic_ms();
+            ack_batch(unsynced);
+            unsynced = NULL;
+        }
+        if(batch != NULL)
+        {
+            continue;
+        }
+        if(atomic_load(&(store->stopping)) && atomic_load(&(store->pending)) == NULL)
+        {
+            break;
+        }
+
+        // 잠든다고 알린 뒤 다시 확인해야 깨우기를 놓치지 않는다
+        unsigned int seq = atomic_load(&(store->pending_seq));
+        atomic_store(&(store->committer_waiting), 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if(atomic_load(&(store->pending)) != NULL || atomic_load(&(store->stopping)))
+        {
+            atomic_store(&(store->committer_waiting), 0);
+            continue;
+        }
+        if(unsynced != NULL)
+        {
+            long            wait_ms = store->sync_interval_ms - (monotonic_ms() - last_sync);
+            struct timespec timeout;
+
+            timeout.tv_sec  = wait_ms > 0 ? wait_ms / 1000 : 0;
+            timeout.tv_nsec = wait_ms > 0 ? (wait_ms % 1000) * 1000000 : 0;
+            futex_wait_timeout(&(store->pending_seq), seq, &timeout);
+        }
+        else
+        {
+            futex_wait(&(store->pending_seq), seq);
+        }
+        atomic_store(&(store->committer_waiting), 0);
+    }
+    return NULL;
+}
+
+// 쌓인 목록을 통째로 가져와 들어온 순서로 뒤집는다
+static KvRecord *take_pending(KvStore *store)
+{
+    KvRecord *list     = atomic_exchange_explicit(&(store->pending), NULL, memory_order_acquire);
+    KvRecord *reversed = NULL;
+
+    while(list != NULL)
+    {
+        KvRecord *next = list->next;
+        list->next     = reversed;
+        reversed       = list;
+        list           = next;
+    }
+    return reversed;
+}
+
+// 없는 키만 테이블에 보이지 않게 올려 두고 파일에 쓴다. 쓰지 못한 쓰기는 테이블에서 빼고 result 를 -1 로 바꾸며 지표에 세지 않는다
+// 테이블은 커미터만 바꾸므로 같은 키의 쓰기는 들어온 순서대로 하나만 새 키가 된다
+static void apply_batch(KvStore *store, KvRecord *batch)
+{
+    uint64_t start   = metrics_now();
+    uint64_t records = 0;
+
+    for(KvRecord *record = batch; record != NULL; record = record->next)
+    {
+        datum k;
+        datum v;
+
+        record->result = kv_table_stage(&(store->table), record->key, record->key_len, record->value, record->value_len);
+        if(record->result != 0)
+        {
+            continue;
+        }
+        k.dptr  = (char *)record->key;
+        k.dsize = (int)record->key_len;
+        v.dptr  = (char *)record->value;
+        v.dsize = (int)record->value_len;
+        if(gdbm_store(store->writer, k, v, GDBM_REPLACE) == -1)
+        {
+            kv_table_remove(&(store->table), record->key, record->key_len);
+            record->result = -1;
+            continue;
+        }
+        records++;
+    }
+    metrics_record(METRIC_STAGE_STORE, metrics_now() - start);
+    metrics_count(METRIC_KV_RECORDS, records);
+}
+
+// 실패하면 -1. 그 사이 적용한 쓰기가 디스크에 있는지 알 수 없다
+static int sync_writer(KvStore *store)
+{
+    uint64_t start  = metrics_now();
+    int      result = gdbm_sync(store->writer);
+
+    metrics_record(METRIC_STAGE_FSYNC, metrics_now() - start);
+    return result == 0 ? 0 : -1;
+}
+
+// fsync 결과에 따라 묶음의 새 키를 공개하거나 되돌린다 (알리기 전에 해야 응답과 읽기가 어긋나지 않는다)
+// fsync 를 기다리던 같은 키의 쓰기는 앞선 쓰기와 같은 묶음에 있으므로 같은 결과를 따른다
+static void finish_batch(KvStore *store, KvRecord *batch, int synced)
+{
+    for(KvRecord *record = batch; record != NULL; record = record->next)
+    {
+        if(record->result == KV_RESULT_WAITING)
+        {
+            record->result = synced ? 1 : -1;
+        }
+        else if(record->result == 0 && synced)
+        {
+            // 공개하지 못해도 파일에는 있으므로 저장한 것이다 (다시 시작하면 보인다)
+            if(kv_table_publish(&(store->table), record->key, record->key_len) == 0)
+            {
+                atomic_fetch_add(&(store->generation), 1);
+            }
+        }
+        else if(record->result == 0)
+        {
+            datum k;
+
+            // 디스크에 내려갔는지 알 수 없으므로 파일에서도 지워 다시 시작할 때 되살아나지 않게 한다
+            k.dptr  = (char *)record->key;
+            k.dsize = (int)record->key_len;
+            gdbm_delete(store->writer, k);
+            kv_table_remove(&(store->table), record->key, record->key_len);
+            record->result = -1;
+        }
+    }
+}
+
+// 쓰기를 요청한 쪽에 알린다. callback 이 record 를 해제할 수 있으므로 next 를 먼저 읽는다
+static void ack_batch(KvRecord *batch)
+{
+    while(batch != NULL)
+    {
+        KvRecord *next = batch->next;
+        batch->callback(batch, batch->arg);
+        batch = next;
+    }
+}
+
+static long monotonic_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// 파일의 모든 레코드를 테이블에 올린다
+static int load_table(KvStore *store)
+{
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Waggregate-return"
+    datum key = gdbm_firstkey(store->writer);
+
+    while(key.dptr != NULL)
+    {
+        datum value = gdbm_fetch(store->writer, key);
+        datum next;
+
+        if(value.dptr == NULL || kv_table_insert(&(store->table), key.dptr, (size_t)key.dsize, value.dptr, (size_t)value.dsize) == -1)
+        {
+            free(value.dptr);
+            free(key.dptr);
+            return -1;
+        }
+        free(value.dptr);
+        // 삭제가 없으므로 세대는 곧 항목 수다. 다시 시작해도 이어지므로 이전 ETag 와 겹치지 않는다
+        atomic_fetch_add(&(store->generation), 1);
+        next = gdbm_nextkey(store->writer, key);
+        free(key.dptr);
+        key = next;
+    }
+#pragma GCC diagnostic pop
+    return 0;
+}
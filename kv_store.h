@@ -0,0 +1,62 @@
+#ifndef KV_STORE_H
+#define KV_STORE_H
+
+#include "kv_table.h"
+#include <gdbm.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+#define KV_BLOCK_SIZE 512    // gdbm 블록 크기
+#define KV_MODE 0666         // 새로 만들 때의 파일 권한
+
+// 쓰기를 디스크에 내리는 시점 (fsync 정책)
+#define KV_SYNC_NONE 0        // fsync 하지 않는다 (커널이 알아서 내린다)
+#define KV_SYNC_BATCH 1       // 묶음마다 fsync 한 뒤 알린다
+#define KV_SYNC_INTERVAL 2    // sync_interval_ms 마다 한 번 fsync 하고, 그때까지 쌓인 쓰기를 함께 알린다
+
+typedef struct KvRecord KvRecord;
+
+// 쓰기가 fsync 정책을 만족하면 커미터 스레드에서 호출된다
+typedef void (*KvCallback)(KvRecord *record, void *arg);
+
+// 커미터에게 넘기는 쓰기 요청 (호출한 쪽이 채우고, callback 이 불릴 때까지 그대로 둔다)
+struct KvRecord
+{
+    const char *key;
+    size_t      key_len;
+    const char *value;
+    size_t      value_len;
+    int         result;      // 저장했으면 0, 이미 있으면 1, 오류면 -1 (커미터가 정한다. 같은 키의 앞선 쓰기가 fsync 를 기다리면 그 결과를 따른다)
+    KvCallback  callback;
+    void       *arg;
+    KvRecord   *next;
+};
+
+// 서버 전체가 공유하는 키-값 저장소 구조체 정의
+// 열 때 파일 전체를 메모리 테이블에 올리고 읽기는 모두 테이블에서 한다 (디스크를 읽지 않는다)
+// 쓰기는 커미터 스레드 하나가 묶어서 파일에 쓰고, fsync 정책을 만족한 뒤에야 테이블에 공개한다 (그 전에는 읽기에 보이지 않는다)
+// 다시 시작하면 파일에서 테이블을 만들므로 기준은 여전히 파일이다
+typedef struct
+{
+    KvTable             table;
+    GDBM_FILE           writer;               // 쓰기 핸들 (연 뒤에는 커미터만 쓴다)
+    atomic_ulong        generation;           // 새 키를 공개할 때마다 증가 (읽기 API 의 ETag. 항목 수는 kv_store_count)
+    int                 sync_policy;          // KV_SYNC_*
+    int                 sync_interval_ms;     // KV_SYNC_INTERVAL 의 주기
+    _Atomic(KvRecord *) pending;              // 아직 적용하지 않은 쓰기 (최근 것이 앞)
+    atomic_uint         pending_seq;          // 커미터가 잠드는 futex
+    atomic_uint         committer_waiting;    // 커미터가 잠들어 있으면 1 (깨우는 쪽이 지운다)
+    atomic_int          stopping;
+    pthread_t           committer;
+} KvStore;
+
+int           kv_store_open(KvStore *store, const char *path, int sync_policy, int sync_interval_ms);
+void          kv_store_close(KvStore *store);
+int           kv_store_fetch(KvStore *store, const char *key, size_t key_len, Arena *arena, char **value, size_t *value_len);
+void          kv_store_insert(KvStore *store, KvRecord *record);
+size_t        kv_store_list(KvStore *store, size_t offset, size_t limit, const KvEntry **entries, size_t *total);
+unsigned long kv_store_generation(KvStore *store);
+size_t        kv_store_count(KvStore *store);
+
+#endif
@@ -0,0 +1,371 @@
+#include "kv_table.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define KV_TABLE_SHARD_BITS 6    // log2(KV_TABLE_SHARDS)
+
+static uint64_t key_hash(const char *key, size_t len);
+static KvShard *shard_for(KvTable *table, uint64_t hash);
+static size_t   slot_for(uint64_t hash, size_t mask);
+static uint32_t tag_for(uint64_t hash);
+static int      lookup_locked(const KvShard *shard, const char *key, size_t key_len, uint64_t hash, size_t *slot);
+static void     slot_clear(KvShard *shard, size_t hole);
+static int      shard_grow(KvShard *shard);
+static int      shard_alloc(KvShard *shard, size_t nslots);
+static int      order_append(KvTable *table, const KvEntry *entry);
+
+int kv_table_init(KvTable *table)
+{
+    table->order = (const KvEntry **)malloc(KV_TABLE_INITIAL_ORDER * sizeof(KvEntry *));
+    if(table->order == NULL)
+    {
+        return -1;
+    }
+    table->norder    = 0;
+    table->order_cap = KV_TABLE_INITIAL_ORDER;
+    pthread_mutex_init(&(table->order_lock), NULL);
+
+    for(int i = 0; i < KV_TABLE_SHARDS; ++i)
+    {
+        KvShard *shard = &(table->shards[i]);
+
+        shard->count = 0;
+        if(shard_alloc(shard, KV_TABLE_INITIAL_SLOTS) == -1)
+        {
+            while(--i >= 0)
+            {
+                free(table->shards[i].tags);
+                free(table->shards[i].entries);
+                pthread_rwlock_destroy(&(table->shards[i].lock));
+            }
+            pthread_mutex_destroy(&(table->order_lock));
+            free(table->order);
+            return -1;
+        }
+        pthread_rwlock_init(&(shard->lock), NULL);
+    }
+    return 0;
+}
+
+void kv_table_destroy(KvTable *table)
+{
+    for(int i = 0; i < KV_TABLE_SHARDS; ++i)
+    {
+        KvShard *shard = &(table->shards[i]);
+
+        for(size_t slot = 0; slot <= shard->mask; ++slot)
+        {
+            free(shard->entries[slot]);
+        }
+        free(shard->tags);
+        free(shard->entries);
+        pthread_rwlock_destroy(&(shard->lock));
+    }
+    pthread_mutex_destroy(&(table->order_lock));
+    free(table->order);
+}
+
+// 값을 찾으면 1 과 함께 arena 에 만든 사본을 돌려준다 (NUL 로 끝나지 않는다). 없으면 0, 메모리가 없으면 -1
+int kv_table_get(KvTable *table, const char *key, size_t key_len, Arena *arena, char **value, size_t *value_len)
+{
+    uint64_t hash  = key_hash(key, key_len);
+    KvShard *shard = shard_for(table, hash);
+    KvEntry *entry;
+    size_t   slot;
+
+    pthread_rwlock_rdlock(&(shard->lock));
+    if(!lookup_locked(shard, key, key_len, hash, &slot) || !shard->entries[slot]->published)
+    {
+        pthread_rwlock_unlock(&(shard->lock));
+        return 0;
+    }
+    entry  = shard->entries[slot];
+    *value = (char *)arena_alloc(arena, entry->value_len > 0 ? entry->value_len : 1);
+    if(*value == NULL)
+    {
+        pthread_rwlock_unlock(&(shard->lock));
+        return -1;
+    }
+    memcpy(*value, entry->data + entry->key_len, entry->value_len);
+    *value_len = entry->value_len;
+    pthread_rwlock_unlock(&(shard->lock));
+    return 1;
+}
+
+// 키가 없을 때만 키와 값을 복사해 넣고 바로 공개한다. 넣었으면 0, 이미 있으면 1, 메모리가 없으면 -1
+int kv_table_insert(KvTable *table, const char *key, size_t key_len, const char *value, size_t value_len)
+{
+    int result = kv_table_stage(table, key, key_len, value, value_len);
+
+    if(result == 0 && kv_table_publish(table, key, key_len) == -1)
+    {
+        kv_table_remove(table, key, key_len);
+        return -1;
+    }
+    return result == 2 ? 1 : result;
+}
+
+// 키가 없을 때만 키와 값을 복사해 넣되, kv_table_publish 전까지는 읽기와 목록에 보이지 않게 둔다
+// 넣었으면 0, 공개한 키가 이미 있으면 1, 올려 두기만 한 키가 이미 있으면 2, 메모리가 없으면 -1
+int kv_table_stage(KvTable *table, const char *key, size_t key_len, const char *value, size_t value_len)
+{
+    uint64_t hash  = key_hash(key, key_len);
+    KvShard *shard = shard_for(table, hash);
+    KvEntry *entry;
+    size_t   slot;
+
+    // 락 밖에서 만들어 두어 쓰기 락을 잡는 시간을 줄인다
+    entry = (KvEntry *)malloc(sizeof(KvEntry) + key_len + value_len);
+    if(entry == NULL)
+    {
+        return -1;
+    }
+    entry->hash      = hash;
+    entry->key_len   = key_len;
+    entry->value_len = value_len;
+    entry->published = 0;
+    memcpy(entry->data, key, key_len);
+    memcpy(entry->data + key_len, value, value_len);
+
+    pthread_rwlock_wrlock(&(shard->lock));
+    if(lookup_locked(shard, key, key_len, hash, &slot))
+    {
+        int published = shard->entries[slot]->published;
+
+        pthread_rwlock_unlock(&(shard->lock));
+        free(entry);
+        return published ? 1 : 2;
+    }
+    // 사용률을 3/4 아래로 유지해야 탐사가 짧다
+    if((shard->count + 1) * 4 > (shard->mask + 1) * 3)
+    {
+        if(shard_grow(shard) == -1)
+        {
+            pthread_rwlock_unlock(&(shard->lock));
+            free(entry);
+            return -1;
+        }
+        lookup_locked(shard, key, key_len, hash, &slot);
+    }
+    shard->tags[slot]    = tag_for(hash);
+    shard->entries[slot] = entry;
+    shard->count++;
+    pthread_rwlock_unlock(&(shard->lock));
+    return 0;
+}
+
+// 올려 둔 항목을 읽기와 목록에 보이게 한다. 목록을 늘리지 못하면 -1 (항목은 계속 보이지 않는다)
+int kv_table_publish(KvTable *table, const char *key, size_t key_len)
+{
+    uint64_t hash   = key_hash(key, key_len);
+    KvShard *shard  = shard_for(table, hash);
+    int      result = 0;
+    size_t   slot;
+
+    pthread_rwlock_wrlock(&(shard->lock));
+    if(lookup_locked(shard, key, key_len, hash, &slot) && !shard->entries[slot]->published)
+    {
+        // 샤드 락을 잡은 채로 순서 목록에 올려야 읽기에 보이는 항목이 목록에도 있다
+        result = order_append(table, shard->entries[slot]);
+        if(result == 0)
+        {
+            shard->entries[slot]->published = 1;
+        }
+    }
+    pthread_rwlock_unlock(&(shard->lock));
+    return result;
+}
+
+// 올려 두기만 한 항목을 빼고 해제한다. 공개한 항목은 목록이 가리키고 있으므로 빼지 않는다
+void kv_table_remove(KvTable *table, const char *key, size_t key_len)
+{
+    uint64_t hash  = key_hash(key, key_len);
+    KvShard *shard = shard_for(table, hash);
+    KvEntry *entry = NULL;
+    size_t   slot;
+
+    pthread_rwlock_wrlock(&(shard->lock));
+    if(lookup_locked(shard, key, key_len, hash, &slot) && !shard->entries[slot]->published)
+    {
+        entry = shard->entries[slot];
+        slot_clear(shard, slot);
+        shard->count--;
+    }
+    pthread_rwlock_unlock(&(shard->lock));
+    free(entry);
+}
+
+// 넣은 순서로 offset 번째부터 최대 limit 개의 항목을 entries 에 담고 그 수를 돌려준다. total 은 전체 항목 수
+// 항목은 복사하지 않는다 (테이블을 없앨 때까지 그대로 있다)
+size_t kv_table_list(KvTable *table, size_t offset, size_t limit, const KvEntry **entries, size_t *total)
+{
+    size_t n = 0;
+
+    pthread_mutex_lock(&(table->order_lock));
+    *total = table->norder;
+    if(offset < table->norder)
+    {
+        n = table->norder - offset < limit ? table->norder - offset : limit;
+        memcpy(entries, table->order + offset, n * sizeof(KvEntry *));
+    }
+    pthread_mutex_unlock(&(table->order_lock));
+    return n;
+}
+
+// 공개한 항목 수 (올려 두기만 한 항목은 세지 않는다)
+size_t kv_table_count(KvTable *table)
+{
+    size_t count;
+
+    pthread_mutex_lock(&(table->order_lock));
+    count = table->norder;
+    pthread_mutex_unlock(&(table->order_lock));
+    return count;
+}
+
+// FNV-1a 64 비트에 마무리 섞기를 더해 하위 비트도 고르게 만든다
+static uint64_t key_hash(const char *key, size_t len)
+{
+    uint64_t hash = 14695981039346656037ULL;
+
+    for(size_t i = 0; i < len; ++i)
+    {
+        hash ^= (unsigned char)key[i];
+        hash *= 1099511628211ULL;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// 하위 비트로 샤드를, 그 위 비트로 슬롯을, 상위 32 비트로 태그를 정한다
+static KvShard *shard_for(KvTable *table, uint64_t hash)
+{
+    return &(table->shards[hash & (KV_TABLE_SHARDS - 1)]);
+}
+
+static size_t slot_for(uint64_t hash, size_t mask)
+{
+    return (size_t)(hash >> KV_TABLE_SHARD_BITS) & mask;
+}
+
+static uint32_t tag_for(uint64_t hash)
+{
+    return (uint32_t)(hash >> 32) | 1U;
+}
+
+// 키가 있으면 1 과 그 슬롯을, 없으면 0 과 넣을 빈 슬롯을 돌려준다
+static int lookup_locked(const KvShard *shard, const char *key, size_t key_len, uint64_t hash, size_t *slot)
+{
+    uint32_t tag = tag_for(hash);
+    size_t   i   = slot_for(hash, shard->mask);
+
+    while(shard->tags[i] != 0)
+    {
+        if(shard->tags[i] == tag)
+        {
+            const KvEntry *entry = shard->entries[i];
+            if(entry->hash == hash && entry->key_len == key_len && memcmp(entry->data, key, key_len) == 0)
+            {
+                *slot = i;
+                return 1;
+            }
+        }
+        i = (i + 1) & shard->mask;
+    }
+    *slot = i;
+    return 0;
+}
+
+// 슬롯을 비운다. 삭제 표시를 남기지 않도록 뒤따르는 항목 중 제자리에서 이 빈칸을 지나와야 닿는 것을 당겨 채운다
+static void slot_clear(KvShard *shard, size_t hole)
+{
+    size_t i = hole;
+
+    while(1)
+    {
+        size_t home;
+
+        i = (i + 1) & shard->mask;
+        if(shard->tags[i] == 0)
+        {
+            break;
+        }
+        home = slot_for(shard->entries[i]->hash, shard->mask);
+        if(((i - home) & shard->mask) >= ((i - hole) & shard->mask))
+        {
+            shard->tags[hole]    = shard->tags[i];
+            shard->entries[hole] = shard->entries[i];
+            hole                 = i;
+        }
+    }
+    shard->tags[hole]    = 0;
+    shard->entries[hole] = NULL;
+}
+
+// 슬롯 수를 두 배로 늘리고 저장해 둔 해시로 다시 배치한다 (키를 다시 해시하지 않는다)
+static int shard_grow(KvShard *shard)
+{
+    uint32_t *old_tags    = shard->tags;
+    KvEntry **old_entries = shard->entries;
+    size_t    old_slots   = shard->mask + 1;
+
+    if(shard_alloc(shard, old_slots * 2) == -1)
+    {
+        shard->tags    = old_tags;
+        shard->entries = old_entries;
+        shard->mask    = old_slots - 1;
+        return -1;
+    }
+    for(size_t slot = 0; slot < old_slots; ++slot)
+    {
+        if(old_tags[slot] != 0)
+        {
+            size_t i = slot_for(old_entries[slot]->hash, shard->mask);
+            while(shard->tags[i] != 0)
+            {
+                i = (i + 1) & shard->mask;
+            }
+            shard->tags[i]    = old_tags[slot];
+            shard->entries[i] = old_entries[slot];
+        }
+    }
+    free(old_tags);
+    free(old_entries);
+    return 0;
+}
+
+static int shard_alloc(KvShard *shard, size_t nslots)
+{
+    shard->tags    = (uint32_t *)aligned_alloc(CACHE_LINE, nslots * sizeof(uint32_t));
+    shard->entries = (KvEntry **)calloc(nslots, sizeof(KvEntry *));
+    if(shard->tags == NULL || shard->entries == NULL)
+    {
+        free(shard->tags);
+        free(shard->entries);
+        return -1;
+    }
+    memset(shard->tags, 0, nslots * sizeof(uint32_t));
+    shard->mask = nslots - 1;
+    return 0;
+}
+
+static int order_append(KvTable *table, const KvEntry *entry)
+{
+    pthread_mutex_lock(&(table->order_lock));
+    if(table->norder == table->order_cap)
+    {
+        const KvEntry **order = (const KvEntry **)realloc(table->order, table->order_cap * 2 * sizeof(KvEntry *));
+        if(order == NULL)
+        {
+            pthread_mutex_unlock(&(table->order_lock));
+            return -1;
+        }
+        table->order = order;
+        table->order_cap *= 2;
+    }
+    table->order[table->norder++] = entry;
+    pthread_mutex_unlock(&(table->order_lock));
+    return 0;
+}
@@ -0,0 +1,59 @@
+#ifndef KV_TABLE_H
+#define KV_TABLE_H
+
+#include "arena.h"
+#include "idle_set.h"    // CACHE_LINE
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define KV_TABLE_SHARDS 64           // 샤드 수 (2의 거듭제곱)
+#define KV_TABLE_INITIAL_SLOTS 64    // 샤드당 처음 슬롯 수 (2의 거듭제곱)
+#define KV_TABLE_INITIAL_ORDER 1024  // 넣은 순서 목록의 처음 크기
+
+// 키와 값을 한 번에 할당한다 (data 에 키, 바로 뒤에 값)
+// 공개한 항목은 테이블을 없앨 때까지 바뀌지도 해제되지도 않는다. 올려 두기만 한 항목은 kv_table_remove 로 뺄 수 있다
+typedef struct
+{
+    uint64_t hash;
+    size_t   key_len;
+    size_t   value_len;
+    int      published;    // 읽기와 목록에 보인다 (샤드 락 아래에서 바꾼다)
+    char     data[];
+} KvEntry;
+
+// 샤드 하나: 선형 탐사 open addressing
+// 탐사는 tags 만 훑고 태그가 같을 때만 항목을 따라간다 (캐시 라인 하나에 슬롯 16개)
+typedef struct
+{
+    _Alignas(CACHE_LINE) pthread_rwlock_t lock;
+    uint32_t *tags;       // 0 이면 빈 슬롯, 아니면 해시 일부 (최하위 비트는 항상 1)
+    KvEntry **entries;
+    size_t    mask;       // 슬롯 수 - 1
+    size_t    count;
+} KvShard;
+
+// 메모리 키-값 테이블 구조체 정의
+// 샤드마다 rwlock 을 따로 두어 다른 키를 읽고 쓰는 워커끼리 부딪히지 않는다
+// 항목은 먼저 보이지 않게 올려 두고 (kv_table_stage) 나중에 공개하거나 (kv_table_publish) 뺀다 (kv_table_remove)
+// 페이지 단위 목록 조회를 위해 넣은 순서도 따로 기록한다 (페이지가 바뀌어도 순서가 같다)
+typedef struct
+{
+    KvShard          shards[KV_TABLE_SHARDS];
+    _Alignas(CACHE_LINE) pthread_mutex_t order_lock;
+    const KvEntry  **order;    // 넣은 순서
+    size_t           norder;
+    size_t           order_cap;
+} KvTable;
+
+int    kv_table_init(KvTable *table);
+void   kv_table_destroy(KvTable *table);
+int    kv_table_get(KvTable *table, const char *key, size_t key_len, Arena *arena, char **value, size_t *value_len);
+int    kv_table_insert(KvTable *table, const char *key, size_t key_len, const char *value, size_t value_len);
+int    kv_table_stage(KvTable *table, const char *key, size_t key_len, const char *value, size_t value_len);
+int    kv_table_publish(KvTable *table, const char *key, size_t key_len);
+void   kv_table_remove(KvTable *table, const char *key, size_t key_len);
+size_t kv_table_list(KvTable *table, size_t offset, size_t limit, const KvEntry **entries, size_t *total);
+size_t kv_table_count(KvTable *table);
+
+#endif
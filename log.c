@@ -0,0 +1,271 @@
+#include "log.h"
+#include "futex.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#define LOG_OUT_SIZE (64 * 1024)    // 기록 스레드가 write 한 번에 내보내는 최대 크기
+
+int log_level = LOG_OFF;
+
+static const char *const level_names[] = {"ERROR", "WARN", "INFO", "DEBUG"};
+
+static _Atomic(LogRing *)     rings;          // 등록된 링 (최근 것이 앞)
+static _Thread_local LogRing *thread_ring;    // 이 스레드의 링
+static int                    log_fd = -1;
+static pthread_t              writer;
+static atomic_uint            writer_seq;     // 기록 스레드가 잠드는 futex (log_close 가 바꾼다)
+static atomic_int             stopping;
+
+static LogRing *ring_register(void);
+static void    *writer_function(void *arg);
+static int      drain_ring(LogRing *ring, char *out, size_t *out_len);
+static size_t   format_line(char *out, const struct timespec *time, int level, const char *text, size_t len);
+static void     flush_out(const char *out, size_t *out_len);
+
+// path 가 NULL 이면 표준 출력에 쓴다. level 이 LOG_OFF 면 스레드를 만들지 않는다
+int log_open(const char *path, int level)
+{
+    if(level == LOG_OFF)
+    {
+        return 0;
+    }
+    log_fd = path == NULL ? STDOUT_FILENO : open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if(log_fd == -1)
+    {
+        return -1;
+    }
+    atomic_init(&writer_seq, 0);
+    atomic_init(&stopping, 0);
+    if(pthread_create(&writer, NULL, writer_function, NULL) != 0)
+    {
+        if(path != NULL)
+        {
+            close(log_fd);
+        }
+        log_fd = -1;
+        return -1;
+    }
+    log_level = level;
+    return 0;
+}
+
+// 모든 스레드가 로그 쓰기를 마친 뒤 (스레드 풀과 커미터를 멈춘 뒤) 불러야 한다. 남은 줄을 모두 내보낸다
+void log_close(void)
+{
+    LogRing *ring;
+
+    if(log_fd == -1)
+    {
+        return;
+    }
+    atomic_store(&stopping, 1);
+    atomic_fetch_add(&writer_seq, 1);
+    futex_wake(&writer_seq, 1);
+    pthread_join(writer, NULL);
+
+    ring = atomic_load(&rings);
+    while(ring != NULL)
+    {
+        LogRing *next = ring->next;
+        free(ring);
+        ring = next;
+    }
+    atomic_store(&rings, NULL);
+    if(log_fd != STDOUT_FILENO)
+    {
+        close(log_fd);
+    }
+    log_fd    = -1;
+    log_level = LOG_OFF;
+}
+
+// "error", "warn", "info", "debug", "off". 모르는 이름이면 -2
+int log_parse_level(const char *name)
+{
+    if(strcmp(name, "off") == 0)
+    {
+        return LOG_OFF;
+    }
+    for(int i = 0; i <= LOG_DEBUG; ++i)
+    {
+        if(strcasecmp(name, level_names[i]) == 0)
+        {
+            return i;
+        }
+    }
+    return -2;
+}
+
+// 호출한 스레드의 링에 한 줄을 넣는다. 락도 시스템 콜도 없고, 링이 가득 차면 기다리지 않고 버린다
+void log_write(int level, const char *format, ...)
+{
+    LogRing *ring  = thread_ring;
+    int      saved = errno;    // %m 이 쓸 errno 를 링을 만들기 전에 남겨 둔다
+    LogLine *line;
+    size_t   head;
+    va_list  args;
+    int      n;
+
+    if(ring == NULL)
+    {
+        ring = ring_register();
+        if(ring == NULL)
+        {
+            return;
+        }
+    }
+    head = atomic_load_explicit(&(ring->head), memory_order_relaxed);
+    if(head - atomic_load_explicit(&(ring->tail), memory_order_acquire) == LOG_RING_SLOTS)
+    {
+        atomic_fetch_add_explicit(&(ring->dropped), 1, memory_order_relaxed);
+        return;
+    }
+
+    line = &(ring->lines[head & (LOG_RING_SLOTS - 1)]);
+    errno = saved;
+    va_start(args, format);
+    n = vsnprintf(line->text, sizeof(line->text), format, args);
+    va_end(args);
+    if(n < 0)
+    {
+        return;
+    }
+    line->len   = n < (int)sizeof(line->text) ? n : (int)sizeof(line->text) - 1;
+    line->level = level;
+    clock_gettime(CLOCK_REALTIME, &(line->time));
+    atomic_store_explicit(&(ring->head), head + 1, memory_order_release);
+}
+
+// 스레드가 처음 로그를 쓸 때 링을 만들어 목록에 올린다 (스레드가 끝나도 log_close 까지 남겨 둔다)
+static LogRing *ring_register(void)
+{
+    LogRing *ring = (LogRing *)aligned_alloc(CACHE_LINE, sizeof(LogRing));
+
+    if(ring == NULL)
+    {
+        return NULL;
+    }
+    atomic_init(&(ring->head), 0);
+    atomic_init(&(ring->tail), 0);
+    atomic_init(&(ring->dropped), 0);
+    ring->reported = 0;
+    ring->next     = atomic_load(&rings);
+    while(!atomic_compare_exchange_weak(&rings, &(ring->next), ring))
+    {
+    }
+    thread_ring = ring;
+    return ring;
+}
+
+// LOG_FLUSH_MS 마다 모든 링을 비워 파일에 쓴다. 쓰는 쪽은 깨우지 않는다 (줄마다 시스템 콜을 하지 않기 위해)
+static void *writer_function(void *arg)
+{
+    char  *out     = (char *)malloc(LOG_OUT_SIZE);
+    size_t out_len = 0;
+
+    (void)arg;
+    if(out == NULL)
+    {
+        return NULL;
+    }
+    for(;;)
+    {
+        unsigned int    seq  = atomic_load(&writer_seq);
+        int             stop = atomic_load(&stopping);
+        int             more = 0;
+        struct timespec timeout;
+
+        for(LogRing *ring = atomic_load(&rings); ring != NULL; ring = ring->next)
+        {
+            more |= drain_ring(ring, out, &out_len);
+        }
+        flush_out(out, &out_len);
+        if(more)
+        {
+            continue;
+        }
+        if(stop)
+        {
+            break;
+        }
+        timeout.tv_sec  = LOG_FLUSH_MS / 1000;
+        timeout.tv_nsec = (LOG_FLUSH_MS % 1000) * 1000000L;
+        futex_wait_timeout(&writer_seq, seq, &timeout);
+    }
+    free(out);
+    return NULL;
+}
+
+// 링의 줄을 "시각 수준 내용" 형식으로 out 에 옮긴다. out 이 차서 다 옮기지 못했으면 1
+static int drain_ring(LogRing *ring, char *out, size_t *out_len)
+{
+    size_t        tail    = atomic_load_explicit(&(ring->tail), memory_order_relaxed);
+    size_t        head    = atomic_load_explicit(&(ring->head), memory_order_acquire);
+    unsigned long dropped = atomic_load_explicit(&(ring->dropped), memory_order_relaxed);
+
+    if(dropped != ring->reported && LOG_OUT_SIZE - *out_len >= LOG_LINE_SIZE + 64)
+    {
+        struct timespec now;
+        char            text[64];
+        int             len = snprintf(text, sizeof(text), "log: dropped %lu lines", dropped - ring->reported);
+
+        clock_gettime(CLOCK_REALTIME, &now);
+        *out_len += format_line(out + *out_len, &now, LOG_WARN, text, (size_t)len);
+        ring->reported = dropped;
+    }
+    for(; tail != head; ++tail)
+    {
+        const LogLine *line = &(ring->lines[tail & (LOG_RING_SLOTS - 1)]);
+
+        if(LOG_OUT_SIZE - *out_len < LOG_LINE_SIZE + 64)
+        {
+            atomic_store_explicit(&(ring->tail), tail, memory_order_release);
+            return 1;
+        }
+        *out_len += format_line(out + *out_len, &(line->time), line->level, line->text, (size_t)line->len);
+    }
+    atomic_store_explicit(&(ring->tail), tail, memory_order_release);
+    return 0;
+}
+
+// "2026-01-02T03:04:05.678901Z INFO  내용\n" 을 out 에 쓰고 길이를 돌려준다 (out 에는 LOG_LINE_SIZE + 64 바이트가 있어야 한다)
+static size_t format_line(char *out, const struct timespec *time, int level, const char *text, size_t len)
+{
+    struct tm tm;
+    size_t    n;
+
+    gmtime_r(&(time->tv_sec), &tm);
+    n = strftime(out, 32, "%Y-%m-%dT%H:%M:%S", &tm);
+    n += (size_t)snprintf(out + n, 32, ".%06ldZ %-5s ", time->tv_nsec / 1000, level_names[level]);
+    memcpy(out + n, text, len);
+    n += len;
+    out[n] = '\n';
+    return n + 1;
+}
+
+static void flush_out(const char *out, size_t *out_len)
+{
+    size_t off = 0;
+
+    while(off < *out_len)
+    {
+        ssize_t n = write(log_fd, out + off, *out_len - off);
+        if(n == -1)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            break;    // 로그를 쓸 수 없으면 버린다 (서버는 계속 돈다)
+        }
+        off += (size_t)n;
+    }
+    *out_len = 0;
+}
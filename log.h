@@ -0,0 +1,57 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include "idle_set.h"    // CACHE_LINE
+#include <stdatomic.h>
+#include <stdint.h>
+#include <time.h>
+
+#define LOG_OFF -1
+#define LOG_ERROR 0
+#define LOG_WARN 1
+#define LOG_INFO 2     // 접근 로그
+#define LOG_DEBUG 3    // 요청마다 헤더, 파일 이름, 폼 필드
+
+#define LOG_LINE_SIZE 240     // 한 줄 최대 길이 (넘으면 자른다)
+#define LOG_RING_SLOTS 1024   // 스레드당 줄 수 (2의 거듭제곱). 가득 차면 새 줄을 버린다
+#define LOG_FLUSH_MS 20       // 기록 스레드가 링을 비우는 주기
+
+// 링의 한 줄. 시각만 재 두고 문자열로 바꾸는 것은 기록 스레드가 한다
+typedef struct
+{
+    struct timespec time;
+    int             level;
+    int             len;
+    char            text[LOG_LINE_SIZE];
+} LogLine;
+
+// 스레드 하나가 쓰고 기록 스레드가 읽는 링 (single producer, single consumer)
+typedef struct LogRing
+{
+    _Alignas(CACHE_LINE) atomic_size_t head;    // 다음에 쓸 줄 (쓰는 스레드만 바꾼다)
+    _Alignas(CACHE_LINE) atomic_size_t tail;    // 다음에 읽을 줄 (기록 스레드만 바꾼다)
+    atomic_ulong    dropped;                    // 링이 가득 차서 버린 줄 수
+    unsigned long   reported;                   // 기록 스레드가 이미 알린 dropped
+    struct LogRing *next;                       // 등록된 링 목록
+    LogLine         lines[LOG_RING_SLOTS];
+} LogRing;
+
+// 최소 수준. 워커를 만들기 전에 log_open 에서 한 번 정하고 바꾸지 않는다
+extern int log_level;
+
+// 수준이 꺼져 있으면 인자를 계산하지도 않는다 (비교 한 번)
+#define LOG(level, ...)                       \
+    do                                        \
+    {                                         \
+        if((level) <= log_level)              \
+        {                                     \
+            log_write((level), __VA_ARGS__); \
+        }                                     \
+    } while(0)
+
+int  log_open(const char *path, int level);
+void log_close(void);
+int  log_parse_level(const char *name);
+void log_write(int level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+#endif
@@ -1,236 +1,400 @@
+#include "admission.h"
+#include "file_cache.h"
+#include "h2.h"
+#include "kv_store.h"
+#include "log.h"
+#include "metrics.h"
+#include "mime.h"
+#include "reactor.h"
+#include "response.h"
+#include "thread_pool.h"
 #include <arpa/inet.h>
 #include <errno.h>
 #include <fcntl.h>
-#include <ndbm.h>
+#include <limits.h>
 #include <netinet/in.h>
 #include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdnoreturn.h>    // noreturn 헤더 파일 포함
 #include <string.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
 #include <sys/types.h>
 #include <unistd.h>
 
-#define THREAD_POOL_SIZE 4     // 스레드 풀 크기
-#define TASK_QUEUE_SIZE 100    // 작업 큐 크기
 #define BUF_SIZE 9000
-#define SMALL_BUF 1024
 #define base 10
-#define DBM_MODE 0666
-#define GDBM 512
 
-#define magic1 10
-#define magic2 15
-#define magic3 30
+#define API_POSTS "api/posts"    // 저장된 POST 를 읽는 API (http_request_path 가 만든 경로 기준)
+#define API_PAGE_SIZE 50         // 목록 한 페이지의 기본 항목 수
+#define API_PAGE_MAX 1000        // 목록 한 페이지의 최대 항목 수
+#define METRICS_PATH "metrics"   // Prometheus 지표 (/metrics)
+#define POST_STORE "post.db"     // POST 저장소 파일 (문서 루트에 있다)
 
-// 작업 구조체 정의
+// handle_request 반환값: 0 연결 닫기, 1 연결 유지
+#define REQUEST_PENDING 2    // 응답을 저장이 끝난 뒤 post_committed 가 보낸다
+
+// 커미터가 저장을 마칠 때까지 미뤄 둔 POST 응답 (연결의 아레나에 있다)
 typedef struct
 {
-    void (*function)(void *);    // 작업 함수 포인터
-    void *argument;              // 작업 인자
-    int   completed;             // 작업 완료 여부 플래그
-} Task;
-
-// 스레드 풀 구조체 정의
+    KvRecord    record;       // 키와 값은 연결 버퍼를 가리킨다 (응답할 때까지 연결을 쓰지 않는다)
+    Connection *conn;
+    ThreadPool *pool;
+    const char *ct;
+    char        file_name[PATH_MAX];
+    int         keep_alive;
+    uint64_t    start;        // 워커가 요청을 받은 시각 (ns, 지표와 접근 로그)
+} PostWrite;
+
+// 검증자를 가진 응답 본문: 캐시 항목이면 body 에서, 아니면 file_fd 에서 보낸다
 typedef struct
 {
-    pthread_t       threads[THREAD_POOL_SIZE];      // 스레드 배열
-    Task            task_queue[TASK_QUEUE_SIZE];    // 작업 큐
-    int             queue_front;                    // 큐의 맨 앞 인덱스
-    int             queue_rear;                     // 큐의 맨 뒤 인덱스
-    pthread_mutex_t queue_mutex;                    // 큐에 대한 뮤텍스
-    pthread_cond_t  queue_not_empty;                // 작업이 들어올 때까지 대기하는 조건 변수
-    pthread_cond_t  queue_not_full;                 // 작업 큐가 가득 차면 대기하는 조건 변수
-    int             shutdown;                       // 스레드 풀 종료 여부
-    int             active_tasks;                   // 실행 중인 작업 수
-    pthread_mutex_t active_tasks_mutex;             // 실행 중인 작업 수에 대한 뮤텍스
-    pthread_cond_t  all_tasks_completed;            // 모든 작업이 완료될 때까지 대기하는 조건 변수
-} ThreadPool;
+    const HttpEntity *entity;
+    const char       *validators;        // entity 로 만든 ETag, Last-Modified, Accept-Ranges 헤더
+    size_t            validators_len;
+    const char       *body;              // NULL 이면 file_fd
+    int               file_fd;
+} EntityBody;
+
+// 모든 워커가 공유하는 정적 파일 캐시
+static FileCache file_cache;
+
+// 시작할 때 한 번 열어 모든 워커가 공유하는 POST 저장소
+static KvStore post_store;
+
+// 이 스레드가 마지막으로 보낸 응답의 상태 코드와 본문 크기 (접근 로그, 크기를 모르면 -1)
+static _Thread_local int   response_status;
+static _Thread_local off_t response_bytes;
 
 noreturn void  error_handling(const char *message);
 void           request_handler(void *arg);
-void           send_error(FILE *fp);
-void           send_data(FILE *fp, char *ct, char *file_name);
-const char    *content_type(const char *file);
-noreturn void *thread_function(void *arg);
-void           thread_pool_init(ThreadPool *pool);
-void           thread_pool_add_task(ThreadPool *pool, void (*function)(void *), void *argument);
-void           thread_pool_wait_all_tasks_completed(ThreadPool *pool);
-void           thread_pool_shutdown(ThreadPool *pool);
+int            serve_stream(Connection *stream, uint64_t queued);
+int            handle_request(Connection *conn, uint64_t queued);
+int            request_priority(const Connection *conn);
+int            serve_request(Connection *conn, uint64_t start);
+void           finish_request(const Connection *conn, uint64_t start);
+void           access_log(const Connection *conn, uint64_t elapsed_ns);
+int            handle_metrics(Connection *conn, ThreadPool *pool, int head_only, int keep_alive);
+int            next_request(Connection *conn, int keep_alive);
+void           send_error(Connection *conn, int status);
+int            send_response(Connection *conn, Response *res, int more);
+int            send_data(Connection *conn, const HttpRequest *req, const char *buf, const char *ct, const char *file_name, int head_only, int keep_alive);
+int            send_cached(Connection *conn, int status, const HttpRequest *req, const char *buf, const char *ct, CacheEntry *entry, int head_only, int keep_alive);
+int            send_entity(Connection *conn, int status, const HttpRequest *req, const char *buf, const char *ct, const EntityBody *body, int head_only, int keep_alive);
+int            send_entity_range(Connection *conn, const EntityBody *body, Response *res, off_t first, off_t last);
+int            open_send_file(const char *file_name, struct stat *st);
+int            send_file_range(Connection *conn, int file_fd, off_t offset, off_t len);
+int            copy_file_body(Connection *conn, int file_fd, off_t limit);
 void           test_task_function(void *arg);
-void           handle_post_request(FILE *clnt_read, int content_length, GDBM_FILE db);
+int            handle_post_request(const Connection *conn, KvStore *store, PostWrite **pending);
+void           post_stored(KvRecord *record, void *arg);
+void           post_committed(void *arg);
+int            post_respond(PostWrite *post);
+void           post_respond_stream(void *arg);
+int            handle_api(Connection *conn, const char *rest, int head_only, int keep_alive);
+int            send_json(Connection *conn, int status, const char *etag, const char *body, size_t body_len, int head_only, int keep_alive);
+long           query_number(const HttpRequest *req, const char *buf, const char *name, long fallback);
+void           json_write_string(FILE *fp, const char *str, size_t len);
+void           dispatch_request(Connection *conn, void *ctx);
+int            poll_reactor(void *ctx, int timeout_ms);
+void           wake_reactor(void *ctx);
+void           probe_port(const struct sockaddr_in *addr);
+int            open_listener(const struct sockaddr_in *addr, int cpu);
 
-// 스레드 함수
-noreturn void *thread_function(void *arg)
+int main(int argc, char *argv[])
 {
-    ThreadPool *pool = (ThreadPool *)arg;
-    Task        task;
-
-    while(1)
+    struct sockaddr_in serv_adr;
+    ThreadPool         pool;
+    Reactor           *reactors;
+
+    int                nthreads = 0;    // 0 이면 CPU affinity mask 의 CPU 수
+    int                pin      = 0;    // 1 이면 워커를 CPU 에 고정
+    int                sync_policy   = KV_SYNC_BATCH;    // POST 저장소 fsync 정책
+    int                sync_interval = 0;                // KV_SYNC_INTERVAL 주기 (ms)
+    long               max_body      = DEFAULT_MAX_BODY; // 요청 본문 최대 크기 (바이트)
+    int                level         = LOG_INFO;         // 로그 최소 수준 (INFO 면 접근 로그까지)
+    const char        *log_path      = NULL;             // NULL 이면 표준 출력
+    const char        *mime_path     = NULL;             // 기본 콘텐츠 타입 표보다 먼저 찾을 mime.types 형식 파일
+    int                backend       = REACTOR_EPOLL;    // 리액터가 소켓을 기다리는 방식
+    int                shed_target   = ADMIT_DEFAULT_TARGET_MS;    // 큐 대기 목표 (ms, 0 이면 큐 대기로 거절하지 않는다)
+    unsigned long      normal_limit  = 0;                // GET, HEAD 동시 처리 상한 (0 이면 없음)
+    unsigned long      low_limit     = 0;                // POST 동시 처리 상한 (0 이면 없음)
+    char              *end;
+    int                opt;
+
+    while((opt = getopt(argc, argv, "t:af:b:l:o:e:s:q:m:")) != -1)
     {
-        pthread_mutex_lock(&(pool->queue_mutex));
-
-        // 작업 큐가 비어있을 때까지 대기
-        while((pool->queue_front == pool->queue_rear) && !(pool->shutdown))
+        switch(opt)
         {
-            pthread_cond_wait(&(pool->queue_not_empty), &(pool->queue_mutex));
+            case 't':
+                nthreads = (int)strtol(optarg, NULL, base);
+                break;
+            case 'a':
+                pin = 1;
+                break;
+            case 'f':
+                // batch: 묶음마다, none: 하지 않음, 숫자: 그 ms 마다 fsync
+                if(strcmp(optarg, "batch") == 0)
+                {
+                    sync_policy = KV_SYNC_BATCH;
+                }
+                else if(strcmp(optarg, "none") == 0)
+                {
+                    sync_policy = KV_SYNC_NONE;
+                }
+                else
+                {
+                    sync_policy   = KV_SYNC_INTERVAL;
+                    sync_interval = (int)strtol(optarg, NULL, base);
+                    if(sync_interval <= 0)
+                    {
+                        error_handling("-f: batch, none or an interval in ms");
+                    }
+                }
+                break;
+            case 'b':
+                max_body = strtol(optarg, NULL, base);
+                if(max_body <= 0)
+                {
+                    error_handling("-b: maximum body size in bytes");
+                }
+                break;
+            case 'l':
+                level = log_parse_level(optarg);
+                if(level == -2)
+                {
+                    error_handling("-l: off, error, warn, info or debug");
+                }
+                break;
+            case 'o':
+                log_path = optarg;
+                break;
+            case 'm':
+                mime_path = optarg;
+                break;
+            case 'e':
+                // epoll 또는 io_uring (같은 요청 처리 경로를 두 방식으로 비교한다)
+                if(strcmp(optarg, "epoll") == 0)
+                {
+                    backend = REACTOR_EPOLL;
+                }
+                else if(strcmp(optarg, "uring") == 0)
+                {
+                    backend = REACTOR_URING;
+                }
+                else
+                {
+                    error_handling("-e: epoll or uring");
+                }
+                break;
+            case 's':
+                shed_target = (int)strtol(optarg, NULL, base);
+                if(shed_target < 0)
+                {
+                    error_handling("-s: queue delay target in ms (0 disables)");
+                }
+                break;
+            case 'q':
+                // <GET, HEAD 상한>:<POST 상한>
+                normal_limit = strtoul(optarg, &end, base);
+                if(*end != ':')
+                {
+                    error_handling("-q: normal:low in-flight limits (0 is unlimited)");
+                }
+                low_limit = strtoul(end + 1, NULL, base);
+                break;
+            default:
+                printf("Usage : %s [-t threads] [-a] [-f batch|none|ms] [-b max_body] [-l level] [-o log_file] [-e epoll|uring] [-s target_ms] [-q normal:low] [-m mime.types] <port>\n", argv[0]);
+                exit(EXIT_FAILURE);
         }
+    }
 
-        // 스레드 풀 종료 조건 확인
-        if(pool->shutdown)
-        {
-            pthread_mutex_unlock(&(pool->queue_mutex));
-            pthread_exit(NULL);
-        }
+    if(argc - optind != 1)
+    {
+        printf("Usage : %s [-t threads] [-a] [-f batch|none|ms] [-b max_body] [-l level] [-o log_file] [-e epoll|uring] [-s target_ms] [-q normal:low] [-m mime.types] <port>\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
 
-        // 작업 큐에서 작업 가져오기
-        task              = pool->task_queue[pool->queue_front];
-        pool->queue_front = (pool->queue_front + 1) % TASK_QUEUE_SIZE;
+    // 종료 시그널은 메인 스레드만 sigwait 로 받는다 (이후 만드는 스레드는 이 마스크를 물려받는다)
+    sigset_t stop_signals;
+    int      sig;
 
-        // 작업 큐가 비어있음을 통지
-        pthread_cond_signal(&(pool->queue_not_full));
-        pthread_mutex_unlock(&(pool->queue_mutex));
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, NULL);
 
-        // 작업 실행
-        (*(task.function))(task.argument);
+    // 끊긴 클라이언트에 쓰더라도 프로세스가 종료되지 않도록 한다
+    signal(SIGPIPE, SIG_IGN);
 
-        // 작업 완료 플래그 설정
-        pthread_mutex_lock(&(pool->active_tasks_mutex));
-        task.completed = 1;
-        pool->active_tasks--;
+    // 워커는 로그를 자기 링에 넣기만 하고, 파일에는 기록 스레드가 모아서 쓴다
+    if(log_open(log_path, level) == -1)
+    {
+        error_handling("log_open() error");
+    }
 
-        // 모든 작업이 완료됐는지 확인하고 통지
-        if(pool->active_tasks == 0)
-        {
-            pthread_cond_signal(&(pool->all_tasks_completed));
-        }
-        pthread_mutex_unlock(&(pool->active_tasks_mutex));
+    // 확장자별 콘텐츠 타입을 바꾸거나 더한다 (워커가 읽기 전에 채운다)
+    if(mime_path != NULL && mime_load(mime_path) == -1)
+    {
+        error_handling("-m: cannot load the content type file");
     }
 
-    pthread_exit(NULL);
-}
+    // 과부하 때 요청을 거절할 기준 (워커가 요청을 받기 전에 정한다)
+    admission_init(shed_target, (unsigned int)normal_limit, (unsigned int)low_limit);
 
-// 스레드 풀 초기화 함수
-void thread_pool_init(ThreadPool *pool)
-{
-    int i;
+    // 스레드 풀 초기화
+    if(thread_pool_init(&pool, nthreads, pin) == -1)
+    {
+        error_handling("thread_pool_init() error");
+    }
 
-    // 큐 인덱스 초기화
-    pool->queue_front = 0;
-    pool->queue_rear  = 0;
+    // 정적 파일 캐시 초기화 (inotify 를 쓸 수 없으면 매번 파일을 연다)
+    if(file_cache_init(&file_cache, POST_STORE) == -1)
+    {
+        LOG(LOG_WARN, "file_cache_init: %m");
+    }
 
-    // 뮤텍스 초기화
-    pthread_mutex_init(&(pool->queue_mutex), NULL);
-    pthread_cond_init(&(pool->queue_not_empty), NULL);
-    pthread_cond_init(&(pool->queue_not_full), NULL);
-    pthread_mutex_init(&(pool->active_tasks_mutex), NULL);
-    pthread_cond_init(&(pool->all_tasks_completed), NULL);
+    // POST 저장소는 요청마다 열지 않고 한 번만 연다. 쓰기는 커미터 스레드가 묶어서 디스크에 내린다
+    if(kv_store_open(&post_store, POST_STORE, sync_policy, sync_interval) == -1)
+    {
+        error_handling("kv_store_open() error");
+    }
 
-    // 스레드 풀 생성
-    for(i = 0; i < THREAD_POOL_SIZE; ++i)
+    char    *endptr;
+    long int port_num = strtol(argv[optind], &endptr, base);
+
+    if(*endptr != '\0')
     {
-        pthread_create(&(pool->threads[i]), NULL, thread_function, (void *)pool);
+        error_handling("conversion error");
     }
-}
 
-// 작업 추가 함수
-void thread_pool_add_task(ThreadPool *pool, void (*function)(void *), void *argument)
-{
-    pthread_mutex_lock(&(pool->queue_mutex));
+    // initialize server address info
+    memset(&serv_adr, 0, sizeof(serv_adr));
+    serv_adr.sin_family      = AF_INET;
+    serv_adr.sin_addr.s_addr = htonl(INADDR_ANY);
+    serv_adr.sin_port        = htons((uint16_t)port_num);
 
-    // 작업 큐가 가득 찰 때까지 대기
-    while(((pool->queue_rear + 1) % TASK_QUEUE_SIZE == pool->queue_front))
+    // 워커마다 SO_REUSEPORT 리슨 소켓과 리액터를 하나씩 두어 커널이 새 연결을 워커에 나눠 준다
+    // accept 부터 응답까지 한 워커 안에서 처리되고, 밀린 작업만 다른 워커가 훔쳐 간다
+    probe_port(&serv_adr);
+    reactors = (Reactor *)calloc((size_t)pool.nthreads, sizeof(Reactor));
+    if(reactors == NULL)
     {
-        pthread_cond_wait(&(pool->queue_not_full), &(pool->queue_mutex));
+        error_handling("calloc() error");
+    }
+    for(int i = 0; i < pool.nthreads; ++i)
+    {
+        int serv_sock = open_listener(&serv_adr, pool.workers[i].cpu);
+
+        if(backend == REACTOR_URING && reactor_init(&reactors[i], serv_sock, (size_t)max_body, REACTOR_URING, dispatch_request, &pool) == -1)
+        {
+            // io_uring 을 쓸 수 없는 커널이면 (또는 막혀 있으면) epoll 로 돈다
+            LOG(LOG_WARN, "io_uring unavailable, using epoll: %m");
+            backend = REACTOR_EPOLL;
+        }
+        if(backend == REACTOR_EPOLL && reactor_init(&reactors[i], serv_sock, (size_t)max_body, REACTOR_EPOLL, dispatch_request, &pool) == -1)
+        {
+            error_handling("reactor_init() error");
+        }
+        thread_pool_attach_loop(&pool, i, poll_reactor, wake_reactor, &reactors[i]);
     }
+    thread_pool_start(&pool);
 
-    // 작업 추가
-    pool->task_queue[pool->queue_rear].function  = function;
-    pool->task_queue[pool->queue_rear].argument  = argument;
-    pool->task_queue[pool->queue_rear].completed = 0;    // 작업이 아직 완료되지 않았음을 표시
-    pool->queue_rear                             = (pool->queue_rear + 1) % TASK_QUEUE_SIZE;
-    pool->active_tasks++;    // 실행 중인 작업 수 증가
+    // SIGINT/SIGTERM 을 받을 때까지 대기
+    sigwait(&stop_signals, &sig);
 
-    // 작업이 들어왔음을 통지
-    pthread_cond_signal(&(pool->queue_not_empty));
-    pthread_mutex_unlock(&(pool->queue_mutex));
+    // 밀린 작업을 끝내고 워커를 종료한 뒤 남은 연결을 닫는다
+    thread_pool_shutdown(&pool);
+    for(int i = 0; i < pool.nthreads; ++i)
+    {
+        reactor_close(&reactors[i]);
+        close(reactors[i].listen_fd);
+    }
+    free(reactors);
+    file_cache_destroy(&file_cache);
+    kv_store_close(&post_store);
+    log_close();
+    metrics_destroy();
+
+    return 0;
 }
 
-// 모든 작업이 완료될 때까지 대기
-void thread_pool_wait_all_tasks_completed(ThreadPool *pool)
+// 리액터 콜백: 요청 전체가 도착한 연결을 스레드 풀에 넘긴다 (리액터를 돌리는 워커의 덱에 들어간다)
+void dispatch_request(Connection *conn, void *ctx)
 {
-    pthread_mutex_lock(&(pool->active_tasks_mutex));
-    while(pool->active_tasks > 0)
-    {
-        pthread_cond_wait(&(pool->all_tasks_completed), &(pool->active_tasks_mutex));
-    }
-    pthread_mutex_unlock(&(pool->active_tasks_mutex));
+    ThreadPool *pool = (ThreadPool *)ctx;
+    conn->dispatched = metrics_now();
+    thread_pool_add_task(pool, request_handler, conn);
 }
 
-// 스레드 풀 종료 함수
-void thread_pool_shutdown(ThreadPool *pool)
+// 워커 이벤트 루프 콜백
+int poll_reactor(void *ctx, int timeout_ms)
 {
-    int i;
+    return reactor_poll((Reactor *)ctx, timeout_ms);
+}
 
-    // 스레드 풀 종료 플래그 설정
-    pool->shutdown = 1;
+void wake_reactor(void *ctx)
+{
+    reactor_wake((Reactor *)ctx);
+}
 
-    // 작업이 들어왔음을 통지
-    pthread_cond_broadcast(&(pool->queue_not_empty));
+// 포트를 이미 쓰는 서버가 있으면 시작하지 않는다
+// SO_REUSEPORT 소켓끼리는 같은 사용자의 다른 프로세스와도 포트를 나눠 가지므로 (커널이 연결을 둘에 나눈다)
+// 워커의 리슨 소켓을 만들기 전에 SO_REUSEPORT 없이 bind 해 보고 바로 닫는다
+void probe_port(const struct sockaddr_in *addr)
+{
+    int probe;
+    int on = 1;
 
-    // 스레드 조인
-    for(i = 0; i < THREAD_POOL_SIZE; ++i)
+    probe = socket(PF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(probe == -1)
     {
-        pthread_join(pool->threads[i], NULL);
+        error_handling("socket() error");
     }
-
-    // 뮤텍스 및 조건 변수 해제
-    pthread_mutex_destroy(&(pool->queue_mutex));
-    pthread_cond_destroy(&(pool->queue_not_empty));
-    pthread_cond_destroy(&(pool->queue_not_full));
-    pthread_mutex_destroy(&(pool->active_tasks_mutex));
-    pthread_cond_destroy(&(pool->all_tasks_completed));
+    // TIME_WAIT 연결이 남아 있어도 다시 시작할 수 있어야 한다
+    if(setsockopt(probe, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) == -1)
+    {
+        error_handling("setsockopt() error");
+    }
+    if(bind(probe, (const struct sockaddr *)addr, sizeof(*addr)) == -1)
+    {
+        error_handling("bind");
+    }
+    close(probe);
 }
 
-int main(int argc, char *argv[])
+// 같은 포트에 여러 개 bind 할 수 있는 논블로킹 리슨 소켓을 만든다
+// cpu 가 0 이상이면 그 CPU 에서 처리된 연결을 이 소켓으로 보내 달라고 커널에 알린다
+int open_listener(const struct sockaddr_in *addr, int cpu)
 {
-    int                serv_sock;
-    int                clnt_sock;
-    struct sockaddr_in serv_adr;
-    struct sockaddr_in clnt_adr;
-    socklen_t          clnt_adr_size;
-    ThreadPool         pool;
-
-    // 스레드 풀 초기화
-    thread_pool_init(&pool);
+    int serv_sock;
+    int on = 1;
 
-    if(argc != 2)
+    // create tcp socket (edge-triggered epoll 을 위해 논블로킹)
+    serv_sock = socket(PF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(serv_sock == -1)
     {
-        printf("Usage : %s <port>\n", argv[0]);
-        exit(EXIT_FAILURE);
+        error_handling("socket() error");
     }
-
-    // create tcp socket
-    serv_sock = socket(PF_INET, SOCK_STREAM, 0);
-
-    char    *endptr;
-    long int port_num = strtol(argv[1], &endptr, base);
-
-    if(*endptr != '\0')
+    if(setsockopt(serv_sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) == -1 || setsockopt(serv_sock, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) == -1)
     {
-        error_handling("conversion error");
+        error_handling("setsockopt() error");
     }
-
-    serv_adr.sin_port = htons((uint16_t)port_num);
-    // initialize server address info
-    memset(&serv_adr, 0, sizeof(serv_adr));
-    serv_adr.sin_family      = AF_INET;
-    serv_adr.sin_addr.s_addr = htonl(INADDR_ANY);
-    serv_adr.sin_port        = htons((uint16_t)port_num);
+#ifdef SO_INCOMING_CPU
+    if(cpu >= 0)
+    {
+        setsockopt(serv_sock, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu));
+    }
+#else
+    (void)cpu;
+#endif
 
     // allocate the address
-    if(bind(serv_sock, (struct sockaddr *)&serv_adr, sizeof(serv_adr)) == -1)
+    if(bind(serv_sock, (const struct sockaddr *)addr, sizeof(*addr)) == -1)
     {
         error_handling("bind");
     }
@@ -240,26 +404,7 @@ int main(int argc, char *argv[])
     {
         error_handling("listen() error");
     }
-
-    while(1)
-    {
-        clnt_adr_size = sizeof(clnt_adr);
-        clnt_sock     = accept(serv_sock, (struct sockaddr *)&clnt_adr, &clnt_adr_size);
-        char client_ip[INET_ADDRSTRLEN];
-
-        inet_ntop(AF_INET, &(clnt_adr.sin_addr), client_ip, INET_ADDRSTRLEN);
-        printf("Connection Request: %s\n", client_ip);
-
-        thread_pool_add_task(&pool, request_handler, &clnt_sock);
-    }
-    // 모든 작업이 완료될 때까지 대기
-    thread_pool_wait_all_tasks_completed(&pool);
-
-    // 스레드 풀 종료
-    thread_pool_shutdown(&pool);
-
-    close(serv_sock);
-    return 0;
+    return serv_sock;
 }
 
 noreturn void error_handling(const char *message)
@@ -276,333 +421,974 @@ void test_task_function(void *arg)
     printf("Task with argument: %d\n", *num);
 }
 
+// 한 연결에서 파이프라인으로 들어온 요청을 순서대로 처리한다
 void request_handler(void *arg)
 {
-    int clnt_sock = *((int *)arg);
+    Connection *conn   = (Connection *)arg;
+    uint64_t    queued = 0;
+    int         result;
+    int         h2;
 
-    char  req_line[SMALL_BUF];
-    char  req_contents[SMALL_BUF];
-    FILE *clnt_read;
-    FILE *clnt_write;
-
-    char method[magic1];
-    char ct[magic2];
-    char file_name[magic3];
-
-    clnt_read  = fdopen(clnt_sock, "r");
-    clnt_write = fdopen(fcntl(clnt_sock, F_DUPFD_CLOEXEC, 0), "w");
-
-    // Read the first line of the request
-    fgets(req_line, SMALL_BUF, clnt_read);
-
-    int content_length = 0;
-    while(fgets(req_contents, SMALL_BUF, clnt_read) != NULL)
+    if(conn->dispatched != 0)
+    {
+        queued = metrics_now() - conn->dispatched;
+        metrics_record(METRIC_STAGE_QUEUE, queued);
+        conn->dispatched = 0;
+    }
+    do
     {
-        if(strcmp(req_contents, "\r\n") == 0 || strcmp(req_contents, "\n") == 0)
+        // HTTP/2 연결이면 (서문으로 시작했거나 h2c 업그레이드 요청) 세션이 스트림마다 serve_stream 을 부른다
+        h2 = conn->h2 != NULL ? 1 : h2_start(conn, serve_stream);
+        if(h2 != 0)
         {
-            break;
+            if(h2 == 1)
+            {
+                h2_session_run(conn, queued);
+            }
+            else
+            {
+                connection_finish(conn);
+            }
+            return;
         }
-        // Find the Content-Length header
-        if(strstr(req_contents, "Content-Length:") != NULL)
+
+        // 큐를 거친 것은 첫 요청뿐이다 (파이프라인으로 이어진 요청은 queued 0)
+        result = handle_request(conn, queued);
+        queued = 0;
+        if(result == REQUEST_PENDING)
         {
-            char *endptr;
-            content_length = (int)strtol(req_contents + strlen("Content-Length:"), &endptr, base);
+            // 저장이 끝나면 post_committed 가 응답하고 이어서 처리한다
+            return;
         }
-    }
+    } while(next_request(conn, result));
+}
 
-    printf("Content-Length: %d\n", content_length);
+// HTTP/2 세션 콜백: 스트림의 요청 하나에 응답한다 (연결 유지 여부는 세션이 정한다)
+// 같은 프레임 묶음으로 온 스트림은 모두 그 묶음이 큐에서 기다린 시간으로 받을지 정한다 (파이프라인의 첫 요청과 같다)
+// 저장을 기다리는 POST 면 1 을 돌려주고, 응답은 post_committed 가 세션에 넘긴다
+int serve_stream(Connection *stream, uint64_t queued)
+{
+    return handle_request(stream, queued) == REQUEST_PENDING;
+}
 
-    if(strstr(req_line, "HTTP/") == NULL)
+// 응답을 마친 연결의 다음 요청을 준비한다. 버퍼에 다음 요청이 이미 와 있으면 1
+int next_request(Connection *conn, int keep_alive)
+{
+    if(!keep_alive)
+    {
+        connection_finish(conn);
+        return 0;
+    }
+    connection_consume(conn);
+    if(connection_request_ready(conn) == 1)
     {
-        send_error(clnt_write);
+        return 1;
     }
 
-    // Extract method using strtok_r
-    char *saveptr;
-    char *token = strtok_r(req_line, " /", &saveptr);
-    if(token != NULL)
+    // 다음 요청은 리액터가 다시 기다린다
+    connection_resume(conn);
+    return 0;
+}
+
+// 요청 하나에 응답하고 지표와 접근 로그를 남긴다 (저장을 기다리는 POST 는 post_committed 가 남긴다)
+// 과부하면 처리하지 않고 바로 503 과 Retry-After 를 보내고 연결을 닫는다 (queued 는 워커 큐에서 기다린 시간)
+int handle_request(Connection *conn, uint64_t queued)
+{
+    uint64_t start = metrics_now();
+    int      result;
+
+    connection_send_begin(conn);
+    conn->priority = request_priority(conn);
+    if(admission_enter(conn->priority, queued, start))
     {
-        strcpy(method, token);
+        result = serve_request(conn, start);
     }
     else
     {
-        send_error(clnt_write);
+        conn->priority = -1;
+        send_error(conn, 503);
+        result = 0;
     }
+    if(result != REQUEST_PENDING)
+    {
+        finish_request(conn, start);
+    }
+    return result;
+}
+
+// 응답을 보낸 뒤 처리 시간, 상태, 본문 크기를 기록한다
+void finish_request(const Connection *conn, uint64_t start)
+{
+    uint64_t elapsed = metrics_now() - start;
 
-    if(strcmp(method, "GET") != 0 && strcmp(method, "HEAD") != 0 && strcmp(method, "POST") != 0)
+    if(conn->priority >= 0)
     {
-        send_error(clnt_write);
+        admission_leave(conn->priority);
     }
+    metrics_record(METRIC_STAGE_SERVICE, elapsed);
+    metrics_response(response_status, (long long)response_bytes);
+    access_log(conn, elapsed);
+}
 
-    printf("method 값: %s\n", method);
+// /metrics 와 오류 응답은 과부하에도 받고, POST 는 저장을 기다리므로 먼저 거절한다
+int request_priority(const Connection *conn)
+{
+    Slice method;
 
-    // Extract file name using strtok_r
-    token = strtok_r(NULL, " /", &saveptr);
-    if(token != NULL)
+    if(conn->req.state == HTTP_STATE_ERROR || http_slice_equals(http_slice(conn->buf, conn->req.target), "/" METRICS_PATH))
     {
-        // 파일 이름을 가져옵니다.
-        strcpy(file_name, token);
+        return ADMIT_CRITICAL;
+    }
+    method = http_slice(conn->buf, conn->req.method);
+    return http_slice_equals(method, "POST") ? ADMIT_LOW : ADMIT_NORMAL;
+}
+
+// "<주소> "<요청 줄>" <상태> <본문 크기> <처리 시간>"
+void access_log(const Connection *conn, uint64_t elapsed_ns)
+{
+    const HttpRequest *req  = &(conn->req);
+    long               usec = (long)(elapsed_ns / 1000);
+    char               addr[INET_ADDRSTRLEN];
+    Slice              method;
+    Slice              target;
+
+    if(LOG_INFO > log_level)
+    {
+        return;
+    }
+    method = http_slice(conn->buf, req->method);
+    target = http_slice(conn->buf, req->target);
+    inet_ntop(AF_INET, &(conn->addr), addr, sizeof(addr));
+    if(response_bytes >= 0)
+    {
+        LOG(LOG_INFO, "%s \"%.*s %.*s\" %d %lld %ldus", addr, (int)method.len, method.ptr, (int)(target.len < 160 ? target.len : 160), target.ptr, response_status, (long long)response_bytes, usec);
     }
     else
     {
-        // 토큰이 NULL인 경우, 오류 처리를 수행합니다.
-        fprintf(stderr, "Failed to extract file name.\n");
+        LOG(LOG_INFO, "%s \"%.*s %.*s\" %d - %ldus", addr, (int)method.len, method.ptr, (int)(target.len < 160 ? target.len : 160), target.ptr, response_status, usec);
+    }
+}
 
-        // 또는 다른 오류 처리 방법을 선택하세요.
+// 요청 하나를 처리하고 연결을 유지할지 여부를 반환한다
+// 요청은 리액터가 버퍼에 모두 받아 해석해 두었으므로 conn->req 의 조각을 그대로 쓴다
+int serve_request(Connection *conn, uint64_t start)
+{
+    HttpRequest *req  = &(conn->req);
+    Slice        method;
+    const char  *ct;
+    char         file_name[PATH_MAX];
+    int          keep_alive;
+
+    if(req->state == HTTP_STATE_ERROR || http_request_path(req, conn->buf, file_name, sizeof(file_name)) == -1)
+    {
+        send_error(conn, req->state == HTTP_STATE_ERROR ? req->error : 400);
+        return 0;
+    }
+
+    method = http_slice(conn->buf, req->method);
+    if(!http_slice_equals(method, "GET") && !http_slice_equals(method, "HEAD") && !http_slice_equals(method, "POST"))
+    {
+        send_error(conn, 400);
+        return 0;
     }
+    keep_alive = req->keep_alive;
 
-    printf("File name1: %s\n", file_name);
-    // 다음 토큰을 계속해서 가져와서 파일 이름에 추가합니다.
-    while((token = strtok_r(NULL, " /", &saveptr)) != NULL)
+    LOG(LOG_DEBUG, "%.*s %s content-length %ld", (int)method.len, method.ptr, file_name, req->content_length);
+
+    // 운영용 지표
+    if(strcmp(file_name, METRICS_PATH) == 0)
     {
-        if(strcmp(token, "HTTP") == 0)
+        if(http_slice_equals(method, "POST"))
+        {
+            send_error(conn, 400);
+            keep_alive = 0;
+        }
+        else if(handle_metrics(conn, (ThreadPool *)conn->reactor->ctx, http_slice_equals(method, "HEAD"), keep_alive) == -1)
         {
-            break;    // 'http' 토큰을 발견하면 루프를 종료합니다.
+            keep_alive = 0;
         }
-        strcat(file_name, "/");
-        strcat(file_name, token);    // 다음 토큰을 파일 이름에 추가
+        return keep_alive;
     }
 
-    // 파일 이름 출력
-    printf("File name: %s\n", file_name);
+    // 저장된 POST 읽기 API (/api/posts, /api/posts/<key>)
+    if(strncmp(file_name, API_POSTS, strlen(API_POSTS)) == 0 && (file_name[strlen(API_POSTS)] == '\0' || file_name[strlen(API_POSTS)] == '/'))
+    {
+        // 읽기 전용이므로 POST 는 받지 않는다
+        if(http_slice_equals(method, "POST"))
+        {
+            send_error(conn, 400);
+            keep_alive = 0;
+        }
+        else if(handle_api(conn, file_name + strlen(API_POSTS), http_slice_equals(method, "HEAD"), keep_alive) == -1)
+        {
+            keep_alive = 0;
+        }
+        return keep_alive;
+    }
 
     // 파일 이름을 기반으로 콘텐츠 타입 결정
-    strcpy(ct, content_type(file_name));
+    ct = content_type(file_name);
 
-    if(strcmp(method, "HEAD") == 0)
+    if(http_slice_equals(method, "POST"))
     {
-        // Send the HTTP response header
-        fprintf(clnt_write, "HTTP/1.0 200 OK\r\n");
-        fprintf(clnt_write, "Server: Simple HTTP Server\r\n");
+        // Handle POST request (본문은 헤더 바로 뒤에 있고, 리액터가 받으면서 필드를 나눠 두었다)
+        PostWrite *post;
+        int        error = handle_post_request(conn, &post_store, &post);
+        if(error != 0)
+        {
+            send_error(conn, error);
+            return 0;
+        }
+        if(post != NULL)
+        {
+            // 워커는 fsync 를 기다리지 않고 다음 작업으로 넘어간다. 응답은 저장이 끝난 뒤 보낸다
+            post->conn            = conn;
+            post->pool            = (ThreadPool *)conn->reactor->ctx;
+            post->ct              = ct;
+            post->keep_alive      = keep_alive;
+            post->start           = start;
+            post->record.callback = post_stored;
+            post->record.arg      = post;
+            strcpy(post->file_name, file_name);
+
+            // 응답이 나갈 때까지 풀이 종료되지 않도록 잡아 둔다
+            thread_pool_hold(post->pool);
+            kv_store_insert(&post_store, &(post->record));
+            return REQUEST_PENDING;
+        }
+    }
 
-        // Calculate and print the content type
-        fprintf(clnt_write, "Content-Type: %s\r\n", ct);
+    // HEAD 는 헤더만 보낸다. 조건부 요청과 Range 는 send_data 가 처리한다
+    if(send_data(conn, req, conn->buf, ct, file_name, http_slice_equals(method, "HEAD"), keep_alive) == -1)
+    {
+        keep_alive = 0;
+    }
+    return keep_alive;
+}
 
-        // Print the content length
-        fprintf(clnt_write, "Content-Length: %d\r\n", content_length);
+// 모든 스레드의 지표를 합치고 스레드 풀과 저장소의 현재 상태를 더해 Prometheus 텍스트 형식으로 보낸다
+// 반환값: 연결을 계속 쓸 수 있으면 0, 닫아야 하면 -1
+int handle_metrics(Connection *conn, ThreadPool *pool, int head_only, int keep_alive)
+{
+    Response res;
+    char    *body     = NULL;
+    size_t   body_len = 0;
+    FILE    *out      = open_memstream(&body, &body_len);
+    int      result;
 
-        fprintf(clnt_write, "\r\n");    // 빈 줄로 헤더를 끝냅니다.
+    if(out == NULL)
+    {
+        send_error(conn, 500);
+        return -1;
+    }
+    metrics_write(out);
+    fputs("# HELP thread_pool_workers Worker threads.\n# TYPE thread_pool_workers gauge\n", out);
+    fprintf(out, "thread_pool_workers %d\n", pool->nthreads);
+    fputs("# HELP thread_pool_active_tasks Tasks queued or running, including POSTs waiting for the committer.\n# TYPE thread_pool_active_tasks gauge\n", out);
+    fprintf(out, "thread_pool_active_tasks %u\n", atomic_load(&(pool->active_tasks)));
+    fputs("# HELP thread_pool_queued_tasks Tasks waiting in the injection queue and worker deques.\n# TYPE thread_pool_queued_tasks gauge\n", out);
+    fprintf(out, "thread_pool_queued_tasks %zu\n", thread_pool_queued(pool));
+    fputs("# HELP http_inflight_requests Admitted requests not yet answered, by priority.\n# TYPE http_inflight_requests gauge\n", out);
+    fprintf(out, "http_inflight_requests{priority=\"critical\"} %u\n", admission_inflight(ADMIT_CRITICAL));
+    fprintf(out, "http_inflight_requests{priority=\"normal\"} %u\n", admission_inflight(ADMIT_NORMAL));
+    fprintf(out, "http_inflight_requests{priority=\"low\"} %u\n", admission_inflight(ADMIT_LOW));
+    fputs("# HELP kv_entries Keys in the post store.\n# TYPE kv_entries gauge\n", out);
+    fprintf(out, "kv_entries %zu\n", kv_store_count(&post_store));
+    if(fclose(out) == EOF)
+    {
+        free(body);
+        send_error(conn, 500);
+        return -1;
+    }
 
-        fflush(clnt_write);    // 출력 버퍼를 비웁니다.
-        fclose(clnt_read);
-        fclose(clnt_write);
-        return;
+    response_status = 200;
+    response_bytes  = head_only ? 0 : (off_t)body_len;
+    response_init(&res, 200);
+    response_printf(&res, "Content-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\nCache-Control: no-store\r\n", body_len);
+    response_end_headers(&res, keep_alive);
+    if(!head_only)
+    {
+        response_add(&res, body, body_len);
+    }
+    result = send_response(conn, &res, 0);
+    free(body);
+    return result;
+}
+
+// 저장된 POST 를 JSON 으로 돌려준다. rest 는 "" (목록) 또는 "/<key>"
+// 새 키가 들어오기 전까지는 모든 응답이 같으므로 저장소 세대를 ETag 로 쓴다
+// 확인은 세대를 한 번 읽는 것뿐이므로 주기적으로 묻는 reader.html 은 304 만 받고 테이블을 읽지 않는다
+// 반환값: 연결을 계속 쓸 수 있으면 0, 닫아야 하면 -1
+int handle_api(Connection *conn, const char *rest, int head_only, int keep_alive)
+{
+    HttpRequest *req = &(conn->req);
+    int          status;
+    char         etag[32];
+    Slice        if_none_match;
+    char        *body     = NULL;
+    size_t       body_len = 0;
+    FILE        *out;
+    int          result;
+
+    snprintf(etag, sizeof(etag), "\"%lu\"", kv_store_generation(&post_store));
+    if(http_header_find(req, conn->buf, "If-None-Match", &if_none_match) == 0 && http_etag_matches(if_none_match, etag, 1))
+    {
+        return send_json(conn, 304, etag, NULL, 0, head_only, keep_alive);
     }
-    if(strcmp(method, "POST") == 0)
+
+    out = open_memstream(&body, &body_len);
+    if(out == NULL)
     {
-        // Handle POST request
-        // Read POST data from clnt_read
-        // Process the data if needed
+        send_error(conn, 500);
+        return -1;
+    }
 
-        GDBM_FILE db;
-        char      db_file[] = "post.db";
-        db                  = gdbm_open(db_file, GDBM, GDBM_WRCREAT | GDBM_READER | GDBM_WRITER, DBM_MODE, NULL);
+    if(*rest == '\0')
+    {
+        // 목록: ?offset=N&limit=M (넣은 순서)
+        const KvEntry *entries[API_PAGE_MAX];
+        long           offset = query_number(req, conn->buf, "offset", 0);
+        long           limit  = query_number(req, conn->buf, "limit", API_PAGE_SIZE);
+        size_t         total;
+        size_t         n;
+
+        if(offset < 0 || limit < 0)
+        {
+            fclose(out);
+            free(body);
+            send_error(conn, 400);
+            return -1;
+        }
+        if(limit > API_PAGE_MAX)
+        {
+            limit = API_PAGE_MAX;
+        }
+        n = kv_store_list(&post_store, (size_t)offset, (size_t)limit, entries, &total);
 
-        if(!db)
+        fprintf(out, "{\"total\":%zu,\"offset\":%ld,\"limit\":%ld,\"items\":[", total, offset, limit);
+        for(size_t i = 0; i < n; ++i)
         {
-            fprintf(stderr, "Failed to open the database\n");
-            exit(EXIT_FAILURE);
+            fputs(i > 0 ? ",{\"key\":" : "{\"key\":", out);
+            json_write_string(out, entries[i]->data, entries[i]->key_len);
+            fputs(",\"value\":", out);
+            json_write_string(out, entries[i]->data + entries[i]->key_len, entries[i]->value_len);
+            fputc('}', out);
         }
+        fputs("]}", out);
+        status = 200;
+    }
+    else
+    {
+        // 한 항목: /<key>
+        const char *key = rest + 1;
+        char       *value;
+        size_t      value_len;
+        int         found = kv_store_fetch(&post_store, key, strlen(key), conn->arena, &value, &value_len);
 
-        //----------------------------------------------------------------
-        handle_post_request(clnt_read, content_length, db);
+        if(found == -1)
+        {
+            fclose(out);
+            free(body);
+            send_error(conn, 500);
+            return -1;
+        }
+        if(found == 1)
+        {
+            fputs("{\"key\":", out);
+            json_write_string(out, key, strlen(key));
+            fputs(",\"value\":", out);
+            json_write_string(out, value, value_len);
+            fputc('}', out);
+            status = 200;
+        }
+        else
+        {
+            fputs("{\"error\":\"not found\"}", out);
+            status = 404;
+        }
     }
 
-    send_data(clnt_write, ct, file_name);
-    fclose(clnt_read);
-    fclose(clnt_write);
+    if(fclose(out) == EOF)
+    {
+        free(body);
+        send_error(conn, 500);
+        return -1;
+    }
+    result = send_json(conn, status, etag, body, body_len, head_only, keep_alive);
+    free(body);
+    return result;
 }
 
-void send_data(FILE *fp, char *ct, char *file_name)
+// body 가 NULL 이면 본문 없는 응답 (304)
+int send_json(Connection *conn, int status, const char *etag, const char *body, size_t body_len, int head_only, int keep_alive)
 {
-    if(fp != NULL)
+    Response res;
+
+    response_status = status;
+    response_bytes  = body != NULL && !head_only ? (off_t)body_len : 0;
+    response_init(&res, status);
+    if(body != NULL)
+    {
+        response_printf(&res, "Content-Type: application/json\r\nContent-Length: %zu\r\n", body_len);
+    }
+    // 브라우저가 캐시를 쓰기 전에 항상 If-None-Match 로 다시 묻게 한다
+    response_printf(&res, "ETag: %s\r\nCache-Control: no-cache\r\n", etag);
+    response_end_headers(&res, keep_alive);
+    if(body != NULL && !head_only)
     {
-        char  protocol[] = "HTTP/1.0 200 OK\r\n";
-        char  server[]   = "Server: Simple HTTP Server\r\n";
-        char  cnt_type[SMALL_BUF];
-        char  buf[BUF_SIZE];
-        FILE *send_file;
+        response_add(&res, body, body_len);
+    }
+    return send_response(conn, &res, 0);
+}
 
-        // Send the HTTP response header
-        sprintf(cnt_type, "Content-type:%s\r\n\r\n", ct);
-        printf("File Path: %s\n", file_name);
+// 쿼리의 음이 아닌 정수 값. 없으면 fallback, 숫자가 아니거나 너무 크면 -1
+long query_number(const HttpRequest *req, const char *buf, const char *name, long fallback)
+{
+    Slice value;
+    long  result = 0;
 
-        send_file = fopen(file_name, "re");
-        if(send_file == NULL)
+    if(http_query_find(req, buf, name, &value) == -1)
+    {
+        return fallback;
+    }
+    if(value.len == 0 || value.len > 9)
+    {
+        return -1;
+    }
+    for(size_t i = 0; i < value.len; ++i)
+    {
+        if(value.ptr[i] < '0' || value.ptr[i] > '9')
         {
-            perror("fopen");    // 파일 열기 실패 시 오류 출력
-
-            send_file = fopen("404.html", "re");
-            if(send_file == NULL)
-            {
-                perror("404.html fopen");
-                send_error(fp);
-                return;
-            }
+            return -1;
         }
+        result = result * base + (value.ptr[i] - '0');
+    }
+    return result;
+}
+
+// JSON 문자열로 쓴다 (따옴표, 역슬래시, 제어 문자를 이스케이프)
+void json_write_string(FILE *fp, const char *str, size_t len)
+{
+    fputc('"', fp);
+    for(size_t i = 0; i < len; ++i)
+    {
+        unsigned char c = (unsigned char)str[i];
 
-        // header info
-        fputs(protocol, fp);
-        fputs(server, fp);
-        // fputs(cnt_len, fp); // 콘텐츠 길이는 추후 계산하여 할당
+        if(c == '"' || c == '\\')
+        {
+            fputc('\\', fp);
+            fputc(c, fp);
+        }
+        else if(c < 0x20)
+        {
+            fprintf(fp, "\\u%04x", c);
+        }
+        else
+        {
+            fputc(c, fp);
+        }
+    }
+    fputc('"', fp);
+}
 
-        fputs(cnt_type, fp);
+// 파일을 응답으로 보낸다. 일반 파일은 sendfile 로 페이지 캐시에서 소켓으로 바로 보낸다
+// req 가 있으면 조건부 요청 (If-None-Match, If-Modified-Since 등) 과 Range 를 평가한다
+// 반환값: 연결을 계속 쓸 수 있으면 0, 닫아야 하면 -1
+int send_data(Connection *conn, const HttpRequest *req, const char *buf, const char *ct, const char *file_name, int head_only, int keep_alive)
+{
+    Response    res;
+    int         status = 200;
+    int         file_fd;
+    struct stat st;
+    int         result = 0;
+    int         missing;
+    CacheEntry *entry;
+
+    // 캐시에 있으면 파일을 열지 않고 sendmsg 한 번으로 보낸다
+    entry = file_cache_acquire(&file_cache, file_name);
+    if(entry != NULL && entry->type == CACHE_BODY)
+    {
+        return send_cached(conn, status, req, buf, ct, entry, head_only, keep_alive);
+    }
+    missing = entry != NULL && entry->type == CACHE_MISSING;
+    if(entry != NULL)
+    {
+        file_cache_release(entry);
+    }
 
-        // Send the content of the requested file
-        while(fgets(buf, BUF_SIZE, send_file) != NULL)
+    // 없다고 기억해 둔 경로는 다시 열어 보지 않는다
+    file_fd = -1;
+    errno   = ENOENT;
+    if(!missing)
+    {
+        file_fd = open_send_file(file_name, &st);
+    }
+    if(file_fd == -1)
+    {
+        LOG(LOG_DEBUG, "open %s: %m", file_name);
+
+        // 404 페이지는 요청한 자원이 아니므로 조건부 요청과 Range 를 적용하지 않는다
+        status   = 404;
+        req      = NULL;
+        ct       = "text/html";
+        entry    = file_cache_acquire(&file_cache, "404.html");
+        if(entry != NULL && entry->type == CACHE_BODY)
+        {
+            return send_cached(conn, status, req, buf, ct, entry, head_only, keep_alive);
+        }
+        if(entry != NULL)
         {
-            fputs(buf, fp);
+            file_cache_release(entry);
         }
+        file_fd = open_send_file("404.html", &st);
+        if(file_fd == -1)
+        {
+            LOG(LOG_ERROR, "open 404.html: %m");
+            send_error(conn, 400);
+            return -1;
+        }
+    }
 
-        // 파일 포인터 닫기
-        fclose(send_file);
+    if(S_ISREG(st.st_mode))
+    {
+        HttpEntity entity;
+        char       validators[HTTP_ENTITY_HEADER_SIZE];
+        int        validators_len;
+        EntityBody body;
+        uint64_t   start;
+
+        http_entity_init(&entity, st.st_size, st.st_mtime);
+        validators_len = http_entity_header(&entity, validators, sizeof(validators));
+        if(validators_len == -1)
+        {
+            close(file_fd);
+            send_error(conn, 500);
+            return -1;
+        }
+        body.entity         = &entity;
+        body.validators     = validators;
+        body.validators_len = (size_t)validators_len;
+        body.body           = NULL;
+        body.file_fd        = file_fd;
+
+        start  = metrics_now();
+        result = send_entity(conn, status, req, buf, ct, &body, head_only, keep_alive);
+        metrics_record(METRIC_STAGE_SEND, metrics_now() - start);
+        close(file_fd);
+        return result;
+    }
 
-        // 출력 버퍼 비우기
-        fflush(fp);
+    // 길이를 알 수 없는 파일 (파이프, 문자 장치) 은 연결을 닫아서 본문의 끝을 알린다
+    response_status = status;
+    response_bytes  = -1;
+    response_init(&res, status);
+    response_printf(&res, "Content-Type: %s\r\n", ct);
+    response_end_headers(&res, 0);
+    if(send_response(conn, &res, !head_only) == -1)
+    {
+        close(file_fd);
+        return -1;
     }
-    else
+    if(!head_only)
     {
-        return;
+        copy_file_body(conn, file_fd, -1);
     }
+
+    // 파일 닫기
+    close(file_fd);
+    return -1;
 }
 
-void send_error(FILE *fp)
+// 캐시 항목을 보내고 반환한다
+int send_cached(Connection *conn, int status, const HttpRequest *req, const char *buf, const char *ct, CacheEntry *entry, int head_only, int keep_alive)
 {
-    char protocol[] = "HTTP/1.0 400 Bad Request\r\n";
-    char server[]   = "Server: Simple HTTP Server\r\n";
-    char cnt_len[]  = "Content-length:2048\r\n";
-    char cnt_type[] = "Content-type:text/html\r\n\r\n";
-    char content[]  = "<html><head><title>NETWORK</title></head>"
-                      "<body><font size=+5><br>Whoops, something went wrong!</font>"
-                      "</body></html>";
-
-    fputs(protocol, fp);
-    fputs(server, fp);
-    fputs(cnt_len, fp);
-    fputs(cnt_type, fp);
-    fputs(content, fp);
-    fflush(fp);
+    EntityBody body;
+    uint64_t   start;
+    int        result;
+
+    body.entity         = &(entry->entity);
+    body.validators     = entry->header;
+    body.validators_len = entry->header_len;
+    body.body           = entry->body;
+    body.file_fd        = -1;
+
+    start  = metrics_now();
+    result = send_entity(conn, status, req, buf, ct, &body, head_only, keep_alive);
+    metrics_record(METRIC_STAGE_SEND, metrics_now() - start);
+    file_cache_release(entry);
+    return result;
 }
 
-const char *content_type(const char *file)
+// 조건부 요청과 Range 를 평가해 200, 206, 304, 412, 416 중 하나로 응답한다 (status 는 조건 없이 보낼 때의 상태, 200 또는 404)
+// 캐시 항목이면 헤더와 본문 조각을 sendmsg 한 번으로 보내고, 파일이면 헤더를 MSG_MORE 로 넘긴 뒤 범위마다 sendfile 한다
+// 범위가 여러 개면 multipart/byteranges 로 보낸다 (RFC 9110 14.6)
+int send_entity(Connection *conn, int status, const HttpRequest *req, const char *buf, const char *ct, const EntityBody *body, int head_only, int keep_alive)
 {
-    const char *result = NULL;
-
-    char extension[SMALL_BUF];
-    char file_name[SMALL_BUF];
-    strcpy(file_name, file);
-    char *saveptr;                                       // saveptr 변수를 정의합니다.
-    char *token = strtok_r(file_name, ".", &saveptr);    // 첫 번째 토큰을 얻습니다.
-    if(token != NULL)
+    const HttpEntity *entity = body->entity;
+    HttpSelection     sel;
+    Response          res;
+    char              parts[HTTP_MAX_RANGES][192];    // multipart 각 부분의 머리 ("\r\n--경계\r\n...\r\n\r\n")
+    char              trailer[64];                    // multipart 의 끝 ("\r\n--경계--\r\n")
+    char              boundary[40];
+    int               part_len[HTTP_MAX_RANGES];
+    int               trailer_len = 0;
+    off_t             length      = 0;    // 본문 길이
+
+    http_conditional_evaluate(req, buf, entity, !head_only, &sel);
+    if(sel.status == 200)
     {
-        strcpy(extension, token);    // 첫 번째 토큰을 확장자로 복사합니다.
+        sel.status = status;
     }
 
-    // strtok_r() 함수의 결과를 검사하고 처리합니다.
-    token = strtok_r(NULL, ".", &saveptr);    // 두 번째 토큰을 얻습니다.
-    if(token != NULL)
+    response_init(&res, sel.status);
+    response_add(&res, body->validators, body->validators_len);
+
+    switch(sel.status)
     {
-        strcpy(extension, token);    // 두 번째 토큰을 확장자로 복사합니다.
+        case 206:
+            if(sel.nranges == 1)
+            {
+                length = sel.ranges[0].last - sel.ranges[0].first + 1;
+                response_printf(&res, "Content-Type: %s\r\nContent-Range: bytes %lld-%lld/%lld\r\nContent-Length: %lld\r\n", ct, (long long)sel.ranges[0].first, (long long)sel.ranges[0].last, (long long)entity->size, (long long)length);
+                break;
+            }
+            // 경계는 본문에 나오지 않을 만큼 길고 파일마다 다르게 만든다
+            snprintf(boundary, sizeof(boundary), "simple-http-%016llx", (unsigned long long)entity->mtime * 0x9e3779b97f4a7c15ULL ^ (unsigned long long)entity->size);
+            length = 0;
+            for(int i = 0; i < sel.nranges; ++i)
+            {
+                part_len[i] = snprintf(parts[i], sizeof(parts[i]), "\r\n--%s\r\nContent-Type: %s\r\nContent-Range: bytes %lld-%lld/%lld\r\n\r\n", boundary, ct, (long long)sel.ranges[i].first, (long long)sel.ranges[i].last, (long long)entity->size);
+                if(part_len[i] < 0 || (size_t)part_len[i] >= sizeof(parts[i]))
+                {
+                    return -1;
+                }
+                length += part_len[i] + sel.ranges[i].last - sel.ranges[i].first + 1;
+            }
+            trailer_len = snprintf(trailer, sizeof(trailer), "\r\n--%s--\r\n", boundary);
+            length += trailer_len;
+            response_printf(&res, "Content-Type: multipart/byteranges; boundary=%s\r\nContent-Length: %lld\r\n", boundary, (long long)length);
+            break;
+        case 304:
+            break;    // 본문도 길이도 없다
+        case 412:
+            response_printf(&res, "Content-Length: 0\r\n");
+            break;
+        case 416:
+            response_printf(&res, "Content-Range: bytes */%lld\r\nContent-Length: 0\r\n", (long long)entity->size);
+            break;
+        default:
+            length = entity->size;
+            response_printf(&res, "Content-Type: %s\r\nContent-Length: %lld\r\n", ct, (long long)length);
+            break;
     }
+    response_status = sel.status;
+    response_bytes  = head_only ? 0 : length;
+    response_end_headers(&res, keep_alive);
+    connection_send_extend(conn, (uint64_t)response_bytes);
 
-    if(strcmp(extension, "jpg") == 0 || strcmp(extension, "jpeg") == 0)
+    if(!head_only)
     {
-        result = "image/jpeg";
+        if(sel.status == 206)
+        {
+            for(int i = 0; i < sel.nranges; ++i)
+            {
+                if(sel.nranges > 1)
+                {
+                    response_add(&res, parts[i], (size_t)part_len[i]);
+                }
+                if(send_entity_range(conn, body, &res, sel.ranges[i].first, sel.ranges[i].last) == -1)
+                {
+                    return -1;
+                }
+            }
+            if(trailer_len > 0)
+            {
+                response_add(&res, trailer, (size_t)trailer_len);
+            }
+        }
+        else if(sel.status == 200 || sel.status == 404)
+        {
+            if(entity->size > 0 && send_entity_range(conn, body, &res, 0, entity->size - 1) == -1)
+            {
+                return -1;
+            }
+        }
     }
-    else if(strcmp(extension, "gif") == 0)
+    if(res.iovcnt > 0 && send_response(conn, &res, 0) == -1)
     {
-        result = "image/gif";
+        return -1;
     }
-    else if(strcmp(extension, "ico") == 0)
+    return 0;
+}
+
+// 본문의 first~last 를 보낸다. 캐시 항목이면 res 에 붙이기만 하고 (마지막에 한 번에 보낸다)
+// 파일이면 쌓인 조각을 MSG_MORE 로 먼저 넘긴 뒤 sendfile 한다 (헤더와 본문 앞부분이 한 세그먼트로 나간다)
+int send_entity_range(Connection *conn, const EntityBody *body, Response *res, off_t first, off_t last)
+{
+    if(body->body != NULL)
     {
-        result = "image/x-icon";
+        response_add(res, body->body + first, (size_t)(last - first + 1));
+        return 0;
     }
-    else
+    if(send_response(conn, res, 1) == -1)
     {
-        result = "text/html";
+        return -1;
     }
+    return send_file_range(conn, body->file_fd, first, last - first + 1);
+}
 
-    return result;
+// 보낼 파일을 연다. 일반 파일, 파이프, 문자 장치만 허용하고 디렉터리 등은 없는 파일로 취급한다
+int open_send_file(const char *file_name, struct stat *st)
+{
+    int file_fd = open(file_name, O_RDONLY | O_CLOEXEC);
+    if(file_fd == -1)
+    {
+        return -1;
+    }
+    if(fstat(file_fd, st) == -1 || !(S_ISREG(st->st_mode) || S_ISFIFO(st->st_mode) || S_ISCHR(st->st_mode)))
+    {
+        close(file_fd);
+        errno = ENOENT;
+        return -1;
+    }
+    return file_fd;
 }
 
-void handle_post_request(FILE *clnt_read, int content_length, GDBM_FILE db)
+// sendfile 로 파일의 offset 부터 len 바이트를 보낸다. 일부만 전송되면 남은 부분을 이어서 보낸다
+// HTTP/2 스트림은 DATA 프레임 머리를 끼워야 하므로 읽어서 보낸다
+int send_file_range(Connection *conn, int file_fd, off_t offset, off_t len)
 {
-    // content_length 출력
-    printf("Content Length: %d\n", content_length);
+    off_t end = offset + len;
 
-    size_t content_length_s = (size_t)content_length;
-    char  *post_data        = (char *)malloc(content_length_s + 1);
-    if(post_data == NULL)
+    if(conn->stream != NULL)
     {
-        fprintf(stderr, "Failed to allocate memory for post data\n");
-        exit(EXIT_FAILURE);
+        return h2_send_file(conn->stream, file_fd, offset, len);
     }
 
-    // 데이터 읽기
-    size_t bytes_read = fread(post_data, sizeof(char), content_length_s, clnt_read);
-    if(bytes_read != content_length_s)
+    while(offset < end)
     {
-        fprintf(stderr, "Failed to read data from client\n");
-        exit(EXIT_FAILURE);
+        ssize_t sent = sendfile(conn->fd, file_fd, &offset, (size_t)(end - offset));
+        if(sent == -1)
+        {
+            if(errno == EINTR || ((errno == EAGAIN || errno == EWOULDBLOCK) && response_wait(conn->fd, conn->send_deadline) == 0))
+            {
+                continue;
+            }
+            if(errno == EINVAL || errno == ENOSYS)
+            {
+                // sendfile 을 지원하지 않는 파일 시스템이면 복사로 대신한다
+                if(lseek(file_fd, offset, SEEK_SET) == -1)
+                {
+                    return -1;
+                }
+                return copy_file_body(conn, file_fd, end - offset);
+            }
+            LOG(LOG_DEBUG, "sendfile: %m");    // 대부분 클라이언트가 먼저 끊었거나 응답 마감 안에 다 읽지 않은 경우
+            return -1;
+        }
+        if(sent == 0)
+        {
+            return -1;    // 파일이 중간에 잘렸다
+        }
     }
-    post_data[content_length_s] = '\0';    // Null terminate the string
-    printf("Value: %s\n", post_data);
-    // post_data를 키와 값으로 분리
-    char *saveptr;
-    char *key_str = strtok_r(post_data, "&", &saveptr);
+    return 0;
+}
 
-    char *saveptr_key;
+// read/write 로 최대 limit 바이트를 복사한다 (바이너리도 그대로 보낸다). limit 이 -1 이면 파일 끝까지
+// HTTP/2 스트림은 창이 닫히면 남은 것을 나중에 읽어야 하므로 스트림에 맡긴다
+int copy_file_body(Connection *conn, int file_fd, off_t limit)
+{
+    char    buf[BUF_SIZE];
+    ssize_t n;
 
-    char *key1 = strtok_r(key_str, "=", &saveptr_key);
-    char *key2 = strtok_r(NULL, "=", &saveptr_key);
+    if(conn->stream != NULL)
+    {
+        return h2_send_file(conn->stream, file_fd, -1, limit);
+    }
+    while(limit != 0)
+    {
+        n = read(file_fd, buf, limit > 0 && limit < BUF_SIZE ? (size_t)limit : BUF_SIZE);
+        if(n == 0)
+        {
+            return limit > 0 ? -1 : 0;
+        }
+        if(n == -1)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        // 길이를 모르는 본문은 읽은 만큼씩 마감을 늦춘다
+        if(limit < 0)
+        {
+            connection_send_extend(conn, (uint64_t)n);
+        }
+        for(ssize_t written = 0; written < n;)
+        {
+            ssize_t w = write(conn->fd, buf + written, (size_t)(n - written));
+            if(w == -1)
+            {
+                if(errno == EINTR || ((errno == EAGAIN || errno == EWOULDBLOCK) && response_wait(conn->fd, conn->send_deadline) == 0))
+                {
+                    continue;
+                }
+                return -1;
+            }
+            written += w;
+        }
+        if(limit > 0)
+        {
+            limit -= n;
+        }
+    }
+    return 0;
+}
 
-    char *saveptr_value;
+// 응답 조각을 보낸다 (more 면 이어서 보낼 본문이 있다). HTTP/2 스트림이면 HEADERS 와 DATA 프레임으로 바꿔 보낸다
+int send_response(Connection *conn, Response *res, int more)
+{
+    if(conn->stream != NULL)
+    {
+        return h2_respond(conn->stream, res, more);
+    }
+    return response_send(res, conn->fd, more, conn->send_deadline);
+}
 
-    char *value_str = strtok_r(NULL, "&", &saveptr);
-    char *value1    = strtok_r(value_str, "=", &saveptr_value);
-    char *value2    = strtok_r(NULL, "=", &saveptr_value);
+void send_error(Connection *conn, int status)
+{
+    static const char content[] = "<html><head><title>NETWORK</title></head>"
+                                  "<body><font size=+5><br>Whoops, something went wrong!</font>"
+                                  "</body></html>";
+    Response          res;
+
+    response_status = status;
+    response_bytes  = (off_t)(sizeof(content) - 1);
+    response_init(&res, status);
+    response_printf(&res, "Content-Type: text/html\r\nContent-Length: %zu\r\n", sizeof(content) - 1);
+    if(status == 503)
+    {
+        response_printf(&res, "Retry-After: %d\r\n", ADMIT_RETRY_AFTER);
+    }
+    response_end_headers(&res, 0);
+    response_add(&res, content, sizeof(content) - 1);
+    send_response(conn, &res, 0);
+}
+
+// 본문의 첫 두 필드 값을 키와 값으로 쓴다 ("key=<키>&value=<값>", 디코딩하지 않고 그대로 저장한다)
+// 없는 키면 저장을 맡길 PostWrite 를 *pending 에 만든다. 반환값: 0 이면 정상 응답, 아니면 보낼 오류 상태 코드
+int handle_post_request(const Connection *conn, KvStore *store, PostWrite **pending)
+{
+    const HttpRequest *req  = &(conn->req);
+    const FormParser  *form = &(conn->form);
+    const char        *body = conn->buf + req->header_len;
 
-    printf("%sKey: %s\n", key1, key2);
-    printf("%sValue: %s\n", value1, value2);
+    *pending = NULL;
 
-    // key_str과 value_str에는 각각 "post_data_key"와 "this+is+what%3F"가 저장됩니다.
+    if(form->nfields < 2 || form->fields[0].value.len == 0 || form->fields[1].value.len == 0)
+    {
+        LOG(LOG_DEBUG, "malformed post data (%zu bytes)", req->body_len);
+        return 400;
+    }
 
-    // 키와 값 설정
-    datum key;
-    datum value;
-    datum result;
-    key.dptr    = key2;
-    key.dsize   = (int)strlen(key2);
-    value.dptr  = value2;
-    value.dsize = (int)strlen(value2);
+    Slice key_name   = http_slice(body, form->fields[0].name);
+    Slice key        = http_slice(body, form->fields[0].value);
+    Slice value_name = http_slice(body, form->fields[1].name);
+    Slice value      = http_slice(body, form->fields[1].value);
 
-    //    // 데이터베이스에 저장
-    //    if(gdbm_store(db, key, value, GDBM_INSERT) != 0)
-    //    {
-    //        fprintf(stderr, "Failed to store data in the database: %d\n", gdbm_error(db));
-    //        free(post_data);    // Free allocated memory
-    //        exit(EXIT_FAILURE);
-    //    }
+    LOG(LOG_DEBUG, "post %.*s=%.*s %.*s=%.*s", (int)key_name.len, key_name.ptr, (int)key.len, key.ptr, (int)value_name.len, value_name.ptr, (int)value.len, value.ptr);
 
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Waggregate-return"
-    result = gdbm_fetch(db, key);
-#pragma GCC diagnostic pop
-    if(result.dptr == NULL)
+    // 공유 저장소에서 먼저 읽고 (다른 워커와 동시에 읽는다) 없을 때만 저장한다
+    char  *db_value;
+    size_t db_value_len;
+    int    found = kv_store_fetch(store, key.ptr, key.len, conn->arena, &db_value, &db_value_len);
+    if(found == 0)
     {
-        printf("Key not found in the database.\n");
-
-        // 데이터베이스에 저장
-        if(gdbm_store(db, key, value, GDBM_INSERT) != 0)
+        // 데이터베이스에 저장 (커미터가 다른 워커의 쓰기와 묶어서 처리한다)
+        // 응답할 때까지 연결을 쓰지 않으므로 연결의 아레나에 둔다 (다음 요청을 받을 때 되돌린다)
+        PostWrite *post = (PostWrite *)arena_alloc(conn->arena, sizeof(PostWrite));
+        if(post == NULL)
         {
-            fprintf(stderr, "Failed to store data in the database: \n");
+            LOG(LOG_ERROR, "post: out of memory");
+            return 500;
         }
+        memset(post, 0, sizeof(*post));
+        post->record.key       = key.ptr;
+        post->record.key_len   = key.len;
+        post->record.value     = value.ptr;
+        post->record.value_len = value.len;
+        *pending               = post;
+        return 0;
     }
-    else
+    if(found == 1)
     {
-        printf("dbValue: %s\n", result.dptr);
+        LOG(LOG_DEBUG, "post %.*s already stored", (int)key.len, key.ptr);
+        return 0;
     }
-    free(post_data);    // Free allocated memory
-    // 데이터베이스 닫기
-    gdbm_close(db);
-}
\ No newline at end of file
+    LOG(LOG_ERROR, "post: failed to read the database");
+    return 500;
+}
+
+// 커미터 스레드에서 불린다. 응답은 워커에게 넘긴다
+void post_stored(KvRecord *record, void *arg)
+{
+    PostWrite *post = (PostWrite *)arg;
+
+    if(record->result == -1)
+    {
+        LOG(LOG_ERROR, "post: failed to store %.*s", (int)record->key_len, record->key);
+    }
+    thread_pool_add_task(post->pool, post_committed, post);
+}
+
+// 저장이 끝난 POST 에 응답하고 연결의 다음 요청을 이어서 처리한다
+// HTTP/2 스트림이면 소켓에는 세션을 돌리는 워커만 쓰므로 응답을 세션에 넘긴다
+void post_committed(void *arg)
+{
+    PostWrite  *post = (PostWrite *)arg;
+    Connection *conn = post->conn;
+    ThreadPool *pool = post->pool;
+
+    if(conn->stream != NULL)
+    {
+        h2_stream_resume(conn, post_respond_stream, post);
+        return;
+    }
+    if(next_request(conn, post_respond(post)))
+    {
+        request_handler(conn);
+    }
+    thread_pool_release(pool);
+}
+
+// 미뤄 둔 POST 응답을 보내고 지표를 남긴다. 반환값: 연결을 유지할지 여부
+int post_respond(PostWrite *post)
+{
+    int keep_alive = post->keep_alive;
+
+    connection_send_begin(post->conn);
+    // 저장하지 못했으면 성공 페이지 대신 500 (응답은 디스크에 내렸다는 뜻이다)
+    if(post->record.result == -1)
+    {
+        send_error(post->conn, 500);
+        keep_alive = 0;
+    }
+    // POST 의 결과 페이지는 조건부 요청으로 보지 않는다
+    else if(send_data(post->conn, NULL, NULL, post->ct, post->file_name, 0, keep_alive) == -1)
+    {
+        keep_alive = 0;
+    }
+    finish_request(post->conn, post->start);
+    return keep_alive;
+}
+
+// 세션을 돌리는 워커가 부른다 (h2_stream_resume). 응답을 보낸 뒤 스트림은 세션이 닫는다
+void post_respond_stream(void *arg)
+{
+    PostWrite  *post = (PostWrite *)arg;
+    ThreadPool *pool = post->pool;
+
+    post_respond(post);
+    thread_pool_release(pool);
+}
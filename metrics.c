@@ -0,0 +1,235 @@
+#include "metrics.h"
+#include <stdlib.h>
+
+static const char *const stage_names[METRIC_STAGES] = {"parse", "queue", "service", "send", "store", "fsync"};
+
+// Prometheus 히스토그램의 le 경계 (초). 경계에 걸친 버킷은 다음 경계로 센다 (지연을 작게 보이지 않도록)
+static const double le_bounds[] = {0.000001, 0.0000025, 0.000005, 0.00001, 0.000025, 0.00005, 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10};
+
+static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+static _Atomic(MetricsShard *)     shards;          // 등록된 샤드 (최근 것이 앞)
+static _Thread_local MetricsShard *thread_shard;    // 이 스레드의 샤드
+
+static MetricsShard *shard_get(void);
+static void          add(atomic_ullong *value, uint64_t n);
+
+void metrics_count(int counter, uint64_t n)
+{
+    MetricsShard *shard = shard_get();
+
+    if(shard != NULL)
+    {
+        add(&(shard->counters[counter]), n);
+    }
+}
+
+void metrics_record(int stage, uint64_t ns)
+{
+    MetricsShard *shard = shard_get();
+
+    if(shard != NULL)
+    {
+        add(&(shard->buckets[stage][metrics_bucket(ns)]), 1);
+        add(&(shard->sum_ns[stage]), ns);
+    }
+}
+
+// 응답 하나를 센다 (bytes 가 -1 이면 본문 크기를 모른다)
+void metrics_response(int status, long long bytes)
+{
+    MetricsShard *shard = shard_get();
+
+    if(shard == NULL)
+    {
+        return;
+    }
+    add(&(shard->counters[METRIC_REQUESTS]), 1);
+    if(status >= 200 && status < 600)
+    {
+        add(&(shard->counters[METRIC_STATUS_2XX + status / 100 - 2]), 1);
+    }
+    if(bytes > 0)
+    {
+        add(&(shard->counters[METRIC_RESPONSE_BYTES]), (uint64_t)bytes);
+    }
+}
+
+// 모든 샤드를 더해 Prometheus 텍스트 형식으로 쓴다. 기록하는 스레드를 멈추지 않으므로 값 사이가 조금 어긋날 수 있다
+void metrics_write(FILE *out)
+{
+    uint64_t counters[METRIC_COUNTERS] = {0};
+    uint64_t sum_ns[METRIC_STAGES]     = {0};
+    uint64_t(*buckets)[METRICS_BUCKETS] = (uint64_t(*)[METRICS_BUCKETS])calloc(METRIC_STAGES, sizeof(*buckets));
+
+    if(buckets == NULL)
+    {
+        return;
+    }
+    for(MetricsShard *shard = atomic_load(&shards); shard != NULL; shard = shard->next)
+    {
+        for(int i = 0; i < METRIC_COUNTERS; ++i)
+        {
+            counters[i] += atomic_load_explicit(&(shard->counters[i]), memory_order_relaxed);
+        }
+        for(int stage = 0; stage < METRIC_STAGES; ++stage)
+        {
+            sum_ns[stage] += atomic_load_explicit(&(shard->sum_ns[stage]), memory_order_relaxed);
+            for(int i = 0; i < METRICS_BUCKETS; ++i)
+            {
+                buckets[stage][i] += atomic_load_explicit(&(shard->buckets[stage][i]), memory_order_relaxed);
+            }
+        }
+    }
+
+    fputs("# HELP http_accepted_connections_total Accepted TCP connections.\n# TYPE http_accepted_connections_total counter\n", out);
+    fprintf(out, "http_accepted_connections_total %llu\n", (unsigned long long)counters[METRIC_ACCEPTS]);
+    fputs("# HELP http_requests_total Requests answered.\n# TYPE http_requests_total counter\n", out);
+    fprintf(out, "http_requests_total %llu\n", (unsigned long long)counters[METRIC_REQUESTS]);
+    fputs("# HELP http_responses_total Responses by status class.\n# TYPE http_responses_total counter\n", out);
+    for(int i = 0; i < 4; ++i)
+    {
+        fprintf(out, "http_responses_total{code=\"%dxx\"} %llu\n", i + 2, (unsigned long long)counters[METRIC_STATUS_2XX + i]);
+    }
+    fputs("# HELP http_response_body_bytes_total Response body bytes sent.\n# TYPE http_response_body_bytes_total counter\n", out);
+    fprintf(out, "http_response_body_bytes_total %llu\n", (unsigned long long)counters[METRIC_RESPONSE_BYTES]);
+    fputs("# HELP kv_committed_records_total Records written to post.db by the committer.\n# TYPE kv_committed_records_total counter\n", out);
+    fprintf(out, "kv_committed_records_total %llu\n", (unsigned long long)counters[METRIC_KV_RECORDS]);
+    fputs("# HELP http_connection_timeouts_total Connections closed by the reactor for idle, header or body timeouts.\n# TYPE http_connection_timeouts_total counter\n", out);
+    fprintf(out, "http_connection_timeouts_total %llu\n", (unsigned long long)counters[METRIC_TIMEOUTS]);
+    fputs("# HELP http_shed_requests_total Requests answered with 503 by admission control.\n# TYPE http_shed_requests_total counter\n", out);
+    fprintf(out, "http_shed_requests_total{priority=\"normal\"} %llu\n", (unsigned long long)counters[METRIC_SHED_NORMAL]);
+    fprintf(out, "http_shed_requests_total{priority=\"low\"} %llu\n", (unsigned long long)counters[METRIC_SHED_LOW]);
+    fputs("# HELP http2_connections_total Connections served over HTTP/2 (prior knowledge or h2c upgrade).\n# TYPE http2_connections_total counter\n", out);
+    fprintf(out, "http2_connections_total %llu\n", (unsigned long long)counters[METRIC_H2_CONNECTIONS]);
+    fputs("# HELP http2_streams_total Streams opened on HTTP/2 connections.\n# TYPE http2_streams_total counter\n", out);
+    fprintf(out, "http2_streams_total %llu\n", (unsigned long long)counters[METRIC_H2_STREAMS]);
+
+    fputs("# HELP http_stage_seconds Latency of each request stage.\n# TYPE http_stage_seconds histogram\n", out);
+    for(int stage = 0; stage < METRIC_STAGES; ++stage)
+    {
+        uint64_t count = 0;
+        int      i     = 0;
+
+        for(size_t b = 0; b < sizeof(le_bounds) / sizeof(le_bounds[0]); ++b)
+        {
+            uint64_t le_ns = (uint64_t)(le_bounds[b] * 1e9);
+
+            for(; i < METRICS_BUCKETS && metrics_bucket_upper(i) <= le_ns + 1; ++i)
+            {
+                count += buckets[stage][i];
+            }
+            fprintf(out, "http_stage_seconds_bucket{stage=\"%s\",le=\"%g\"} %llu\n", stage_names[stage], le_bounds[b], (unsigned long long)count);
+        }
+        for(; i < METRICS_BUCKETS; ++i)
+        {
+            count += buckets[stage][i];
+        }
+        fprintf(out, "http_stage_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %llu\n", stage_names[stage], (unsigned long long)count);
+        fprintf(out, "http_stage_seconds_sum{stage=\"%s\"} %.9f\n", stage_names[stage], (double)sum_ns[stage] / 1e9);
+        fprintf(out, "http_stage_seconds_count{stage=\"%s\"} %llu\n", stage_names[stage], (unsigned long long)count);
+    }
+
+    // 서버 쪽에서 바로 읽을 수 있도록 HDR 버킷에서 구한 분위수도 내보낸다 (버킷 상한, 상대 오차 1/8 이하)
+    fputs("# HELP http_stage_quantile_seconds Latency quantiles of each request stage since start.\n# TYPE http_stage_quantile_seconds gauge\n", out);
+    for(int stage = 0; stage < METRIC_STAGES; ++stage)
+    {
+        uint64_t count = 0;
+
+        for(int i = 0; i < METRICS_BUCKETS; ++i)
+        {
+            count += buckets[stage][i];
+        }
+        for(size_t q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); ++q)
+        {
+            uint64_t rank  = (uint64_t)(quantiles[q] * (double)count + 0.999999);
+            uint64_t seen  = 0;
+            uint64_t value = 0;
+
+            for(int i = 0; i < METRICS_BUCKETS && count > 0; ++i)
+            {
+                seen += buckets[stage][i];
+                if(seen >= rank)
+                {
+                    value = metrics_bucket_upper(i) - 1;
+                    break;
+                }
+            }
+            fprintf(out, "http_stage_quantile_seconds{stage=\"%s\",quantile=\"%g\"} %.9f\n", stage_names[stage], quantiles[q], (double)value / 1e9);
+        }
+    }
+    free(buckets);
+}
+
+// 모든 스레드가 끝난 뒤에 부른다
+void metrics_destroy(void)
+{
+    MetricsShard *shard = atomic_exchange(&shards, NULL);
+
+    while(shard != NULL)
+    {
+        MetricsShard *next = shard->next;
+        free(shard);
+        shard = next;
+    }
+}
+
+// 2^SUB_BITS 보다 작은 값은 그대로, 그 위로는 최상위 비트 위치와 그 아래 SUB_BITS 비트로 버킷을 정한다
+int metrics_bucket(uint64_t ns)
+{
+    int shift;
+
+    if(ns < (1U << METRICS_SUB_BITS))
+    {
+        return (int)ns;
+    }
+    shift = 63 - __builtin_clzll(ns) - METRICS_SUB_BITS;
+    return ((shift + 1) << METRICS_SUB_BITS) + (int)((ns >> shift) & ((1U << METRICS_SUB_BITS) - 1));
+}
+
+// 버킷에 들어가는 값의 상한 (이 값은 포함하지 않는다)
+uint64_t metrics_bucket_upper(int index)
+{
+    int      shift;
+    uint64_t mantissa;
+
+    if(index < (1 << METRICS_SUB_BITS))
+    {
+        return (uint64_t)index + 1;
+    }
+    shift = (index >> METRICS_SUB_BITS) - 1;
+    if(shift + METRICS_SUB_BITS + 1 >= 64)
+    {
+        return UINT64_MAX;
+    }
+    mantissa = (uint64_t)((index & ((1 << METRICS_SUB_BITS) - 1)) + (1 << METRICS_SUB_BITS));
+    return (mantissa + 1) << shift;
+}
+
+// 스레드가 처음 기록할 때 샤드를 만들어 목록에 올린다 (스레드가 끝나도 합계에 남도록 지우지 않는다)
+static MetricsShard *shard_get(void)
+{
+    MetricsShard *shard = thread_shard;
+
+    if(shard != NULL)
+    {
+        return shard;
+    }
+    shard = (MetricsShard *)calloc(1, sizeof(MetricsShard));
+    if(shard == NULL)
+    {
+        return NULL;
+    }
+    shard->next = atomic_load(&shards);
+    while(!atomic_compare_exchange_weak(&shards, &(shard->next), shard))
+    {
+    }
+    thread_shard = shard;
+    return shard;
+}
+
+// 쓰는 스레드가 하나뿐이므로 lock 접두어 없는 load + store 로 더한다 (읽는 쪽이 찢어진 값을 보지 않을 만큼만 원자적)
+static void add(atomic_ullong *value, uint64_t n)
+{
+    atomic_store_explicit(value, atomic_load_explicit(value, memory_order_relaxed) + n, memory_order_relaxed);
+}
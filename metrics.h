@@ -0,0 +1,65 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+// 히스토그램 버킷: 2의 거듭제곱 구간마다 2^METRICS_SUB_BITS 개로 나눈다 (상대 오차 1/8 이하, HDR 방식)
+#define METRICS_SUB_BITS 3
+#define METRICS_BUCKETS (64 << METRICS_SUB_BITS)
+
+// 지연 시간을 재는 단계
+#define METRIC_STAGE_PARSE 0      // 리액터가 받은 바이트를 해석하는 시간 (읽을 때마다)
+#define METRIC_STAGE_QUEUE 1      // 요청이 완성된 뒤 워커가 집어 갈 때까지
+#define METRIC_STAGE_SERVICE 2    // 워커가 요청을 받아 응답을 보낼 때까지 (POST 는 저장을 기다린 시간 포함)
+#define METRIC_STAGE_SEND 3       // 정적 파일 응답을 소켓에 쓰는 시간
+#define METRIC_STAGE_STORE 4      // 커미터가 한 묶음을 gdbm 에 쓰는 시간
+#define METRIC_STAGE_FSYNC 5      // 커미터의 gdbm_sync
+#define METRIC_STAGES 6
+
+// 카운터
+#define METRIC_ACCEPTS 0          // 받아들인 연결
+#define METRIC_REQUESTS 1         // 응답한 요청
+#define METRIC_STATUS_2XX 2       // 상태 코드별 응답 (2xx ~ 5xx)
+#define METRIC_STATUS_3XX 3
+#define METRIC_STATUS_4XX 4
+#define METRIC_STATUS_5XX 5
+#define METRIC_RESPONSE_BYTES 6   // 응답 본문 바이트
+#define METRIC_KV_RECORDS 7       // 커미터가 gdbm 에 쓴 레코드
+#define METRIC_TIMEOUTS 8         // 제한 시간이 지나 리액터가 닫은 연결 (유휴, 헤더, 본문)
+#define METRIC_SHED_NORMAL 9      // 과부하로 503 을 보낸 요청 (GET, HEAD)
+#define METRIC_SHED_LOW 10        // 과부하로 503 을 보낸 요청 (POST)
+#define METRIC_H2_CONNECTIONS 11  // HTTP/2 로 시작하거나 업그레이드한 연결
+#define METRIC_H2_STREAMS 12      // HTTP/2 연결에서 연 스트림 (요청)
+#define METRIC_COUNTERS 13
+
+// 스레드 하나가 기록하는 지표 (그 스레드만 쓰므로 락도 원자적 read-modify-write 도 없다)
+// /metrics 를 요청하면 모든 스레드의 것을 더해서 보여 준다
+typedef struct MetricsShard
+{
+    atomic_ullong        counters[METRIC_COUNTERS];
+    atomic_ullong        buckets[METRIC_STAGES][METRICS_BUCKETS];
+    atomic_ullong        sum_ns[METRIC_STAGES];
+    struct MetricsShard *next;    // 등록된 샤드 목록
+} MetricsShard;
+
+void     metrics_count(int counter, uint64_t n);
+void     metrics_record(int stage, uint64_t ns);
+void     metrics_response(int status, long long bytes);
+void     metrics_write(FILE *out);
+void     metrics_destroy(void);
+int      metrics_bucket(uint64_t ns);
+uint64_t metrics_bucket_upper(int index);
+
+// 단조 시계 (ns)
+static inline uint64_t metrics_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+#endif
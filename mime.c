@@ -0,0 +1,178 @@
+#include "mime.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mime_table.h"    // mime_gen 이 mime.types 로 만든 완전 해시 표 (mime_seeds, mime_table)
+
+static MimeEntry overrides[MIME_OVERRIDE_SLOTS];    // 시작할 때 mime_load 가 채우고 그 뒤로는 읽기만 한다
+static size_t    override_count;
+
+static const MimeEntry *override_find(const char *ext, size_t len, uint32_t hash);
+static int              ext_equals(const MimeEntry *entry, const char *ext, size_t len);
+
+// 마지막 '/' 뒤의 마지막 '.' 뒤를 확장자로 본다 ("a.b.c" 는 "c"). 경로를 복사하지 않는다
+// -m 으로 읽은 표를 먼저 찾고, 없으면 빌드할 때 만든 표에서 해시 두 번과 비교 한 번으로 찾는다
+const char *content_type(const char *file)
+{
+    const char      *extension = NULL;
+    const MimeEntry *entry;
+    size_t           len;
+    uint32_t         hash;
+
+    for(const char *p = file; *p != '\0'; ++p)
+    {
+        if(*p == '/')
+        {
+            extension = NULL;
+        }
+        else if(*p == '.')
+        {
+            extension = p + 1;
+        }
+    }
+    if(extension == NULL)
+    {
+        return MIME_NO_EXTENSION;
+    }
+    len = strlen(extension);
+    if(len == 0 || len > MIME_EXT_MAX)
+    {
+        return MIME_DEFAULT;
+    }
+
+    hash = mime_hash(extension, len, 0);
+    if(override_count > 0 && (entry = override_find(extension, len, hash)) != NULL)
+    {
+        return entry->type;
+    }
+    entry = &mime_table[mime_hash(extension, len, mime_seeds[hash & (MIME_TABLE_BUCKETS - 1)]) & (MIME_TABLE_SLOTS - 1)];
+    if(ext_equals(entry, extension, len))
+    {
+        return entry->type;
+    }
+    return MIME_DEFAULT;
+}
+
+// mime.types 와 같은 형식의 파일을 읽어 기본 표보다 먼저 찾을 항목으로 둔다 (워커를 만들기 전에 부른다)
+// 같은 확장자가 다시 나오면 뒤의 것을 쓴다. 파일을 열 수 없거나 형식이 틀리면 -1
+int mime_load(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    char  line[1024];
+    int   lineno = 0;
+
+    if(fp == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+    while(fgets(line, sizeof(line), fp) != NULL)
+    {
+        char *save = NULL;
+        char *type;
+        char *ext;
+        char *comment = strchr(line, '#');
+
+        lineno++;
+        if(comment != NULL)
+        {
+            *comment = '\0';
+        }
+        type = strtok_r(line, " \t\r\n", &save);
+        if(type == NULL)
+        {
+            continue;
+        }
+        if(strchr(type, '/') == NULL)
+        {
+            fprintf(stderr, "%s:%d: not a content type: %s\n", path, lineno, type);
+            fclose(fp);
+            return -1;
+        }
+        type = strdup(type);
+        if(type == NULL)
+        {
+            fclose(fp);
+            return -1;
+        }
+        while((ext = strtok_r(NULL, " \t\r\n", &save)) != NULL)
+        {
+            size_t     len  = strlen(ext);
+            uint32_t   hash = mime_hash(ext, len, 0);
+            size_t     slot = hash & (MIME_OVERRIDE_SLOTS - 1);
+            MimeEntry *entry;
+
+            if(len > MIME_EXT_MAX || override_count >= MIME_OVERRIDE_SLOTS / 2)
+            {
+                fprintf(stderr, "%s:%d: extension too long or too many entries: %s\n", path, lineno, ext);
+                fclose(fp);
+                return -1;
+            }
+            // 선형 탐사. 같은 확장자면 타입만 바꾼다
+            while(overrides[slot].len != 0 && !ext_equals(&overrides[slot], ext, len))
+            {
+                slot = (slot + 1) & (MIME_OVERRIDE_SLOTS - 1);
+            }
+            entry = &overrides[slot];
+            if(entry->len == 0)
+            {
+                char *copy = strdup(ext);
+
+                if(copy == NULL)
+                {
+                    fclose(fp);
+                    return -1;
+                }
+                for(char *c = copy; *c != '\0'; ++c)
+                {
+                    if(*c >= 'A' && *c <= 'Z')
+                    {
+                        *c |= 0x20;
+                    }
+                }
+                entry->ext = copy;
+                entry->len = len;
+                override_count++;
+            }
+            entry->type = type;
+        }
+    }
+    fclose(fp);
+    return 0;
+}
+
+static const MimeEntry *override_find(const char *ext, size_t len, uint32_t hash)
+{
+    for(size_t slot = hash & (MIME_OVERRIDE_SLOTS - 1); overrides[slot].len != 0; slot = (slot + 1) & (MIME_OVERRIDE_SLOTS - 1))
+    {
+        if(ext_equals(&overrides[slot], ext, len))
+        {
+            return &overrides[slot];
+        }
+    }
+    return NULL;
+}
+
+// 표의 확장자는 소문자다
+static int ext_equals(const MimeEntry *entry, const char *ext, size_t len)
+{
+    if(entry->len != len)
+    {
+        return 0;
+    }
+    for(size_t i = 0; i < len; ++i)
+    {
+        unsigned char c = (unsigned char)ext[i];
+
+        if(c >= 'A' && c <= 'Z')
+        {
+            c |= 0x20;
+        }
+        if(c != (unsigned char)entry->ext[i])
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
@@ -0,0 +1,43 @@
+#ifndef MIME_H
+#define MIME_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MIME_EXT_MAX 16                            // 이보다 긴 확장자는 표에 없는 것으로 본다
+#define MIME_DEFAULT "application/octet-stream"    // 표에 없는 확장자
+#define MIME_NO_EXTENSION "text/html"              // 확장자가 없는 경로
+#define MIME_OVERRIDE_SLOTS 512                    // -m 으로 읽는 표의 크기 (2의 거듭제곱, 항목은 절반까지)
+
+// 확장자 하나 (ext 는 소문자)
+typedef struct
+{
+    const char *ext;
+    size_t      len;    // 0 이면 빈 자리
+    const char *type;
+} MimeEntry;
+
+// 대소문자를 가리지 않는 확장자 해시. mime_gen 이 만든 표와 같은 함수를 써야 한다
+static inline uint32_t mime_hash(const char *ext, size_t len, uint32_t seed)
+{
+    uint32_t hash = 2166136261u ^ (seed * 0x9e3779b9u);
+
+    for(size_t i = 0; i < len; ++i)
+    {
+        unsigned char c = (unsigned char)ext[i];
+
+        if(c >= 'A' && c <= 'Z')
+        {
+            c |= 0x20;
+        }
+        hash = (hash ^ c) * 16777619u;
+    }
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    return hash ^ (hash >> 13);
+}
+
+const char *content_type(const char *file);
+int         mime_load(const char *path);
+
+#endif
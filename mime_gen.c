@@ -0,0 +1,286 @@
+// mime.types 로 content_type 이 쓰는 완전 해시 표 (mime_table.h) 를 만든다
+// 확장자를 해시로 버킷에 나누고, 큰 버킷부터 모든 확장자가 빈 자리에 떨어지는 seed 를 찾는다 (hash and displace)
+// 찾을 때는 버킷의 seed 로 한 번 더 해시하면 자리가 정해지므로 충돌 처리 없이 비교 한 번으로 끝난다
+// 사용법: mime_gen <mime.types> <mime_table.h>
+#include "mime.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_ENTRIES 4096
+#define MAX_SEED (1u << 22)    // 버킷 하나에서 시도할 seed 수 (넘으면 자리를 늘려 다시 한다)
+
+typedef struct
+{
+    char   ext[MIME_EXT_MAX + 1];
+    size_t len;
+    int    type;      // types 의 번호
+    int    bucket;
+} Key;
+
+static Key   keys[MAX_ENTRIES];
+static int   nkeys;
+static char *types[MAX_ENTRIES];
+static int   ntypes;
+static int   bucket_sizes[MAX_ENTRIES];
+
+static int  read_types(const char *path);
+static int  build(unsigned int nbuckets, unsigned int nslots, uint32_t *seeds, int *slots);
+static int  compare_bucket_size(const void *a, const void *b);
+static void write_table(FILE *out, const char *source, unsigned int nbuckets, unsigned int nslots, const uint32_t *seeds, const int *slots);
+
+int main(int argc, char *argv[])
+{
+    unsigned int nbuckets = 1;
+    unsigned int nslots   = 16;
+    uint32_t    *seeds;
+    int         *slots;
+    FILE        *out;
+
+    if(argc != 3)
+    {
+        fprintf(stderr, "Usage : %s <mime.types> <mime_table.h>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if(read_types(argv[1]) == -1)
+    {
+        return EXIT_FAILURE;
+    }
+
+    // 버킷은 평균 두 개, 자리는 1.25 배 이상 (둘 다 2의 거듭제곱이라 찾을 때 나머지 대신 마스크)
+    while(nbuckets * 2 < (unsigned int)nkeys)
+    {
+        nbuckets *= 2;
+    }
+    while(nslots < (unsigned int)nkeys + (unsigned int)nkeys / 4)
+    {
+        nslots *= 2;
+    }
+    while(1)
+    {
+        seeds = (uint32_t *)calloc(nbuckets, sizeof(uint32_t));
+        slots = (int *)malloc(nslots * sizeof(int));
+        if(seeds == NULL || slots == NULL)
+        {
+            fprintf(stderr, "out of memory\n");
+            return EXIT_FAILURE;
+        }
+        if(build(nbuckets, nslots, seeds, slots) == 0)
+        {
+            break;
+        }
+        free(seeds);
+        free(slots);
+        nslots *= 2;
+    }
+
+    out = fopen(argv[2], "w");
+    if(out == NULL)
+    {
+        perror(argv[2]);
+        return EXIT_FAILURE;
+    }
+    write_table(out, argv[1], nbuckets, nslots, seeds, slots);
+    if(fclose(out) == EOF)
+    {
+        perror(argv[2]);
+        return EXIT_FAILURE;
+    }
+    printf("%s: %d extensions, %d types, %u buckets, %u slots\n", argv[2], nkeys, ntypes, nbuckets, nslots);
+    free(seeds);
+    free(slots);
+    return EXIT_SUCCESS;
+}
+
+// "<타입> <확장자>..." 줄을 읽는다. 확장자가 겹치거나 너무 길면 -1
+static int read_types(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    char  line[1024];
+    int   lineno = 0;
+
+    if(fp == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+    while(fgets(line, sizeof(line), fp) != NULL)
+    {
+        char *save    = NULL;
+        char *comment = strchr(line, '#');
+        char *type;
+        char *ext;
+
+        lineno++;
+        if(comment != NULL)
+        {
+            *comment = '\0';
+        }
+        type = strtok_r(line, " \t\r\n", &save);
+        if(type == NULL)
+        {
+            continue;
+        }
+        if(strchr(type, '/') == NULL || ntypes == MAX_ENTRIES)
+        {
+            fprintf(stderr, "%s:%d: not a content type: %s\n", path, lineno, type);
+            fclose(fp);
+            return -1;
+        }
+        types[ntypes] = strdup(type);
+        while((ext = strtok_r(NULL, " \t\r\n", &save)) != NULL)
+        {
+            size_t len = strlen(ext);
+
+            if(len > MIME_EXT_MAX || nkeys == MAX_ENTRIES)
+            {
+                fprintf(stderr, "%s:%d: extension too long or too many entries: %s\n", path, lineno, ext);
+                fclose(fp);
+                return -1;
+            }
+            for(size_t i = 0; i <= len; ++i)
+            {
+                keys[nkeys].ext[i] = (char)(ext[i] >= 'A' && ext[i] <= 'Z' ? ext[i] | 0x20 : ext[i]);
+            }
+            for(int i = 0; i < nkeys; ++i)
+            {
+                if(strcmp(keys[i].ext, keys[nkeys].ext) == 0)
+                {
+                    fprintf(stderr, "%s:%d: duplicate extension: %s\n", path, lineno, ext);
+                    fclose(fp);
+                    return -1;
+                }
+            }
+            keys[nkeys].len  = len;
+            keys[nkeys].type = ntypes;
+            nkeys++;
+        }
+        ntypes++;
+    }
+    fclose(fp);
+    return 0;
+}
+
+// 큰 버킷부터 seed 를 정한다. 어느 버킷이든 seed 를 찾지 못하면 -1
+static int build(unsigned int nbuckets, unsigned int nslots, uint32_t *seeds, int *slots)
+{
+    int *order  = (int *)malloc(nbuckets * sizeof(int));
+    int  result = 0;
+
+    if(order == NULL)
+    {
+        return -1;
+    }
+    memset(bucket_sizes, 0, sizeof(bucket_sizes));
+    for(int i = 0; i < nkeys; ++i)
+    {
+        keys[i].bucket = (int)(mime_hash(keys[i].ext, keys[i].len, 0) & (nbuckets - 1));
+        bucket_sizes[keys[i].bucket]++;
+    }
+    for(unsigned int b = 0; b < nbuckets; ++b)
+    {
+        order[b] = (int)b;
+    }
+    qsort(order, nbuckets, sizeof(int), compare_bucket_size);
+    for(unsigned int i = 0; i < nslots; ++i)
+    {
+        slots[i] = -1;
+    }
+
+    for(unsigned int o = 0; o < nbuckets && result == 0; ++o)
+    {
+        int      bucket = order[o];
+        uint32_t seed;
+
+        if(bucket_sizes[bucket] == 0)
+        {
+            break;
+        }
+        for(seed = 1; seed < MAX_SEED; ++seed)
+        {
+            int placed = 0;
+            int ok     = 1;
+
+            for(int i = 0; i < nkeys; ++i)
+            {
+                unsigned int slot;
+
+                if(keys[i].bucket != bucket)
+                {
+                    continue;
+                }
+                slot = mime_hash(keys[i].ext, keys[i].len, seed) & (nslots - 1);
+                if(slots[slot] != -1)
+                {
+                    ok = 0;
+                    break;
+                }
+                slots[slot] = i;
+                placed++;
+            }
+            if(ok)
+            {
+                seeds[bucket] = seed;
+                break;
+            }
+            // 이번 seed 로 놓은 것을 되돌린다
+            for(unsigned int s = 0; s < nslots && placed > 0; ++s)
+            {
+                if(slots[s] != -1 && keys[slots[s]].bucket == bucket)
+                {
+                    slots[s] = -1;
+                    placed--;
+                }
+            }
+        }
+        if(seed == MAX_SEED)
+        {
+            result = -1;
+        }
+    }
+    free(order);
+    return result;
+}
+
+static int compare_bucket_size(const void *a, const void *b)
+{
+    return bucket_sizes[*(const int *)b] - bucket_sizes[*(const int *)a];
+}
+
+static void write_table(FILE *out, const char *source, unsigned int nbuckets, unsigned int nslots, const uint32_t *seeds, const int *slots)
+{
+    const char *slash = strrchr(source, '/');
+
+    // 빌드 디렉터리에 따라 내용이 달라지지 않도록 파일 이름만 적는다
+    if(slash != NULL)
+    {
+        source = slash + 1;
+    }
+    fprintf(out, "// mime_gen 이 %s 로 만든 파일이다. 고치지 말고 %s 를 고친 뒤 다시 만든다\n", source, source);
+    fputs("#ifndef MIME_TABLE_H\n#define MIME_TABLE_H\n\n", out);
+    fprintf(out, "#define MIME_TABLE_BUCKETS %u\n", nbuckets);
+    fprintf(out, "#define MIME_TABLE_SLOTS %u\n\n", nslots);
+
+    fputs("// 버킷마다 두 번째 해시의 seed\nstatic const uint32_t mime_seeds[MIME_TABLE_BUCKETS] = {", out);
+    for(unsigned int b = 0; b < nbuckets; ++b)
+    {
+        fprintf(out, "%s%u", b % 12 == 0 ? "\n    " : " ", seeds[b]);
+        if(b + 1 < nbuckets)
+        {
+            fputc(',', out);
+        }
+    }
+    fputs("\n};\n\n", out);
+
+    fputs("static const MimeEntry mime_table[MIME_TABLE_SLOTS] = {\n", out);
+    for(unsigned int s = 0; s < nslots; ++s)
+    {
+        if(slots[s] != -1)
+        {
+            const Key *key = &keys[slots[s]];
+
+            fprintf(out, "    [%u] = {\"%s\", %zu, \"%s\"},\n", s, key->ext, key->len, types[key->type]);
+        }
+    }
+    fputs("};\n\n#endif\n", out);
+}
@@ -0,0 +1,222 @@
+// mime_gen 이 mime.types 로 만든 파일이다. 고치지 말고 mime.types 를 고친 뒤 다시 만든다
+#ifndef MIME_TABLE_H
+#define MIME_TABLE_H
+
+#define MIME_TABLE_BUCKETS 128
+#define MIME_TABLE_SLOTS 256
+
+// 버킷마다 두 번째 해시의 seed
+static const uint32_t mime_seeds[MIME_TABLE_BUCKETS] = {
+    1, 1, 0, 1, 3, 1, 2, 0, 1, 5, 3, 1,
+    4, 1, 3, 0, 0, 4, 2, 1, 0, 1, 0, 1,
+    0, 0, 1, 1, 6, 5, 2, 3, 3, 1, 0, 1,
+    1, 3, 1, 1, 8, 1, 2, 1, 0, 2, 1, 0,
+    1, 4, 8, 1, 1, 1, 3, 1, 2, 0, 5, 0,
+    1, 1, 2, 2, 2, 1, 2, 1, 1, 0, 9, 7,
+    6, 2, 1, 2, 2, 5, 1, 0, 2, 2, 0, 1,
+    2, 2, 5, 2, 2, 3, 2, 2, 0, 4, 2, 1,
+    1, 14, 2, 1, 3, 4, 1, 6, 1, 2, 7, 4,
+    1, 4, 0, 3, 6, 4, 4, 1, 0, 3, 4, 7,
+    0, 1, 0, 3, 1, 4, 8, 1
+};
+
+static const MimeEntry mime_table[MIME_TABLE_SLOTS] = {
+    [0] = {"mp4", 3, "video/mp4"},
+    [1] = {"tiff", 4, "image/tiff"},
+    [2] = {"ppt", 3, "application/vnd.ms-powerpoint"},
+    [4] = {"torrent", 7, "application/x-bittorrent"},
+    [5] = {"woff2", 5, "font/woff2"},
+    [6] = {"mpg", 3, "video/mpeg"},
+    [7] = {"vcf", 3, "text/vcard"},
+    [9] = {"toml", 4, "application/toml"},
+    [10] = {"odg", 3, "application/vnd.oasis.opendocument.graphics"},
+    [11] = {"sh", 2, "text/x-shellscript"},
+    [13] = {"mml", 3, "text/mathml"},
+    [14] = {"gz", 2, "application/gzip"},
+    [17] = {"markdown", 8, "text/markdown"},
+    [18] = {"mpga", 4, "audio/mpeg"},
+    [19] = {"jfif", 4, "image/jpeg"},
+    [22] = {"opus", 4, "audio/opus"},
+    [23] = {"log", 3, "text/plain"},
+    [24] = {"msp", 3, "application/octet-stream"},
+    [26] = {"3gp", 3, "video/3gpp"},
+    [27] = {"mpd", 3, "application/dash+xml"},
+    [29] = {"iso", 3, "application/x-iso9660-image"},
+    [30] = {"cur", 3, "image/x-icon"},
+    [31] = {"patch", 5, "text/plain"},
+    [32] = {"otf", 3, "font/otf"},
+    [33] = {"deb", 3, "application/octet-stream"},
+    [34] = {"aiff", 4, "audio/x-aiff"},
+    [38] = {"odt", 3, "application/vnd.oasis.opendocument.text"},
+    [39] = {"heic", 4, "image/heic"},
+    [40] = {"7z", 2, "application/x-7z-compressed"},
+    [41] = {"svg", 3, "image/svg+xml"},
+    [42] = {"pdf", 3, "application/pdf"},
+    [43] = {"wav", 3, "audio/wav"},
+    [44] = {"msi", 3, "application/octet-stream"},
+    [45] = {"jpe", 3, "image/jpeg"},
+    [47] = {"tbz2", 4, "application/x-bzip2"},
+    [48] = {"bin", 3, "application/octet-stream"},
+    [49] = {"eps", 3, "application/postscript"},
+    [50] = {"xls", 3, "application/vnd.ms-excel"},
+    [52] = {"webp", 4, "image/webp"},
+    [53] = {"jnlp", 4, "application/x-java-jnlp-file"},
+    [55] = {"png", 3, "image/png"},
+    [60] = {"mov", 3, "video/quicktime"},
+    [61] = {"xlt", 3, "application/vnd.ms-excel"},
+    [62] = {"der", 3, "application/x-x509-ca-cert"},
+    [63] = {"ods", 3, "application/vnd.oasis.opendocument.spreadsheet"},
+    [64] = {"apk", 3, "application/vnd.android.package-archive"},
+    [66] = {"hpp", 3, "text/x-c"},
+    [67] = {"m4a", 3, "audio/mp4"},
+    [68] = {"db", 2, "application/x-sqlite3"},
+    [69] = {"epub", 4, "application/epub+zip"},
+    [70] = {"tar", 3, "application/x-tar"},
+    [71] = {"ics", 3, "text/calendar"},
+    [72] = {"weba", 4, "audio/webm"},
+    [73] = {"zst", 3, "application/zstd"},
+    [74] = {"jsonld", 6, "application/ld+json"},
+    [75] = {"msm", 3, "application/octet-stream"},
+    [76] = {"rss", 3, "application/rss+xml"},
+    [78] = {"xsl", 3, "text/xml"},
+    [79] = {"asx", 3, "video/x-ms-asf"},
+    [80] = {"htc", 3, "text/x-component"},
+    [81] = {"dot", 3, "application/msword"},
+    [82] = {"jpg", 3, "image/jpeg"},
+    [85] = {"vcard", 5, "text/vcard"},
+    [87] = {"mpeg", 4, "video/mpeg"},
+    [88] = {"map", 3, "application/json"},
+    [89] = {"m2ts", 4, "video/mp2t"},
+    [90] = {"mkv", 3, "video/x-matroska"},
+    [91] = {"m3u", 3, "audio/x-mpegurl"},
+    [93] = {"midi", 4, "audio/midi"},
+    [94] = {"kar", 3, "audio/midi"},
+    [95] = {"bmp", 3, "image/bmp"},
+    [96] = {"mid", 3, "audio/midi"},
+    [97] = {"rpm", 3, "application/x-redhat-package-manager"},
+    [100] = {"html", 4, "text/html"},
+    [101] = {"webm", 4, "video/webm"},
+    [102] = {"xlsx", 4, "application/vnd.openxmlformats-officedocument.spreadsheetml.sheet"},
+    [103] = {"avif", 4, "image/avif"},
+    [104] = {"pl", 2, "application/x-perl"},
+    [106] = {"mp4v", 4, "video/mp4"},
+    [107] = {"cer", 3, "application/pkix-cert"},
+    [108] = {"tif", 3, "image/tiff"},
+    [109] = {"heif", 4, "image/heif"},
+    [110] = {"rar", 3, "application/vnd.rar"},
+    [112] = {"gql", 3, "application/graphql"},
+    [114] = {"mpe", 3, "video/mpeg"},
+    [115] = {"h", 1, "text/x-c"},
+    [116] = {"pjp", 3, "image/jpeg"},
+    [117] = {"xml", 3, "text/xml"},
+    [118] = {"conf", 4, "text/plain"},
+    [120] = {"zip", 3, "application/zip"},
+    [121] = {"rtf", 3, "application/rtf"},
+    [122] = {"vtt", 3, "text/vtt"},
+    [124] = {"flac", 4, "audio/flac"},
+    [125] = {"cc", 2, "text/x-c"},
+    [126] = {"wbmp", 4, "image/vnd.wap.wbmp"},
+    [127] = {"txz", 3, "application/x-xz"},
+    [128] = {"atom", 4, "application/atom+xml"},
+    [131] = {"svgz", 4, "image/svg+xml"},
+    [132] = {"bz2", 3, "application/x-bzip2"},
+    [133] = {"hqx", 3, "application/mac-binhex40"},
+    [135] = {"mp3", 3, "audio/mpeg"},
+    [136] = {"udeb", 4, "application/vnd.debian.binary-package"},
+    [137] = {"pfx", 3, "application/x-pkcs12"},
+    [138] = {"3gpp", 4, "video/3gpp"},
+    [139] = {"diff", 4, "text/plain"},
+    [140] = {"3g2", 3, "video/3gpp2"},
+    [141] = {"dll", 3, "application/octet-stream"},
+    [143] = {"cpp", 3, "text/x-c"},
+    [144] = {"ico", 3, "image/x-icon"},
+    [145] = {"gif", 3, "image/gif"},
+    [146] = {"jsonp", 5, "application/javascript"},
+    [147] = {"m4v", 3, "video/mp4"},
+    [148] = {"js", 2, "text/javascript"},
+    [149] = {"ai", 2, "application/postscript"},
+    [150] = {"xsd", 3, "text/xml"},
+    [151] = {"sqlite3", 7, "application/x-sqlite3"},
+    [152] = {"p7c", 3, "application/pkcs7-mime"},
+    [154] = {"ttf", 3, "font/ttf"},
+    [155] = {"kmz", 3, "application/vnd.google-earth.kmz"},
+    [156] = {"tgz", 3, "application/gzip"},
+    [157] = {"tsv", 3, "text/tab-separated-values"},
+    [158] = {"csv", 3, "text/csv"},
+    [161] = {"jxl", 3, "image/jxl"},
+    [162] = {"odp", 3, "application/vnd.oasis.opendocument.presentation"},
+    [163] = {"graphql", 7, "application/graphql"},
+    [165] = {"pptx", 4, "application/vnd.openxmlformats-officedocument.presentationml.presentation"},
+    [166] = {"aif", 3, "audio/x-aiff"},
+    [167] = {"aifc", 4, "audio/x-aiff"},
+    [169] = {"asf", 3, "video/x-ms-asf"},
+    [170] = {"php", 3, "application/x-httpd-php"},
+    [173] = {"eot", 3, "application/vnd.ms-fontobject"},
+    [174] = {"jar", 3, "application/java-archive"},
+    [175] = {"avi", 3, "video/x-msvideo"},
+    [176] = {"mjs", 3, "text/javascript"},
+    [178] = {"spx", 3, "audio/ogg"},
+    [179] = {"pjpeg", 5, "image/jpeg"},
+    [181] = {"kml", 3, "application/vnd.google-earth.kml+xml"},
+    [183] = {"doc", 3, "application/msword"},
+    [184] = {"exe", 3, "application/octet-stream"},
+    [185] = {"ogg", 3, "audio/ogg"},
+    [186] = {"css", 3, "text/css"},
+    [187] = {"oga", 3, "audio/ogg"},
+    [188] = {"ifb", 3, "text/calendar"},
+    [190] = {"ear", 3, "application/java-archive"},
+    [191] = {"latex", 5, "application/x-latex"},
+    [192] = {"pps", 3, "application/vnd.ms-powerpoint"},
+    [193] = {"flv", 3, "video/x-flv"},
+    [194] = {"txt", 3, "text/plain"},
+    [195] = {"pm", 2, "application/x-perl"},
+    [196] = {"java", 4, "text/x-java-source"},
+    [197] = {"xhtml", 5, "application/xhtml+xml"},
+    [198] = {"text", 4, "text/plain"},
+    [199] = {"pem", 3, "application/x-x509-ca-cert"},
+    [201] = {"dmg", 3, "application/octet-stream"},
+    [202] = {"img", 3, "application/octet-stream"},
+    [203] = {"wmv", 3, "video/x-ms-wmv"},
+    [204] = {"md", 2, "text/markdown"},
+    [205] = {"ts", 2, "video/mp2t"},
+    [206] = {"rb", 2, "application/x-ruby"},
+    [207] = {"jpeg", 4, "image/jpeg"},
+    [208] = {"apng", 4, "image/apng"},
+    [209] = {"mng", 3, "video/x-mng"},
+    [210] = {"py", 2, "text/x-python"},
+    [211] = {"so", 2, "application/octet-stream"},
+    [214] = {"ps", 2, "application/postscript"},
+    [215] = {"war", 3, "application/java-archive"},
+    [216] = {"yml", 3, "text/yaml"},
+    [220] = {"jng", 3, "image/x-jng"},
+    [221] = {"sparseimage", 11, "application/x-apple-diskimage"},
+    [222] = {"wasm", 4, "application/wasm"},
+    [223] = {"xht", 3, "application/xhtml+xml"},
+    [225] = {"tex", 3, "application/x-tex"},
+    [226] = {"webmanifest", 11, "application/manifest+json"},
+    [227] = {"qt", 2, "video/quicktime"},
+    [228] = {"woff", 4, "font/woff"},
+    [230] = {"cjs", 3, "text/javascript"},
+    [231] = {"m3u8", 4, "application/vnd.apple.mpegurl"},
+    [232] = {"xz", 2, "application/x-xz"},
+    [233] = {"sqlite", 6, "application/x-sqlite3"},
+    [234] = {"htm", 3, "text/html"},
+    [236] = {"docx", 4, "application/vnd.openxmlformats-officedocument.wordprocessingml.document"},
+    [237] = {"ogv", 3, "video/ogg"},
+    [238] = {"sql", 3, "application/sql"},
+    [239] = {"ra", 2, "audio/x-realaudio"},
+    [240] = {"ttc", 3, "font/collection"},
+    [241] = {"aac", 3, "audio/aac"},
+    [242] = {"p7m", 3, "application/pkcs7-mime"},
+    [243] = {"json", 4, "application/json"},
+    [245] = {"ini", 3, "text/plain"},
+    [246] = {"p12", 3, "application/x-pkcs12"},
+    [250] = {"c", 1, "text/x-c"},
+    [251] = {"crt", 3, "application/x-x509-ca-cert"},
+    [252] = {"swf", 3, "application/x-shockwave-flash"},
+    [253] = {"yaml", 4, "text/yaml"},
+    [254] = {"shtml", 5, "text/html"},
+    [255] = {"cpio", 4, "application/x-cpio"},
+};
+
+#endif
@@ -0,0 +1,816 @@
+#define _GNU_SOURCE    // accept4
+
+#include "reactor.h"
+#include "h2.h"
+#include "log.h"
+#include "metrics.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define CONN_EVENTS (EPOLLIN | EPOLLRDHUP | EPOLLET | EPOLLONESHOT)
+#define URING_CLOSE_TRIES 50          // 닫을 때 남은 recv 를 기다리는 횟수 (100ms 씩)
+
+#define TIMER_CONNECTION(timer) ((Connection *)((char *)(timer) - offsetof(Connection, timer)))
+
+static _Thread_local Reactor *polling_reactor;    // 이 스레드가 돌리는 io_uring 리액터 (제출을 다음 poll 로 미룰 수 있다)
+
+static void accept_connections(Reactor *reactor);
+static void connection_open(Reactor *reactor, int clnt_sock, const struct sockaddr_in *clnt_adr);
+static void handle_readable(Reactor *reactor, Connection *conn);
+static void connection_free(Connection *conn);
+static int  connection_arm(Connection *conn, int op);
+static int  uring_init_reactor(Reactor *reactor);
+static int  uring_poll(Reactor *reactor, int timeout_ms);
+static int  uring_arm_accept(Reactor *reactor);
+static int  uring_arm_wake(Reactor *reactor);
+static int  uring_arm_recv(Connection *conn);
+static void uring_accepted(Reactor *reactor, const struct io_uring_cqe *cqe);
+static void uring_received(Reactor *reactor, Connection *conn, int res);
+static void uring_close(Reactor *reactor);
+static void deadline_arm(Reactor *reactor, Connection *conn);
+static void deadline_cancel(Reactor *reactor, Connection *conn);
+static void deadline_expire(Reactor *reactor);
+static uint64_t tick_now(void);
+
+// backend 가 REACTOR_URING 인데 커널이 io_uring 을 지원하지 않으면 -1 (호출한 쪽이 REACTOR_EPOLL 로 다시 부를 수 있다)
+int reactor_init(Reactor *reactor, int listen_fd, size_t max_body, int backend, DispatchFunction dispatch, void *ctx)
+{
+    struct epoll_event ev;
+
+    reactor->backend   = backend;
+    reactor->listen_fd = listen_fd;
+    reactor->max_body  = max_body;
+    reactor->dispatch  = dispatch;
+    reactor->ctx       = ctx;
+    timer_wheel_init(&(reactor->timers), tick_now());
+    pthread_mutex_init(&(reactor->timer_mutex), NULL);
+    reactor->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if(reactor->epfd == -1)
+    {
+        return -1;
+    }
+    reactor->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(reactor->wake_fd == -1)
+    {
+        close(reactor->epfd);
+        return -1;
+    }
+    if(backend == REACTOR_URING)
+    {
+        if(uring_init_reactor(reactor) == -1)
+        {
+            close(reactor->wake_fd);
+            close(reactor->epfd);
+            return -1;
+        }
+        return 0;
+    }
+
+    // 리슨 소켓은 data.ptr 을 NULL 로, eventfd 는 리액터 자신으로 두어 클라이언트와 구분한다
+    memset(&ev, 0, sizeof(ev));
+    ev.events   = EPOLLIN | EPOLLET;
+    ev.data.ptr = NULL;
+    if(epoll_ctl(reactor->epfd, EPOLL_CTL_ADD, listen_fd, &ev) == -1)
+    {
+        close(reactor->wake_fd);
+        close(reactor->epfd);
+        return -1;
+    }
+    ev.data.ptr = reactor;
+    if(epoll_ctl(reactor->epfd, EPOLL_CTL_ADD, reactor->wake_fd, &ev) == -1)
+    {
+        close(reactor->wake_fd);
+        close(reactor->epfd);
+        return -1;
+    }
+    return 0;
+}
+
+// 이벤트를 한 번 기다려 처리하고 처리한 이벤트 수를 돌려준다 (timeout_ms 가 0 이면 기다리지 않는다)
+// 요청이 완성된 연결은 dispatch 로 넘기고, 제한 시간이 지난 유휴 연결을 닫는다
+int reactor_poll(Reactor *reactor, int timeout_ms)
+{
+    struct epoll_event events[MAX_EVENTS];
+    int                n;
+
+    if(reactor->backend == REACTOR_URING)
+    {
+        return uring_poll(reactor, timeout_ms);
+    }
+    n = epoll_wait(reactor->epfd, events, MAX_EVENTS, timeout_ms);
+    if(n == -1)
+    {
+        if(errno != EINTR)
+        {
+            LOG(LOG_ERROR, "epoll_wait: %m");
+        }
+        return 0;
+    }
+
+    for(int i = 0; i < n; ++i)
+    {
+        if(events[i].data.ptr == NULL)
+        {
+            accept_connections(reactor);
+        }
+        else if(events[i].data.ptr == reactor)
+        {
+            uint64_t count;
+            while(read(reactor->wake_fd, &count, sizeof(count)) > 0)
+            {
+            }
+        }
+        else
+        {
+            handle_readable(reactor, (Connection *)events[i].data.ptr);
+        }
+    }
+    deadline_expire(reactor);
+    return n;
+}
+
+// 다른 스레드에서 호출한다. epoll_wait 에서 잠든 리액터를 깨운다
+void reactor_wake(Reactor *reactor)
+{
+    uint64_t one = 1;
+
+    if(write(reactor->wake_fd, &one, sizeof(one)) == -1 && errno != EAGAIN)
+    {
+        LOG(LOG_ERROR, "reactor_wake: %m");
+    }
+}
+
+void reactor_close(Reactor *reactor)
+{
+    if(reactor->backend == REACTOR_URING)
+    {
+        uring_close(reactor);
+    }
+    for(Timer *timer = timer_wheel_take_all(&(reactor->timers)); timer != NULL;)
+    {
+        Connection *conn = TIMER_CONNECTION(timer);
+
+        timer = timer->next;
+        connection_free(conn);
+    }
+    pthread_mutex_destroy(&(reactor->timer_mutex));
+    close(reactor->wake_fd);
+    close(reactor->epfd);
+}
+
+// 버퍼에 완성된 요청이 있는지 확인한다 (1 완성, 0 미완성). HTTP/2 연결은 요청 대신 서문이나 프레임 하나가 다 왔는지 본다
+// 본문은 도착하는 대로 chunked 디코딩과 필드 나누기를 이어서 하므로 요청이 완성될 때 다시 읽을 필요가 없다
+// 잘못됐거나 너무 큰 요청도 워커가 오류로 응답하도록 완성된 것으로 넘긴다 (conn->req.state 가 HTTP_STATE_ERROR, 상태 코드는 req.error)
+int connection_request_ready(Connection *conn)
+{
+    HttpRequest *req      = &(conn->req);
+    size_t       max_body = conn->reactor->max_body;
+    uint64_t     start    = metrics_now();
+    int          status;
+    size_t       end;
+
+    if(conn->h2 != NULL)
+    {
+        return h2_frame_ready(conn->h2, conn->buf, conn->len);
+    }
+    if(conn->len > 0 && conn->buf[0] == 'P' && (status = h2_preface(conn->buf, conn->len)) != -1)
+    {
+        return status;    // 서문으로 시작하는 HTTP/2 연결 (prior knowledge)
+    }
+    status = http_request_parse(req, conn->buf, conn->len);
+    metrics_record(METRIC_STAGE_PARSE, metrics_now() - start);
+
+    if(status == 0 && conn->len < MAX_HEADER_SIZE)
+    {
+        return 0;
+    }
+    if(status == 0 || (status == 1 && req->header_len > MAX_HEADER_SIZE))
+    {
+        http_request_fail(req, 431);
+        status = -1;
+    }
+    if(status == 1 && !req->chunked && req->content_length > (long int)max_body)
+    {
+        // 본문을 받기 전에 거절한다
+        http_request_fail(req, 413);
+        status = -1;
+    }
+    if(status == -1)
+    {
+        conn->req_len = conn->len;
+        return 1;
+    }
+
+    if(!req->chunked)
+    {
+        size_t avail = conn->len - req->header_len;
+
+        req->body_len = avail < (size_t)req->content_length ? avail : (size_t)req->content_length;
+        form_parse(&(conn->form), conn->buf + req->header_len, req->body_len, req->body_len == (size_t)req->content_length);
+        if(req->body_len < (size_t)req->content_length)
+        {
+            return 0;
+        }
+        conn->req_len = req->header_len + req->body_len;
+        return 1;
+    }
+
+    status = http_chunked_decode(req, conn->buf, conn->len);
+    if(status == -1 || req->body_len + req->chunk_left > max_body)
+    {
+        http_request_fail(req, status == -1 ? 400 : 413);
+        conn->req_len = conn->len;
+        return 1;
+    }
+    form_parse(&(conn->form), conn->buf + req->header_len, req->body_len, status == 1);
+
+    // 디코딩한 본문 바로 뒤로 남은 바이트를 당겨 청크 틀이 차지하던 자리를 돌려받는다
+    // 본문이 끝나기 전에는 덜 온 청크 크기 줄 정도만 남으므로 비용이 작고, 끝났으면 파이프라인으로 뒤따라온 요청이 이어진다
+    end = req->header_len + req->body_len;
+    memmove(conn->buf + end, conn->buf + req->chunk_pos, conn->len - req->chunk_pos);
+    conn->len -= req->chunk_pos - end;
+    req->chunk_pos = end;
+    if(status == 0)
+    {
+        return 0;
+    }
+    conn->req_len = end;
+    return 1;
+}
+
+// 처리한 요청을 버퍼에서 지우고 파이프라인으로 뒤따라온 바이트를 앞으로 당긴다
+void connection_consume(Connection *conn)
+{
+    conn->len -= conn->req_len;
+    if(conn->len <= CONN_BUF_SIZE)
+    {
+        // 파이프라인으로 이미 받은 다음 요청을 기본 버퍼로 옮기고 이번 요청에 쓴 메모리를 모두 되돌린다
+        memmove(conn->inline_buf, conn->buf + conn->req_len, conn->len);
+        conn->buf = conn->inline_buf;
+        conn->cap = CONN_BUF_SIZE;
+        arena_reset(conn->arena);
+    }
+    else
+    {
+        // 남은 것이 기본 버퍼보다 크면 키운 버퍼를 그대로 쓴다 (다음 요청을 마칠 때 되돌린다)
+        memmove(conn->buf, conn->buf + conn->req_len, conn->len);
+    }
+    conn->req_len       = 0;
+    conn->request_start = 0;
+    http_request_init(&(conn->req));
+    form_parser_init(&(conn->form));
+}
+
+// 워커가 응답을 마친 keep-alive 연결을 리액터에 돌려준다
+void connection_resume(Connection *conn)
+{
+    Reactor *reactor = conn->reactor;
+
+    // 이벤트가 먼저 발생해도 리액터가 목록에서 지울 수 있도록 다시 등록하기 전에 넣는다
+    deadline_arm(reactor, conn);
+    if(connection_arm(conn, EPOLL_CTL_MOD) == -1)
+    {
+        deadline_cancel(reactor, conn);
+        connection_free(conn);
+        return;
+    }
+    // io_uring 은 리액터를 돌리는 워커면 다음 poll 에 묶어서 넘기고, 다른 워커면 바로 넘긴다
+    if(reactor->backend == REACTOR_URING && polling_reactor != reactor && uring_submit(&(reactor->uring)) == -1)
+    {
+        LOG(LOG_ERROR, "io_uring_enter: %m");
+    }
+}
+
+// 워커가 응답을 마친 연결을 닫는다
+void connection_finish(Connection *conn)
+{
+    connection_free(conn);
+}
+
+// 워커가 응답을 보내기 시작할 때 부른다. 응답 전체를 SEND_TIMEOUT_MS 안에 보내야 한다
+// 쓰기마다 시간을 새로 주면 조금씩 읽는 클라이언트가 워커를 얼마든지 잡아 둘 수 있으므로 마감은 응답마다 한 번 정한다
+void connection_send_begin(Connection *conn)
+{
+    conn->send_deadline = metrics_now() + (uint64_t)SEND_TIMEOUT_MS * 1000000;
+}
+
+// 본문 len 바이트를 SEND_MIN_RATE 로 보낼 시간만큼 마감을 늦춘다
+// 보낼 크기로 미리 늘리므로 클라이언트가 읽는 속도와 상관없이 마감은 정해져 있다
+void connection_send_extend(Connection *conn, uint64_t len)
+{
+    conn->send_deadline += len / SEND_MIN_RATE * 1000000000 + len % SEND_MIN_RATE * 1000000000 / SEND_MIN_RATE;
+}
+
+// edge-triggered 이므로 EAGAIN 이 나올 때까지 모두 accept 한다
+static void accept_connections(Reactor *reactor)
+{
+    while(1)
+    {
+        struct sockaddr_in clnt_adr;
+        socklen_t          clnt_adr_size = sizeof(clnt_adr);
+        int                clnt_sock;
+
+        // 클라이언트 소켓은 논블로킹이다. 워커는 쓰다가 막히면 response_wait 로 응답 마감까지만 기다린다
+        clnt_sock = accept4(reactor->listen_fd, (struct sockaddr *)&clnt_adr, &clnt_adr_size, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(clnt_sock == -1)
+        {
+            if(errno == EINTR || errno == ECONNABORTED)
+            {
+                continue;
+            }
+            if(errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                LOG(LOG_ERROR, "accept4: %m");
+            }
+            return;
+        }
+        connection_open(reactor, clnt_sock, &clnt_adr);
+    }
+}
+
+// 받아들인 소켓으로 연결을 만들고 첫 요청을 기다린다
+// clnt_adr 이 NULL 이면 (io_uring multishot accept) 접근 로그를 남길 때만 주소를 묻는다
+static void connection_open(Reactor *reactor, int clnt_sock, const struct sockaddr_in *clnt_adr)
+{
+    struct sockaddr_in peer;
+    socklen_t          peer_size = sizeof(peer);
+    char               client_ip[INET_ADDRSTRLEN];
+    Arena             *arena;
+    Connection        *conn;
+
+    if(clnt_adr == NULL)
+    {
+        memset(&peer, 0, sizeof(peer));
+        if(LOG_INFO <= log_level)
+        {
+            getpeername(clnt_sock, (struct sockaddr *)&peer, &peer_size);
+        }
+        clnt_adr = &peer;
+    }
+    if(LOG_DEBUG <= log_level)
+    {
+        inet_ntop(AF_INET, &(clnt_adr->sin_addr), client_ip, INET_ADDRSTRLEN);
+        LOG(LOG_DEBUG, "connection %d from %s", clnt_sock, client_ip);
+    }
+
+    // 연결 구조체는 아레나의 첫 블록에 둔다 (연결이 살아 있는 동안 남고, 뒤의 할당은 요청마다 되돌린다)
+    arena = arena_create();
+    conn  = arena != NULL ? (Connection *)arena_alloc(arena, sizeof(Connection)) : NULL;
+    if(conn == NULL)
+    {
+        if(arena != NULL)
+        {
+            arena_destroy(arena);
+        }
+        close(clnt_sock);
+        return;
+    }
+    arena_mark(arena);
+    memset(conn, 0, offsetof(Connection, inline_buf));
+    metrics_count(METRIC_ACCEPTS, 1);
+    conn->fd      = clnt_sock;
+    conn->addr    = clnt_adr->sin_addr;
+    conn->arena   = arena;
+    conn->buf     = conn->inline_buf;
+    conn->cap     = CONN_BUF_SIZE;
+    conn->reactor = reactor;
+    http_request_init(&(conn->req));
+    form_parser_init(&(conn->form));
+
+    deadline_arm(reactor, conn);
+    if(connection_arm(conn, EPOLL_CTL_ADD) == -1)
+    {
+        LOG(LOG_ERROR, "connection_arm: %m");
+        deadline_cancel(reactor, conn);
+        connection_free(conn);
+    }
+}
+
+// 읽을 수 있는 만큼 읽고, 요청이 완성되면 워커에게 넘긴다
+static void handle_readable(Reactor *reactor, Connection *conn)
+{
+    size_t limit  = MAX_HEADER_SIZE + reactor->max_body;
+    int    closed = 0;
+    int    status;
+
+    deadline_cancel(reactor, conn);
+
+    while(1)
+    {
+        ssize_t n;
+
+        if(conn->len == conn->cap)
+        {
+            size_t new_cap = conn->cap * 2;
+            char  *new_buf;
+
+            if(conn->cap >= limit)
+            {
+                // 더 키우지 않는다. 쌓인 것을 해석하면 (chunked 틀이 빠지면) 자리가 생길 수 있다
+                if(connection_request_ready(conn) == 0 && conn->len < conn->cap)
+                {
+                    continue;
+                }
+                break;
+            }
+            if(new_cap > limit)
+            {
+                new_cap = limit;
+            }
+            // 작은 버퍼는 아레나에 남아 있다가 요청을 마칠 때 함께 돌아간다
+            new_buf = (char *)arena_alloc(conn->arena, new_cap);
+            if(new_buf == NULL)
+            {
+                closed = 1;
+                break;
+            }
+            memcpy(new_buf, conn->buf, conn->len);
+            conn->buf = new_buf;
+            conn->cap = new_cap;
+        }
+
+        n = recv(conn->fd, conn->buf + conn->len, conn->cap - conn->len, MSG_DONTWAIT);
+        if(n > 0)
+        {
+            conn->len += (size_t)n;
+            continue;
+        }
+        if(n == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if(n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            break;
+        }
+        closed = 1;    // EOF 또는 오류
+        break;
+    }
+
+    status = connection_request_ready(conn);
+    if(status == 1)
+    {
+        // 완성된 요청: 이제부터 연결은 워커 소유이며 리액터는 다시 등록하지 않는다
+        reactor->dispatch(conn, reactor->ctx);
+        return;
+    }
+    if(closed || conn->len == limit)
+    {
+        connection_free(conn);
+        return;
+    }
+
+    // 아직 요청이 덜 왔으므로 다시 대기
+    deadline_arm(reactor, conn);
+    if(connection_arm(conn, EPOLL_CTL_MOD) == -1)
+    {
+        LOG(LOG_ERROR, "epoll_ctl: %m");
+        deadline_cancel(reactor, conn);
+        connection_free(conn);
+    }
+}
+
+static void connection_free(Connection *conn)
+{
+    if(conn->h2 != NULL)
+    {
+        // 저장을 마친 POST 의 응답을 보내는 워커가 있거나 저장을 기다리는 POST 가 있으면 그쪽이 마지막에 해제한다
+        // 그러면 h2_session_close 뒤로는 연결을 건드릴 수 없으므로 소켓을 먼저 끊고 epoll 에서 뺀다
+        // (io_uring 은 걸어 둔 recv 가 없을 때만 여기에 온다)
+        if(conn->reactor->backend == REACTOR_EPOLL)
+        {
+            epoll_ctl(conn->reactor->epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+        }
+        shutdown(conn->fd, SHUT_RDWR);
+        if(!h2_session_close(conn->h2))
+        {
+            return;
+        }
+        h2_session_destroy(conn->h2);
+    }
+    close(conn->fd);
+    arena_destroy(conn->arena);
+}
+
+// 연결이 다음 요청을 기다리게 한다 (epoll 은 op 로 등록, io_uring 은 recv 를 건다)
+static int connection_arm(Connection *conn, int op)
+{
+    struct epoll_event ev;
+
+    if(conn->reactor->backend == REACTOR_URING)
+    {
+        return uring_arm_recv(conn);
+    }
+    memset(&ev, 0, sizeof(ev));
+    ev.events   = CONN_EVENTS;
+    ev.data.ptr = conn;
+    return epoll_ctl(conn->reactor->epfd, op, conn->fd, &ev);
+}
+
+// 연결의 상태에 맞는 제한 시간을 건다
+// 요청 사이에는 KEEPALIVE_TIMEOUT_MS (HTTP/2 스트림이 응답을 기다리면 SEND_TIMEOUT_MS), 헤더는 첫 바이트부터 HEADER_TIMEOUT_MS 안에 모두 와야 하고 (조금씩 보내도 늘어나지 않는다),
+// 본문은 BODY_TIMEOUT_MS 안에 조금이라도 더 와야 한다
+static void deadline_arm(Reactor *reactor, Connection *conn)
+{
+    uint64_t now = tick_now();
+    uint64_t expires;
+
+    if(conn->len == 0)
+    {
+        // 응답을 기다리는 스트림이 있는 HTTP/2 연결은 유휴 연결이 아니다 (저장 중인 POST, 창이 열리기를 기다리는 본문)
+        expires = now + (conn->h2 != NULL && h2_session_busy(conn->h2) ? SEND_TIMEOUT_MS : KEEPALIVE_TIMEOUT_MS) / TIMER_TICK_MS;
+    }
+    else if(conn->req.state != HTTP_STATE_DONE)
+    {
+        if(conn->request_start == 0)
+        {
+            conn->request_start = now;
+        }
+        expires = conn->request_start + HEADER_TIMEOUT_MS / TIMER_TICK_MS;
+    }
+    else
+    {
+        expires = now + BODY_TIMEOUT_MS / TIMER_TICK_MS;
+    }
+    pthread_mutex_lock(&(reactor->timer_mutex));
+    timer_add(&(reactor->timers), &(conn->timer), expires);
+    pthread_mutex_unlock(&(reactor->timer_mutex));
+}
+
+static void deadline_cancel(Reactor *reactor, Connection *conn)
+{
+    pthread_mutex_lock(&(reactor->timer_mutex));
+    timer_cancel(&(conn->timer));
+    pthread_mutex_unlock(&(reactor->timer_mutex));
+}
+
+// 제한 시간이 지난 연결을 닫는다
+static void deadline_expire(Reactor *reactor)
+{
+    Timer *timer;
+
+    pthread_mutex_lock(&(reactor->timer_mutex));
+    timer = timer_wheel_advance(&(reactor->timers), tick_now());
+    pthread_mutex_unlock(&(reactor->timer_mutex));
+
+    while(timer != NULL)
+    {
+        Connection *conn = TIMER_CONNECTION(timer);
+
+        timer = timer->next;
+        LOG(LOG_DEBUG, "connection %d: %s timeout", conn->fd, conn->len == 0 ? "idle" : conn->req.state != HTTP_STATE_DONE ? "header" : "body");
+        metrics_count(METRIC_TIMEOUTS, 1);
+        if(reactor->backend == REACTOR_URING)
+        {
+            // 걸려 있는 recv 가 버퍼를 쓰고 있으므로 소켓만 닫아 recv 를 끝내고, 해제는 완료를 받은 뒤에 한다
+            shutdown(conn->fd, SHUT_RDWR);
+            continue;
+        }
+        connection_free(conn);
+    }
+}
+
+// io_uring 을 만들고 accept 와 eventfd 읽기를 걸어 둔다
+static int uring_init_reactor(Reactor *reactor)
+{
+    if(uring_init(&(reactor->uring), URING_ENTRIES) == -1)
+    {
+        return -1;
+    }
+    reactor->multishot = 1;
+    atomic_init(&(reactor->recvs), 0);
+    if(uring_arm_accept(reactor) == -1 || uring_arm_wake(reactor) == -1 || uring_submit(&(reactor->uring)) == -1)
+    {
+        uring_destroy(&(reactor->uring));
+        return -1;
+    }
+    return 0;
+}
+
+// 쌓인 요청을 넘기고 완료를 기다려 처리한다. user_data 는 epoll 의 data.ptr 처럼 0 이 accept, 리액터 자신이 eventfd, 나머지는 연결
+static int uring_poll(Reactor *reactor, int timeout_ms)
+{
+    struct io_uring_cqe cqe;
+    int                 n = 0;
+
+    polling_reactor = reactor;
+    if(uring_wait(&(reactor->uring), timeout_ms) == -1)
+    {
+        LOG(LOG_ERROR, "io_uring_enter: %m");
+        return 0;
+    }
+    while(uring_peek(&(reactor->uring), &cqe))
+    {
+        if(cqe.user_data == 0)
+        {
+            uring_accepted(reactor, &cqe);
+        }
+        else if(cqe.user_data == (uintptr_t)reactor)
+        {
+            if(uring_arm_wake(reactor) == -1)
+            {
+                LOG(LOG_ERROR, "io_uring: %m");
+            }
+        }
+        else
+        {
+            uring_received(reactor, (Connection *)(uintptr_t)cqe.user_data, cqe.res);
+        }
+        n++;
+    }
+    deadline_expire(reactor);
+    return n;
+}
+
+// multishot 이면 한 번 걸어 둔 accept 가 연결마다 완료를 하나씩 낸다 (IORING_CQE_F_MORE 가 빠지면 다시 건다)
+static int uring_arm_accept(Reactor *reactor)
+{
+    struct io_uring_sqe sqe;
+
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode       = IORING_OP_ACCEPT;
+    sqe.fd           = reactor->listen_fd;
+    sqe.accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe.ioprio       = reactor->multishot ? IORING_ACCEPT_MULTISHOT : 0;
+    sqe.user_data    = 0;
+    return uring_queue(&(reactor->uring), &sqe);
+}
+
+// reactor_wake 가 eventfd 에 쓰면 이 읽기가 끝나면서 io_uring_enter 에서 잠든 리액터가 깬다
+static int uring_arm_wake(Reactor *reactor)
+{
+    struct io_uring_sqe sqe;
+
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode    = IORING_OP_READ;
+    sqe.fd        = reactor->wake_fd;
+    sqe.addr      = (uint64_t)(uintptr_t)&(reactor->wake_value);
+    sqe.len       = sizeof(reactor->wake_value);
+    sqe.user_data = (uint64_t)(uintptr_t)reactor;
+    return uring_queue(&(reactor->uring), &sqe);
+}
+
+// 버퍼의 남은 자리에 바로 받는 recv 를 건다 (epoll 과 달리 준비 알림과 recv 가 시스템 콜 하나로 묶인다)
+// 자리가 없으면 MAX_HEADER_SIZE + max_body 까지 키우고, 더 키울 수 없으면 -1
+static int uring_arm_recv(Connection *conn)
+{
+    Reactor            *reactor = conn->reactor;
+    size_t              limit   = MAX_HEADER_SIZE + reactor->max_body;
+    struct io_uring_sqe sqe;
+
+    if(conn->len == conn->cap)
+    {
+        size_t new_cap = conn->cap * 2;
+        char  *new_buf;
+
+        if(conn->cap >= limit)
+        {
+            return -1;
+        }
+        if(new_cap > limit)
+        {
+            new_cap = limit;
+        }
+        new_buf = (char *)arena_alloc(conn->arena, new_cap);
+        if(new_buf == NULL)
+        {
+            return -1;
+        }
+        memcpy(new_buf, conn->buf, conn->len);
+        conn->buf = new_buf;
+        conn->cap = new_cap;
+    }
+
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode    = IORING_OP_RECV;
+    sqe.fd        = conn->fd;
+    sqe.addr      = (uint64_t)(uintptr_t)(conn->buf + conn->len);
+    sqe.len       = (uint32_t)(conn->cap - conn->len);
+    sqe.user_data = (uint64_t)(uintptr_t)conn;
+    atomic_fetch_add(&(reactor->recvs), 1);
+    if(uring_queue(&(reactor->uring), &sqe) == -1)
+    {
+        atomic_fetch_sub(&(reactor->recvs), 1);
+        return -1;
+    }
+    return 0;
+}
+
+static void uring_accepted(Reactor *reactor, const struct io_uring_cqe *cqe)
+{
+    if(cqe->res >= 0)
+    {
+        connection_open(reactor, cqe->res, NULL);
+    }
+    else if(cqe->res == -EINVAL && reactor->multishot)
+    {
+        // multishot accept 가 없는 커널 (5.19 미만): 연결마다 다시 건다
+        reactor->multishot = 0;
+    }
+    else if(cqe->res == -EINVAL)
+    {
+        LOG(LOG_ERROR, "io_uring accept: %s", strerror(-cqe->res));
+        return;
+    }
+    else if(cqe->res != -EINTR && cqe->res != -ECONNABORTED && cqe->res != -EAGAIN)
+    {
+        LOG(LOG_ERROR, "io_uring accept: %s", strerror(-cqe->res));
+    }
+    if(!(cqe->flags & IORING_CQE_F_MORE) && uring_arm_accept(reactor) == -1)
+    {
+        LOG(LOG_ERROR, "io_uring accept: %m");
+    }
+}
+
+// handle_readable 과 같지만 데이터는 이미 버퍼에 들어와 있다
+static void uring_received(Reactor *reactor, Connection *conn, int res)
+{
+    size_t limit  = MAX_HEADER_SIZE + reactor->max_body;
+    int    closed = 0;
+
+    atomic_fetch_sub(&(reactor->recvs), 1);
+    deadline_cancel(reactor, conn);
+    if(res > 0)
+    {
+        conn->len += (size_t)res;
+    }
+    else if(res != -EINTR && res != -EAGAIN)
+    {
+        closed = 1;    // EOF 또는 오류
+    }
+
+    if(connection_request_ready(conn) == 1)
+    {
+        // 완성된 요청: 이제부터 연결은 워커 소유이며 리액터는 recv 를 걸지 않는다
+        reactor->dispatch(conn, reactor->ctx);
+        return;
+    }
+    if(closed || conn->len == limit)
+    {
+        connection_free(conn);
+        return;
+    }
+
+    // 아직 요청이 덜 왔으므로 다시 대기
+    deadline_arm(reactor, conn);
+    if(uring_arm_recv(conn) == -1)
+    {
+        LOG(LOG_ERROR, "io_uring recv: %m");
+        deadline_cancel(reactor, conn);
+        connection_free(conn);
+    }
+}
+
+// 워커를 모두 멈춘 뒤에 불린다. 유휴 연결의 소켓을 닫아 걸려 있는 recv 를 끝내고, 완료가 모두 돌아오면 연결을 해제한다
+static void uring_close(Reactor *reactor)
+{
+    struct io_uring_cqe cqe;
+
+    for(Timer *timer = timer_wheel_take_all(&(reactor->timers)); timer != NULL;)
+    {
+        Connection *conn = TIMER_CONNECTION(timer);
+
+        timer = timer->next;
+        shutdown(conn->fd, SHUT_RDWR);
+    }
+
+    for(int tries = 0; atomic_load(&(reactor->recvs)) > 0 && tries < URING_CLOSE_TRIES; ++tries)
+    {
+        uring_wait(&(reactor->uring), 100);
+        while(uring_peek(&(reactor->uring), &cqe))
+        {
+            if(cqe.user_data == 0)
+            {
+                if(cqe.res >= 0)
+                {
+                    close(cqe.res);
+                }
+            }
+            else if(cqe.user_data != (uintptr_t)reactor)
+            {
+                Connection *conn = (Connection *)(uintptr_t)cqe.user_data;
+
+                atomic_fetch_sub(&(reactor->recvs), 1);
+                deadline_cancel(reactor, conn);
+                connection_free(conn);
+            }
+        }
+    }
+    uring_destroy(&(reactor->uring));
+}
+
+static uint64_t tick_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000) / TIMER_TICK_MS;
+}
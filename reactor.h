@@ -0,0 +1,92 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include "arena.h"
+#include "form_parser.h"
+#include "http_parser.h"
+#include "timer_wheel.h"
+#include "uring.h"
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <time.h>
+
+#define MAX_EVENTS 256                 // epoll_wait 한 번에 처리할 최대 이벤트 수
+#define CONN_BUF_SIZE 4096             // 연결 구조체에 들어 있는 기본 수신 버퍼 크기
+#define MAX_HEADER_SIZE (16 * 1024)    // 요청 줄 + 헤더 최대 크기 (넘으면 431)
+#define DEFAULT_MAX_BODY (1 << 20)     // 본문 최대 크기 기본값 (넘으면 413)
+#define TIMER_TICK_MS 100              // 연결 제한 시간의 단위
+#define KEEPALIVE_TIMEOUT_MS 5000      // 요청 사이에 유휴 연결을 닫기까지의 시간
+#define HEADER_TIMEOUT_MS 10000        // 요청의 첫 바이트부터 헤더를 모두 받기까지의 시간 (느리게 보내는 클라이언트)
+#define BODY_TIMEOUT_MS 10000          // 본문이 더 오지 않으면 닫기까지의 시간
+#define SEND_TIMEOUT_MS 10000          // 응답을 읽지 않는 클라이언트에 워커가 쓰기를 기다리는 시간 (응답 마감의 기본값)
+#define SEND_MIN_RATE (64 * 1024)      // 본문을 이보다 느리게 (바이트/초) 읽는 클라이언트는 응답 마감에 걸려 끊긴다
+#define URING_ENTRIES 1024             // 리액터마다 io_uring 제출 큐 크기
+
+// 리액터가 소켓을 기다리는 방식
+#define REACTOR_EPOLL 0    // epoll 로 읽을 수 있게 된 소켓을 알려 받아 recv 한다
+#define REACTOR_URING 1    // io_uring 에 accept 와 recv 를 걸어 두고 완료를 받는다 (시스템 콜을 묶는다)
+
+typedef struct Reactor   Reactor;
+typedef struct H2Session H2Session;
+typedef struct H2Stream  H2Stream;
+
+// 클라이언트 연결 구조체 정의
+// 연결의 아레나 첫 블록에 들어 있다. 요청을 처리하며 쓰는 메모리 (키운 수신 버퍼, 응답 버퍼, POST 저장 대기) 도
+// 같은 아레나에서 받고, 요청을 마치면 connection_consume 이 한꺼번에 되돌린다
+typedef struct Connection
+{
+    int            fd;               // 클라이언트 소켓
+    struct in_addr addr;             // 클라이언트 주소 (접근 로그)
+    Arena         *arena;            // 이 연결의 메모리
+    char          *buf;              // 수신 버퍼 (처음에는 inline_buf, 요청이 크면 아레나에서 키운 버퍼)
+    size_t         len;              // 버퍼에 쌓인 바이트 수
+    size_t         cap;              // 버퍼 용량
+    size_t         req_len;          // 완성된 요청의 길이 (헤더 + 본문)
+    HttpRequest    req;              // 버퍼 앞쪽 요청의 파서 상태 (읽을 때마다 이어서 해석한다)
+    FormParser     form;             // 본문의 urlencoded 필드 (본문이 도착하는 대로 나눈다)
+    Reactor       *reactor;          // 이 연결을 소유한 리액터
+    uint64_t       dispatched;       // 워커에게 넘긴 시각 (ns, 큐 대기 지표)
+    uint64_t       request_start;    // 지금 요청의 첫 바이트를 기다리기 시작한 틱 (0 이면 아직, 헤더 제한 시간)
+    uint64_t       send_deadline;    // 워커가 지금 응답을 다 보내야 하는 시각 (ns, 쓰기가 막히면 이때까지만 기다린다)
+    Timer          timer;            // 리액터가 기다리는 동안의 제한 시간
+    int            priority;         // 처리 중인 요청의 우선순위 (ADMIT_*, 거절했으면 -1)
+    H2Session     *h2;               // HTTP/2 로 바뀐 연결의 세션 (NULL 이면 HTTP/1.x)
+    H2Stream      *stream;           // HTTP/2 스트림의 요청이면 그 스트림 (응답을 프레임으로 보낸다)
+    char           inline_buf[CONN_BUF_SIZE];    // 기본 수신 버퍼 (맨 뒤에 두어 초기화하지 않는다)
+} Connection;
+
+// 요청이 완성된 연결을 워커에게 넘기는 콜백
+typedef void (*DispatchFunction)(Connection *conn, void *ctx);
+
+// 리액터 구조체 정의 (워커 스레드 하나가 소유하고 돌린다)
+struct Reactor
+{
+    int              backend;      // REACTOR_EPOLL 또는 REACTOR_URING
+    int              epfd;         // epoll 인스턴스
+    int              listen_fd;    // 논블로킹 리슨 소켓 (SO_REUSEPORT 로 리액터마다 하나)
+    int              wake_fd;      // epoll_wait 에서 잠든 리액터를 깨우는 eventfd
+    DispatchFunction dispatch;     // 요청 완성 시 호출할 함수
+    void            *ctx;          // dispatch 에 넘길 인자
+    size_t           max_body;     // 본문 최대 크기 (연결 버퍼는 MAX_HEADER_SIZE + max_body 까지만 커진다)
+    pthread_mutex_t  timer_mutex;  // timers 에 대한 뮤텍스 (워커도 연결을 되돌려 놓는다)
+    TimerWheel       timers;       // 리액터가 기다리는 연결의 제한 시간
+    Uring            uring;        // REACTOR_URING: accept, recv, eventfd 읽기를 걸어 두는 링
+    uint64_t         wake_value;   // REACTOR_URING: eventfd 를 읽어 들이는 자리
+    int              multishot;    // REACTOR_URING: accept 하나로 여러 연결을 받는다 (5.19 미만이면 0)
+    atomic_uint      recvs;        // REACTOR_URING: 걸려 있는 recv 수 (닫을 때 모두 돌아올 때까지 기다린다)
+};
+
+int  reactor_init(Reactor *reactor, int listen_fd, size_t max_body, int backend, DispatchFunction dispatch, void *ctx);
+int  reactor_poll(Reactor *reactor, int timeout_ms);
+void reactor_wake(Reactor *reactor);
+void reactor_close(Reactor *reactor);
+int  connection_request_ready(Connection *conn);
+void connection_consume(Connection *conn);
+void connection_resume(Connection *conn);
+void connection_finish(Connection *conn);
+void connection_send_begin(Connection *conn);
+void connection_send_extend(Connection *conn, uint64_t len);
+
+#endif
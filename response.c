@@ -0,0 +1,246 @@
+#include "response.h"
+#include "metrics.h"
+#include <errno.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+
+#define STATIC_LINE(str) \
+    do \
+    { \
+        *len = sizeof(str) - 1; \
+        return str; \
+    } while(0)
+
+static const char  *status_line(int status, size_t *len);
+static const char  *server_date(size_t *len);
+
+static const char conn_keep[]  = "Connection: keep-alive\r\n\r\n";
+static const char conn_close[] = "Connection: close\r\n\r\n";
+
+// 스레드마다 초가 바뀔 때만 다시 만드는 "Server: ...\r\nDate: ...\r\n"
+static _Thread_local time_t date_second = -1;
+static _Thread_local char   date_header[96];
+static _Thread_local size_t date_len;
+
+// 상태 줄과 Server, Date 로 시작한다
+void response_init(Response *res, int status)
+{
+    const char *line;
+    size_t      len;
+
+    res->iovcnt   = 0;
+    res->overflow = 0;
+    res->used     = 0;
+    line          = status_line(status, &len);
+    if(line == NULL)
+    {
+        response_printf(res, "HTTP/1.1 %d %s\r\n", status, status_reason(status));
+    }
+    else
+    {
+        response_add(res, line, len);
+    }
+    line = server_date(&len);
+    response_add(res, line, len);
+}
+
+// 그대로 보낼 조각을 붙인다 (헤더 조각이나 본문)
+void response_add(Response *res, const void *data, size_t len)
+{
+    if(len == 0)
+    {
+        return;
+    }
+    if(res->iovcnt == RESPONSE_IOV_MAX)
+    {
+        res->overflow = 1;
+        return;
+    }
+    res->iov[res->iovcnt].iov_base  = (void *)data;
+    res->iov[res->iovcnt++].iov_len = len;
+}
+
+// 형식을 채운 헤더를 scratch 에 쓰고 조각으로 붙인다
+void response_printf(Response *res, const char *format, ...)
+{
+    size_t  avail = RESPONSE_SCRATCH - res->used;
+    va_list args;
+    int     n;
+
+    va_start(args, format);
+    n = vsnprintf(res->scratch + res->used, avail, format, args);
+    va_end(args);
+    if(n < 0 || (size_t)n >= avail)
+    {
+        res->overflow = 1;
+        return;
+    }
+    response_add(res, res->scratch + res->used, (size_t)n);
+    res->used += (size_t)n;
+}
+
+// Connection 헤더와 헤더 끝의 빈 줄
+void response_end_headers(Response *res, int keep_alive)
+{
+    if(keep_alive)
+    {
+        response_add(res, conn_keep, sizeof(conn_keep) - 1);
+    }
+    else
+    {
+        response_add(res, conn_close, sizeof(conn_close) - 1);
+    }
+}
+
+// 모은 조각을 sendmsg 로 보낸다. 일부만 나가면 남은 조각을 이어서 보낸다
+// more 가 1 이면 곧 본문이 이어진다고 알려 (MSG_MORE) 헤더와 sendfile 의 첫 바이트가 한 세그먼트로 나가게 한다
+// 보낸 뒤에는 조각을 비우므로 같은 응답에 이어서 붙일 수 있다 (scratch 는 그대로 남는다)
+// 소켓은 논블로킹이므로 버퍼가 차면 deadline (ns, metrics_now 기준) 까지만 기다린다
+int response_send(Response *res, int sock, int more, uint64_t deadline)
+{
+    struct msghdr msg;
+    struct iovec *iov    = res->iov;
+    int           iovcnt = res->iovcnt;
+
+    if(res->overflow)
+    {
+        return -1;
+    }
+    res->iovcnt = 0;
+    memset(&msg, 0, sizeof(msg));
+    while(iovcnt > 0)
+    {
+        ssize_t n;
+
+        msg.msg_iov    = iov;
+        msg.msg_iovlen = (size_t)iovcnt;
+        n              = sendmsg(sock, &msg, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+        if(n == -1)
+        {
+            if(errno == EINTR || ((errno == EAGAIN || errno == EWOULDBLOCK) && response_wait(sock, deadline) == 0))
+            {
+                continue;
+            }
+            return -1;
+        }
+        while(iovcnt > 0 && (size_t)n >= iov->iov_len)
+        {
+            n -= (ssize_t)iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if(iovcnt > 0)
+        {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= (size_t)n;
+        }
+    }
+    return 0;
+}
+
+// 소켓에 다시 쓸 수 있을 때까지 기다린다. deadline 이 지나면 -1 (ETIMEDOUT)
+// 기다림마다 시간을 새로 주지 않으므로 조금씩 읽는 클라이언트도 응답 하나를 deadline 넘게 붙잡지 못한다
+int response_wait(int sock, uint64_t deadline)
+{
+    struct pollfd pfd = {sock, POLLOUT, 0};
+
+    while(1)
+    {
+        uint64_t now = metrics_now();
+        int      ready;
+
+        if(now >= deadline)
+        {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+        ready = poll(&pfd, 1, (int)((deadline - now + 999999) / 1000000));
+        if(ready > 0)
+        {
+            return 0;
+        }
+        if(ready == -1 && errno != EINTR)
+        {
+            return -1;
+        }
+    }
+}
+
+const char *status_reason(int status)
+{
+    switch(status)
+    {
+        case 101:
+            return "Switching Protocols";
+        case 200:
+            return "OK";
+        case 206:
+            return "Partial Content";
+        case 304:
+            return "Not Modified";
+        case 404:
+            return "Not Found";
+        case 412:
+            return "Precondition Failed";
+        case 413:
+            return "Content Too Large";
+        case 416:
+            return "Range Not Satisfiable";
+        case 431:
+            return "Request Header Fields Too Large";
+        case 500:
+            return "Internal Server Error";
+        case 501:
+            return "Not Implemented";
+        case 503:
+            return "Service Unavailable";
+        default:
+            return "Bad Request";
+    }
+}
+
+// 자주 보내는 상태 줄은 문자열 상수로 둔다. 없으면 NULL (response_init 이 형식을 채운다)
+static const char *status_line(int status, size_t *len)
+{
+    switch(status)
+    {
+        case 200:
+            STATIC_LINE("HTTP/1.1 200 OK\r\n");
+        case 206:
+            STATIC_LINE("HTTP/1.1 206 Partial Content\r\n");
+        case 304:
+            STATIC_LINE("HTTP/1.1 304 Not Modified\r\n");
+        case 400:
+            STATIC_LINE("HTTP/1.1 400 Bad Request\r\n");
+        case 404:
+            STATIC_LINE("HTTP/1.1 404 Not Found\r\n");
+        case 503:
+            STATIC_LINE("HTTP/1.1 503 Service Unavailable\r\n");
+        default:
+            return NULL;
+    }
+}
+
+// time 은 vDSO 라 시스템 콜이 아니다. 형식을 채우는 것 (gmtime_r, strftime) 만 초마다 한 번
+static const char *server_date(size_t *len)
+{
+    time_t now = time(NULL);
+
+    if(now != date_second)
+    {
+        struct tm tm;
+        size_t    n;
+
+        gmtime_r(&now, &tm);
+        n = (size_t)snprintf(date_header, sizeof(date_header), "Server: %s\r\nDate: ", SERVER_NAME);
+        n += strftime(date_header + n, sizeof(date_header) - n, "%a, %d %b %Y %H:%M:%S GMT\r\n", &tm);
+        date_len    = n;
+        date_second = now;
+    }
+    *len = date_len;
+    return date_header;
+}
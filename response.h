@@ -0,0 +1,32 @@
+#ifndef RESPONSE_H
+#define RESPONSE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#define RESPONSE_IOV_MAX 40         // 조각 수 (multipart 는 범위마다 머리와 본문 두 조각)
+#define RESPONSE_SCRATCH 512        // response_printf 로 만든 헤더를 담는 자리
+#define SERVER_NAME "Simple HTTP Server"
+
+// 응답 하나를 조각 (iovec) 으로 모았다가 시스템 콜 한 번으로 보내는 구조체 정의
+// 상태 줄과 Server, Date, Connection 같은 고정 조각은 미리 만들어 둔 문자열을 가리키기만 하고
+// 요청마다 다른 헤더만 scratch 에 형식을 채운다. 본문 조각은 복사하지 않으므로 보낼 때까지 그대로 있어야 한다
+typedef struct
+{
+    struct iovec iov[RESPONSE_IOV_MAX];
+    int          iovcnt;
+    int          overflow;                     // 조각이나 scratch 가 모자랐다 (response_send 가 -1)
+    size_t       used;                         // scratch 에 쓴 바이트
+    char         scratch[RESPONSE_SCRATCH];
+} Response;
+
+void        response_init(Response *res, int status);
+void        response_add(Response *res, const void *data, size_t len);
+void        response_printf(Response *res, const char *format, ...) __attribute__((format(printf, 2, 3)));
+void        response_end_headers(Response *res, int keep_alive);
+int         response_send(Response *res, int sock, int more, uint64_t deadline);
+int         response_wait(int sock, uint64_t deadline);
+const char *status_reason(int status);
+
+#endif
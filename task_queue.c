@@ -0,0 +1,217 @@
+#include "task_queue.h"
+#include "futex.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static void cpu_relax(void);
+static void wake_producer(TaskQueue *queue);
+
+// 용량을 2의 거듭제곱으로 올려서 칸을 만든다
+int task_queue_init(TaskQueue *queue, size_t capacity)
+{
+    size_t size = 2;
+
+    while(size < capacity)
+    {
+        size <<= 1;
+    }
+
+    queue->cells = (TaskCell *)aligned_alloc(CACHE_LINE, ((size * sizeof(TaskCell) + CACHE_LINE - 1) / CACHE_LINE) * CACHE_LINE);
+    if(queue->cells == NULL)
+    {
+        return -1;
+    }
+    for(size_t i = 0; i < size; ++i)
+    {
+        atomic_init(&(queue->cells[i].sequence), i);
+    }
+    queue->mask = size - 1;
+    atomic_init(&(queue->enqueue_pos), 0);
+    atomic_init(&(queue->dequeue_pos), 0);
+    atomic_init(&(queue->not_full_seq), 0);
+    atomic_init(&(queue->push_waiting), 0);
+    atomic_init(&(queue->closed), 0);
+    idle_set_init(&(queue->idle));
+
+    // CPU 가 하나뿐이면 기다리는 동안 상대가 실행될 수 없으므로 돌지 않고 바로 잠든다
+    queue->spin = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? QUEUE_SPIN : 0;
+    return 0;
+}
+
+void task_queue_destroy(TaskQueue *queue)
+{
+    free(queue->cells);
+    queue->cells = NULL;
+}
+
+// 가득 찼으면 -1
+int task_queue_try_push(TaskQueue *queue, const Task *task)
+{
+    size_t    pos = atomic_load_explicit(&(queue->enqueue_pos), memory_order_relaxed);
+    TaskCell *cell;
+
+    while(1)
+    {
+        cell          = &(queue->cells[pos & queue->mask]);
+        size_t   seq  = atomic_load_explicit(&(cell->sequence), memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if(diff == 0)
+        {
+            // 이 칸을 차지한다
+            if(atomic_compare_exchange_weak_explicit(&(queue->enqueue_pos), &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if(diff < 0)
+        {
+            return -1;
+        }
+        else
+        {
+            pos = atomic_load_explicit(&(queue->enqueue_pos), memory_order_relaxed);
+        }
+    }
+
+    cell->task = *task;
+    atomic_store_explicit(&(cell->sequence), pos + 1, memory_order_release);
+    idle_set_wake_one(&(queue->idle));
+    return 0;
+}
+
+// 비었으면 -1
+int task_queue_try_pop(TaskQueue *queue, Task *task)
+{
+    size_t    pos = atomic_load_explicit(&(queue->dequeue_pos), memory_order_relaxed);
+    TaskCell *cell;
+
+    while(1)
+    {
+        cell          = &(queue->cells[pos & queue->mask]);
+        size_t   seq  = atomic_load_explicit(&(cell->sequence), memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+        if(diff == 0)
+        {
+            if(atomic_compare_exchange_weak_explicit(&(queue->dequeue_pos), &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if(diff < 0)
+        {
+            return -1;
+        }
+        else
+        {
+            pos = atomic_load_explicit(&(queue->dequeue_pos), memory_order_relaxed);
+        }
+    }
+
+    *task = cell->task;
+    // 한 바퀴 뒤의 생산자가 쓸 수 있도록 칸을 비운다
+    atomic_store_explicit(&(cell->sequence), pos + queue->mask + 1, memory_order_release);
+    wake_producer(queue);
+    return 0;
+}
+
+// 큐가 가득 차면 자리가 날 때까지 잠든다
+void task_queue_push(TaskQueue *queue, const Task *task)
+{
+    while(1)
+    {
+        for(int i = 0; i < queue->spin; ++i)
+        {
+            if(task_queue_try_push(queue, task) == 0)
+            {
+                return;
+            }
+            cpu_relax();
+        }
+
+        unsigned int seq = atomic_load(&(queue->not_full_seq));
+        atomic_store(&(queue->push_waiting), 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        // 기다린다고 알린 뒤 다시 확인해야 깨우기를 놓치지 않는다
+        if(task_queue_try_push(queue, task) == 0)
+        {
+            return;
+        }
+        futex_wait(&(queue->not_full_seq), seq);
+    }
+}
+
+// 작업이 들어올 때까지 잠든다. 큐가 닫혔고 비어 있으면 -1
+// consumer 는 0 ~ QUEUE_MAX_CONSUMERS-1 사이의 소비자 고유 번호
+int task_queue_pop(TaskQueue *queue, Task *task, int consumer)
+{
+    while(1)
+    {
+        for(int i = 0; i <= queue->spin; ++i)
+        {
+            if(task_queue_try_pop(queue, task) == 0)
+            {
+                // 작업이 더 남아 있으면 다른 소비자를 깨워 나눠 맡긴다
+                if(atomic_load_explicit(&(queue->enqueue_pos), memory_order_relaxed) != atomic_load_explicit(&(queue->dequeue_pos), memory_order_relaxed))
+                {
+                    idle_set_wake_one(&(queue->idle));
+                }
+                return 0;
+            }
+            cpu_relax();
+        }
+
+        unsigned int seq = idle_set_prepare(&(queue->idle), consumer);
+        // 잠든다고 알린 뒤 다시 확인해야 깨우기를 놓치지 않는다
+        if(task_queue_try_pop(queue, task) == 0)
+        {
+            idle_set_cancel(&(queue->idle), consumer);
+            return 0;
+        }
+        if(atomic_load(&(queue->closed)))
+        {
+            idle_set_cancel(&(queue->idle), consumer);
+            return -1;
+        }
+        idle_set_wait(&(queue->idle), consumer, seq);
+    }
+}
+
+// 잠든 소비자를 모두 깨운다. 남은 작업은 그대로 꺼낼 수 있다
+void task_queue_close(TaskQueue *queue)
+{
+    atomic_store(&(queue->closed), 1);
+    idle_set_wake_all(&(queue->idle));
+}
+
+// 대략적인 작업 수 (넣는 중이거나 꺼내는 중인 칸도 센다)
+size_t task_queue_size(TaskQueue *queue)
+{
+    size_t dequeue_pos = atomic_load_explicit(&(queue->dequeue_pos), memory_order_relaxed);
+    size_t enqueue_pos = atomic_load_explicit(&(queue->enqueue_pos), memory_order_relaxed);
+    return enqueue_pos > dequeue_pos ? enqueue_pos - dequeue_pos : 0;
+}
+
+static void cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    atomic_signal_fence(memory_order_seq_cst);
+#endif
+}
+
+// 가득 찬 큐에서 잠든 생산자가 있을 때만 futex 시스템 콜을 한다
+// 플래그를 지운 쪽만 깨우므로 생산자가 실행되기 전에 여러 번 꺼내도 시스템 콜은 한 번이다
+static void wake_producer(TaskQueue *queue)
+{
+    // 칸을 비운 뒤 플래그를 읽는 순서가 바뀌지 않도록 한다
+    atomic_thread_fence(memory_order_seq_cst);
+    if(atomic_load_explicit(&(queue->push_waiting), memory_order_relaxed) && atomic_exchange(&(queue->push_waiting), 0))
+    {
+        atomic_fetch_add(&(queue->not_full_seq), 1);
+        futex_wake(&(queue->not_full_seq), INT_MAX);
+    }
+}
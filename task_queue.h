@@ -0,0 +1,48 @@
+#ifndef TASK_QUEUE_H
+#define TASK_QUEUE_H
+
+#include "idle_set.h"
+#include <stdatomic.h>
+#include <stddef.h>
+
+#define QUEUE_SPIN 64                       // 잠들기 전에 다시 시도하는 횟수
+#define QUEUE_MAX_CONSUMERS IDLE_SET_MAX    // 잠든 소비자를 IdleSet 으로 관리한다
+
+// 작업 구조체 정의
+typedef struct
+{
+    void (*function)(void *);    // 작업 함수 포인터
+    void *argument;              // 작업 인자
+} Task;
+
+// 큐 칸: sequence 로 칸의 상태(비었음/찼음)와 차례를 나타낸다
+typedef struct
+{
+    atomic_size_t sequence;
+    Task          task;
+} TaskCell;
+
+// 락 없는 bounded MPMC 작업 큐 (Vyukov 방식)
+typedef struct
+{
+    _Alignas(CACHE_LINE) atomic_size_t enqueue_pos;    // 다음에 넣을 위치
+    _Alignas(CACHE_LINE) atomic_size_t dequeue_pos;    // 다음에 꺼낼 위치
+    _Alignas(CACHE_LINE) TaskCell *cells;
+    size_t             mask;                           // 용량 - 1 (용량은 2의 거듭제곱)
+    int                spin;                           // 잠들기 전 재시도 횟수 (CPU 가 하나면 0)
+    atomic_int         closed;                         // 종료 여부
+    atomic_uint        not_full_seq;                   // 생산자가 잠드는 futex
+    atomic_uint        push_waiting;                   // 잠든 생산자가 있으면 1 (깨우는 쪽이 지운다)
+    IdleSet            idle;                           // 잠든 소비자
+} TaskQueue;
+
+int    task_queue_init(TaskQueue *queue, size_t capacity);
+void   task_queue_destroy(TaskQueue *queue);
+int    task_queue_try_push(TaskQueue *queue, const Task *task);
+int    task_queue_try_pop(TaskQueue *queue, Task *task);
+void   task_queue_push(TaskQueue *queue, const Task *task);
+int    task_queue_pop(TaskQueue *queue, Task *task, int consumer);
+void   task_queue_close(TaskQueue *queue);
+size_t task_queue_size(TaskQueue *queue);
+
+#endif
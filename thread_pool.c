@@ -0,0 +1,408 @@
+#define _GNU_SOURCE
+#include "thread_pool.h"
+#include "futex.h"
+#include <sched.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// 지금 스레드가 워커라면 그 워커 (워커가 추가하는 작업은 자기 덱에 넣는다)
+static _Thread_local Worker *current_worker;
+
+static int  find_task(Worker *worker, Task *task);
+static int  refill_from_injector(Worker *worker, Task *task);
+static int  steal_task(Worker *worker, Task *task);
+static int  has_work(ThreadPool *pool);
+static int  allowed_cpus(int *cpus, int max);
+static void run_task(ThreadPool *pool, const Task *task);
+static void wake_worker(ThreadPool *pool);
+static void wake_all_workers(ThreadPool *pool);
+
+// 스레드 함수
+noreturn void *thread_function(void *arg)
+{
+    Worker      *worker = (Worker *)arg;
+    ThreadPool  *pool   = worker->pool;
+    unsigned int ticks  = 0;
+    Task         task;
+
+    current_worker = worker;
+    while(1)
+    {
+        // 작업이 밀려 있어도 새 연결과 요청을 너무 오래 기다리게 하지 않는다
+        if(worker->poll != NULL && ++ticks % LOOP_POLL_INTERVAL == 0)
+        {
+            worker->poll(worker->loop_ctx, 0);
+        }
+
+        if(find_task(worker, &task) == 0)
+        {
+            // 남은 일감이 보이면 잠든 워커를 하나 깨워 훔쳐 가게 한다
+            if(has_work(pool))
+            {
+                wake_worker(pool);
+            }
+            run_task(pool, &task);
+            continue;
+        }
+        // 종료 중에는 새 요청을 받지 않고 남은 작업만 끝낸다
+        if(worker->poll != NULL && !atomic_load_explicit(&(pool->shutdown), memory_order_relaxed) && worker->poll(worker->loop_ctx, 0) > 0)
+        {
+            continue;
+        }
+
+        unsigned int seq = idle_set_prepare(&(pool->idle), worker->id);
+        // 잠든다고 알린 뒤 다시 확인해야 깨우기를 놓치지 않는다
+        if(has_work(pool))
+        {
+            idle_set_cancel(&(pool->idle), worker->id);
+            continue;
+        }
+        // 종료 중이어도 나중에 이어질 작업(thread_pool_hold)이 남아 있으면 기다린다
+        if(atomic_load(&(pool->shutdown)) && atomic_load(&(pool->active_tasks)) == 0)
+        {
+            idle_set_cancel(&(pool->idle), worker->id);
+            break;
+        }
+        if(worker->poll != NULL && !atomic_load(&(pool->shutdown)))
+        {
+            // 이벤트 루프가 있는 워커는 epoll 에서 잠들고 wake 로 깨운다
+            worker->poll(worker->loop_ctx, LOOP_IDLE_TIMEOUT);
+            idle_set_cancel(&(pool->idle), worker->id);
+        }
+        else
+        {
+            idle_set_wait(&(pool->idle), worker->id, seq);
+        }
+    }
+
+    pthread_exit(NULL);
+}
+
+// 스레드 풀 초기화 함수 (스레드는 thread_pool_start 에서 만든다)
+// nthreads 가 0 이하이면 CPU affinity mask 의 CPU 수만큼 만들고, pin 이면 워커를 CPU 하나에 고정한다
+int thread_pool_init(ThreadPool *pool, int nthreads, int pin)
+{
+    int cpus[THREAD_POOL_MAX];
+    int ncpu = allowed_cpus(cpus, THREAD_POOL_MAX);
+
+    if(nthreads <= 0)
+    {
+        nthreads = ncpu;
+    }
+    if(nthreads > THREAD_POOL_MAX)
+    {
+        nthreads = THREAD_POOL_MAX;
+    }
+
+    pool->nthreads = nthreads;
+    atomic_init(&(pool->active_tasks), 0);
+    atomic_init(&(pool->shutdown), 0);
+    idle_set_init(&(pool->idle));
+    if(task_queue_init(&(pool->task_queue), (size_t)TASK_QUEUE_SIZE * (size_t)nthreads) == -1)
+    {
+        return -1;
+    }
+    pool->workers = (Worker *)aligned_alloc(CACHE_LINE, sizeof(Worker) * (size_t)nthreads);
+    if(pool->workers == NULL)
+    {
+        task_queue_destroy(&(pool->task_queue));
+        return -1;
+    }
+
+    for(int i = 0; i < nthreads; ++i)
+    {
+        Worker *worker = &(pool->workers[i]);
+
+        work_deque_init(&(worker->deque));
+        worker->pool     = pool;
+        worker->id       = i;
+        worker->cpu      = pin ? cpus[i % ncpu] : -1;
+        worker->seed     = (unsigned int)i * 2654435761U + 1;
+        worker->poll     = NULL;
+        worker->wake     = NULL;
+        worker->loop_ctx = NULL;
+    }
+    return 0;
+}
+
+// 워커 id 가 돌릴 이벤트 루프를 붙인다 (thread_pool_start 전에 호출)
+void thread_pool_attach_loop(ThreadPool *pool, int id, PollFunction poll, WakeFunction wake, void *ctx)
+{
+    pool->workers[id].poll     = poll;
+    pool->workers[id].wake     = wake;
+    pool->workers[id].loop_ctx = ctx;
+}
+
+// 스레드 풀 생성
+void thread_pool_start(ThreadPool *pool)
+{
+    for(int i = 0; i < pool->nthreads; ++i)
+    {
+        Worker        *worker = &(pool->workers[i]);
+        pthread_attr_t attr;
+
+        pthread_attr_init(&attr);
+        if(worker->cpu >= 0)
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(worker->cpu, &set);
+            pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+        }
+        pthread_create(&(worker->thread), &attr, thread_function, (void *)worker);
+        pthread_attr_destroy(&attr);
+    }
+}
+
+// 작업 추가 함수
+// 워커가 추가하면 자기 덱에, 다른 스레드가 추가하면 주입 큐에 넣는다
+// 다른 스레드는 주입 큐가 가득 차면 기다리지만, 워커는 기다리면 아무도 큐를 비우지 못할 수 있으므로 직접 실행한다
+void thread_pool_add_task(ThreadPool *pool, void (*function)(void *), void *argument)
+{
+    Task task;
+
+    task.function = function;
+    task.argument = argument;
+
+    // 작업이 실행되기 전에 세어야 wait_all 이 먼저 끝나지 않는다
+    atomic_fetch_add(&(pool->active_tasks), 1);
+    if(current_worker == NULL || current_worker->pool != pool)
+    {
+        task_queue_push(&(pool->task_queue), &task);
+    }
+    else if(work_deque_push(&(current_worker->deque), &task) == -1 && task_queue_try_push(&(pool->task_queue), &task) == -1)
+    {
+        run_task(pool, &task);
+        return;
+    }
+    wake_worker(pool);
+}
+
+// 작업이 끝난 뒤에도 다른 스레드가 이어서 작업을 넣을 예정이면 그때까지 센다 (wait_all 과 종료가 기다린다)
+void thread_pool_hold(ThreadPool *pool)
+{
+    atomic_fetch_add(&(pool->active_tasks), 1);
+}
+
+// 작업 하나 또는 thread_pool_hold 하나가 끝났다
+void thread_pool_release(ThreadPool *pool)
+{
+    // 모든 작업이 완료됐는지 확인하고 통지
+    if(atomic_fetch_sub(&(pool->active_tasks), 1) == 1)
+    {
+        futex_wake(&(pool->active_tasks), INT_MAX);
+        if(atomic_load(&(pool->shutdown)))
+        {
+            wake_all_workers(pool);
+        }
+    }
+}
+
+// 모든 작업이 완료될 때까지 대기
+void thread_pool_wait_all_tasks_completed(ThreadPool *pool)
+{
+    unsigned int active;
+
+    while((active = atomic_load(&(pool->active_tasks))) > 0)
+    {
+        futex_wait(&(pool->active_tasks), active);
+    }
+}
+
+// 주입 큐와 모든 덱에서 기다리는 작업 수 (지표용, 락 없이 읽으므로 대략적인 값)
+size_t thread_pool_queued(ThreadPool *pool)
+{
+    size_t queued = task_queue_size(&(pool->task_queue));
+
+    for(int i = 0; i < pool->nthreads; ++i)
+    {
+        queued += (size_t)work_deque_size(&(pool->workers[i].deque));
+    }
+    return queued;
+}
+
+// 스레드 풀 종료 함수 (남은 작업은 끝까지 실행한다)
+void thread_pool_shutdown(ThreadPool *pool)
+{
+    atomic_store(&(pool->shutdown), 1);
+    task_queue_close(&(pool->task_queue));
+    wake_all_workers(pool);
+
+    // 스레드 조인
+    for(int i = 0; i < pool->nthreads; ++i)
+    {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+
+    task_queue_destroy(&(pool->task_queue));
+    free(pool->workers);
+    pool->workers = NULL;
+}
+
+// 자기 덱 -> 주입 큐 -> 다른 워커의 덱 순서로 작업을 찾는다. 없으면 -1
+static int find_task(Worker *worker, Task *task)
+{
+    if(work_deque_take(&(worker->deque), task) == 0)
+    {
+        return 0;
+    }
+    if(refill_from_injector(worker, task) == 0)
+    {
+        return 0;
+    }
+    return steal_task(worker, task);
+}
+
+// 주입 큐에서 하나를 꺼내고, 워커 수로 나눈 몫만큼 더 꺼내 자기 덱에 옮긴다
+// 워커마다 조금씩 가져가므로 주입 큐의 CAS 경쟁이 줄고, 나머지 워커는 덱에서 훔쳐 간다
+static int refill_from_injector(Worker *worker, Task *task)
+{
+    ThreadPool *pool = worker->pool;
+    size_t      pending;
+    size_t      batch;
+    Task        extra;
+
+    if(task_queue_try_pop(&(pool->task_queue), task) == -1)
+    {
+        return -1;
+    }
+
+    pending = atomic_load_explicit(&(pool->task_queue.enqueue_pos), memory_order_relaxed) - atomic_load_explicit(&(pool->task_queue.dequeue_pos), memory_order_relaxed);
+    batch   = pending / (size_t)pool->nthreads;
+    if(batch > INJECT_BATCH)
+    {
+        batch = INJECT_BATCH;
+    }
+    for(size_t i = 0; i < batch; ++i)
+    {
+        if(task_queue_try_pop(&(pool->task_queue), &extra) == -1)
+        {
+            break;
+        }
+        if(work_deque_push(&(worker->deque), &extra) == -1)
+        {
+            // 덱이 가득 차면 돌려놓는다 (방금 자리를 비웠으므로 실패하지 않는다)
+            task_queue_push(&(pool->task_queue), &extra);
+            break;
+        }
+    }
+    return 0;
+}
+
+// 무작위 워커부터 차례로 한 바퀴 돌며 하나를 훔친다
+static int steal_task(Worker *worker, Task *task)
+{
+    ThreadPool *pool = worker->pool;
+    int         n    = pool->nthreads;
+    int         start;
+
+    if(n == 1)
+    {
+        return -1;
+    }
+
+    // xorshift
+    worker->seed ^= worker->seed << 13;
+    worker->seed ^= worker->seed >> 17;
+    worker->seed ^= worker->seed << 5;
+    start = (int)(worker->seed % (unsigned int)n);
+
+    for(int i = 0; i < n; ++i)
+    {
+        Worker *victim = &(pool->workers[(start + i) % n]);
+        if(victim != worker && work_deque_steal(&(victim->deque), task) == 0)
+        {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// 주입 큐나 어느 워커의 덱에 작업이 남아 있는지 확인
+static int has_work(ThreadPool *pool)
+{
+    if(atomic_load(&(pool->task_queue.enqueue_pos)) != atomic_load(&(pool->task_queue.dequeue_pos)))
+    {
+        return 1;
+    }
+    for(int i = 0; i < pool->nthreads; ++i)
+    {
+        if(!work_deque_empty(&(pool->workers[i].deque)))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// 이 프로세스가 실행될 수 있는 CPU 번호를 채우고 개수를 돌려준다
+static int allowed_cpus(int *cpus, int max)
+{
+    cpu_set_t set;
+    int       n = 0;
+
+    if(sched_getaffinity(0, sizeof(set), &set) == -1)
+    {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        for(int i = 0; i < online && n < max; ++i)
+        {
+            cpus[n++] = i;
+        }
+    }
+    else
+    {
+        for(int i = 0; i < CPU_SETSIZE && n < max; ++i)
+        {
+            if(CPU_ISSET(i, &set))
+            {
+                cpus[n++] = i;
+            }
+        }
+    }
+    if(n == 0)
+    {
+        cpus[n++] = 0;
+    }
+    return n;
+}
+
+static void run_task(ThreadPool *pool, const Task *task)
+{
+    // 작업 실행
+    (*(task->function))(task->argument);
+    thread_pool_release(pool);
+}
+
+// 잠든 워커 하나를 깨운다 (이벤트 루프에서 잠들었으면 루프를 깨운다)
+// 종료 중에는 루프 대신 futex 에서 잠들므로 둘 다 깨운다
+static void wake_worker(ThreadPool *pool)
+{
+    int     id = idle_set_claim(&(pool->idle));
+    Worker *worker;
+
+    if(id < 0)
+    {
+        return;
+    }
+    worker = &(pool->workers[id]);
+    if(worker->wake != NULL)
+    {
+        worker->wake(worker->loop_ctx);
+    }
+    if(worker->wake == NULL || atomic_load(&(pool->shutdown)))
+    {
+        idle_set_wake(&(pool->idle), id);
+    }
+}
+
+static void wake_all_workers(ThreadPool *pool)
+{
+    idle_set_wake_all(&(pool->idle));
+    for(int i = 0; i < pool->nthreads; ++i)
+    {
+        if(pool->workers[i].wake != NULL)
+        {
+            pool->workers[i].wake(pool->workers[i].loop_ctx);
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include "idle_set.h"
+#include "task_queue.h"
+#include "work_deque.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdnoreturn.h>
+
+#define THREAD_POOL_MAX IDLE_SET_MAX    // 워커 수 상한 (IdleSet 비트 수)
+#define TASK_QUEUE_SIZE 128             // 워커 하나당 주입 큐 크기
+#define INJECT_BATCH 32                 // 주입 큐에서 한 번에 덱으로 옮길 최대 작업 수
+#define LOOP_POLL_INTERVAL 32           // 바쁠 때도 이 작업 수마다 이벤트 루프를 한 번 확인한다
+#define LOOP_IDLE_TIMEOUT 1000          // 일감이 없을 때 이벤트 루프에서 기다리는 최대 시간 (ms)
+
+typedef struct ThreadPool ThreadPool;
+
+// 워커가 함께 돌리는 이벤트 루프 (이벤트를 처리한 수를 돌려준다)
+typedef int (*PollFunction)(void *ctx, int timeout_ms);
+// 이벤트 루프에서 잠든 워커를 다른 스레드가 깨운다
+typedef void (*WakeFunction)(void *ctx);
+
+// 워커 스레드 구조체 정의
+typedef struct
+{
+    WorkDeque    deque;     // 이 워커의 작업 덱 (다른 워커가 훔쳐 간다)
+    ThreadPool  *pool;
+    int          id;        // IdleSet 에서 쓰는 고유 번호
+    int          cpu;       // 고정할 CPU (-1 이면 고정하지 않는다)
+    unsigned int seed;      // 훔칠 워커를 고르는 난수 상태
+    PollFunction poll;      // 이 워커가 소유한 이벤트 루프 (없으면 NULL)
+    WakeFunction wake;
+    void        *loop_ctx;
+    pthread_t    thread;
+} Worker;
+
+// 작업 훔치기 스케줄러 구조체 정의
+struct ThreadPool
+{
+    Worker     *workers;         // 워커 배열
+    int         nthreads;        // 워커 수
+    TaskQueue   task_queue;      // 워커가 아닌 스레드(리액터)가 작업을 넣는 주입 큐
+    IdleSet     idle;            // 일감이 없어 잠든 워커
+    atomic_int  shutdown;        // 종료 여부
+    atomic_uint active_tasks;    // 큐에 있거나 실행 중인 작업 수 (0 이 되면 futex 로 알린다)
+};
+
+noreturn void *thread_function(void *arg);
+int            thread_pool_init(ThreadPool *pool, int nthreads, int pin);
+void           thread_pool_attach_loop(ThreadPool *pool, int id, PollFunction poll, WakeFunction wake, void *ctx);
+void           thread_pool_start(ThreadPool *pool);
+void           thread_pool_add_task(ThreadPool *pool, void (*function)(void *), void *argument);
+void           thread_pool_hold(ThreadPool *pool);
+void           thread_pool_release(ThreadPool *pool);
+void           thread_pool_wait_all_tasks_completed(ThreadPool *pool);
+void           thread_pool_shutdown(ThreadPool *pool);
+size_t         thread_pool_queued(ThreadPool *pool);
+
+#endif
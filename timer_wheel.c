@@ -0,0 +1,159 @@
+#include "timer_wheel.h"
+#include <stddef.h>
+
+static void   slot_append(Timer *head, Timer *timer);
+static Timer *slot_take(Timer *head);
+static void   cascade(TimerWheel *wheel, int level);
+
+// now 는 지금 틱 (이 틱에 만료되는 타이머는 다음 advance 에서 나온다)
+void timer_wheel_init(TimerWheel *wheel, uint64_t now)
+{
+    wheel->next = now;
+    for(int level = 0; level < TIMER_WHEEL_LEVELS; ++level)
+    {
+        for(int i = 0; i < TIMER_WHEEL_SLOTS; ++i)
+        {
+            wheel->slots[level][i].prev = &(wheel->slots[level][i]);
+            wheel->slots[level][i].next = &(wheel->slots[level][i]);
+        }
+    }
+}
+
+// 이미 걸려 있으면 먼저 timer_cancel 한다. 이미 지난 틱이면 다음 advance 에서 만료된다
+void timer_add(TimerWheel *wheel, Timer *timer, uint64_t expires)
+{
+    uint64_t max   = (1ULL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1;
+    uint64_t delta;
+    int      level = 0;
+
+    if(expires < wheel->next)
+    {
+        expires = wheel->next;
+    }
+    delta = expires - wheel->next;
+    if(delta > max)
+    {
+        expires = wheel->next + max;
+        delta   = max;
+    }
+    while(level < TIMER_WHEEL_LEVELS - 1 && delta >= (1ULL << (TIMER_WHEEL_BITS * (level + 1))))
+    {
+        level++;
+    }
+    timer->expires = expires;
+    slot_append(&(wheel->slots[level][(expires >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK]), timer);
+}
+
+// 걸려 있지 않으면 아무것도 하지 않는다 (휠이 없어도 된다)
+void timer_cancel(Timer *timer)
+{
+    if(timer->prev == NULL)
+    {
+        return;
+    }
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->prev       = NULL;
+    timer->next       = NULL;
+}
+
+// now 틱까지 만료된 타이머를 휠에서 빼서 next 로 이은 목록으로 돌려준다 (prev 는 NULL)
+Timer *timer_wheel_advance(TimerWheel *wheel, uint64_t now)
+{
+    Timer *expired = NULL;
+
+    while(wheel->next <= now)
+    {
+        int    index = (int)(wheel->next & TIMER_WHEEL_MASK);
+        Timer *timer;
+
+        if(index == 0)
+        {
+            cascade(wheel, 1);
+        }
+        while((timer = slot_take(&(wheel->slots[0][index]))) != NULL)
+        {
+            timer->next = expired;
+            expired     = timer;
+        }
+        wheel->next++;
+    }
+    return expired;
+}
+
+// 걸려 있는 타이머를 모두 빼서 돌려준다 (닫을 때)
+Timer *timer_wheel_take_all(TimerWheel *wheel)
+{
+    Timer *all = NULL;
+
+    for(int level = 0; level < TIMER_WHEEL_LEVELS; ++level)
+    {
+        for(int i = 0; i < TIMER_WHEEL_SLOTS; ++i)
+        {
+            Timer *timer;
+
+            while((timer = slot_take(&(wheel->slots[level][i]))) != NULL)
+            {
+                timer->next = all;
+                all         = timer;
+            }
+        }
+    }
+    return all;
+}
+
+static void slot_append(Timer *head, Timer *timer)
+{
+    timer->prev      = head->prev;
+    timer->next      = head;
+    head->prev->next = timer;
+    head->prev       = timer;
+}
+
+// 슬롯의 첫 타이머를 빼서 돌려준다. 비었으면 NULL
+static Timer *slot_take(Timer *head)
+{
+    Timer *timer = head->next;
+
+    if(timer == head)
+    {
+        return NULL;
+    }
+    timer_cancel(timer);
+    return timer;
+}
+
+// 단계 0 이 한 바퀴 돌 때마다 윗단계의 지금 슬롯을 아랫단계로 다시 나눈다. 그 슬롯이 0 이면 더 윗단계도
+static void cascade(TimerWheel *wheel, int level)
+{
+    int    index;
+    Timer  list;
+    Timer *timer;
+
+    if(level >= TIMER_WHEEL_LEVELS)
+    {
+        return;
+    }
+    index = (int)((wheel->next >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK);
+    if(index == 0)
+    {
+        cascade(wheel, level + 1);
+    }
+
+    // 다시 넣는 동안 같은 슬롯에 돌아오지 않도록 먼저 통째로 떼어 낸다
+    list.prev = &list;
+    list.next = &list;
+    if(wheel->slots[level][index].next != &(wheel->slots[level][index]))
+    {
+        list.next       = wheel->slots[level][index].next;
+        list.prev       = wheel->slots[level][index].prev;
+        list.next->prev = &list;
+        list.prev->next = &list;
+        wheel->slots[level][index].next = &(wheel->slots[level][index]);
+        wheel->slots[level][index].prev = &(wheel->slots[level][index]);
+    }
+    while((timer = slot_take(&list)) != NULL)
+    {
+        timer_add(wheel, timer, timer->expires);
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+
+#define TIMER_WHEEL_BITS 6                              // 단계마다 슬롯 수의 로그
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_LEVELS 4                            // 64^4 틱까지 (더 먼 만료는 끝 단계에 둔다)
+
+// 타이머 하나. 쓰는 쪽 구조체에 넣어 두고 할당하지 않는다
+typedef struct Timer
+{
+    uint64_t      expires;    // 만료 틱
+    struct Timer *prev;       // 슬롯의 원형 목록 (걸려 있지 않으면 NULL)
+    struct Timer *next;       // 만료되어 돌려받은 목록에서는 다음 타이머
+} Timer;
+
+// 계층 타이머 휠 구조체 정의
+// 단계 0 은 틱마다, 단계 n 은 64^n 틱마다 한 슬롯씩 넘어가며 윗단계 슬롯을 아랫단계로 내린다 (cascade)
+// 넣기와 취소는 목록 연결만 바꾸므로 O(1), 만료 처리는 지난 틱 수와 만료된 타이머 수에 비례한다
+// 락이 없으므로 여러 스레드가 쓰면 호출한 쪽이 감싼다
+typedef struct
+{
+    uint64_t next;                                            // 다음에 처리할 틱
+    Timer    slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];    // 슬롯마다 원형 목록의 머리
+} TimerWheel;
+
+void   timer_wheel_init(TimerWheel *wheel, uint64_t now);
+void   timer_add(TimerWheel *wheel, Timer *timer, uint64_t expires);
+void   timer_cancel(Timer *timer);
+Timer *timer_wheel_advance(TimerWheel *wheel, uint64_t now);
+Timer *timer_wheel_take_all(TimerWheel *wheel);
+
+#endif
@@ -0,0 +1,196 @@
+#include "uring.h"
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define CQ_FACTOR 4    // 완료 큐 크기 = 제출 큐 크기 * CQ_FACTOR (연결마다 recv 하나가 걸려 있을 수 있다)
+
+static int enter(Uring *ring, unsigned int to_submit, unsigned int min_complete, unsigned int flags, const void *arg, size_t arg_size);
+
+// 링을 만들고 커널과 나눠 쓰는 큐를 mmap 한다. 제한 시간을 둔 대기 (IORING_FEAT_EXT_ARG, 5.11) 가 없는 커널이면 -1
+int uring_init(Uring *ring, unsigned int entries)
+{
+    struct io_uring_params params;
+    unsigned int          *array;
+    int                    fd;
+
+    memset(&params, 0, sizeof(params));
+    params.flags      = IORING_SETUP_CQSIZE;
+    params.cq_entries = entries * CQ_FACTOR;
+    fd                = (int)syscall(SYS_io_uring_setup, entries, &params);
+    if(fd == -1)
+    {
+        return -1;
+    }
+    if(!(params.features & IORING_FEAT_EXT_ARG))
+    {
+        close(fd);
+        errno = ENOSYS;
+        return -1;
+    }
+
+    ring->fd           = fd;
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size    = params.sq_entries * sizeof(struct io_uring_sqe);
+    if(params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if(ring->cq_ring_size > ring->sq_ring_size)
+        {
+            ring->sq_ring_size = ring->cq_ring_size;
+        }
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if(ring->sq_ring == MAP_FAILED)
+    {
+        close(fd);
+        return -1;
+    }
+    ring->cq_ring = ring->sq_ring;
+    if(!(params.features & IORING_FEAT_SINGLE_MMAP))
+    {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if(ring->cq_ring == MAP_FAILED)
+        {
+            munmap(ring->sq_ring, ring->sq_ring_size);
+            close(fd);
+            return -1;
+        }
+    }
+    ring->sqes = (struct io_uring_sqe *)mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if(ring->sqes == MAP_FAILED)
+    {
+        if(ring->cq_ring != ring->sq_ring)
+        {
+            munmap(ring->cq_ring, ring->cq_ring_size);
+        }
+        munmap(ring->sq_ring, ring->sq_ring_size);
+        close(fd);
+        return -1;
+    }
+
+    ring->sq_entries = params.sq_entries;
+    ring->sq_mask    = *(unsigned int *)((char *)ring->sq_ring + params.sq_off.ring_mask);
+    ring->sq_head    = (atomic_uint *)((char *)ring->sq_ring + params.sq_off.head);
+    ring->sq_tail    = (atomic_uint *)((char *)ring->sq_ring + params.sq_off.tail);
+    ring->cq_mask    = *(unsigned int *)((char *)ring->cq_ring + params.cq_off.ring_mask);
+    ring->cq_head    = (atomic_uint *)((char *)ring->cq_ring + params.cq_off.head);
+    ring->cq_tail    = (atomic_uint *)((char *)ring->cq_ring + params.cq_off.tail);
+    ring->cqes       = (struct io_uring_cqe *)((char *)ring->cq_ring + params.cq_off.cqes);
+
+    // 제출 큐 항목은 언제나 tail 과 같은 자리에 쓰므로 간접 배열은 처음에 한 번만 채운다
+    array = (unsigned int *)((char *)ring->sq_ring + params.sq_off.array);
+    for(unsigned int i = 0; i < params.sq_entries; ++i)
+    {
+        array[i] = i;
+    }
+    pthread_mutex_init(&(ring->submit_mutex), NULL);
+    return 0;
+}
+
+// 링을 닫으면 커널이 남은 요청을 취소한다
+void uring_destroy(Uring *ring)
+{
+    munmap(ring->sqes, ring->sqes_size);
+    if(ring->cq_ring != ring->sq_ring)
+    {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->fd);
+    pthread_mutex_destroy(&(ring->submit_mutex));
+}
+
+// 제출 큐에 항목 하나를 넣는다 (커널에 알리는 것은 uring_submit 이나 uring_wait). 아무 스레드에서나 부를 수 있다
+int uring_queue(Uring *ring, const struct io_uring_sqe *sqe)
+{
+    unsigned int tail;
+
+    pthread_mutex_lock(&(ring->submit_mutex));
+    tail = atomic_load_explicit(ring->sq_tail, memory_order_relaxed);
+    while(tail - atomic_load_explicit(ring->sq_head, memory_order_acquire) == ring->sq_entries)
+    {
+        // 가득 찼으면 커널이 가져가게 한다 (io_uring_enter 는 제출한 만큼 head 를 바로 옮긴다)
+        if(enter(ring, ring->sq_entries, 0, 0, NULL, 0) == -1)
+        {
+            pthread_mutex_unlock(&(ring->submit_mutex));
+            return -1;
+        }
+    }
+    ring->sqes[tail & ring->sq_mask] = *sqe;
+    atomic_store_explicit(ring->sq_tail, tail + 1, memory_order_release);
+    pthread_mutex_unlock(&(ring->submit_mutex));
+    return 0;
+}
+
+// 쌓인 항목을 커널에 넘긴다 (기다리지 않는다)
+// 다른 스레드가 동시에 넣고 있어도 된다. 커널은 넘긴 수와 실제로 쌓인 수 중 작은 만큼만 가져간다
+int uring_submit(Uring *ring)
+{
+    unsigned int pending = atomic_load_explicit(ring->sq_tail, memory_order_acquire) - atomic_load_explicit(ring->sq_head, memory_order_acquire);
+
+    if(pending == 0)
+    {
+        return 0;
+    }
+    return enter(ring, pending, 0, 0, NULL, 0) == -1 ? -1 : 0;
+}
+
+// 쌓인 항목을 넘기고 완료가 하나 이상 생기거나 timeout_ms 가 지날 때까지 기다린다 (음수면 제한 없이, 0 이면 넘기기만)
+int uring_wait(Uring *ring, int timeout_ms)
+{
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec      ts;
+    unsigned int                  pending;
+
+    if(timeout_ms == 0 || atomic_load_explicit(ring->cq_head, memory_order_relaxed) != atomic_load_explicit(ring->cq_tail, memory_order_acquire))
+    {
+        return uring_submit(ring);
+    }
+    memset(&arg, 0, sizeof(arg));
+    if(timeout_ms > 0)
+    {
+        ts.tv_sec  = timeout_ms / 1000;
+        ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+        arg.ts     = (uint64_t)(uintptr_t)&ts;
+    }
+    pending = atomic_load_explicit(ring->sq_tail, memory_order_acquire) - atomic_load_explicit(ring->sq_head, memory_order_acquire);
+    if(enter(ring, pending, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg)) == -1 && errno != ETIME)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+// 완료 큐에서 항목 하나를 꺼낸다. 없으면 0 (링을 소유한 스레드만 부른다)
+int uring_peek(Uring *ring, struct io_uring_cqe *cqe)
+{
+    unsigned int head = atomic_load_explicit(ring->cq_head, memory_order_relaxed);
+
+    if(head == atomic_load_explicit(ring->cq_tail, memory_order_acquire))
+    {
+        return 0;
+    }
+    *cqe = ring->cqes[head & ring->cq_mask];
+    atomic_store_explicit(ring->cq_head, head + 1, memory_order_release);
+    return 1;
+}
+
+static int enter(Uring *ring, unsigned int to_submit, unsigned int min_complete, unsigned int flags, const void *arg, size_t arg_size)
+{
+    long n;
+
+    do
+    {
+        n = syscall(SYS_io_uring_enter, ring->fd, to_submit, min_complete, flags, arg, arg_size);
+    } while(n == -1 && errno == EINTR && min_complete == 0);
+    if(n == -1 && errno == EINTR)
+    {
+        errno = ETIME;    // 기다리다 시그널을 받았으면 제한 시간이 지난 것처럼 돌아간다
+    }
+    return (int)n;
+}
@@ -0,0 +1,38 @@
+#ifndef URING_H
+#define URING_H
+
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+// liburing 없이 시스템 콜로 직접 쓰는 io_uring 인스턴스
+// 제출 큐는 여러 스레드가 submit_mutex 로 나눠 쓰고 (워커가 연결을 돌려줄 때), 완료 큐는 uring_wait 을 부르는 스레드 하나만 읽는다
+typedef struct
+{
+    int                  fd;
+    unsigned int         sq_entries;
+    unsigned int         sq_mask;
+    atomic_uint         *sq_head;         // 커널이 옮긴다
+    atomic_uint         *sq_tail;
+    struct io_uring_sqe *sqes;
+    unsigned int         cq_mask;
+    atomic_uint         *cq_head;
+    atomic_uint         *cq_tail;         // 커널이 옮긴다
+    struct io_uring_cqe *cqes;
+    void                *sq_ring;         // 커널과 나눠 쓰는 mmap 영역
+    size_t               sq_ring_size;
+    void                *cq_ring;         // IORING_FEAT_SINGLE_MMAP 이면 sq_ring 과 같다
+    size_t               cq_ring_size;
+    size_t               sqes_size;
+    pthread_mutex_t      submit_mutex;    // 제출 큐 tail 을 옮기는 스레드를 하나로
+} Uring;
+
+int  uring_init(Uring *ring, unsigned int entries);
+void uring_destroy(Uring *ring);
+int  uring_queue(Uring *ring, const struct io_uring_sqe *sqe);
+int  uring_submit(Uring *ring);
+int  uring_wait(Uring *ring, int timeout_ms);
+int  uring_peek(Uring *ring, struct io_uring_cqe *cqe);
+
+#endif
@@ -0,0 +1,88 @@
+#include "work_deque.h"
+
+void work_deque_init(WorkDeque *deque)
+{
+    atomic_init(&(deque->top), 0);
+    atomic_init(&(deque->bottom), 0);
+}
+
+// 주인 워커만 호출한다. 가득 찼으면 -1
+int work_deque_push(WorkDeque *deque, const Task *task)
+{
+    long bottom = atomic_load_explicit(&(deque->bottom), memory_order_relaxed);
+    long top    = atomic_load_explicit(&(deque->top), memory_order_acquire);
+
+    if(bottom - top >= WORK_DEQUE_SIZE)
+    {
+        return -1;
+    }
+    deque->tasks[bottom & (WORK_DEQUE_SIZE - 1)] = *task;
+    // 작업을 쓴 뒤에 bottom 을 올려야 훔치는 쪽이 빈 칸을 읽지 않는다
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&(deque->bottom), bottom + 1, memory_order_relaxed);
+    return 0;
+}
+
+// 주인 워커만 호출한다. 가장 최근에 넣은 작업을 꺼낸다. 비었으면 -1
+int work_deque_take(WorkDeque *deque, Task *task)
+{
+    long bottom = atomic_load_explicit(&(deque->bottom), memory_order_relaxed) - 1;
+    long top;
+
+    atomic_store_explicit(&(deque->bottom), bottom, memory_order_relaxed);
+    // bottom 을 줄인 것이 훔치는 쪽에 보인 뒤에 top 을 읽는다
+    atomic_thread_fence(memory_order_seq_cst);
+    top = atomic_load_explicit(&(deque->top), memory_order_relaxed);
+
+    if(top > bottom)
+    {
+        // 비어 있다
+        atomic_store_explicit(&(deque->bottom), bottom + 1, memory_order_relaxed);
+        return -1;
+    }
+
+    *task = deque->tasks[bottom & (WORK_DEQUE_SIZE - 1)];
+    if(top == bottom)
+    {
+        // 마지막 하나는 훔치는 쪽과 top 을 두고 경쟁한다
+        int won = atomic_compare_exchange_strong_explicit(&(deque->top), &top, top + 1, memory_order_seq_cst, memory_order_relaxed);
+        atomic_store_explicit(&(deque->bottom), bottom + 1, memory_order_relaxed);
+        return won ? 0 : -1;
+    }
+    return 0;
+}
+
+// 다른 워커가 호출한다. 가장 오래된 작업을 가져간다. 비었거나 경쟁에서 지면 -1
+int work_deque_steal(WorkDeque *deque, Task *task)
+{
+    long top = atomic_load_explicit(&(deque->top), memory_order_acquire);
+    long bottom;
+
+    atomic_thread_fence(memory_order_seq_cst);
+    bottom = atomic_load_explicit(&(deque->bottom), memory_order_acquire);
+    if(top >= bottom)
+    {
+        return -1;
+    }
+
+    // CAS 에 성공한 경우에만 읽은 작업이 유효하다
+    *task = deque->tasks[top & (WORK_DEQUE_SIZE - 1)];
+    if(!atomic_compare_exchange_strong_explicit(&(deque->top), &top, top + 1, memory_order_seq_cst, memory_order_relaxed))
+    {
+        return -1;
+    }
+    return 0;
+}
+
+// 잠들기 전 확인용 (정확하지 않아도 된다)
+int work_deque_empty(WorkDeque *deque)
+{
+    return atomic_load(&(deque->top)) >= atomic_load(&(deque->bottom));
+}
+
+// 대략적인 작업 수 (주인이 아닌 스레드가 읽으면 그 순간의 값이 아닐 수 있다)
+long work_deque_size(WorkDeque *deque)
+{
+    long size = atomic_load(&(deque->bottom)) - atomic_load(&(deque->top));
+    return size > 0 ? size : 0;
+}
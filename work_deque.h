@@ -0,0 +1,25 @@
+#ifndef WORK_DEQUE_H
+#define WORK_DEQUE_H
+
+#include "task_queue.h"
+#include <stdatomic.h>
+
+#define WORK_DEQUE_SIZE 256    // 워커별 덱 크기 (2의 거듭제곱)
+
+// 워커별 작업 덱 (Chase-Lev 방식)
+// 주인 워커만 bottom 쪽에서 넣고 꺼내며(LIFO), 다른 워커는 top 쪽에서 훔친다(FIFO)
+typedef struct
+{
+    _Alignas(CACHE_LINE) atomic_long top;       // 훔쳐 갈 위치
+    _Alignas(CACHE_LINE) atomic_long bottom;    // 주인이 넣을 위치
+    _Alignas(CACHE_LINE) Task tasks[WORK_DEQUE_SIZE];
+} WorkDeque;
+
+void work_deque_init(WorkDeque *deque);
+int  work_deque_push(WorkDeque *deque, const Task *task);
+int  work_deque_take(WorkDeque *deque, Task *task);
+int  work_deque_steal(WorkDeque *deque, Task *task);
+int  work_deque_empty(WorkDeque *deque);
+long work_deque_size(WorkDeque *deque);
+
+#endif